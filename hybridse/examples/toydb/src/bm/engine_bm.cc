@@ -16,8 +16,11 @@
 
 #include "benchmark/benchmark.h"
 #include "bm/engine_bm_case.h"
+#include "gflags/gflags.h"
 #include "llvm/Transforms/Scalar.h"
 
+DECLARE_uint32(project_batch_size);
+
 namespace hybridse {
 namespace bm {
 using namespace ::llvm;  // NOLINT
@@ -124,6 +127,20 @@ static void BM_EngineSimpleUDF(benchmark::State& state) {  // NOLINT
     EngineSimpleUDF(&state, BENCHMARK);
 }
 
+// the third arg is the rows projected in a batch, 1 for row at a time
+static void BM_EngineRunBatchProjectFeature5(
+    benchmark::State& state) {  // NOLINT
+    FLAGS_project_batch_size = state.range(2);
+    EngineRunBatchProjectFeature5(&state, BENCHMARK, state.range(0),
+                                  state.range(1));
+}
+static void BM_EngineRunBatchWindowSumFeature5ProjectBatch(
+    benchmark::State& state) {  // NOLINT
+    FLAGS_project_batch_size = state.range(2);
+    EngineRunBatchWindowSumFeature5(&state, BENCHMARK, state.range(0),
+                                    state.range(1));
+}
+
 static void BM_EngineRunBatchWindowSumFeature1(
     benchmark::State& state) {  // NOLINT
     EngineRunBatchWindowSumFeature1(&state, BENCHMARK, state.range(0),
@@ -276,6 +293,16 @@ BENCHMARK(BM_EngineRunBatchWindowMultiAggWindow25Feature25)
     ->Args({1000, 1000})
     ->Args({10000, 10000});
 
+// batch engine project bm
+BENCHMARK(BM_EngineRunBatchProjectFeature5)
+    ->Args({10000, 10000, 1})
+    ->Args({10000, 10000, 1024})
+    ->Args({100000, 100000, 1})
+    ->Args({100000, 100000, 1024});
+BENCHMARK(BM_EngineRunBatchWindowSumFeature5ProjectBatch)
+    ->Args({10000, 10000, 1})
+    ->Args({10000, 10000, 1024});
+
 // batch engine window bm exclude current time
 BENCHMARK(BM_EngineRunBatchWindowSumFeature1ExcludeCurrentTime)
     ->Args({1, 2})
@@ -218,6 +218,21 @@ void EngineWindowRowsSumFeature1(benchmark::State* state, MODE mode,
     EngineRequestMode(sql, mode, limit_cnt, size, state);
 }
 
+void EngineRunBatchProjectFeature5(benchmark::State* state, MODE mode,
+                                   int64_t limit_cnt,
+                                   int64_t size) {  // NOLINT
+    const std::string sql =
+        "SELECT "
+        "col1 + 1 as col1_add, "
+        "col2 + 1 as col2_add, "
+        "col3 + 1.0 as col3_add, "
+        "col4 + 1.0 as col4_add, "
+        "col5 + 1 as col5_add "
+        "FROM t1 limit " +
+        std::to_string(limit_cnt) + ";";
+    EngineBatchMode(sql, mode, limit_cnt, size, state);
+}
+
 void EngineRunBatchWindowSumFeature1(benchmark::State* state, MODE mode,
                                      int64_t limit_cnt,
                                      int64_t size) {  // NOLINT
@@ -42,6 +42,9 @@ void EngineWindowRowsSumFeature1(benchmark::State* state, MODE mode,
                                  int64_t limit_cnt,
                                  int64_t size);  // NOLINT
 
+void EngineRunBatchProjectFeature5(benchmark::State* state, MODE mode,
+                                   int64_t limit_cnt,
+                                   int64_t size);  // NOLINT
 void EngineRunBatchWindowSumFeature1ExcludeCurrentTime(benchmark::State* state,
                                                        MODE mode,
                                                        int64_t limit_cnt,
@@ -15,9 +15,11 @@
  */
 
 #include "bm/engine_bm_case.h"
+#include "gflags/gflags.h"
 #include "gtest/gtest.h"
 #include "llvm/Support/InitLLVM.h"
 #include "llvm/Support/TargetSelect.h"
+DECLARE_uint32(project_batch_size);
 namespace hybridse {
 namespace bm {
 class EngineBMCaseTest : public ::testing::Test {
@@ -81,6 +83,20 @@ TEST_F(EngineBMCaseTest, WINDOW_CASE0_QUERY_BATCH_TEST) {
     EngineRunBatchWindowSumFeature5(nullptr, TEST, 100L, 100L);
     EngineRunBatchWindowSumFeature5(nullptr, TEST, 1000L, 1000L);
 }
+TEST_F(EngineBMCaseTest, EngineRunBatchProjectFeature5_TEST) {
+    EngineRunBatchProjectFeature5(nullptr, TEST, 1L, 2L);
+    EngineRunBatchProjectFeature5(nullptr, TEST, 100L, 100L);
+    EngineRunBatchProjectFeature5(nullptr, TEST, 1000L, 1000L);
+    // the batches end in the middle of the rows and windows
+    uint32_t project_batch_size = FLAGS_project_batch_size;
+    FLAGS_project_batch_size = 3;
+    EngineRunBatchProjectFeature5(nullptr, TEST, 100L, 100L);
+    EngineRunBatchWindowSumFeature5(nullptr, TEST, 100L, 100L);
+    FLAGS_project_batch_size = 1;
+    EngineRunBatchProjectFeature5(nullptr, TEST, 100L, 100L);
+    EngineRunBatchWindowSumFeature5(nullptr, TEST, 100L, 100L);
+    FLAGS_project_batch_size = project_batch_size;
+}
 
 TEST_F(EngineBMCaseTest, EngineRequestSimpleSelectDouble_TEST) {
     EngineRequestSimpleSelectDouble(nullptr, TEST);
@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include "gflags/gflags.h"
 #include "gtest/gtest.h"
 #include "gtest/internal/gtest-param-util.h"
 #include "testing/toydb_engine_test_base.h"
@@ -21,6 +22,10 @@
 using namespace llvm;       // NOLINT (build/namespaces)
 using namespace llvm::orc;  // NOLINT (build/namespaces)
 
+DECLARE_uint32(batch_run_thread_num);
+DECLARE_uint32(project_batch_size);
+DECLARE_uint32(request_branch_thread_num);
+
 namespace hybridse {
 namespace vm {
 TEST_P(EngineTest, TestRequestEngine) {
@@ -35,6 +40,20 @@ TEST_P(EngineTest, TestRequestEngine) {
         LOG(INFO) << "Skip mode " << sql_case.mode();
     }
 }
+TEST_P(EngineTest, TestRequestEngineWithParallelBranches) {
+    ParamType sql_case = GetParam();
+    EngineOptions options;
+    LOG(INFO) << "ID: " << sql_case.id() << ", DESC: " << sql_case.desc();
+    if (!boost::contains(sql_case.mode(), "request-unsupport") &&
+        !boost::contains(sql_case.mode(), "performance-sensitive-unsupport") &&
+        !boost::contains(sql_case.mode(), "rtidb-unsupport")) {
+        FLAGS_request_branch_thread_num = 4;
+        EngineCheck(sql_case, options, kRequestMode);
+        FLAGS_request_branch_thread_num = 0;
+    } else {
+        LOG(INFO) << "Skip mode " << sql_case.mode();
+    }
+}
 TEST_P(EngineTest, TestBatchEngine) {
     ParamType sql_case = GetParam();
     EngineOptions options;
@@ -48,6 +67,25 @@ TEST_P(EngineTest, TestBatchEngine) {
         LOG(INFO) << "Skip mode " << sql_case.mode();
     }
 }
+TEST_P(EngineTest, TestBatchEngineWithParallelRunners) {
+    ParamType sql_case = GetParam();
+    EngineOptions options;
+    LOG(INFO) << "ID: " << sql_case.id() << ", DESC: " << sql_case.desc();
+    if (!boost::contains(sql_case.mode(), "batch-unsupport") &&
+        !boost::contains(sql_case.mode(), "rtidb-unsupport") &&
+        !boost::contains(sql_case.mode(), "performance-sensitive-unsupport") &&
+        !boost::contains(sql_case.mode(), "rtidb-batch-unsupport")) {
+        // every row is a morsel, so the rows of the cases are projected by different threads
+        uint32_t project_batch_size = FLAGS_project_batch_size;
+        FLAGS_batch_run_thread_num = 4;
+        FLAGS_project_batch_size = 1;
+        EngineCheck(sql_case, options, kBatchMode);
+        FLAGS_batch_run_thread_num = 0;
+        FLAGS_project_batch_size = project_batch_size;
+    } else {
+        LOG(INFO) << "Skip mode " << sql_case.mode();
+    }
+}
 TEST_P(EngineTest, TestBatchRequestEngineForLastRow) {
     ParamType sql_case = GetParam();
     EngineOptions options;
@@ -22,11 +22,14 @@
 #include <mutex>  //NOLINT
 #include <set>
 #include <string>
+#include <tuple>
 #include <utility>
 #include <vector>
 #include <unordered_map>
 #include "base/raw_buffer.h"
 #include "base/spin_lock.h"
+#include "bthread/bthread.h"
+#include "bthread/condition_variable.h"
 #include "codec/fe_row_codec.h"
 #include "codec/list_iterator_codec.h"
 #include "gflags/gflags.h"
@@ -428,6 +431,10 @@ class Engine {
                         EngineMode engine_mode,
                         std::shared_ptr<CompileInfo> info);
 
+    /// Compile sql for session and put the result into the cache
+    bool Compile(const std::string& sql, const std::string& db, RunSession& session,  // NOLINT
+                 base::Status& status);  // NOLINT
+
     bool IsCompatibleCache(RunSession& session,  // NOLINT
                            std::shared_ptr<CompileInfo> info,
                            base::Status& status);  // NOLINT
@@ -438,8 +445,20 @@ class Engine {
                  ExplainOutput* explain_output, base::Status* status);
     std::shared_ptr<Catalog> cl_;
     EngineOptions options_;
-    base::SpinMutex mu_;
     EngineLRUCache lru_cache_;
+    /// A compiling in progress. The waiters are bthreads of the tablet, so they wait on
+    /// the bthread condition variable without blocking the worker pthreads
+    struct CompilingTask {
+        bthread::Mutex mu;
+        bthread::ConditionVariable cv;
+        bool done = false;
+        /// nullptr if the compiling fails
+        std::shared_ptr<CompileInfo> info;
+    };
+    /// The compilings in progress keyed by EngineMode, DB name and SQL string. Only one
+    /// caller compiles a key at a time, and the others missing the cache wait on its result
+    std::mutex compiling_mu_;
+    std::map<std::tuple<EngineMode, std::string, std::string>, std::shared_ptr<CompilingTask>> compiling_;
 };
 
 /// \brief Local tablet is responsible to run a task locally.
@@ -15,11 +15,15 @@
  */
 #ifndef HYBRIDSE_INCLUDE_VM_ENGINE_CONTEXT_H_
 #define HYBRIDSE_INCLUDE_VM_ENGINE_CONTEXT_H_
+#include <atomic>
 #include <map>
 #include <memory>
+#include <mutex>  // NOLINT
 #include <set>
 #include <string>
-#include "boost/compute/detail/lru_cache.hpp"
+#include <unordered_map>
+#include <utility>
+#include "base/spin_lock.h"
 #include "vm/physical_op.h"
 namespace hybridse {
 namespace vm {
@@ -65,15 +69,59 @@ class CompileInfo {
                                 const std::string& tab) = 0;
 };
 
-/// @typedef EngineLRUCache
-/// - EngineMode
-///     - DB name
-///       - SQL string
-///           - CompileInfo
-typedef std::map<EngineMode,
-                std::map<std::string,
-                    boost::compute::detail::lru_cache<std::string, std::shared_ptr<CompileInfo>>>>
-    EngineLRUCache;
+/// \brief The cache of compiling results
+///
+/// The results are keyed by EngineMode, DB name and SQL string. Every EngineMode and DB
+/// name keeps at most `capacity` SQL strings, and the least recently used one of them is
+/// evicted first. The lookup maps are spread over shards by the hash of the key, each
+/// under its own lock, so the lookups of different SQL strings rarely contend with each
+/// other. Only inserting and clearing, which follow a compiling, go through all the shards.
+class EngineLRUCache {
+ public:
+    explicit EngineLRUCache(uint32_t capacity);
+    EngineLRUCache(const EngineLRUCache&) = delete;
+    EngineLRUCache& operator=(const EngineLRUCache&) = delete;
+
+    std::shared_ptr<CompileInfo> Get(EngineMode engine_mode, const std::string& db, const std::string& sql);
+
+    /// Return false if there is a cached one already, which is replaced by info only if
+    /// overwrite is true
+    bool Insert(EngineMode engine_mode, const std::string& db, const std::string& sql,
+                const std::shared_ptr<CompileInfo>& info, bool overwrite = false);
+
+    /// Clear the cached results of db, or all the results if db is empty
+    void Clear(const std::string& db);
+
+ private:
+    struct Entry {
+        std::shared_ptr<CompileInfo> info;
+        /// The tick of the last lookup, the entry with the smallest one is evicted first
+        std::atomic<uint64_t> last_used;
+    };
+    /// - EngineMode
+    ///     - DB name
+    ///       - SQL string
+    ///           - Entry
+    typedef std::map<EngineMode, std::map<std::string, std::unordered_map<std::string, std::unique_ptr<Entry>>>>
+        ShardCache;
+    struct Shard {
+        base::SpinMutex mu;
+        ShardCache cache;
+    };
+
+    Shard& GetShard(EngineMode engine_mode, const std::string& db, const std::string& sql);
+    /// Evict the least recently used SQL string of engine_mode and db, insert_mu_ is held
+    void EvictLocked(EngineMode engine_mode, const std::string& db);
+
+    uint32_t capacity_;
+    uint32_t shard_cnt_;
+    std::unique_ptr<Shard[]> shards_;
+    std::atomic<uint64_t> tick_;
+    /// Serialize the inserts and the clears, and protect sql_cnt_
+    std::mutex insert_mu_;
+    /// The count of the cached SQL strings per EngineMode and DB name
+    std::map<std::pair<EngineMode, std::string>, uint32_t> sql_cnt_;
+};
 
 class CompileInfoCache {
  public:
@@ -101,11 +149,17 @@ class JitOptions {
     bool IsEnablePerf() const { return enable_perf_; }
     void SetEnablePerf(bool flag) { enable_perf_ = flag; }
 
+    /// The directory to keep the compiled object files, which are loaded without
+    /// codegen when the same module is compiled again. Empty means disabled
+    const std::string& GetObjectCacheDir() const { return object_cache_dir_; }
+    void SetObjectCacheDir(const std::string& dir) { object_cache_dir_ = dir; }
+
  private:
     bool enable_mcjit_ = false;
     bool enable_vtune_ = false;
     bool enable_gdb_ = false;
     bool enable_perf_ = false;
+    std::string object_cache_dir_ = "";
 };
 }  // namespace vm
 }  // namespace hybridse
@@ -16,6 +16,7 @@
 
 #include "base/mem_pool.h"
 #include <string>
+#include <vector>
 #include "gtest/gtest.h"
 
 namespace hybridse {
@@ -53,6 +54,36 @@ TEST_F(MemPoolTest, ByteMemoryPoolTest) {
         ASSERT_EQ("helloworldhybri", std::string(s3, 15));
     }
 }
+
+TEST_F(MemPoolTest, SlabMemoryPoolTest) {
+    int64_t slab_cnt = ::openmldb::base::MemorySlab::LiveSlabCnt().load();
+    std::vector<char*> addrs;
+    {
+        ::openmldb::base::SlabMemoryPool mem_pool;
+        ASSERT_TRUE(mem_pool.Alloc(::openmldb::base::SlabMemoryPool::MAX_ALLOC_SIZE + 1) == nullptr);
+        for (int i = 0; i < 1000; i++) {
+            char* s = mem_pool.Alloc(100);
+            ASSERT_EQ(0u, reinterpret_cast<uintptr_t>(s) % 8);
+            memcpy(s, "helloworld", 10);
+            addrs.push_back(s);
+        }
+        ASSERT_EQ(slab_cnt + 2, ::openmldb::base::MemorySlab::LiveSlabCnt().load());
+        // the first slab is full and released once all its objects are freed
+        ::openmldb::base::MemorySlab* first = ::openmldb::base::MemorySlab::Of(addrs[0]);
+        while (!addrs.empty() && ::openmldb::base::MemorySlab::Of(addrs.front()) == first) {
+            ::openmldb::base::SlabMemoryPool::Free(addrs.front());
+            addrs.erase(addrs.begin());
+        }
+        ASSERT_EQ(slab_cnt + 1, ::openmldb::base::MemorySlab::LiveSlabCnt().load());
+    }
+    // objects can outlive the pool
+    ASSERT_EQ(slab_cnt + 1, ::openmldb::base::MemorySlab::LiveSlabCnt().load());
+    for (char* s : addrs) {
+        ASSERT_EQ("helloworld", std::string(s, 10));
+        ::openmldb::base::SlabMemoryPool::Free(s);
+    }
+    ASSERT_EQ(slab_cnt, ::openmldb::base::MemorySlab::LiveSlabCnt().load());
+}
 }  // namespace base
 }  // namespace hybridse
 
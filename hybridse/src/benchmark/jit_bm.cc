@@ -0,0 +1,123 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <unistd.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include "benchmark/benchmark.h"
+#include "vm/engine.h"
+#include "vm/jit_object_cache.h"
+#include "vm/simple_catalog.h"
+
+namespace hybridse {
+namespace bm {
+
+static std::shared_ptr<vm::SimpleCatalog> BuildDeploymentCatalog() {
+    type::Database db;
+    db.set_name("db");
+    type::TableDef* table = db.add_tables();
+    table->set_name("t1");
+    table->set_catalog("db");
+    {
+        type::ColumnDef* column = table->add_columns();
+        column->set_type(type::kVarchar);
+        column->set_name("col_1");
+    }
+    {
+        type::ColumnDef* column = table->add_columns();
+        column->set_type(type::kInt64);
+        column->set_name("col_2");
+    }
+    {
+        type::ColumnDef* column = table->add_columns();
+        column->set_type(type::kDouble);
+        column->set_name("col_3");
+    }
+    {
+        type::ColumnDef* column = table->add_columns();
+        column->set_type(type::kTimestamp);
+        column->set_name("col_4");
+    }
+    type::IndexDef* index = table->add_indexes();
+    index->set_name("index1");
+    index->add_first_keys("col_1");
+    index->set_second_key("col_4");
+    auto catalog = std::make_shared<vm::SimpleCatalog>();
+    catalog->AddDatabase(db);
+    return catalog;
+}
+
+// the window aggregations of a deployment, different for every i
+static std::string DeploymentSql(int64_t i) {
+    return "select col_1, sum(col_2 + " + std::to_string(i) + ") over w as s, avg(col_3) over w as a, " +
+           "max(col_3 * " + std::to_string(i) + ") over w as m, count(col_2) over w as c, " +
+           "distinct_count(col_2) over w as dc from t1 " +
+           "window w as (partition by col_1 order by col_4 rows_range between 1d preceding and current row);";
+}
+
+// compile the deployments like a tablet after the restart, i.e. by a new engine
+static void CompileDeployments(benchmark::State* state, const std::string& object_cache_dir,
+                               int64_t deployment_cnt) {
+    auto catalog = BuildDeploymentCatalog();
+    vm::EngineOptions options;
+    options.jit_options().SetObjectCacheDir(object_cache_dir);
+    auto compile = [&]() {
+        vm::Engine engine(catalog, options);
+        for (int64_t i = 0; i < deployment_cnt; i++) {
+            base::Status status;
+            vm::RequestRunSession session;
+            if (!engine.Get(DeploymentSql(i), "db", session, status)) {
+                state->SkipWithError(status.msg.c_str());
+                return;
+            }
+        }
+    };
+    if (!object_cache_dir.empty()) {
+        // the objects are saved before the restart
+        compile();
+    }
+    for (auto _ : *state) {
+        compile();
+    }
+    state->SetItemsProcessed(state->iterations() * deployment_cnt);
+}
+
+static void BM_CompileDeployments(benchmark::State& state) {  // NOLINT
+    CompileDeployments(&state, "", state.range(0));
+}
+
+static void BM_CompileDeploymentsWithObjectCache(benchmark::State& state) {  // NOLINT
+    std::string dir = "/tmp/hybridse_jit_bm_" + std::to_string(getpid());
+    CompileDeployments(&state, dir, state.range(0));
+    auto object_cache = vm::JitObjectCache::GetInstance(dir);
+    state.counters["hit"] = object_cache->GetHitCnt();
+    state.counters["miss"] = object_cache->GetMissCnt();
+}
+
+BENCHMARK(BM_CompileDeployments)->Args({10})->Args({100})->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_CompileDeploymentsWithObjectCache)->Args({10})->Args({100})->Unit(benchmark::kMillisecond);
+
+}  // namespace bm
+}  // namespace hybridse
+
+int main(int argc, char** argv) {
+    hybridse::vm::Engine::InitializeGlobalLLVM();
+    ::benchmark::Initialize(&argc, argv);
+    ::benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
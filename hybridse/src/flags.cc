@@ -22,3 +22,15 @@ DEFINE_string(default_db_name, "_hybridse",
 // Offline Spark config
 DEFINE_bool(enable_spark_unsaferow_format, false,
             "config if codec uses Spark UnsafeRow format");
+
+// batch runner config
+DEFINE_uint32(project_batch_size, 1024,
+              "config the rows projected by batch runners between two releases of "
+              "jit runtime, 1 means releasing after every row");
+DEFINE_uint32(batch_run_thread_num, 0,
+              "config the threads running the partitions and rows of batch "
+              "runners in parallel with the calling thread, 0 means disabled");
+DEFINE_uint32(request_branch_thread_num, 0,
+              "config the threads running the independent branches of a "
+              "query, e.g. the windows over different keys of a request, in "
+              "parallel with the calling thread, 0 means disabled");
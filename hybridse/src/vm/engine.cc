@@ -15,6 +15,9 @@
  */
 
 #include "vm/engine.h"
+#include <algorithm>
+#include <functional>
+#include <limits>
 #include <string>
 #include <utility>
 #include <vector>
@@ -53,9 +56,10 @@ EngineOptions::EngineOptions()
       max_sql_cache_size_(50) {
 }
 
-Engine::Engine(const std::shared_ptr<Catalog>& catalog) : cl_(catalog), options_(), mu_(), lru_cache_() {}
+Engine::Engine(const std::shared_ptr<Catalog>& catalog)
+    : cl_(catalog), options_(), lru_cache_(options_.GetMaxSqlCacheSize()) {}
 Engine::Engine(const std::shared_ptr<Catalog>& catalog, const EngineOptions& options)
-    : cl_(catalog), options_(options), mu_(), lru_cache_() {}
+    : cl_(catalog), options_(options), lru_cache_(options_.GetMaxSqlCacheSize()) {}
 Engine::~Engine() {}
 void Engine::InitializeGlobalLLVM() {
     if (LLVM_IS_INITIALIZED) return;
@@ -214,6 +218,73 @@ bool Engine::Get(const std::string& sql, const std::string& db, RunSession& sess
         LOG(WARNING) << status;
         status = base::Status::OK();
     }
+    auto key = std::make_tuple(session.engine_mode(), db, sql);
+    std::shared_ptr<CompilingTask> task;
+    bool leader = false;
+    {
+        std::lock_guard<std::mutex> lock(compiling_mu_);
+        auto iter = compiling_.find(key);
+        if (iter == compiling_.end()) {
+            task = std::make_shared<CompilingTask>();
+            compiling_.emplace(key, task);
+            leader = true;
+        } else {
+            task = iter->second;
+        }
+    }
+    if (!leader) {
+        std::shared_ptr<CompileInfo> info;
+        {
+            std::unique_lock<bthread::Mutex> lock(task->mu);
+            while (!task->done) {
+                task->cv.wait(lock);
+            }
+            info = task->info;
+        }
+        // the result of the same sql compiled for another session is reused if it's compatible,
+        // otherwise it's compiled again for this session
+        if (info && IsCompatibleCache(session, info, status)) {
+            session.SetCompileInfo(info);
+            return true;
+        }
+        status = base::Status::OK();
+        return Compile(sql, db, session, status);
+    }
+    // the waiters are woken up on every exit of the leader, without the result if it fails
+    struct CompilingGuard {
+        ~CompilingGuard() {
+            {
+                std::lock_guard<std::mutex> lock(engine->compiling_mu_);
+                engine->compiling_.erase(*key);
+            }
+            std::lock_guard<bthread::Mutex> lock(task->mu);
+            task->info = info;
+            task->done = true;
+            task->cv.notify_all();
+        }
+        Engine* engine;
+        const std::tuple<EngineMode, std::string, std::string>* key;
+        CompilingTask* task;
+        std::shared_ptr<CompileInfo> info;
+    } guard{this, &key, task.get(), nullptr};
+    // the compiling of the key before may finish between the lookup of the cache and the one of compiling_
+    cached_info = GetCacheLocked(db, sql, session.engine_mode());
+    bool ok = false;
+    if (cached_info && IsCompatibleCache(session, cached_info, status)) {
+        session.SetCompileInfo(cached_info);
+        ok = true;
+    } else {
+        status = base::Status::OK();
+        ok = Compile(sql, db, session, status);
+    }
+    if (ok) {
+        guard.info = session.GetCompileInfo();
+    }
+    return ok;
+}
+
+bool Engine::Compile(const std::string& sql, const std::string& db, RunSession& session,
+                     base::Status& status) {  // NOLINT (runtime/references)
     DLOG(INFO) << "Compile Engine ...";
     status = base::Status::OK();
     std::shared_ptr<SqlCompileInfo> info = std::make_shared<SqlCompileInfo>();
@@ -368,17 +439,7 @@ bool Engine::Explain(const std::string& sql, const std::string& db, EngineMode e
     return Explain(sql, db, engine_mode, empty_schema, common_column_indices, explain_output, status);
 }
 
-void Engine::ClearCacheLocked(const std::string& db) {
-    std::lock_guard<base::SpinMutex> lock(mu_);
-    if (db.empty()) {
-        lru_cache_.clear();
-        return;
-    }
-    for (auto& cache : lru_cache_) {
-        auto& mode_cache = cache.second;
-        mode_cache.erase(db);
-    }
-}
+void Engine::ClearCacheLocked(const std::string& db) { lru_cache_.Clear(db); }
 
 EngineOptions Engine::GetEngineOptions() {
     return options_;
@@ -386,10 +447,47 @@ EngineOptions Engine::GetEngineOptions() {
 
 std::shared_ptr<CompileInfo> Engine::GetCacheLocked(const std::string& db, const std::string& sql,
                                                     EngineMode engine_mode) {
-    std::lock_guard<base::SpinMutex> lock(mu_);
+    return lru_cache_.Get(engine_mode, db, sql);
+}
+
+bool Engine::SetCacheLocked(const std::string& db, const std::string& sql, EngineMode engine_mode,
+                            std::shared_ptr<CompileInfo> info) {
+    // the result of batch request mode depends on the common column indices of the session,
+    // so the cached one is replaced by the latest one
+    if (lru_cache_.Insert(engine_mode, db, sql, info, engine_mode == kBatchRequestMode) ||
+        engine_mode == kBatchRequestMode) {
+        return true;
+    }
+    // TODO(xxx): Ensure compile result is stable
+    DLOG(INFO) << "Engine cache already exists: " << engine_mode << " " << db << "\n" << sql;
+    return false;
+}
+
+static const uint32_t ENGINE_CACHE_SHARD_CNT = 16;
+
+EngineLRUCache::EngineLRUCache(uint32_t capacity)
+    : capacity_(std::max(1u, capacity)),
+      shard_cnt_(ENGINE_CACHE_SHARD_CNT),
+      shards_(new Shard[shard_cnt_]),
+      tick_(0),
+      insert_mu_(),
+      sql_cnt_() {}
+
+EngineLRUCache::Shard& EngineLRUCache::GetShard(EngineMode engine_mode, const std::string& db,
+                                                const std::string& sql) {
+    size_t hash = std::hash<std::string>()(sql);
+    hash ^= std::hash<std::string>()(db) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    hash ^= static_cast<size_t>(engine_mode) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    return shards_[hash % shard_cnt_];
+}
+
+std::shared_ptr<CompileInfo> EngineLRUCache::Get(EngineMode engine_mode, const std::string& db,
+                                                 const std::string& sql) {
+    Shard& shard = GetShard(engine_mode, db, sql);
+    std::lock_guard<base::SpinMutex> lock(shard.mu);
     // Check mode
-    auto mode_iter = lru_cache_.find(engine_mode);
-    if (mode_iter == lru_cache_.end()) {
+    auto mode_iter = shard.cache.find(engine_mode);
+    if (mode_iter == shard.cache.end()) {
         return nullptr;
     }
     auto& mode_cache = mode_iter->second;
@@ -398,36 +496,96 @@ std::shared_ptr<CompileInfo> Engine::GetCacheLocked(const std::string& db, const
     if (db_iter == mode_cache.end()) {
         return nullptr;
     }
-    auto& lru = db_iter->second;
-
     // Check SQL
-    auto value = lru.get(sql);
-    if (value == boost::none) {
+    auto sql_iter = db_iter->second.find(sql);
+    if (sql_iter == db_iter->second.end()) {
         return nullptr;
-    } else {
-        return value.value();
     }
+    Entry& entry = *sql_iter->second;
+    entry.last_used.store(tick_.fetch_add(1, std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    return entry.info;
 }
 
-bool Engine::SetCacheLocked(const std::string& db, const std::string& sql, EngineMode engine_mode,
-                            std::shared_ptr<CompileInfo> info) {
-    std::lock_guard<base::SpinMutex> lock(mu_);
+bool EngineLRUCache::Insert(EngineMode engine_mode, const std::string& db, const std::string& sql,
+                            const std::shared_ptr<CompileInfo>& info, bool overwrite) {
+    std::lock_guard<std::mutex> insert_lock(insert_mu_);
+    {
+        Shard& shard = GetShard(engine_mode, db, sql);
+        std::lock_guard<base::SpinMutex> lock(shard.mu);
+        auto& sqls = shard.cache[engine_mode][db];
+        auto sql_iter = sqls.find(sql);
+        uint64_t tick = tick_.fetch_add(1, std::memory_order_relaxed) + 1;
+        if (sql_iter != sqls.end()) {
+            if (overwrite) {
+                sql_iter->second->info = info;
+                sql_iter->second->last_used.store(tick, std::memory_order_relaxed);
+            }
+            return false;
+        }
+        std::unique_ptr<Entry> entry(new Entry());
+        entry->info = info;
+        entry->last_used.store(tick, std::memory_order_relaxed);
+        sqls.emplace(sql, std::move(entry));
+    }
+    uint32_t& sql_cnt = sql_cnt_[std::make_pair(engine_mode, db)];
+    sql_cnt++;
+    if (sql_cnt > capacity_) {
+        EvictLocked(engine_mode, db);
+        sql_cnt--;
+    }
+    return true;
+}
 
-    auto& mode_cache = lru_cache_[engine_mode];
-    using BoostLRU = boost::compute::detail::lru_cache<std::string, std::shared_ptr<CompileInfo>>;
-    std::map<std::string, BoostLRU>::iterator db_iter = mode_cache.find(db);
-    if (db_iter == mode_cache.end()) {
-        db_iter = mode_cache.insert(db_iter, {db, BoostLRU(options_.GetMaxSqlCacheSize())});
+void EngineLRUCache::EvictLocked(EngineMode engine_mode, const std::string& db) {
+    // the entries are only removed under insert_mu_, so the oldest one found stays until it's erased
+    Shard* victim_shard = nullptr;
+    std::string victim_sql;
+    uint64_t victim_tick = std::numeric_limits<uint64_t>::max();
+    for (uint32_t i = 0; i < shard_cnt_; i++) {
+        Shard& shard = shards_[i];
+        std::lock_guard<base::SpinMutex> lock(shard.mu);
+        auto mode_iter = shard.cache.find(engine_mode);
+        if (mode_iter == shard.cache.end()) {
+            continue;
+        }
+        auto db_iter = mode_iter->second.find(db);
+        if (db_iter == mode_iter->second.end()) {
+            continue;
+        }
+        for (const auto& kv : db_iter->second) {
+            uint64_t tick = kv.second->last_used.load(std::memory_order_relaxed);
+            if (tick < victim_tick) {
+                victim_shard = &shard;
+                victim_sql = kv.first;
+                victim_tick = tick;
+            }
+        }
     }
-    auto& lru = db_iter->second;
-    auto value = lru.get(sql);
-    if (value == boost::none || engine_mode == kBatchRequestMode) {
-        lru.insert(sql, info);
-        return true;
-    } else {
-        // TODO(xxx): Ensure compile result is stable
-        DLOG(INFO) << "Engine cache already exists: " << engine_mode << " " << db << "\n" << sql;
-        return false;
+    if (victim_shard != nullptr) {
+        std::lock_guard<base::SpinMutex> lock(victim_shard->mu);
+        victim_shard->cache[engine_mode][db].erase(victim_sql);
+    }
+}
+
+void EngineLRUCache::Clear(const std::string& db) {
+    std::lock_guard<std::mutex> insert_lock(insert_mu_);
+    for (uint32_t i = 0; i < shard_cnt_; i++) {
+        Shard& shard = shards_[i];
+        std::lock_guard<base::SpinMutex> lock(shard.mu);
+        if (db.empty()) {
+            shard.cache.clear();
+            continue;
+        }
+        for (auto& cache : shard.cache) {
+            cache.second.erase(db);
+        }
+    }
+    for (auto iter = sql_cnt_.begin(); iter != sql_cnt_.end();) {
+        if (db.empty() || iter->first.second == db) {
+            iter = sql_cnt_.erase(iter);
+        } else {
+            ++iter;
+        }
     }
 }
 
@@ -14,6 +14,9 @@
  * limitations under the License.
  */
 
+#include <atomic>
+#include <thread>  // NOLINT
+
 #include "case/case_data_mock.h"
 #include "gtest/gtest.h"
 #include "gtest/internal/gtest-param-util.h"
@@ -221,6 +224,128 @@ TEST_F(EngineCompileTest, EngineEmptyDefaultDBLRUCacheTest) {
         ASSERT_NE(bsession1.GetCompileInfo().get(), bsession4.GetCompileInfo().get());
     }
 }
+TEST_F(EngineCompileTest, EngineConcurrentGetTest) {
+    // Build Simple Catalog
+    auto catalog = BuildSimpleCatalog();
+
+    // database simple_db
+    hybridse::type::Database db;
+    db.set_name("simple_db");
+
+    // table t1
+    hybridse::type::TableDef table_def;
+    sqlcase::CaseSchemaMock::BuildTableDef(table_def);
+    table_def.set_name("t1");
+    ::hybridse::type::IndexDef* index = table_def.add_indexes();
+    index->set_name("index12");
+    index->add_first_keys("col1");
+    index->add_first_keys("col2");
+    index->set_second_key("col5");
+    AddTable(db, table_def);
+    catalog->AddDatabase(db);
+
+    EngineOptions options;
+    options.SetCompileOnly(true);
+    Engine engine(catalog, options);
+
+    // the callers missing the cache of the same sql share one compiling result
+    const int thread_num = 8;
+    const int sql_num = 20;
+    std::vector<std::vector<std::shared_ptr<CompileInfo>>> infos(thread_num);
+    std::vector<std::thread> threads;
+    std::atomic<int> failed_cnt(0);
+    for (int i = 0; i < thread_num; i++) {
+        threads.emplace_back([&, i]() {
+            for (int k = 0; k < sql_num; k++) {
+                std::string sql = "select col1, col2 as c" + std::to_string(k) + " from t1;";
+                base::Status get_status;
+                BatchRunSession bsession;
+                if (!engine.Get(sql, "simple_db", bsession, get_status)) {
+                    failed_cnt++;
+                }
+                infos[i].push_back(bsession.GetCompileInfo());
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    ASSERT_EQ(0, failed_cnt.load());
+    for (int i = 1; i < thread_num; i++) {
+        for (int k = 0; k < sql_num; k++) {
+            ASSERT_TRUE(infos[0][k]);
+            ASSERT_EQ(infos[0][k].get(), infos[i][k].get());
+        }
+    }
+
+    // the sqls are cached over shards and cleared by db
+    base::Status get_status;
+    BatchRunSession bsession;
+    ASSERT_TRUE(engine.Get("select col1, col2 as c0 from t1;", "simple_db", bsession, get_status));
+    ASSERT_EQ(infos[0][0].get(), bsession.GetCompileInfo().get());
+    engine.ClearCacheLocked("simple_db");
+    ASSERT_TRUE(engine.Get("select col1, col2 as c0 from t1;", "simple_db", bsession, get_status));
+    ASSERT_NE(infos[0][0].get(), bsession.GetCompileInfo().get());
+}
+
+TEST_F(EngineCompileTest, EngineLRUCacheCapacityTest) {
+    // Build Simple Catalog
+    auto catalog = BuildSimpleCatalog();
+
+    // database simple_db
+    hybridse::type::Database db;
+    db.set_name("simple_db");
+
+    // table t1
+    hybridse::type::TableDef table_def;
+    sqlcase::CaseSchemaMock::BuildTableDef(table_def);
+    table_def.set_name("t1");
+    AddTable(db, table_def);
+    catalog->AddDatabase(db);
+
+    const int sql_num = 20;
+    EngineOptions options;
+    options.SetCompileOnly(true);
+    options.SetMaxSqlCacheSize(sql_num);
+    Engine engine(catalog, options);
+
+    // all the sqls stay cached as long as there are at most max_sql_cache_size ones, whatever
+    // shards they are spread over
+    auto get = [&](int k) {
+        std::string sql = "select col1, col2 as c" + std::to_string(k) + " from t1;";
+        base::Status get_status;
+        BatchRunSession bsession;
+        EXPECT_TRUE(engine.Get(sql, "simple_db", bsession, get_status)) << get_status;
+        return bsession.GetCompileInfo();
+    };
+    std::vector<std::shared_ptr<CompileInfo>> infos;
+    for (int k = 0; k < sql_num; k++) {
+        infos.push_back(get(k));
+    }
+    for (int round = 0; round < 3; round++) {
+        for (int k = 0; k < sql_num; k++) {
+            ASSERT_EQ(infos[k].get(), get(k).get());
+        }
+    }
+    // the least recently used one is evicted by one more sql
+    get(sql_num);
+    for (int k = 1; k < sql_num; k++) {
+        ASSERT_EQ(infos[k].get(), get(k).get());
+    }
+    ASSERT_NE(infos[0].get(), get(0).get());
+
+    // the cached one is kept unless it's overwritten
+    EngineLRUCache cache(1);
+    ASSERT_TRUE(cache.Insert(kBatchRequestMode, "simple_db", "sql", infos[1]));
+    ASSERT_FALSE(cache.Insert(kBatchRequestMode, "simple_db", "sql", infos[2]));
+    ASSERT_EQ(infos[1].get(), cache.Get(kBatchRequestMode, "simple_db", "sql").get());
+    ASSERT_FALSE(cache.Insert(kBatchRequestMode, "simple_db", "sql", infos[2], true));
+    ASSERT_EQ(infos[2].get(), cache.Get(kBatchRequestMode, "simple_db", "sql").get());
+    ASSERT_TRUE(cache.Insert(kBatchRequestMode, "simple_db", "sql2", infos[3]));
+    ASSERT_FALSE(cache.Get(kBatchRequestMode, "simple_db", "sql"));
+    ASSERT_EQ(infos[3].get(), cache.Get(kBatchRequestMode, "simple_db", "sql2").get());
+}
+
 TEST_F(EngineCompileTest, EngineCompileOnlyTest) {
     // Build Simple Catalog
     auto catalog = BuildSimpleCatalog();
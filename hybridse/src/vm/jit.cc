@@ -40,6 +40,7 @@ extern "C" {
 #include "llvm/Transforms/Scalar.h"
 #include "llvm/Transforms/Scalar/GVN.h"
 #include "llvm/Transforms/Utils.h"
+#include "vm/jit_object_cache.h"
 #ifdef LLVM_EXT_ENABLE
 #include "llvm_ext/symbol_resolve.h"
 #endif
@@ -150,8 +151,23 @@ bool HybridSeJit::AddSymbol(::llvm::orc::JITDylib& jd,
 
 bool HybridSeLlvmJitWrapper::Init() {
     DLOG(INFO) << "Start to initialize hybridse jit";
-    auto jit = ::llvm::Expected<std::unique_ptr<HybridSeJit>>(
-        HybridSeJitBuilder().create());
+    HybridSeJitBuilder builder;
+    JitObjectCache* object_cache =
+        JitObjectCache::GetInstance(jit_options_.GetObjectCacheDir());
+    if (object_cache != nullptr) {
+        // same as the default compiler of LLJIT, but looking up the object cache first
+        builder.setCompileFunctionCreator(
+            [object_cache](::llvm::orc::JITTargetMachineBuilder jtmb)
+                -> ::llvm::Expected<::llvm::orc::IRCompileLayer::CompileFunction> {
+                auto tm = jtmb.createTargetMachine();
+                if (!tm) {
+                    return tm.takeError();
+                }
+                return ::llvm::orc::IRCompileLayer::CompileFunction(
+                    ::llvm::orc::TMOwningSimpleCompiler(std::move(*tm), object_cache));
+            });
+    }
+    auto jit = ::llvm::Expected<std::unique_ptr<HybridSeJit>>(builder.create());
     {
         ::llvm::Error e = jit.takeError();
         if (e) {
@@ -248,6 +264,11 @@ bool HybridSeMcJitWrapper::AddModule(
                          << err_str_;
             return false;
         }
+        JitObjectCache* object_cache =
+            JitObjectCache::GetInstance(jit_options_.GetObjectCacheDir());
+        if (object_cache != nullptr) {
+            execution_engine_->setObjectCache(object_cache);
+        }
         for (auto& pair : extern_functions_) {
             resolver->addSymbol(pair.first, pair.second);
         }
@@ -0,0 +1,133 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "vm/jit_object_cache.h"
+#include <unistd.h>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <utility>
+#include "glog/logging.h"
+#include "hybridse_version.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace hybridse {
+namespace vm {
+
+static std::string GetCodegenEnv() {
+    std::string env;
+    ::llvm::raw_string_ostream ss(env);
+    ss << "hybridse-" << HYBRIDSE_VERSION_MAJOR << "." << HYBRIDSE_VERSION_MINOR << "." << HYBRIDSE_VERSION_BUG
+       << " llvm-" << LLVM_VERSION_STRING << " " << ::llvm::sys::getProcessTriple() << " "
+       << ::llvm::sys::getHostCPUName();
+    ss.flush();
+    return env;
+}
+
+JitObjectCache::JitObjectCache(const std::string& dir)
+    : dir_(dir), env_(GetCodegenEnv()), mu_(), compiling_(), hit_cnt_(0), miss_cnt_(0) {
+    std::error_code ec = ::llvm::sys::fs::create_directories(dir_);
+    if (ec) {
+        LOG(WARNING) << "fail to create jit object cache dir " << dir_ << ": " << ec.message();
+    }
+}
+
+JitObjectCache* JitObjectCache::GetInstance(const std::string& dir) {
+    if (dir.empty()) {
+        return nullptr;
+    }
+    static std::mutex mu;
+    static std::map<std::string, std::unique_ptr<JitObjectCache>> caches;
+    std::lock_guard<std::mutex> lock(mu);
+    auto& cache = caches[dir];
+    if (!cache) {
+        cache.reset(new JitObjectCache(dir));
+    }
+    return cache.get();
+}
+
+std::string JitObjectCache::GetKey(const ::llvm::Module* module) const {
+    std::string ir;
+    ::llvm::raw_string_ostream ss(ir);
+    module->print(ss, nullptr);
+    ss.flush();
+    ::llvm::MD5 hash;
+    hash.update(env_);
+    hash.update(::llvm::StringRef("\0", 1));
+    hash.update(ir);
+    ::llvm::MD5::MD5Result result;
+    hash.final(result);
+    return std::string(result.digest().str());
+}
+
+std::unique_ptr<::llvm::MemoryBuffer> JitObjectCache::getObject(const ::llvm::Module* module) {
+    std::string key = GetKey(module);
+    std::string path = dir_ + "/" + key + ".o";
+    auto buf = ::llvm::MemoryBuffer::getFile(path, -1, false);
+    if (buf && (*buf)->getBufferSize() > 0) {
+        hit_cnt_.fetch_add(1, std::memory_order_relaxed);
+        DLOG(INFO) << "load jit object " << path;
+        std::lock_guard<std::mutex> lock(mu_);
+        compiling_.erase(module);
+        return std::move(*buf);
+    }
+    miss_cnt_.fetch_add(1, std::memory_order_relaxed);
+    // the key of a module whose codegen failed before is overwritten here if the address is reused
+    std::lock_guard<std::mutex> lock(mu_);
+    compiling_[module] = key;
+    return nullptr;
+}
+
+void JitObjectCache::notifyObjectCompiled(const ::llvm::Module* module, ::llvm::MemoryBufferRef obj) {
+    std::string key;
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        auto iter = compiling_.find(module);
+        if (iter == compiling_.end()) {
+            return;
+        }
+        key = std::move(iter->second);
+        compiling_.erase(iter);
+    }
+    // write to a temporary file and rename it, so a partial object is never loaded
+    std::string path = dir_ + "/" + key + ".o";
+    std::string tmp_path = path + ".tmp." + std::to_string(getpid()) + "." +
+                           std::to_string(reinterpret_cast<uintptr_t>(module));
+    {
+        std::ofstream ofs(tmp_path, std::ios::binary | std::ios::trunc);
+        ofs.write(obj.getBufferStart(), obj.getBufferSize());
+        ofs.close();
+        if (!ofs) {
+            LOG(WARNING) << "fail to write jit object " << tmp_path;
+            std::remove(tmp_path.c_str());
+            return;
+        }
+    }
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        LOG(WARNING) << "fail to rename jit object " << tmp_path << " to " << path;
+        std::remove(tmp_path.c_str());
+        return;
+    }
+    DLOG(INFO) << "save jit object " << path;
+}
+
+}  // namespace vm
+}  // namespace hybridse
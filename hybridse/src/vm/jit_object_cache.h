@@ -0,0 +1,69 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HYBRIDSE_SRC_VM_JIT_OBJECT_CACHE_H_
+#define HYBRIDSE_SRC_VM_JIT_OBJECT_CACHE_H_
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>  //NOLINT
+#include <string>
+#include "llvm/ExecutionEngine/ObjectCache.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+namespace hybridse {
+namespace vm {
+
+/// \brief The object files of the compiled modules kept in a directory
+///
+/// An object file is keyed by the hash of the optimized IR of the module and the
+/// versions of hybridse, llvm and the host cpu, so the same sql compiled again,
+/// e.g. by a restarted tablet, is loaded without codegen. The external symbols
+/// are resolved by name when the object is linked, so they're not in the key.
+class JitObjectCache : public ::llvm::ObjectCache {
+ public:
+    explicit JitObjectCache(const std::string& dir);
+    ~JitObjectCache() override {}
+
+    /// Return the cache of dir shared in the process, or nullptr if dir is empty
+    static JitObjectCache* GetInstance(const std::string& dir);
+
+    void notifyObjectCompiled(const ::llvm::Module* module, ::llvm::MemoryBufferRef obj) override;
+
+    std::unique_ptr<::llvm::MemoryBuffer> getObject(const ::llvm::Module* module) override;
+
+    uint64_t GetHitCnt() const { return hit_cnt_.load(std::memory_order_relaxed); }
+    uint64_t GetMissCnt() const { return miss_cnt_.load(std::memory_order_relaxed); }
+
+ private:
+    std::string GetKey(const ::llvm::Module* module) const;
+
+    const std::string dir_;
+    // the versions of the environment generating the code
+    const std::string env_;
+    std::mutex mu_;
+    // the keys of the modules being compiled, the module may be changed by codegen,
+    // so the key is got before it
+    std::map<const ::llvm::Module*, std::string> compiling_;
+    std::atomic<uint64_t> hit_cnt_;
+    std::atomic<uint64_t> miss_cnt_;
+};
+
+}  // namespace vm
+}  // namespace hybridse
+#endif  // HYBRIDSE_SRC_VM_JIT_OBJECT_CACHE_H_
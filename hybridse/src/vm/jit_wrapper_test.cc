@@ -15,10 +15,12 @@
  */
 
 #include "vm/jit_wrapper.h"
+#include <unistd.h>
 #include "codec/fe_row_codec.h"
 #include "gtest/gtest.h"
 #include "udf/udf.h"
 #include "vm/engine.h"
+#include "vm/jit_object_cache.h"
 #include "vm/simple_catalog.h"
 #include "vm/sql_compiler.h"
 
@@ -118,6 +120,54 @@ TEST_F(JitWrapperTest, test) {
     simple_test(options);
 }
 
+TEST_F(JitWrapperTest, test_object_cache) {
+    std::string dir = ::testing::TempDir() + "/jit_object_cache_" + std::to_string(getpid());
+    EngineOptions options;
+    options.jit_options().SetObjectCacheDir(dir);
+    auto object_cache = JitObjectCache::GetInstance(dir);
+    ASSERT_TRUE(object_cache != nullptr);
+    auto catalog = GetTestCatalog();
+    std::string sql = "select col_1 + 1.0, col_2 * 2 from t1;";
+
+    // compiled by the engines of a tablet before and after the restart
+    auto compile_info = Compile(sql, options, catalog);
+    ASSERT_TRUE(compile_info != nullptr);
+    ASSERT_EQ(0u, object_cache->GetHitCnt());
+    uint64_t miss_cnt = object_cache->GetMissCnt();
+    ASSERT_GT(miss_cnt, 0u);
+    compile_info = Compile(sql, options, catalog);
+    ASSERT_TRUE(compile_info != nullptr);
+    ASSERT_EQ(miss_cnt, object_cache->GetHitCnt());
+    ASSERT_EQ(miss_cnt, object_cache->GetMissCnt());
+
+    // the loaded object runs the same as the compiled one
+    auto &sql_context = compile_info->get_sql_context();
+    auto fn = sql_context.physical_plan->GetFnInfos()[0]->fn_ptr();
+    ASSERT_TRUE(fn != nullptr);
+    int8_t buf[1024];
+    auto schema = catalog->GetTable("db", "t1")->GetSchema();
+    codec::RowBuilder row_builder(*schema);
+    row_builder.SetBuffer(buf, 1024);
+    row_builder.AppendDouble(3.14);
+    row_builder.AppendInt64(42);
+    hybridse::codec::Row empty_parameter;
+    hybridse::codec::Row row(base::RefCountedSlice::Create(buf, 1024));
+    hybridse::codec::Row output = CoreAPI::RowProject(fn, row, empty_parameter);
+    codec::RowView row_view(sql_context.schema, output.buf(), output.size());
+    double c1;
+    int64_t c2;
+    ASSERT_EQ(row_view.GetDouble(0, &c1), 0);
+    ASSERT_EQ(row_view.GetInt64(1, &c2), 0);
+    ASSERT_DOUBLE_EQ(c1, 4.14);
+    ASSERT_EQ(c2, 84);
+
+    // a different sql is not loaded from the cache
+    compile_info = Compile("select col_1 + 2.0, col_2 * 2 from t1;", options, catalog);
+    ASSERT_TRUE(compile_info != nullptr);
+    ASSERT_EQ(miss_cnt, object_cache->GetHitCnt());
+    ASSERT_GT(object_cache->GetMissCnt(), miss_cnt);
+}
+
 #ifdef LLVM_EXT_ENABLE
 TEST_F(JitWrapperTest, test_mcjit) {
     EngineOptions options;
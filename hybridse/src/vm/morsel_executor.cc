@@ -0,0 +1,134 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "vm/morsel_executor.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include "bthread/bthread.h"
+#include "bthread/condition_variable.h"
+#include "gflags/gflags.h"
+
+DECLARE_uint32(batch_run_thread_num);
+DECLARE_uint32(request_branch_thread_num);
+
+namespace hybridse {
+namespace vm {
+
+// the executor owning the thread, set in the threads of the pools
+static thread_local const MorselExecutor* pool_executor = nullptr;
+
+MorselExecutor::MorselExecutor(uint32_t thread_num) : mu_(), cv_(), tasks_(), stop_(false), threads_() {
+    for (uint32_t i = 0; i < thread_num; i++) {
+        threads_.emplace_back(&MorselExecutor::Work, this);
+    }
+}
+
+MorselExecutor::~MorselExecutor() {
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+MorselExecutor* MorselExecutor::GetInstance() {
+    static MorselExecutor executor(FLAGS_batch_run_thread_num);
+    return &executor;
+}
+
+MorselExecutor* MorselExecutor::GetRequestInstance() {
+    static MorselExecutor executor(FLAGS_request_branch_thread_num);
+    return &executor;
+}
+
+bool MorselExecutor::IsParallel() const { return !threads_.empty() && pool_executor != this; }
+
+void MorselExecutor::Work() {
+    pool_executor = this;
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mu_);
+            cv_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+            if (tasks_.empty()) {
+                return;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        task();
+    }
+}
+
+void MorselExecutor::Run(size_t morsel_cnt, const std::function<void(size_t)>& fn) {
+    if (!IsParallel() || morsel_cnt <= 1) {
+        for (size_t i = 0; i < morsel_cnt; i++) {
+            fn(i);
+        }
+        return;
+    }
+    struct State {
+        const std::function<void(size_t)>* fn;
+        size_t morsel_cnt;
+        std::atomic<size_t> next;
+        // the caller of a request is a bthread, so it waits without blocking the worker pthread
+        bthread::Mutex mu;
+        bthread::ConditionVariable cv;
+        size_t done_cnt;
+    };
+    // a helper may start after all the morsels are done, so the state is shared with it.
+    // fn is only called for a claimed morsel, which is done before Run returns
+    auto state = std::make_shared<State>();
+    state->fn = &fn;
+    state->morsel_cnt = morsel_cnt;
+    state->next = 0;
+    state->done_cnt = 0;
+    auto work = [state]() {
+        size_t done_cnt = 0;
+        for (size_t i = state->next.fetch_add(1); i < state->morsel_cnt; i = state->next.fetch_add(1)) {
+            (*state->fn)(i);
+            done_cnt++;
+        }
+        if (done_cnt > 0) {
+            std::lock_guard<bthread::Mutex> lock(state->mu);
+            state->done_cnt += done_cnt;
+            if (state->done_cnt == state->morsel_cnt) {
+                state->cv.notify_all();
+            }
+        }
+    };
+    size_t helper_cnt = std::min(threads_.size(), morsel_cnt - 1);
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        for (size_t i = 0; i < helper_cnt; i++) {
+            tasks_.push_back(work);
+        }
+    }
+    cv_.notify_all();
+    work();
+    std::unique_lock<bthread::Mutex> lock(state->mu);
+    while (state->done_cnt != state->morsel_cnt) {
+        state->cv.wait(lock);
+    }
+}
+
+}  // namespace vm
+}  // namespace hybridse
@@ -0,0 +1,76 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef HYBRIDSE_SRC_VM_MORSEL_EXECUTOR_H_
+#define HYBRIDSE_SRC_VM_MORSEL_EXECUTOR_H_
+
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <functional>
+#include <mutex>  // NOLINT
+#include <thread>  // NOLINT
+#include <vector>
+
+namespace hybridse {
+namespace vm {
+
+/// \brief MorselExecutor runs the morsels of the runners in parallel
+///
+/// The morsels, e.g. the keys of a partition, a range of rows or the independent
+/// branches of a request, run by the threads of the pool and the calling thread.
+/// Every thread claims the next morsel once it's done with the one before, so the
+/// threads done early take over the rest. The nested morsels of a morsel run by a
+/// thread of the same pool, e.g. the projection of the input of a window aggregation,
+/// run on the thread itself, while the ones of another executor, e.g. a batch runner
+/// under a branch of a request, run in parallel.
+class MorselExecutor {
+ public:
+    explicit MorselExecutor(uint32_t thread_num);
+    ~MorselExecutor();
+    MorselExecutor(const MorselExecutor&) = delete;
+    MorselExecutor& operator=(const MorselExecutor&) = delete;
+
+    /// The executor of batch_run_thread_num threads running the batch mode runners,
+    /// created when it's got first with the flag set
+    static MorselExecutor* GetInstance();
+
+    /// The executor of request_branch_thread_num threads running the branches
+    /// of the requests, created when it's got first with the flag set
+    static MorselExecutor* GetRequestInstance();
+
+    /// Return false if the morsels run on the calling thread only, e.g. it's a thread
+    /// of this executor
+    bool IsParallel() const;
+
+    uint32_t GetThreadNum() const { return threads_.size(); }
+
+    /// Run fn(0), ..., fn(morsel_cnt - 1) and return after all of them are done
+    void Run(size_t morsel_cnt, const std::function<void(size_t)>& fn);
+
+ private:
+    void Work();
+
+    std::mutex mu_;
+    std::condition_variable cv_;
+    std::deque<std::function<void()>> tasks_;
+    bool stop_;
+    std::vector<std::thread> threads_;
+};
+
+}  // namespace vm
+}  // namespace hybridse
+#endif  // HYBRIDSE_SRC_VM_MORSEL_EXECUTOR_H_
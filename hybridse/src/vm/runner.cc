@@ -16,6 +16,8 @@
 
 #include "vm/runner.h"
 
+#include <algorithm>
+#include <atomic>
 #include <memory>
 #include <string>
 #include <utility>
@@ -28,8 +30,12 @@
 #include "vm/core_api.h"
 #include "vm/jit_runtime.h"
 #include "vm/mem_catalog.h"
+#include "vm/morsel_executor.h"
 
 DECLARE_bool(enable_spark_unsaferow_format);
+DECLARE_uint32(project_batch_size);
+DECLARE_uint32(batch_run_thread_num);
+DECLARE_uint32(request_branch_thread_num);
 
 namespace hybridse {
 namespace vm {
@@ -963,10 +969,11 @@ bool Runner::GetColumnBool(const int8_t* buf, const RowView* row_view, int idx,
 }
 
 Row Runner::WindowProject(const int8_t* fn, const uint64_t row_key,
-                          const Row row,
+                          const Row& row,
                           const codec::Row& parameter,
                           const bool is_instance,
-                          size_t append_slices, Window* window) {
+                          size_t append_slices, Window* window,
+                          bool release_run_step) {
     if (row.empty()) {
         return row;
     }
@@ -994,7 +1001,9 @@ Row Runner::WindowProject(const int8_t* fn, const uint64_t row_key,
     uint32_t ret = udf(row_key, row_ptr, window_ptr, parameter_ptr, &out_buf);
 
     // Release current run step resources
-    JitRuntime::get()->ReleaseRunStep();
+    if (release_run_step) {
+        JitRuntime::get()->ReleaseRunStep();
+    }
 
     if (ret != 0) {
         LOG(WARNING) << "fail to run udf " << ret;
@@ -1148,15 +1157,46 @@ std::shared_ptr<DataHandlerList> Runner::BatchRequestRun(RunnerContext& ctx) {
 }
 std::shared_ptr<DataHandler> Runner::RunWithCache(RunnerContext& ctx) {
     if (need_cache_) {
+        if (ctx.is_request_mode() && FLAGS_request_branch_thread_num > 0) {
+            // the branches run in parallel may share the runner, it's run once for them
+            return ctx.GetOrRunCache(id_, [&]() { return RunWithoutCache(ctx); });
+        }
         auto cached = ctx.GetCache(id_);
         if (cached != nullptr) {
             DLOG(INFO) << "RUNNER ID " << id_ << " HIT CACHE!";
             return cached;
         }
     }
+    auto res = RunWithoutCache(ctx);
+    if (need_cache_) {
+        ctx.SetCache(id_, res);
+    }
+    return res;
+}
+std::shared_ptr<DataHandler> Runner::RunWithoutCache(RunnerContext& ctx) {
     std::vector<std::shared_ptr<DataHandler>> inputs(producers_.size());
-    for (size_t idx = producers_.size(); idx > 0; idx--) {
-        inputs[idx - 1] = producers_[idx - 1]->RunWithCache(ctx);
+    MorselExecutor* executor = nullptr;
+    if (kRunnerConcat == type_ && ctx.is_request_mode() && FLAGS_request_branch_thread_num > 0) {
+        executor = MorselExecutor::GetRequestInstance();
+    }
+    if (nullptr != executor && executor->IsParallel()) {
+        // the branches of the concat runners, e.g. the windows over different keys of a request,
+        // are run in parallel, so the latency is about the one of the slowest branch
+        std::vector<Runner*> branches;
+        CollectConcatBranches(&branches);
+        std::vector<std::shared_ptr<DataHandler>> outputs(branches.size());
+        executor->Run(branches.size(), [&](size_t i) { outputs[i] = branches[i]->RunWithCache(ctx); });
+        std::map<const Runner*, std::shared_ptr<DataHandler>> branch_outputs;
+        for (size_t i = 0; i < branches.size(); i++) {
+            branch_outputs[branches[i]] = outputs[i];
+        }
+        for (size_t idx = 0; idx < producers_.size(); idx++) {
+            inputs[idx] = producers_[idx]->RunWithBranchOutputs(ctx, branch_outputs);
+        }
+    } else {
+        for (size_t idx = producers_.size(); idx > 0; idx--) {
+            inputs[idx - 1] = producers_[idx - 1]->RunWithCache(ctx);
+        }
     }
 
     auto res = Run(ctx, inputs);
@@ -1166,10 +1206,35 @@ std::shared_ptr<DataHandler> Runner::RunWithCache(RunnerContext& ctx) {
         Runner::PrintData(oss, output_schemas_, res);
         LOG(INFO) << oss.str();
     }
+    return res;
+}
+void Runner::CollectConcatBranches(std::vector<Runner*>* branches) {
+    for (auto producer : producers_) {
+        if (kRunnerConcat == producer->type_) {
+            producer->CollectConcatBranches(branches);
+        } else if (std::find(branches->begin(), branches->end(), producer) == branches->end()) {
+            branches->push_back(producer);
+        }
+    }
+}
+std::shared_ptr<DataHandler> Runner::RunWithBranchOutputs(
+    RunnerContext& ctx, const std::map<const Runner*, std::shared_ptr<DataHandler>>& branch_outputs) {
+    auto iter = branch_outputs.find(this);
+    if (iter != branch_outputs.end()) {
+        return iter->second;
+    }
+    // a concat runner under the one running the branches
+    auto run = [&]() {
+        std::vector<std::shared_ptr<DataHandler>> inputs(producers_.size());
+        for (size_t idx = 0; idx < producers_.size(); idx++) {
+            inputs[idx] = producers_[idx]->RunWithBranchOutputs(ctx, branch_outputs);
+        }
+        return Run(ctx, inputs);
+    };
     if (need_cache_) {
-        ctx.SetCache(id_, res);
+        return ctx.GetOrRunCache(id_, run);
     }
-    return res;
+    return run();
 }
 std::shared_ptr<DataHandler> DataRunner::Run(
     RunnerContext& ctx,
@@ -1277,6 +1342,26 @@ std::shared_ptr<DataHandler> ConstProjectRunner::Run(
     output_table->AddRow(project_gen_.Gen(ctx.GetParameterRow()));
     return output_table;
 }
+
+// split cnt keys into [begin, end) ranges, there are about 16 ranges for every thread so the
+// threads finishing early can take the left ones
+static std::vector<std::pair<size_t, size_t>> SplitMorsels(size_t cnt, uint32_t thread_num) {
+    size_t morsel_size = std::max<size_t>(1, cnt / (std::max(1u, thread_num) * 16));
+    std::vector<std::pair<size_t, size_t>> morsels;
+    for (size_t begin = 0; begin < cnt; begin += morsel_size) {
+        morsels.emplace_back(begin, std::min(cnt, begin + morsel_size));
+    }
+    return morsels;
+}
+
+static void AppendRows(const std::vector<std::shared_ptr<MemTableHandler>>& tables, MemTableHandler* output) {
+    for (const auto& table : tables) {
+        for (uint64_t i = 0; i < table->GetCount(); i++) {
+            output->AddRow(table->At(i));
+        }
+    }
+}
+
 std::shared_ptr<DataHandler> TableProjectRunner::Run(
     RunnerContext& ctx,
     const std::vector<std::shared_ptr<DataHandler>>& inputs) {
@@ -1298,16 +1383,35 @@ std::shared_ptr<DataHandler> TableProjectRunner::Run(
         LOG(WARNING) << "Table Project Fail: table iter is Empty";
         return std::shared_ptr<DataHandler>();
     }
-    auto& parameter = ctx.GetParameterRow();
     iter->SeekToFirst();
+    auto& parameter = ctx.GetParameterRow();
+    MorselExecutor* executor = FLAGS_batch_run_thread_num > 0 ? MorselExecutor::GetInstance() : nullptr;
+    if (nullptr == executor || !executor->IsParallel()) {
+        project_gen_.Gen(iter.get(), parameter, limit_cnt_, output_table.get());
+        return output_table;
+    }
+    // the rows are split into morsels of a project batch, which are projected in parallel
+    uint32_t morsel_size = std::max(1u, FLAGS_project_batch_size);
+    std::vector<std::shared_ptr<MemTableHandler>> morsels;
     int32_t cnt = 0;
     while (iter->Valid()) {
         if (limit_cnt_ > 0 && cnt++ >= limit_cnt_) {
             break;
         }
-        output_table->AddRow(project_gen_.Gen(iter->GetValue(), parameter));
+        if (morsels.empty() || morsels.back()->GetCount() >= morsel_size) {
+            morsels.push_back(std::make_shared<MemTableHandler>());
+        }
+        morsels.back()->AddRow(iter->GetValue());
         iter->Next();
     }
+    std::vector<std::shared_ptr<MemTableHandler>> morsel_outputs(morsels.size());
+    executor->Run(morsels.size(), [&](size_t i) {
+        morsel_outputs[i] = std::make_shared<MemTableHandler>();
+        auto morsel_iter = morsels[i]->GetIterator();
+        morsel_iter->SeekToFirst();
+        project_gen_.Gen(morsel_iter.get(), parameter, 0, morsel_outputs[i].get());
+    });
+    AppendRows(morsel_outputs, output_table.get());
     return output_table;
 }
 
@@ -1444,12 +1548,32 @@ std::shared_ptr<DataHandler> WindowAggRunner::Run(
 
     // Compute output
     std::shared_ptr<MemTableHandler> output_table = std::make_shared<MemTableHandler>();
+    MorselExecutor* executor = FLAGS_batch_run_thread_num > 0 ? MorselExecutor::GetInstance() : nullptr;
+    if (nullptr == executor || !executor->IsParallel() || limit_cnt_ > 0) {
+        while (instance_partition_iter->Valid()) {
+            auto key = instance_partition_iter->GetKey().ToString();
+            RunWindowAggOnKey(parameter, instance_partition, union_partitions,
+                              join_right_tables, key, output_table);
+            instance_partition_iter->Next();
+        }
+        return output_table;
+    }
+    // the keys are aggregated in parallel, the outputs are in the order of the keys as before
+    std::vector<std::string> keys;
     while (instance_partition_iter->Valid()) {
-        auto key = instance_partition_iter->GetKey().ToString();
-        RunWindowAggOnKey(parameter, instance_partition, union_partitions,
-                          join_right_tables, key, output_table);
+        keys.push_back(instance_partition_iter->GetKey().ToString());
         instance_partition_iter->Next();
     }
+    auto morsels = SplitMorsels(keys.size(), executor->GetThreadNum());
+    std::vector<std::shared_ptr<MemTableHandler>> morsel_outputs(morsels.size());
+    executor->Run(morsels.size(), [&](size_t i) {
+        morsel_outputs[i] = std::make_shared<MemTableHandler>();
+        for (size_t pos = morsels[i].first; pos < morsels[i].second; pos++) {
+            RunWindowAggOnKey(parameter, instance_partition, union_partitions,
+                              join_right_tables, keys[pos], morsel_outputs[i]);
+        }
+    });
+    AppendRows(morsel_outputs, output_table.get());
     return output_table;
 }
 
@@ -1512,6 +1636,8 @@ void WindowAggRunner::RunWindowAggOnKey(
     window.set_instance_not_in_window(instance_not_in_window_);
     window.set_exclude_current_time(exclude_current_time_);
 
+    uint64_t batch_window_rows = 0;
+    JitRuntime::get()->InitRunStep();
     while (instance_segment_iter->Valid()) {
         if (limit_cnt_ > 0 && cnt >= limit_cnt_) {
             break;
@@ -1542,16 +1668,25 @@ void WindowAggRunner::RunWindowAggOnKey(
         if (windows_join_gen_.Valid()) {
             Row row = windows_join_gen_.Join(instance_row, join_right_tables, parameter);
             output_table->AddRow(window_project_gen_.Gen(instance_segment_iter->GetKey(), row, parameter, true,
-                                                         append_slices_, &window));
+                                                         append_slices_, &window, false));
         } else {
             output_table->AddRow(window_project_gen_.Gen(
                 instance_segment_iter->GetKey(), instance_row, parameter, true,
-                append_slices_, &window));
+                append_slices_, &window, false));
+        }
+        // the memory the aggregations allocate grows with the window, so the jit runtime
+        // is released once the windows of a batch have project_batch_size rows in all
+        batch_window_rows += std::max<uint64_t>(1, window.GetCount());
+        if (batch_window_rows >= FLAGS_project_batch_size) {
+            JitRuntime::get()->ReleaseRunStep();
+            JitRuntime::get()->InitRunStep();
+            batch_window_rows = 0;
         }
 
         cnt++;
         instance_segment_iter->Next();
     }
+    JitRuntime::get()->ReleaseRunStep();
 }
 
 std::shared_ptr<DataHandler> RequestLastJoinRunner::Run(
@@ -2646,22 +2781,53 @@ std::shared_ptr<DataHandler> GroupAggRunner::Run(
             return std::shared_ptr<DataHandler>();
         }
         iter->SeekToFirst();
-        int32_t cnt = 0;
-        while (iter->Valid()) {
-            if (limit_cnt_ > 0 && cnt++ >= limit_cnt_) {
-                break;
-            }
-            auto key = iter->GetKey().ToString();
-            auto segment = partition->GetSegment(key);
-            if (!segment) {
-                LOG(WARNING) << "group aggregation fail: segment segment is null";
-                return std::shared_ptr<DataHandler>();
-            }
-            if (!having_condition_.Valid() || having_condition_.Gen(segment, parameter)) {
-                output_table->AddRow(agg_gen_.Gen(parameter, segment));
+        MorselExecutor* executor = FLAGS_batch_run_thread_num > 0 ? MorselExecutor::GetInstance() : nullptr;
+        if (nullptr == executor || !executor->IsParallel() || limit_cnt_ > 0) {
+            int32_t cnt = 0;
+            while (iter->Valid()) {
+                if (limit_cnt_ > 0 && cnt++ >= limit_cnt_) {
+                    break;
+                }
+                auto key = iter->GetKey().ToString();
+                auto segment = partition->GetSegment(key);
+                if (!segment) {
+                    LOG(WARNING) << "group aggregation fail: segment segment is null";
+                    return std::shared_ptr<DataHandler>();
+                }
+                if (!having_condition_.Valid() || having_condition_.Gen(segment, parameter)) {
+                    output_table->AddRow(agg_gen_.Gen(parameter, segment));
+                }
+                iter->Next();
             }
+            return output_table;
+        }
+        // the keys are aggregated in parallel, the outputs are in the order of the keys as before
+        std::vector<std::string> keys;
+        while (iter->Valid()) {
+            keys.push_back(iter->GetKey().ToString());
             iter->Next();
         }
+        auto morsels = SplitMorsels(keys.size(), executor->GetThreadNum());
+        std::vector<std::shared_ptr<MemTableHandler>> morsel_outputs(morsels.size());
+        std::atomic<bool> failed(false);
+        executor->Run(morsels.size(), [&](size_t i) {
+            morsel_outputs[i] = std::make_shared<MemTableHandler>();
+            for (size_t pos = morsels[i].first; pos < morsels[i].second && !failed.load(); pos++) {
+                auto segment = partition->GetSegment(keys[pos]);
+                if (!segment) {
+                    failed.store(true);
+                    return;
+                }
+                if (!having_condition_.Valid() || having_condition_.Gen(segment, parameter)) {
+                    morsel_outputs[i]->AddRow(agg_gen_.Gen(parameter, segment));
+                }
+            }
+        });
+        if (failed.load()) {
+            LOG(WARNING) << "group aggregation fail: segment segment is null";
+            return std::shared_ptr<DataHandler>();
+        }
+        AppendRows(morsel_outputs, output_table.get());
         return output_table;
     } else {
         LOG(WARNING) << "group aggregation fail: input isn't partition/table ";
@@ -3770,6 +3936,44 @@ const Row ProjectGenerator::Gen(const Row& row, const Row& parameter) {
     return CoreAPI::RowProject(fn_, row, parameter, false);
 }
 
+void ProjectGenerator::Gen(RowIterator* iter, const Row& parameter, int32_t limit_cnt,
+                           MemTableHandler* output) {
+    auto udf = reinterpret_cast<int32_t (*)(const int64_t, const int8_t*,
+                                            const int8_t*, const int8_t*, int8_t**)>(
+        const_cast<int8_t*>(fn_));
+    auto parameter_ptr = reinterpret_cast<const int8_t*>(&parameter);
+    uint32_t batch_size = std::max(1u, FLAGS_project_batch_size);
+    uint32_t batch_cnt = 0;
+    int32_t cnt = 0;
+    JitRuntime::get()->InitRunStep();
+    while (iter->Valid()) {
+        if (limit_cnt > 0 && cnt++ >= limit_cnt) {
+            break;
+        }
+        const Row& row = iter->GetValue();
+        if (row.empty()) {
+            output->AddRow(Row());
+            iter->Next();
+            continue;
+        }
+        int8_t* buf = nullptr;
+        uint32_t ret = udf(0, reinterpret_cast<const int8_t*>(&row), nullptr, parameter_ptr, &buf);
+        if (ret != 0) {
+            LOG(WARNING) << "fail to run udf " << ret;
+            output->AddRow(Row());
+        } else {
+            output->AddRow(Row(base::RefCountedSlice::CreateManaged(buf, RowView::GetSize(buf))));
+        }
+        if (++batch_cnt >= batch_size) {
+            JitRuntime::get()->ReleaseRunStep();
+            JitRuntime::get()->InitRunStep();
+            batch_cnt = 0;
+        }
+        iter->Next();
+    }
+    JitRuntime::get()->ReleaseRunStep();
+}
+
 const Row ConstProjectGenerator::Gen(const Row& parameter) {
     return CoreAPI::RowConstProject(fn_, parameter, false);
 }
@@ -3811,12 +4015,12 @@ Row Runner::GroupbyProject(const int8_t* fn, const codec::Row& parameter, TableH
         base::RefCountedSlice::CreateManaged(buf, RowView::GetSize(buf)));
 }
 
-const Row WindowProjectGenerator::Gen(const uint64_t key, const Row row,
+const Row WindowProjectGenerator::Gen(const uint64_t key, const Row& row,
                                       const codec::Row& parameter,
                                       bool is_instance, size_t append_slices,
-                                      Window* window) {
+                                      Window* window, bool release_run_step) {
     return Runner::WindowProject(fn_, key, row, parameter, is_instance, append_slices,
-                                 window);
+                                 window, release_run_step);
 }
 
 std::vector<std::shared_ptr<DataHandler>> InputsGenerator::RunInputs(
@@ -4016,6 +4220,7 @@ void RunnerContext::SetBatchCache(int64_t id,
 }
 
 std::shared_ptr<DataHandler> RunnerContext::GetCache(int64_t id) const {
+    std::lock_guard<std::mutex> lock(cache_mu_);
     auto iter = cache_.find(id);
     if (iter == cache_.end()) {
         return std::shared_ptr<DataHandler>();
@@ -4026,9 +4231,51 @@ std::shared_ptr<DataHandler> RunnerContext::GetCache(int64_t id) const {
 
 void RunnerContext::SetCache(int64_t id,
                              const std::shared_ptr<DataHandler> data) {
+    std::lock_guard<std::mutex> lock(cache_mu_);
     cache_[id] = data;
 }
 
+std::shared_ptr<DataHandler> RunnerContext::GetOrRunCache(
+    int64_t id, const std::function<std::shared_ptr<DataHandler>()>& fn) {
+    std::shared_ptr<PendingData> pending;
+    bool wait = false;
+    {
+        std::lock_guard<std::mutex> lock(cache_mu_);
+        auto iter = cache_.find(id);
+        if (iter != cache_.end()) {
+            return iter->second;
+        }
+        auto pending_iter = pending_cache_.find(id);
+        if (pending_iter != pending_cache_.end()) {
+            pending = pending_iter->second;
+            wait = true;
+        } else {
+            pending = std::make_shared<PendingData>();
+            pending_cache_.emplace(id, pending);
+        }
+    }
+    if (wait) {
+        std::unique_lock<bthread::Mutex> lock(pending->mu);
+        while (!pending->done) {
+            pending->cv.wait(lock);
+        }
+        return pending->data;
+    }
+    auto data = fn();
+    {
+        std::lock_guard<std::mutex> lock(cache_mu_);
+        cache_[id] = data;
+        pending_cache_.erase(id);
+    }
+    {
+        std::lock_guard<bthread::Mutex> lock(pending->mu);
+        pending->data = data;
+        pending->done = true;
+    }
+    pending->cv.notify_all();
+    return data;
+}
+
 void RunnerContext::SetRequest(const hybridse::codec::Row& request) {
     request_ = request;
 }
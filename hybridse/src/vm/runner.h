@@ -17,14 +17,18 @@
 #ifndef HYBRIDSE_SRC_VM_RUNNER_H_
 #define HYBRIDSE_SRC_VM_RUNNER_H_
 
+#include <functional>
 #include <map>
 #include <memory>
+#include <mutex>  // NOLINT
 #include <set>
 #include <string>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 #include "base/fe_status.h"
+#include "bthread/bthread.h"
+#include "bthread/condition_variable.h"
 #include "codec/fe_row_codec.h"
 #include "node/node_manager.h"
 #include "vm/aggregator.h"
@@ -81,6 +85,11 @@ class ProjectGenerator : public FnGenerator {
         : FnGenerator(info), fun_(info.fn_ptr()) {}
     virtual ~ProjectGenerator() {}
     const Row Gen(const Row& row, const Row& parameter);
+    // project the rows of iter from its current position into output, at most
+    // limit_cnt rows if limit_cnt > 0. the rows are passed to the function
+    // without copies, and the jit runtime is released once a batch of rows
+    void Gen(RowIterator* iter, const Row& parameter, int32_t limit_cnt,
+             MemTableHandler* output);
     RowProjectFun fun_;
 };
 
@@ -102,8 +111,8 @@ class WindowProjectGenerator : public FnGenerator {
  public:
     explicit WindowProjectGenerator(const FnInfo& info) : FnGenerator(info) {}
     virtual ~WindowProjectGenerator() {}
-    const Row Gen(const uint64_t key, const Row row, const codec::Row& parameter_row, const bool is_instance,
-                  size_t append_slices, Window* window);
+    const Row Gen(const uint64_t key, const Row& row, const codec::Row& parameter_row, const bool is_instance,
+                  size_t append_slices, Window* window, bool release_run_step = true);
 };
 class KeyGenerator : public FnGenerator {
  public:
@@ -502,9 +511,10 @@ class Runner : public node::NodeBase<Runner> {
     static Row RowProject(const int8_t* fn, const hybridse::codec::Row& row, const hybridse::codec::Row& parameter,
                           const bool need_free);
     static Row WindowProject(const int8_t* fn, const uint64_t key,
-                             const Row row, const Row& parameter,
+                             const Row& row, const Row& parameter,
                              const bool is_instance,
-                             size_t append_slices, Window* window);
+                             size_t append_slices, Window* window,
+                             bool release_run_step = true);
     static Row GroupbyProject(const int8_t* fn, const Row& parameter, TableHandler* table);
     static const Row RowLastJoinTable(size_t left_slices, const Row& left_row,
                                       size_t right_slices,
@@ -560,6 +570,16 @@ class Runner : public node::NodeBase<Runner> {
         }
     }
 
+    // the runners under this one and the concat runners under it which are not concat runners,
+    // they're independent of each other
+    void CollectConcatBranches(std::vector<Runner*>* branches);
+    // run with the outputs of the branches run already
+    std::shared_ptr<DataHandler> RunWithBranchOutputs(
+        RunnerContext& ctx,  // NOLINT
+        const std::map<const Runner*, std::shared_ptr<DataHandler>>& branch_outputs);
+    // run the producers and this runner without looking up the cache
+    std::shared_ptr<DataHandler> RunWithoutCache(RunnerContext& ctx);  // NOLINT
+
     bool need_cache_;
     bool need_batch_cache_;
     std::vector<Runner*> producers_;
@@ -1542,6 +1562,7 @@ class RunnerContext {
           requests_(),
           parameter_(parameter),
           is_debug_(is_debug),
+          is_request_mode_(false),
           batch_cache_() {}
     explicit RunnerContext(hybridse::vm::ClusterJob* cluster_job,
                            const hybridse::codec::Row& request,
@@ -1553,6 +1574,7 @@ class RunnerContext {
           requests_(),
           parameter_(),
           is_debug_(is_debug),
+          is_request_mode_(true),
           batch_cache_() {}
     explicit RunnerContext(hybridse::vm::ClusterJob* cluster_job,
                            const std::vector<Row>& request_batch,
@@ -1564,6 +1586,7 @@ class RunnerContext {
           requests_(request_batch),
           parameter_(),
           is_debug_(is_debug),
+          is_request_mode_(false),
           batch_cache_() {}
 
     const size_t GetRequestSize() const { return requests_.size(); }
@@ -1576,15 +1599,31 @@ class RunnerContext {
     void SetRequest(const hybridse::codec::Row& request);
     void SetRequests(const std::vector<hybridse::codec::Row>& requests);
     bool is_debug() const { return is_debug_; }
+    // run for a single request row, whose branches may run in parallel
+    bool is_request_mode() const { return is_request_mode_; }
 
     const std::string& sp_name() { return sp_name_; }
     std::shared_ptr<DataHandler> GetCache(int64_t id) const;
     void SetCache(int64_t id, std::shared_ptr<DataHandler> data);
-    void ClearCache() { cache_.clear(); }
+    // return the cached data of id, or run fn and cache its result if it's not cached. the
+    // callers of the same id wait for the one running fn, so fn runs once
+    std::shared_ptr<DataHandler> GetOrRunCache(int64_t id, const std::function<std::shared_ptr<DataHandler>()>& fn);
+    void ClearCache() {
+        std::lock_guard<std::mutex> lock(cache_mu_);
+        cache_.clear();
+    }
     std::shared_ptr<DataHandlerList> GetBatchCache(int64_t id) const;
     void SetBatchCache(int64_t id, std::shared_ptr<DataHandlerList> data);
 
  private:
+    // the data of an id being made. the request mode callers are bthreads, so they wait on
+    // the bthread condition variable without blocking the worker pthreads
+    struct PendingData {
+        bthread::Mutex mu;
+        bthread::ConditionVariable cv;
+        bool done = false;
+        std::shared_ptr<DataHandler> data;
+    };
     hybridse::vm::ClusterJob* cluster_job_;
     const std::string sp_name_;
     hybridse::codec::Row request_;
@@ -1592,8 +1631,13 @@ class RunnerContext {
     hybridse::codec::Row parameter_;
     size_t idx_;
     const bool is_debug_;
+    const bool is_request_mode_;
     // TODO(chenjing): optimize
+    // the branches of a request may run in parallel
+    mutable std::mutex cache_mu_;
     std::map<int64_t, std::shared_ptr<DataHandler>> cache_;
+    // the data of the ids being made by GetOrRunCache
+    std::map<int64_t, std::shared_ptr<PendingData>> pending_cache_;
     std::map<int64_t, std::shared_ptr<DataHandlerList>> batch_cache_;
 };
 }  // namespace vm
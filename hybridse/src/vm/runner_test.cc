@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <atomic>
 #include <memory>
 #include <utility>
 #include "boost/algorithm/string.hpp"
@@ -34,6 +35,7 @@
 #include "llvm/Transforms/Scalar/GVN.h"
 #include "plan/plan_api.h"
 #include "testing/test_base.h"
+#include "vm/morsel_executor.h"
 #include "vm/sql_compiler.h"
 
 using namespace llvm;       // NOLINT
@@ -522,6 +524,28 @@ TEST_F(RunnerTest, RunnerPrintDataMemTimeTableTest) {
         LOG(INFO) << oss.str();
     }
 }
+
+TEST_F(RunnerTest, MorselExecutorTest) {
+    MorselExecutor executor(4);
+    ASSERT_TRUE(executor.IsParallel());
+    std::vector<int> results(1000, 0);
+    std::atomic<int> nested_cnt(0);
+    executor.Run(results.size(), [&](size_t i) {
+        results[i] = i * 2;
+        // the nested morsels run on the same thread
+        executor.Run(4, [&](size_t) { nested_cnt++; });
+    });
+    for (size_t i = 0; i < results.size(); i++) {
+        ASSERT_EQ(static_cast<int>(i * 2), results[i]);
+    }
+    ASSERT_EQ(4000, nested_cnt.load());
+
+    MorselExecutor sequential_executor(0);
+    ASSERT_FALSE(sequential_executor.IsParallel());
+    int sum = 0;
+    sequential_executor.Run(10, [&](size_t i) { sum += i; });
+    ASSERT_EQ(45, sum);
+}
 }  // namespace vm
 }  // namespace hybridse
 
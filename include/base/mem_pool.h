@@ -19,7 +19,12 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <stdlib.h>
+
+#include <atomic>
 #include <list>
+#include <mutex>  //NOLINT
+#include <new>
 #include <thread>  //NOLINT
 namespace openmldb {
 namespace base {
@@ -85,6 +90,109 @@ class ByteMemoryPool {
  private:
     MemoryChunk* chucks_;
 };
+
+// MemorySlab is a size aligned chunk which is carved by bump allocation.
+// Every allocation holds one reference of the slab, and the whole slab is
+// returned to the system when the last object in it is freed.
+class MemorySlab {
+ public:
+    enum { SLAB_SIZE = 64 * 1024 };
+
+    static MemorySlab* New() {
+        void* mem = nullptr;
+        if (posix_memalign(&mem, SLAB_SIZE, SLAB_SIZE) != 0) {
+            return nullptr;
+        }
+        LiveSlabCnt().fetch_add(1, std::memory_order_relaxed);
+        return new (mem) MemorySlab();
+    }
+
+    // the slab which addr is allocated from
+    static MemorySlab* Of(const void* addr) {
+        return reinterpret_cast<MemorySlab*>(reinterpret_cast<uintptr_t>(addr) &
+                                             ~static_cast<uintptr_t>(SLAB_SIZE - 1));
+    }
+
+    static std::atomic<int64_t>& LiveSlabCnt() {
+        static std::atomic<int64_t> cnt(0);
+        return cnt;
+    }
+
+    inline size_t available_size() const { return SLAB_SIZE - allocated_size_; }
+
+    // not thread safe, the owner pool should synchronize it
+    char* Alloc(size_t request_size) {
+        request_size = (request_size + 7) & ~static_cast<size_t>(7);
+        if (request_size > available_size()) {
+            return nullptr;
+        }
+        char* addr = reinterpret_cast<char*>(this) + allocated_size_;
+        allocated_size_ += request_size;
+        refs_.fetch_add(1, std::memory_order_relaxed);
+        return addr;
+    }
+
+    void UnRef() {
+        if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            this->~MemorySlab();
+            free(this);
+            LiveSlabCnt().fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+ private:
+    // the first reference is held by the pool until the slab is full
+    MemorySlab() : refs_(1), allocated_size_((sizeof(MemorySlab) + 7) & ~static_cast<size_t>(7)) {}
+    ~MemorySlab() {}
+
+    std::atomic<uint32_t> refs_;
+    size_t allocated_size_;
+};
+
+// SlabMemoryPool is a thread safe pool built on MemorySlab. Objects are
+// released one by one with Free and can outlive the pool itself
+class SlabMemoryPool {
+ public:
+    enum { MAX_ALLOC_SIZE = MemorySlab::SLAB_SIZE / 4 };
+
+    SlabMemoryPool() : mu_(), slab_(nullptr) {}
+    ~SlabMemoryPool() {
+        if (slab_ != nullptr) {
+            slab_->UnRef();
+        }
+    }
+    SlabMemoryPool(const SlabMemoryPool&) = delete;
+    SlabMemoryPool& operator=(const SlabMemoryPool&) = delete;
+
+    // return nullptr if request_size exceeds MAX_ALLOC_SIZE,
+    // the caller should allocate it from heap
+    char* Alloc(size_t request_size) {
+        if (request_size > MAX_ALLOC_SIZE) {
+            return nullptr;
+        }
+        std::lock_guard<std::mutex> lock(mu_);
+        char* addr = slab_ == nullptr ? nullptr : slab_->Alloc(request_size);
+        if (addr == nullptr) {
+            MemorySlab* slab = MemorySlab::New();
+            if (slab == nullptr) {
+                return nullptr;
+            }
+            if (slab_ != nullptr) {
+                slab_->UnRef();
+            }
+            slab_ = slab;
+            addr = slab_->Alloc(request_size);
+        }
+        return addr;
+    }
+
+    static void Free(void* addr) { MemorySlab::Of(addr)->UnRef(); }
+
+ private:
+    std::mutex mu_;
+    MemorySlab* slab_;
+};
+
 }  // namespace base
 }  // namespace openmldb
 
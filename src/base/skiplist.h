@@ -22,6 +22,7 @@
 
 #include <atomic>
 #include <iostream>
+#include <new>
 
 #include "base/random.h"
 
@@ -45,14 +46,28 @@ class Node {
  public:
     // Set data reference and Node height
     Node(const K& key, V& value, uint8_t height)  // NOLINT
-        : height_(height), key_(key), value_(value) {
+        : height_(height), embedded_(false), key_(key), value_(value) {
         nexts_ = new std::atomic<Node<K, V>*>[height];
     }
 
-    Node(uint8_t height) : height_(height), key_(), value_() {  // NOLINT
+    Node(uint8_t height) : height_(height), embedded_(false), key_(), value_() {  // NOLINT
         nexts_ = new std::atomic<Node<K, V>*>[height];
     }
 
+    // Allocate the node along with its nexts array in one piece of memory
+    static Node<K, V>* New(const K& key, V& value, uint8_t height) {  // NOLINT
+        void* mem = ::operator new(sizeof(Node<K, V>) + height * sizeof(std::atomic<Node<K, V>*>));
+        return new (mem) Node<K, V>(key, value, height, reinterpret_cast<char*>(mem) + sizeof(Node<K, V>));
+    }
+
+    static Node<K, V>* New(uint8_t height) {
+        void* mem = ::operator new(sizeof(Node<K, V>) + height * sizeof(std::atomic<Node<K, V>*>));
+        return new (mem) Node<K, V>(height, reinterpret_cast<char*>(mem) + sizeof(Node<K, V>));
+    }
+
+    // The memory of embedded node is larger than sizeof(Node), so the unsized delete must be used
+    static void operator delete(void* ptr) { ::operator delete(ptr); }
+
     // Set the next node with memory barrier
     void SetNext(uint8_t level, Node<K, V>* node) {
         assert(level < height_ && level >= 0);
@@ -81,10 +96,30 @@ class Node {
 
     const K& GetKey() const { return key_; }
 
-    ~Node() { delete[] nexts_; }
+    ~Node() {
+        if (!embedded_) {
+            delete[] nexts_;
+        }
+    }
+
+ private:
+    Node(const K& key, V& value, uint8_t height, void* nexts)  // NOLINT
+        : height_(height), embedded_(true), key_(key), value_(value) {
+        InitNexts(nexts);
+    }
+
+    Node(uint8_t height, void* nexts) : height_(height), embedded_(true), key_(), value_() { InitNexts(nexts); }
+
+    void InitNexts(void* nexts) {
+        nexts_ = reinterpret_cast<std::atomic<Node<K, V>*>*>(nexts);
+        for (uint8_t i = 0; i < height_; i++) {
+            new (&nexts_[i]) std::atomic<Node<K, V>*>(nullptr);
+        }
+    }
 
  private:
     uint8_t const height_;
+    bool const embedded_;
     K const key_;
     V value_;
     std::atomic<Node<K, V>*>* nexts_;
@@ -101,7 +136,7 @@ class Skiplist {
           rand_(0xdeadbeef),
           head_(NULL),
           tail_(NULL) {
-        head_ = new Node<K, V>(MaxHeight);
+        head_ = Node<K, V>::New(MaxHeight);
         for (uint8_t i = 0; i < head_->Height(); i++) {
             head_->SetNext(i, NULL);
         }
@@ -364,8 +399,7 @@ class Skiplist {
 
  private:
     Node<K, V>* NewNode(const K& key, V& value, uint8_t height) {  // NOLINT
-        Node<K, V>* node = new Node<K, V>(key, value, height);
-        return node;
+        return Node<K, V>::New(key, value, height);
     }
 
     uint8_t RandomHeight() {
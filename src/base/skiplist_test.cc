@@ -94,6 +94,23 @@ TEST_F(NodeTest, NodeByteSize) {
     ASSERT_EQ(40u, sizeof(Node<Slice, void*>));
 }
 
+TEST_F(NodeTest, EmbeddedNode) {
+    uint32_t key = 1;
+    uint32_t value = 2;
+    Node<uint32_t, uint32_t>* node = Node<uint32_t, uint32_t>::New(key, value, 4);
+    Node<uint32_t, uint32_t>* node2 = Node<uint32_t, uint32_t>::New(4);
+    ASSERT_EQ(4, (signed)node->Height());
+    for (uint8_t i = 0; i < node->Height(); i++) {
+        ASSERT_TRUE(node->GetNext(i) == NULL);
+        node->SetNext(i, node2);
+    }
+    ASSERT_EQ(node2, node->GetNext(3));
+    ASSERT_EQ(1, (signed)node->GetKey());
+    ASSERT_EQ(2, (signed)node->GetValue());
+    delete node;
+    delete node2;
+}
+
 TEST_F(NodeTest, SliceTest) {
     SliceComparator cmp;
     Skiplist<Slice, KE*, SliceComparator> sl(12, 4, cmp);
@@ -294,6 +294,26 @@ bool TabletClient::Put(uint32_t tid, uint32_t pid, const std::string& pk, uint64
     return Put(tid, pid, pk.c_str(), time, value.c_str(), value.size(), format_version);
 }
 
+bool TabletClient::PutBatch(uint32_t tid, uint32_t pid,
+                            const ::google::protobuf::RepeatedPtrField<::openmldb::api::PutBatchRow>& rows,
+                            uint32_t* put_cnt) {
+    ::openmldb::api::PutBatchRequest request;
+    request.set_tid(tid);
+    request.set_pid(pid);
+    request.mutable_rows()->CopyFrom(rows);
+    ::openmldb::api::PutBatchResponse response;
+    bool ok = client_.SendRequest(&::openmldb::api::TabletServer_Stub::PutBatch, &request, &response,
+                                  FLAGS_request_timeout_ms, 1);
+    if (put_cnt != nullptr) {
+        *put_cnt = ok ? response.put_cnt() : 0;
+    }
+    if (ok && response.code() == 0) {
+        return true;
+    }
+    LOG(WARNING) << "fail to put batch for error " << response.msg() << " and error code " << response.code();
+    return false;
+}
+
 bool TabletClient::MakeSnapshot(uint32_t tid, uint32_t pid, uint64_t offset, std::shared_ptr<TaskInfo> task_info) {
     ::openmldb::api::GeneralRequest request;
     request.set_tid(tid);
@@ -90,6 +90,11 @@ class TabletClient : public Client {
     bool Put(uint32_t tid, uint32_t pid, uint64_t time, const std::string& value,
              const std::vector<std::pair<std::string, uint32_t>>& dimensions, uint32_t format_version);
 
+    // put_cnt is the count of rows put, they are the first ones of the batch
+    bool PutBatch(uint32_t tid, uint32_t pid,
+                  const ::google::protobuf::RepeatedPtrField<::openmldb::api::PutBatchRow>& rows,
+                  uint32_t* put_cnt = nullptr);
+
 
 
     bool Get(uint32_t tid, uint32_t pid, const std::string& pk, uint64_t time, std::string& value,  // NOLINT
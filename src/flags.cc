@@ -46,10 +46,16 @@ DEFINE_uint32(replica_num, 3,
 DEFINE_uint32(system_table_replica_num, 1, "config the default replica_num of system table.");
 DEFINE_int32(gc_interval, 120, "the gc interval of tablet every two hour");
 DEFINE_int32(disk_gc_interval, 120, "the rocksdb gc interval of tablet");
+DEFINE_uint32(disk_periodic_compaction_interval, 0,
+              "the interval in minutes to recompact the sst files of disk tables with ttl, so the expired rows in "
+              "them are removed. 0 disables it");
 DEFINE_int32(gc_pool_size, 2, "the size of tablet gc thread pool");
 DEFINE_int32(gc_safe_offset, 1, "the safe offset of tablet gc in minute");
 DEFINE_uint64(gc_on_table_recover_count, 10000000, "make a gc on recover count");
-DEFINE_uint32(gc_deleted_pk_version_delta, 2, "config the gc version delta");
+DEFINE_uint32(gc_tick_key_cnt, 0,
+              "the max count of keys visited in one gc tick of a memory table segment, 0 means gc the whole segment "
+              "in one tick");
+DEFINE_uint32(gc_tick_interval, 10, "the interval in millisecond between two gc ticks of one index");
 DEFINE_double(mem_release_rate, 5, "specify memory release rate, which should be in 0 ~ 10");
 DEFINE_int32(task_pool_size, 3, "the size of tablet task thread pool");
 DEFINE_int32(io_pool_size, 2, "the size of tablet io task thread pool");
@@ -58,6 +64,7 @@ DEFINE_string(data_dir, "./data", "the path of data dir");
 DEFINE_bool(enable_distsql, false, "enable or disable distribute sql");
 DEFINE_bool(enable_localtablet, true, "enable or disable local tablet opt when distribute sql circumstance");
 DEFINE_string(bucket_size, "1d", "the default bucket size in pre-aggr table");
+DEFINE_string(jit_object_cache_dir, "", "the dir to keep the object files compiled by jit, empty means disabled");
 
 // scan configuration
 DEFINE_uint32(scan_max_bytes_size, 2 * 1024 * 1024, "config the max size of scan bytes size");
@@ -67,11 +74,25 @@ DEFINE_uint32(preview_default_limit, 100, "config the default limit of preview")
 // binlog configuration
 DEFINE_int32(binlog_single_file_max_size, 1024 * 4, "the max size of single binlog file");
 DEFINE_int32(binlog_sync_batch_size, 32, "the batch size of sync binlog");
+DEFINE_uint32(binlog_sync_window_size, 1,
+              "the max number of requests of syncing binlog in flight to a follower. the window grows by one on "
+              "every success and is halved on failure. 1 means waiting for the response before the next request. "
+              "all tablets must be upgraded to the versions supporting it before it's set larger than 1");
+DEFINE_bool(binlog_sync_compress, false,
+            "compress the entries of the requests of syncing binlog by snappy if binlog_sync_window_size > 1");
+DEFINE_bool(binlog_sync_raw_record, false,
+            "send the binlog records as they are in the attachment of the requests of syncing binlog if "
+            "binlog_sync_window_size > 1, they are not decoded by the leader. binlog_sync_compress is ignored. "
+            "all tablets must be upgraded to the versions supporting it");
 DEFINE_bool(binlog_notify_on_put, false, "config the sync log to follower strategy");
 DEFINE_bool(binlog_enable_crc, false, "enable crc");
 DEFINE_int32(binlog_coffee_time, 1000, "config the coffee time");
 DEFINE_int32(binlog_sync_wait_time, 100, "config the sync log wait time");
 DEFINE_int32(binlog_sync_to_disk_interval, 20000, "config the interval of sync binlog to disk time");
+DEFINE_bool(binlog_group_commit, false,
+            "the puts of the leader return after the binlog is synced to disk, the concurrent puts are written "
+            "and synced together by one of them");
+DEFINE_uint32(binlog_group_commit_max_batch, 256, "the max number of entries synced together by group commit");
 DEFINE_int32(binlog_delete_interval, 60000, "config the interval of delete binlog");
 DEFINE_int32(binlog_match_logoffset_interval, 1000, "config the interval of match log offset ");
 DEFINE_int32(binlog_name_length, 8, "binlog name length");
@@ -114,6 +135,15 @@ DEFINE_uint32(make_snapshot_offline_interval, 60 * 60 * 24,
               "config tablet self makesnapshot when how long time do not "
               "makesnapshot from ns. unit is second");
 DEFINE_string(snapshot_compression, "off", "Type of snapshot compression, can be off, snappy, zlib");
+DEFINE_bool(snapshot_image, false,
+            "Write a binary image besides the snapshot of memory tables, which is mmaped to recover the table "
+            "without decoding the rows");
+DEFINE_uint32(snapshot_part_num, 1,
+              "the number of data files the snapshot of memory tables is split into by key, which are written "
+              "and loaded by different threads");
+DEFINE_uint32(snapshot_delta_max_num, 0,
+              "the max number of delta snapshots of memory tables, which only keep the binlog since the last "
+              "snapshot. the deltas are merged into a full snapshot when the number is reached. 0 disables it");
 DEFINE_int32(snapshot_pool_size, 1, "the size of tablet thread pool for making snapshot");
 
 DEFINE_uint32(load_index_max_wait_time, 120 * 60 * 1000, "config the max wait time of load index");
@@ -130,6 +160,16 @@ DEFINE_uint32(skiplist_max_height, 12, "the max height of skiplist");
 DEFINE_uint32(key_entry_max_height, 8, "the max height of key entry");
 DEFINE_uint32(latest_default_skiplist_height, 1, "the default height of skiplist for latest table");
 DEFINE_uint32(absolute_default_skiplist_height, 4, "the default height of skiplist for absolute table");
+DEFINE_bool(enable_segment_mem_pool, false,
+            "enable or disable allocating rows of memory table from per-segment slabs");
+DEFINE_uint32(latest_ring_max_cnt, 0,
+              "the rows of a key are kept in a ring if the index is latest ttl with a count not larger than it, "
+              "0 means disable");
+DEFINE_bool(enable_key_hash_index, false, "enable or disable the hash index for the key lookups of memory table");
+DEFINE_uint32(key_hash_index_bucket_cnt, 1024, "the initial bucket count of key hash index in one segment");
+DEFINE_uint32(cold_tier_age, 0,
+              "the age in minute after which rows of absolute ttl index in memory table are moved to cold blocks, "
+              "0 means disable");
 DEFINE_bool(enable_show_tp, false, "enable show tp");
 DEFINE_uint32(max_col_display_length, 256, "config the max length of column display");
 
@@ -142,6 +182,18 @@ DEFINE_uint32(block_cache_mb, 4096,
 DEFINE_uint32(write_buffer_mb, 128, "Memtable size");
 DEFINE_uint32(block_cache_shardbits, 8, "Divide block cache into 2^8 shards to avoid cache contention");
 DEFINE_bool(verify_compression, false, "For debug");
+DEFINE_uint32(disk_table_bloom_bits_per_key, 10,
+              "Bits per key of the prefix bloom filter of disk tables, the filter is disabled if it's 0");
+DEFINE_uint32(disk_table_block_size_kb, 256, "Default block size of disk tables, can be set per table");
+DEFINE_uint32(disk_row_cache_mb, 0,
+              "Memory of the row cache of every disk table for the newest rows of hot keys, 0 disables it. "
+              "can be set per table");
+DEFINE_uint32(disk_row_cache_row_cnt, 100, "The max count of the newest rows cached for one key");
+DEFINE_uint32(disk_row_cache_admit_cnt, 2, "A key is cached after it's looked up these times recently");
+DEFINE_uint32(disk_write_group_delay_us, 0,
+              "The max time in us a put into disk tables waits for other puts to write them in one batch, "
+              "0 disables it");
+DEFINE_uint32(disk_write_group_max_rows, 1024, "A batch of puts into disk tables is written at once with these rows");
 
 // load table resouce control
 DEFINE_uint32(load_table_batch, 30, "set laod table batch size");
@@ -446,6 +446,15 @@ LogReader::~LogReader() {
 
 void LogReader::SetOffset(uint64_t start_offset) { start_offset_ = start_offset; }
 
+void LogReader::ResetOffset(uint64_t start_offset) {
+    delete reader_;
+    reader_ = NULL;
+    delete sf_;
+    sf_ = NULL;
+    log_part_index_ = -1;
+    start_offset_ = start_offset;
+}
+
 void LogReader::GoBackToLastBlock() {
     if (sf_ == NULL || reader_ == NULL) {
         return;
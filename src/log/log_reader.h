@@ -162,6 +162,8 @@ class LogReader {
     int GetEndLogIndex();
     uint64_t GetLastRecordEndOffset();
     void SetOffset(uint64_t start_offset);
+    // read from the log part of start_offset again
+    void ResetOffset(uint64_t start_offset);
     LogReader(const LogReader&) = delete;
     LogReader& operator=(const LogReader&) = delete;
 
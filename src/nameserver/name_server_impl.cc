@@ -2312,6 +2312,12 @@ int NameServerImpl::CreateTableOnTablet(const std::shared_ptr<::openmldb::namese
     if (table_info->has_key_entry_max_height()) {
         table_meta.set_key_entry_max_height(table_info->key_entry_max_height());
     }
+    if (table_info->has_block_size_kb()) {
+        table_meta.set_block_size_kb(table_info->block_size_kb());
+    }
+    if (table_info->has_row_cache_mb()) {
+        table_meta.set_row_cache_mb(table_info->row_cache_mb());
+    }
     for (int idx = 0; idx < table_info->column_desc_size(); idx++) {
         ::openmldb::common::ColumnDesc* column_desc = table_meta.add_column_desc();
         column_desc->CopyFrom(table_info->column_desc(idx));
@@ -35,6 +35,8 @@
 
 DECLARE_int32(binlog_single_file_max_size);
 DECLARE_int32(binlog_name_length);
+DECLARE_bool(binlog_group_commit);
+DECLARE_uint32(binlog_group_commit_max_batch);
 DECLARE_string(zk_cluster);
 
 namespace openmldb {
@@ -59,7 +61,9 @@ LogReplicator::LogReplicator(uint32_t tid, uint32_t pid, const std::string& path
       term_(0),
       mu_(),
       cv_(),
-      wmu_() {
+      wmu_(),
+      commit_mu_(),
+      commit_waiters_() {
     binlog_index_ = 0;
     snapshot_log_part_index_.store(-1, std::memory_order_relaxed);
     snapshot_last_offset_.store(0, std::memory_order_relaxed);
@@ -289,8 +293,11 @@ uint64_t LogReplicator::GetLeaderTerm() { return term_.load(std::memory_order_re
 
 void LogReplicator::SetLeaderTerm(uint64_t term) { term_.store(term, std::memory_order_relaxed); }
 
-bool LogReplicator::ApplyEntry(const LogEntry& entry) {
+bool LogReplicator::ApplyEntry(const LogEntry& entry, bool* applied, const std::string* record) {
     std::lock_guard<std::mutex> lock(wmu_);
+    if (applied != NULL) {
+        *applied = false;
+    }
     uint64_t last_log_offset = GetOffset();
     if (wh_ == NULL || (wh_->GetSize() / (1024 * 1024)) > (uint32_t)FLAGS_binlog_single_file_max_size) {
         if (!RollWLogFile()) {
@@ -304,18 +311,41 @@ bool LogReplicator::ApplyEntry(const LogEntry& entry) {
         return true;
     }
     std::string buffer;
-    entry.SerializeToString(&buffer);
-    ::openmldb::base::Slice slice(buffer.c_str(), buffer.size());
+    if (record == NULL) {
+        entry.SerializeToString(&buffer);
+        record = &buffer;
+    }
+    ::openmldb::base::Slice slice(record->c_str(), record->size());
     ::openmldb::log::Status status = wh_->Write(slice);
     if (!status.ok()) {
         PDLOG(WARNING, "fail to write replication log in dir %s for %s", path_.c_str(), status.ToString().c_str());
         return false;
     }
     log_offset_.store(entry.log_index(), std::memory_order_relaxed);
+    {
+        std::lock_guard<bthread::Mutex> apply_lock(apply_mu_);
+        apply_cv_.notify_all();
+    }
+    if (applied != NULL) {
+        *applied = true;
+    }
     DEBUGLOG("sync log entry to offset %lu for %s", GetOffset(), path_.c_str());
     return true;
 }
 
+bool LogReplicator::WaitForOffset(uint64_t offset, uint32_t timeout_ms) {
+    uint64_t deadline = ::baidu::common::timer::get_micros() + timeout_ms * 1000ul;
+    std::unique_lock<bthread::Mutex> lock(apply_mu_);
+    while (GetOffset() < offset) {
+        uint64_t now = ::baidu::common::timer::get_micros();
+        if (now >= deadline) {
+            return false;
+        }
+        apply_cv_.wait_for(lock, deadline - now);
+    }
+    return true;
+}
+
 int LogReplicator::AddReplicateNode(const std::map<std::string, std::string>& real_ep_map) {
     return AddReplicateNode(real_ep_map, UINT32_MAX);
 }
@@ -434,7 +464,96 @@ bool LogReplicator::DelAllReplicateNode() {
 }
 
 bool LogReplicator::AppendEntry(LogEntry& entry) {
+    if (FLAGS_binlog_group_commit) {
+        return GroupCommit(entry);
+    }
     std::lock_guard<std::mutex> lock(wmu_);
+    std::string buffer;
+    return AppendEntryUnlock(entry, &buffer);
+}
+
+uint32_t LogReplicator::AppendEntries(std::vector<LogEntry>& entries) {
+    std::lock_guard<std::mutex> lock(wmu_);
+    std::string buffer;
+    uint32_t cnt = 0;
+    for (auto& entry : entries) {
+        if (!AppendEntryUnlock(entry, &buffer)) {
+            break;
+        }
+        cnt++;
+    }
+    if (FLAGS_binlog_group_commit && cnt > 0) {
+        ::openmldb::log::Status status = wh_->Sync();
+        if (!status.ok()) {
+            PDLOG(WARNING, "fail to sync data for path %s for %s", path_.c_str(), status.ToString().c_str());
+            return 0;
+        }
+    }
+    return cnt;
+}
+
+bool LogReplicator::GroupCommit(LogEntry& entry) {
+    CommitWaiter waiter;
+    waiter.entry = &entry;
+    waiter.done = false;
+    waiter.ok = false;
+    std::unique_lock<bthread::Mutex> lock(commit_mu_);
+    commit_waiters_.push_back(&waiter);
+    while (!waiter.done && commit_waiters_.front() != &waiter) {
+        waiter.cv.wait(lock);
+    }
+    if (waiter.done) {
+        return waiter.ok;
+    }
+    // the waiters queued later are left to the next leader
+    uint32_t max_batch = std::max(FLAGS_binlog_group_commit_max_batch, 1u);
+    std::vector<CommitWaiter*> batch;
+    for (auto* cur : commit_waiters_) {
+        if (batch.size() >= max_batch) {
+            break;
+        }
+        batch.push_back(cur);
+    }
+    // the others can be queued while the batch is written and synced
+    lock.unlock();
+    uint32_t write_cnt = 0;
+    bool sync_ok = false;
+    {
+        std::lock_guard<std::mutex> wlock(wmu_);
+        std::string buffer;
+        for (auto* cur : batch) {
+            if (!AppendEntryUnlock(*cur->entry, &buffer)) {
+                break;
+            }
+            write_cnt++;
+        }
+        // the entries written are not durable if the binlog fails to roll, as it may be the sync
+        // of the file rolled that fails, so the whole batch fails
+        if (write_cnt > 0 && write_cnt == batch.size()) {
+            ::openmldb::log::Status status = wh_->Sync();
+            sync_ok = status.ok();
+            if (!sync_ok) {
+                PDLOG(WARNING, "fail to sync data for path %s for %s", path_.c_str(), status.ToString().c_str());
+            }
+        }
+    }
+    lock.lock();
+    for (uint32_t i = 0; i < batch.size(); i++) {
+        CommitWaiter* cur = batch[i];
+        commit_waiters_.pop_front();
+        cur->ok = i < write_cnt && sync_ok;
+        cur->done = true;
+        if (cur != &waiter) {
+            cur->cv.notify_one();
+        }
+    }
+    if (!commit_waiters_.empty()) {
+        commit_waiters_.front()->cv.notify_one();
+    }
+    return waiter.ok;
+}
+
+bool LogReplicator::AppendEntryUnlock(LogEntry& entry, std::string* buffer) {
     if (wh_ == NULL || wh_->GetSize() / (1024 * 1024) > (uint32_t)FLAGS_binlog_single_file_max_size) {
         bool ok = RollWLogFile();
         if (!ok) {
@@ -443,9 +562,8 @@ bool LogReplicator::AppendEntry(LogEntry& entry) {
     }
     uint64_t cur_offset = log_offset_.load(std::memory_order_relaxed);
     entry.set_log_index(1 + cur_offset);
-    std::string buffer;
-    entry.SerializeToString(&buffer);
-    ::openmldb::base::Slice slice(buffer);
+    entry.SerializeToString(buffer);
+    ::openmldb::base::Slice slice(*buffer);
     ::openmldb::log::Status status = wh_->Write(slice);
     if (!status.ok()) {
         PDLOG(WARNING, "fail to write replication log in dir %s for %s", path_.c_str(), status.ToString().c_str());
@@ -461,6 +579,15 @@ bool LogReplicator::AppendEntry(LogEntry& entry) {
 
 bool LogReplicator::RollWLogFile() {
     if (wh_ != NULL) {
+        // the entries of a group may be written to the file before it's rolled, and they are
+        // acked by the sync of the new file
+        if (FLAGS_binlog_group_commit) {
+            ::openmldb::log::Status status = wh_->Sync();
+            if (!status.ok()) {
+                PDLOG(WARNING, "fail to sync data for path %s for %s", path_.c_str(), status.ToString().c_str());
+                return false;
+            }
+        }
         wh_->EndLog();
         delete wh_;
         wh_ = NULL;
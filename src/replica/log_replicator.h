@@ -19,6 +19,7 @@
 
 #include <atomic>
 #include <condition_variable>  // NOLINT
+#include <deque>
 #include <map>
 #include <memory>
 #include <mutex>  // NOLINT
@@ -60,12 +61,23 @@ class LogReplicator {
 
     bool StartSyncing();
 
-    // the slave node receives master log entries
-    bool ApplyEntry(const ::openmldb::api::LogEntry& entry);
+    // the slave node receives master log entries, applied is set false if the entry
+    // has been applied before. record is written to binlog as it is if it's the serialized entry
+    bool ApplyEntry(const ::openmldb::api::LogEntry& entry, bool* applied = NULL, const std::string* record = NULL);
 
-    // the master node append entry
+    // the slave node waits until the entries up to offset are applied, return false if it's
+    // timeout
+    bool WaitForOffset(uint64_t offset, uint32_t timeout_ms);
+
+    // the master node append entry, it returns after the entry is synced to disk
+    // if binlog_group_commit is set
     bool AppendEntry(::openmldb::api::LogEntry& entry);  // NOLINT
 
+    // the master node append entries with the write lock held once, the entries
+    // before the failed one are appended. they are synced at once if binlog_group_commit
+    // is set. return the count of the entries logged, it's 0 if the sync fails
+    uint32_t AppendEntries(std::vector<::openmldb::api::LogEntry>& entries);  // NOLINT
+
     //  data to slave nodes
     void Notify();
     // recover logs meta
@@ -113,6 +125,21 @@ class LogReplicator {
  private:
     bool OpenSeqFile(const std::string& path, SequentialFile** sf);
 
+    // wmu_ must be held
+    bool AppendEntryUnlock(::openmldb::api::LogEntry& entry, std::string* buffer);  // NOLINT
+
+    // an entry waiting in the group commit queue
+    struct CommitWaiter {
+        ::openmldb::api::LogEntry* entry;
+        bool done;
+        bool ok;
+        bthread::ConditionVariable cv;
+    };
+
+    // append entry by group commit. the waiter at the front of the queue is the leader, it
+    // writes the entries queued so far and syncs them once, then wakes them and the next leader
+    bool GroupCommit(::openmldb::api::LogEntry& entry);  // NOLINT
+
  private:
     // the replicator root data path
     uint32_t tid_;
@@ -139,6 +166,12 @@ class LogReplicator {
     std::atomic<uint64_t> snapshot_last_offset_;
 
     std::mutex wmu_;
+    // notified when the slave node applies an entry
+    bthread::Mutex apply_mu_;
+    bthread::ConditionVariable apply_cv_;
+    // protect commit_waiters_
+    bthread::Mutex commit_mu_;
+    std::deque<CommitWaiter*> commit_waiters_;
 };
 
 }  // namespace replica
@@ -17,6 +17,7 @@
 #include "replica/log_replicator.h"
 
 #include <brpc/server.h>
+#include <gflags/gflags.h>
 #include <gtest/gtest.h>
 #include <sched.h>
 #include <stdio.h>
@@ -24,12 +25,17 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <atomic>
+#include <set>
+#include <thread>  // NOLINT
+#include <tuple>
 #include <utility>
 
 #include "base/glog_wapper.h"
 #include "base/status.h"
 #include "common/thread_pool.h"
 #include "common/timer.h"
+#include "log/log_reader.h"
 #include "proto/tablet.pb.h"
 #include "replica/replicate_node.h"
 #include "storage/mem_table.h"
@@ -37,6 +43,12 @@
 #include "storage/ticket.h"
 #include "test/util.h"
 
+DECLARE_bool(binlog_group_commit);
+DECLARE_int32(binlog_single_file_max_size);
+DECLARE_uint32(binlog_sync_window_size);
+DECLARE_bool(binlog_sync_compress);
+DECLARE_bool(binlog_sync_raw_record);
+
 using ::baidu::common::ThreadPool;
 using ::google::protobuf::Closure;
 using ::google::protobuf::RpcController;
@@ -82,26 +94,67 @@ class MockTabletImpl : public ::openmldb::api::TabletServer {
 
     void AppendEntries(RpcController* controller, const ::openmldb::api::AppendEntriesRequest* request,
                        ::openmldb::api::AppendEntriesResponse* response, Closure* done) {
+        brpc::ClosureGuard done_guard(done);
         uint64_t last_log_offset = replicator_.GetOffset();
-        for (int32_t i = 0; i < request->entries_size(); i++) {
-            if (request->entries(i).log_index() <= last_log_offset) {
+        if (request->pre_log_index() > last_log_offset) {
+            if (!replicator_.WaitForOffset(request->pre_log_index(), 100)) {
+                response->set_code(::openmldb::base::ReturnCode::kLogIsNotContinuous);
+                response->set_msg("log is not continuous");
+                response->set_log_offset(replicator_.GetOffset());
+                return;
+            }
+            last_log_offset = replicator_.GetOffset();
+        }
+        ::openmldb::api::AppendEntriesRequest decompressed;
+        std::vector<std::string> records;
+        const auto* entries = &request->entries();
+        if (old_version_.load(std::memory_order_relaxed)) {
+            // the follower of an old version only knows the entries of request
+        } else if (request->raw_entry_num() > 0) {
+            const butil::IOBuf& attachment = static_cast<brpc::Controller*>(controller)->request_attachment();
+            if (!ReplicateNode::ParseRawEntries(attachment, request->raw_entry_num(), &records, &decompressed)) {
+                response->set_code(::openmldb::base::ReturnCode::kFailToAppendEntriesToReplicator);
+                response->set_msg("fail to parse raw entries");
+                return;
+            }
+            entries = &decompressed.entries();
+        } else if (request->has_compressed_entries()) {
+            if (!ReplicateNode::DecompressEntries(*request, &decompressed)) {
+                response->set_code(::openmldb::base::ReturnCode::kFailToAppendEntriesToReplicator);
+                response->set_msg("fail to decompress entries");
+                return;
+            }
+            entries = &decompressed.entries();
+        }
+        for (int32_t i = 0; i < entries->size(); i++) {
+            const auto& entry = entries->Get(i);
+            if (entry.log_index() <= last_log_offset) {
                 continue;
             }
-            const auto& entry = request->entries(i);
-            if (!replicator_.ApplyEntry(entry)) {
+            bool applied = false;
+            if (!replicator_.ApplyEntry(entry, &applied, records.empty() ? NULL : &records[i])) {
                 response->set_code(::openmldb::base::ReturnCode::kFailToAppendEntriesToReplicator);
                 response->set_msg("fail to append entries to replicator");
                 return;
             }
-            table_->Put(entry);
+            if (applied) {
+                table_->Put(entry);
+            }
         }
         response->set_log_offset(replicator_.GetOffset());
-        done->Run();
         replicator_.Notify();
     }
 
     void SetMode(bool follower) { follower_.store(follower); }
 
+    // ignore the compressed entries and the raw records like the versions before them
+    void SetOldVersion(bool old_version) { old_version_.store(old_version); }
+
+    // lose the entries after offset
+    void SetOffset(uint64_t offset) { replicator_.SetOffset(offset); }
+
+    uint64_t GetOffset() { return replicator_.GetOffset(); }
+
     bool GetMode() { return follower_.load(std::memory_order_relaxed); }
 
  private:
@@ -111,6 +164,7 @@ class MockTabletImpl : public ::openmldb::api::TabletServer {
     std::map<std::string, std::string> real_ep_map_;
     LogReplicator replicator_;
     std::atomic<bool> follower_;
+    std::atomic<bool> old_version_{false};
 };
 
 bool ReceiveEntry(const ::openmldb::api::LogEntry& entry) { return true; }
@@ -147,6 +201,284 @@ TEST_F(LogReplicatorTest, BenchMark) {
     ASSERT_TRUE(ok);
 }
 
+TEST_F(LogReplicatorTest, GroupCommit) {
+    std::map<std::string, std::string> map;
+    std::string folder = "/tmp/" + GenRand() + "/";
+    LogReplicator replicator(1, 1, folder, map, kLeaderNode);
+    ASSERT_TRUE(replicator.Init());
+    FLAGS_binlog_group_commit = true;
+    uint32_t thread_num = 8;
+    uint32_t entry_num = 1000;
+    std::vector<std::vector<uint64_t>> offsets(thread_num);
+    std::vector<std::thread> threads;
+    for (uint32_t i = 0; i < thread_num; i++) {
+        threads.emplace_back([&, i]() {
+            for (uint32_t j = 0; j < entry_num; j++) {
+                ::openmldb::api::LogEntry entry;
+                entry.set_term(1);
+                entry.set_pk("test" + std::to_string(i));
+                entry.set_value("value" + std::to_string(j));
+                entry.set_ts(9527);
+                if (replicator.AppendEntry(entry)) {
+                    offsets[i].push_back(entry.log_index());
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    std::vector<::openmldb::api::LogEntry> entries(10);
+    ASSERT_EQ(entries.size(), replicator.AppendEntries(entries));
+    FLAGS_binlog_group_commit = false;
+    ASSERT_EQ(thread_num * entry_num + 10, replicator.GetLogOffset());
+    std::set<uint64_t> offset_set;
+    for (const auto& thread_offsets : offsets) {
+        ASSERT_EQ(entry_num, thread_offsets.size());
+        // the entries of a thread are appended in order
+        for (uint32_t j = 1; j < thread_offsets.size(); j++) {
+            ASSERT_LT(thread_offsets[j - 1], thread_offsets[j]);
+        }
+        offset_set.insert(thread_offsets.begin(), thread_offsets.end());
+    }
+    ASSERT_EQ(thread_num * entry_num, offset_set.size());
+    ASSERT_EQ(1u, *offset_set.begin());
+    ASSERT_EQ(thread_num * entry_num, *offset_set.rbegin());
+}
+
+TEST_F(LogReplicatorTest, GroupCommitWithRoll) {
+    std::map<std::string, std::string> map;
+    std::string folder = "/tmp/" + GenRand() + "/";
+    LogReplicator replicator(1, 1, folder, map, kLeaderNode);
+    ASSERT_TRUE(replicator.Init());
+    FLAGS_binlog_group_commit = true;
+    // the binlog is rolled once it's over 1M, so it's rolled in the middle of the groups
+    int32_t old_max_size = FLAGS_binlog_single_file_max_size;
+    FLAGS_binlog_single_file_max_size = 0;
+    uint32_t thread_num = 8;
+    uint32_t entry_num = 100;
+    std::atomic<uint32_t> failed_cnt(0);
+    std::vector<std::thread> threads;
+    for (uint32_t i = 0; i < thread_num; i++) {
+        threads.emplace_back([&, i]() {
+            for (uint32_t j = 0; j < entry_num; j++) {
+                ::openmldb::api::LogEntry entry;
+                entry.set_term(1);
+                entry.set_pk("test" + std::to_string(i));
+                entry.set_value(std::string(64 * 1024, 'a' + j % 26));
+                entry.set_ts(9527);
+                if (!replicator.AppendEntry(entry)) {
+                    failed_cnt++;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    FLAGS_binlog_group_commit = false;
+    FLAGS_binlog_single_file_max_size = old_max_size;
+    ASSERT_EQ(0u, failed_cnt.load());
+    ASSERT_EQ(thread_num * entry_num, replicator.GetLogOffset());
+    ASSERT_GT(replicator.GetLogPart()->GetSize(), 10u);
+    // every acked entry is in the binlog files, including the rolled ones
+    ::openmldb::log::LogReader log_reader(replicator.GetLogPart(), replicator.GetLogPath(), false);
+    log_reader.SetOffset(0);
+    uint64_t offset = 0;
+    int last_log_index = log_reader.GetLogIndex();
+    while (true) {
+        std::string buffer;
+        ::openmldb::base::Slice record;
+        ::openmldb::log::Status status = log_reader.ReadNextRecord(&record, &buffer);
+        if (status.IsEof()) {
+            if (log_reader.GetLogIndex() != last_log_index) {
+                last_log_index = log_reader.GetLogIndex();
+                continue;
+            }
+            break;
+        }
+        if (!status.ok()) {
+            break;
+        }
+        ::openmldb::api::LogEntry entry;
+        ASSERT_TRUE(entry.ParseFromString(record.ToString()));
+        ASSERT_EQ(offset + 1, entry.log_index());
+        offset = entry.log_index();
+    }
+    ASSERT_EQ(thread_num * entry_num, offset);
+}
+
+TEST_F(LogReplicatorTest, ReplicationLag) {
+    std::map<std::string, uint32_t> mapping;
+    mapping.insert(std::make_pair("idx0", 0));
+    uint32_t entry_num = 20000;
+    // the window size, compression and raw record of every round
+    std::vector<std::tuple<uint32_t, bool, bool>> modes = {
+        {1, false, false}, {8, false, false}, {8, true, false}, {8, false, true}};
+    for (uint32_t round = 0; round < modes.size(); round++) {
+        FLAGS_binlog_sync_window_size = std::get<0>(modes[round]);
+        FLAGS_binlog_sync_compress = std::get<1>(modes[round]);
+        FLAGS_binlog_sync_raw_record = std::get<2>(modes[round]);
+        std::shared_ptr<MemTable> table =
+            std::make_shared<MemTable>("test", 1, 1, 8, mapping, 0, ::openmldb::type::TTLType::kAbsoluteTime);
+        table->Init();
+        brpc::ServerOptions options;
+        brpc::Server server;
+        std::string follower_addr = "127.0.0.1:" + std::to_string(17530 + round);
+        MockTabletImpl* follower = new MockTabletImpl(kFollowerNode, "/tmp/" + GenRand() + "/", g_endpoints, table);
+        ASSERT_TRUE(follower->Init());
+        ASSERT_EQ(0, server.AddService(follower, brpc::SERVER_OWNS_SERVICE));
+        ASSERT_EQ(0, server.Start(follower_addr.c_str(), &options));
+        LogReplicator leader(1, 1, "/tmp/" + GenRand() + "/", g_endpoints, kLeaderNode);
+        ASSERT_TRUE(leader.Init());
+        for (uint32_t i = 0; i < entry_num; i++) {
+            ::openmldb::api::LogEntry entry;
+            entry.set_pk("key" + std::to_string(i % 100));
+            entry.set_ts(i + 1);
+            entry.set_value(std::string(100, 'a' + i % 26));
+            ASSERT_TRUE(leader.AppendEntry(entry));
+        }
+        leader.SyncToDisk();
+        uint64_t start = ::baidu::common::timer::get_micros();
+        std::map<std::string, std::string> map;
+        map.insert(std::make_pair(follower_addr, ""));
+        ASSERT_EQ(0, leader.AddReplicateNode(map));
+        leader.Notify();
+        std::map<std::string, uint64_t> info_map;
+        for (uint32_t i = 0; i < 6000; i++) {
+            info_map.clear();
+            leader.GetReplicateInfo(info_map);
+            if (info_map[follower_addr] >= entry_num) {
+                break;
+            }
+            usleep(10000);
+        }
+        uint64_t consumed = ::baidu::common::timer::get_micros() - start;
+        PDLOG(INFO, "window size %u compress %d raw record %d: %u entries are replicated in %lu ms",
+              FLAGS_binlog_sync_window_size, FLAGS_binlog_sync_compress, FLAGS_binlog_sync_raw_record, entry_num,
+              consumed / 1000);
+        ASSERT_EQ(entry_num, info_map[follower_addr]);
+        leader.DelAllReplicateNode();
+        ASSERT_EQ(entry_num, table->GetRecordCnt());
+    }
+    FLAGS_binlog_sync_window_size = 1;
+    FLAGS_binlog_sync_compress = false;
+    FLAGS_binlog_sync_raw_record = false;
+}
+
+TEST_F(LogReplicatorTest, FollowerBehind) {
+    std::map<std::string, uint32_t> mapping;
+    mapping.insert(std::make_pair("idx0", 0));
+    uint32_t entry_num = 1000;
+    std::vector<uint32_t> window_sizes = {1, 8};
+    for (uint32_t round = 0; round < window_sizes.size(); round++) {
+        FLAGS_binlog_sync_window_size = window_sizes[round];
+        std::shared_ptr<MemTable> table =
+            std::make_shared<MemTable>("test", 1, 1, 8, mapping, 0, ::openmldb::type::TTLType::kAbsoluteTime);
+        table->Init();
+        brpc::ServerOptions options;
+        brpc::Server server;
+        std::string follower_addr = "127.0.0.1:" + std::to_string(17540 + round);
+        MockTabletImpl* follower = new MockTabletImpl(kFollowerNode, "/tmp/" + GenRand() + "/", g_endpoints, table);
+        ASSERT_TRUE(follower->Init());
+        ASSERT_EQ(0, server.AddService(follower, brpc::SERVER_OWNS_SERVICE));
+        ASSERT_EQ(0, server.Start(follower_addr.c_str(), &options));
+        LogReplicator leader(1, 1, "/tmp/" + GenRand() + "/", g_endpoints, kLeaderNode);
+        ASSERT_TRUE(leader.Init());
+        auto append = [&](uint32_t start) {
+            for (uint32_t i = start; i < start + entry_num; i++) {
+                ::openmldb::api::LogEntry entry;
+                entry.set_pk("key" + std::to_string(i % 100));
+                entry.set_ts(i + 1);
+                entry.set_value("value" + std::to_string(i));
+                ASSERT_TRUE(leader.AppendEntry(entry));
+            }
+            leader.SyncToDisk();
+            leader.Notify();
+        };
+        auto wait = [&](uint64_t offset) {
+            std::map<std::string, uint64_t> info_map;
+            for (uint32_t i = 0; i < 1000; i++) {
+                info_map.clear();
+                leader.GetReplicateInfo(info_map);
+                if (info_map[follower_addr] >= offset && follower->GetOffset() >= offset) {
+                    break;
+                }
+                usleep(10000);
+            }
+            ASSERT_EQ(offset, info_map[follower_addr]);
+            ASSERT_EQ(offset, follower->GetOffset());
+        };
+        append(0);
+        std::map<std::string, std::string> map;
+        map.insert(std::make_pair(follower_addr, ""));
+        ASSERT_EQ(0, leader.AddReplicateNode(map));
+        leader.Notify();
+        wait(entry_num);
+        // the follower loses the entries not synced to disk, so it rejects the requests after them,
+        // and the leader sends them again from its log offset
+        follower->SetOffset(entry_num - 100);
+        append(entry_num);
+        wait(entry_num * 2);
+        leader.DelAllReplicateNode();
+    }
+    FLAGS_binlog_sync_window_size = 1;
+}
+
+TEST_F(LogReplicatorTest, OldVersionFollower) {
+    std::map<std::string, uint32_t> mapping;
+    mapping.insert(std::make_pair("idx0", 0));
+    uint32_t entry_num = 1000;
+    FLAGS_binlog_sync_window_size = 8;
+    FLAGS_binlog_sync_compress = true;
+    // the entries are compressed in the first round and sent as raw records in the second one
+    for (uint32_t round = 0; round < 2; round++) {
+        FLAGS_binlog_sync_raw_record = round == 1;
+        std::shared_ptr<MemTable> table =
+            std::make_shared<MemTable>("test", 1, 1, 8, mapping, 0, ::openmldb::type::TTLType::kAbsoluteTime);
+        table->Init();
+        brpc::ServerOptions options;
+        brpc::Server server;
+        std::string follower_addr = "127.0.0.1:" + std::to_string(17545 + round);
+        MockTabletImpl* follower = new MockTabletImpl(kFollowerNode, "/tmp/" + GenRand() + "/", g_endpoints, table);
+        ASSERT_TRUE(follower->Init());
+        follower->SetOldVersion(true);
+        ASSERT_EQ(0, server.AddService(follower, brpc::SERVER_OWNS_SERVICE));
+        ASSERT_EQ(0, server.Start(follower_addr.c_str(), &options));
+        LogReplicator leader(1, 1, "/tmp/" + GenRand() + "/", g_endpoints, kLeaderNode);
+        ASSERT_TRUE(leader.Init());
+        for (uint32_t i = 0; i < entry_num; i++) {
+            ::openmldb::api::LogEntry entry;
+            entry.set_pk("key" + std::to_string(i % 100));
+            entry.set_ts(i + 1);
+            entry.set_value("value" + std::to_string(i));
+            ASSERT_TRUE(leader.AppendEntry(entry));
+        }
+        leader.SyncToDisk();
+        std::map<std::string, std::string> map;
+        map.insert(std::make_pair(follower_addr, ""));
+        ASSERT_EQ(0, leader.AddReplicateNode(map));
+        leader.Notify();
+        // the follower returns ok for the requests it can't apply, so the leader syncs from its offset
+        // again and sends the entries as they are
+        std::map<std::string, uint64_t> info_map;
+        for (uint32_t i = 0; i < 1000; i++) {
+            info_map.clear();
+            leader.GetReplicateInfo(info_map);
+            if (info_map[follower_addr] >= entry_num && follower->GetOffset() >= entry_num) {
+                break;
+            }
+            usleep(10000);
+        }
+        ASSERT_EQ(entry_num, info_map[follower_addr]);
+        ASSERT_EQ(entry_num, follower->GetOffset());
+        leader.DelAllReplicateNode();
+    }
+    FLAGS_binlog_sync_raw_record = false;
+    FLAGS_binlog_sync_compress = false;
+    FLAGS_binlog_sync_window_size = 1;
+}
+
 TEST_F(LogReplicatorTest, LeaderAndFollowerMulti) {
     brpc::ServerOptions options;
     brpc::Server server0;
@@ -17,13 +17,20 @@
 #include "replica/replicate_node.h"
 
 #include <gflags/gflags.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/wire_format_lite.h>
+#include <snappy.h>
 
 #include <algorithm>
 
 #include "base/glog_wapper.h"  // NOLINT
+#include "base/status.h"
 #include "base/strings.h"
 
 DECLARE_int32(binlog_sync_batch_size);
+DECLARE_uint32(binlog_sync_window_size);
+DECLARE_bool(binlog_sync_compress);
+DECLARE_bool(binlog_sync_raw_record);
 DECLARE_int32(binlog_sync_wait_time);
 DECLARE_int32(binlog_coffee_time);
 DECLARE_int32(binlog_match_logoffset_interval);
@@ -35,6 +42,25 @@ DECLARE_uint32(go_back_max_try_cnt);
 namespace openmldb {
 namespace replica {
 
+// get the log index of a serialized LogEntry without parsing the other fields
+static bool ParseLogIndex(const ::openmldb::base::Slice& record, uint64_t* log_index) {
+    using ::google::protobuf::internal::WireFormatLite;
+    ::google::protobuf::io::CodedInputStream input(reinterpret_cast<const uint8_t*>(record.data()), record.size());
+    while (true) {
+        uint32_t tag = input.ReadTag();
+        if (tag == 0) {
+            return false;
+        }
+        if (WireFormatLite::GetTagFieldNumber(tag) == ::openmldb::api::LogEntry::kLogIndexFieldNumber &&
+            WireFormatLite::GetTagWireType(tag) == WireFormatLite::WIRETYPE_VARINT) {
+            return input.ReadVarint64(log_index);
+        }
+        if (!WireFormatLite::SkipField(&input, tag)) {
+            return false;
+        }
+    }
+}
+
 static void* RunSyncTask(void* args) {
     if (args == NULL) {
         PDLOG(WARNING, "input args is null");
@@ -52,6 +78,12 @@ ReplicateNode::ReplicateNode(const std::string& point, LogParts* logs, const std
                              std::atomic<uint64_t>* follower_offset, const std::string& real_point)
     : log_reader_(logs, log_path, false),
       cache_(),
+      inflight_(),
+      retry_(),
+      window_(1),
+      compress_(true),
+      raw_record_(true),
+      sent_offset_(0),
       endpoint_(point),
       last_sync_offset_(0),
       log_matched_(false),
@@ -120,6 +152,7 @@ void ReplicateNode::SyncData() {
             while (last_sync_offset_ >= leader_log_offset_->load(std::memory_order_relaxed)) {
                 cv_->wait_for(lock, FLAGS_binlog_sync_wait_time * 1000);
                 if (!is_running_.load(std::memory_order_relaxed)) {
+                    ClearInflight();
                     PDLOG(INFO,
                           "replicate log to endpoint %s for table #tid %u #pid "
                           "%u exist",
@@ -128,16 +161,21 @@ void ReplicateNode::SyncData() {
                 }
             }
         }
+        uint64_t log_offset = rep_node_.load(std::memory_order_relaxed)
+                                  ? follower_offset_->load(std::memory_order_relaxed)
+                                  : leader_log_offset_->load(std::memory_order_relaxed);
         int ret;
-        if (rep_node_.load(std::memory_order_relaxed)) {
-            ret = SyncData(follower_offset_->load(std::memory_order_relaxed));
+        // the mode is only switched when no request is waiting to resend
+        if ((FLAGS_binlog_sync_window_size > 1 && cache_.empty()) || !inflight_.empty() || !retry_.empty()) {
+            ret = PipelineSyncData(log_offset);
         } else {
-            ret = SyncData(leader_log_offset_->load(std::memory_order_relaxed));
+            ret = SyncData(log_offset);
         }
         if (ret == 1) {
             coffee_time = FLAGS_binlog_coffee_time;
         }
     }
+    ClearInflight();
     PDLOG(INFO, "replicate log to endpoint %s for table #tid %u #pid %u exist", endpoint_.c_str(), tid_, pid_);
 }
 
@@ -162,6 +200,7 @@ int ReplicateNode::MatchLogOffsetFromNode() {
                                        FLAGS_request_timeout_ms, FLAGS_request_max_retry);
     if (ret && response.code() == 0) {
         last_sync_offset_ = response.log_offset();
+        sent_offset_ = last_sync_offset_;
         log_matched_ = true;
         log_reader_.SetOffset(last_sync_offset_);
         PDLOG(INFO, "match node %s log offset %lu for table tid %u pid %u", endpoint_.c_str(), last_sync_offset_, tid_,
@@ -206,68 +245,7 @@ int ReplicateNode::SyncData(uint64_t log_offset) {
         if (!FLAGS_zk_cluster.empty()) {
             request.set_term(term_->load(std::memory_order_relaxed));
         }
-        uint32_t batchSize = log_offset - last_sync_offset_;
-        batchSize = std::min(batchSize, (uint32_t)FLAGS_binlog_sync_batch_size);
-        for (uint64_t i = 0; i < batchSize;) {
-            std::string buffer;
-            ::openmldb::base::Slice record;
-            ::openmldb::log::Status status = log_reader_.ReadNextRecord(&record, &buffer);
-            if (status.ok()) {
-                ::openmldb::api::LogEntry* entry = request.add_entries();
-                if (!entry->ParseFromString(record.ToString())) {
-                    PDLOG(WARNING, "bad protobuf format %s size %ld. tid %u pid %u",
-                          ::openmldb::base::DebugString(record.ToString()).c_str(), record.ToString().size(), tid_,
-                          pid_);
-                    request.mutable_entries()->RemoveLast();
-                    break;
-                }
-                DEBUGLOG("entry val %s log index %lld", entry->value().c_str(), entry->log_index());
-                if (entry->log_index() <= sync_log_offset) {
-                    DEBUGLOG("skip duplicate log offset %lld", entry->log_index());
-                    request.mutable_entries()->RemoveLast();
-                    continue;
-                }
-                // the log index should incr by 1
-                if ((sync_log_offset + 1) != entry->log_index()) {
-                    PDLOG(WARNING, "log missing expect offset %lu but %ld. tid %u pid %u", sync_log_offset + 1,
-                          entry->log_index(), tid_, pid_);
-                    request.mutable_entries()->RemoveLast();
-                    if (go_back_cnt_ > FLAGS_go_back_max_try_cnt) {
-                        log_reader_.GoBackToStart();
-                        go_back_cnt_ = 0;
-                        PDLOG(WARNING, "go back to start. tid %u pid %u endpoint %s", tid_, pid_, endpoint_.c_str());
-                    } else {
-                        log_reader_.GoBackToLastBlock();
-                        go_back_cnt_++;
-                    }
-                    need_wait = true;
-                    break;
-                }
-                sync_log_offset = entry->log_index();
-            } else if (status.IsWaitRecord()) {
-                DEBUGLOG("got a coffee time for[%s]", endpoint_.c_str());
-                need_wait = true;
-                break;
-            } else if (status.IsInvalidRecord()) {
-                DEBUGLOG("fail to get record. %s. tid %u pid %u", status.ToString().c_str(), tid_, pid_);
-                need_wait = true;
-                if (go_back_cnt_ > FLAGS_go_back_max_try_cnt) {
-                    log_reader_.GoBackToStart();
-                    go_back_cnt_ = 0;
-                    PDLOG(WARNING, "go back to start. tid %u pid %u endpoint %s", tid_, pid_, endpoint_.c_str());
-                } else {
-                    log_reader_.GoBackToLastBlock();
-                    go_back_cnt_++;
-                }
-                break;
-            } else {
-                PDLOG(WARNING, "fail to get record: %s. tid %u pid %u", status.ToString().c_str(), tid_, pid_);
-                need_wait = true;
-                break;
-            }
-            i++;
-            go_back_cnt_ = 0;
-        }
+        need_wait = ReadEntries(log_offset, &sync_log_offset, &request, NULL);
     }
     if (request.entries_size() > 0) {
         bool ret = rpc_client_.SendRequest(&::openmldb::api::TabletServer_Stub::AppendEntries, &request, &response,
@@ -275,6 +253,7 @@ int ReplicateNode::SyncData(uint64_t log_offset) {
         if (ret && response.code() == 0) {
             DEBUGLOG("sync log to node[%s] to offset %lld", endpoint_.c_str(), sync_log_offset);
             last_sync_offset_ = sync_log_offset;
+            sent_offset_ = sync_log_offset;
             if (!rep_node_.load(std::memory_order_relaxed) &&
                 (last_sync_offset_ > follower_offset_->load(std::memory_order_relaxed))) {
                 follower_offset_->store(last_sync_offset_, std::memory_order_relaxed);
@@ -282,6 +261,10 @@ int ReplicateNode::SyncData(uint64_t log_offset) {
             if (request_from_cache) {
                 cache_.clear();
             }
+        } else if (ret && response.code() == ::openmldb::base::ReturnCode::kLogIsNotContinuous) {
+            PDLOG(WARNING, "log of node %s is behind %lu, sync from its offset %lu. tid %u pid %u", endpoint_.c_str(),
+                  request.pre_log_index(), response.log_offset(), tid_, pid_);
+            ResetSyncOffset(response.log_offset());
         } else {
             if (!request_from_cache) {
                 cache_.push_back(request);
@@ -296,6 +279,263 @@ int ReplicateNode::SyncData(uint64_t log_offset) {
     return 0;
 }
 
+bool ReplicateNode::ReadEntries(uint64_t log_offset, uint64_t* sync_log_offset,
+                                ::openmldb::api::AppendEntriesRequest* request, butil::IOBuf* raw) {
+    bool need_wait = false;
+    uint32_t batchSize = log_offset - *sync_log_offset;
+    batchSize = std::min(batchSize, (uint32_t)FLAGS_binlog_sync_batch_size);
+    for (uint64_t i = 0; i < batchSize;) {
+        std::string buffer;
+        ::openmldb::base::Slice record;
+        ::openmldb::log::Status status = log_reader_.ReadNextRecord(&record, &buffer);
+        if (status.ok()) {
+            ::openmldb::api::LogEntry* entry = NULL;
+            uint64_t log_index = 0;
+            bool ok = false;
+            if (raw == NULL) {
+                entry = request->add_entries();
+                ok = entry->ParseFromString(record.ToString());
+                log_index = entry->log_index();
+            } else {
+                ok = ParseLogIndex(record, &log_index);
+            }
+            if (!ok) {
+                PDLOG(WARNING, "bad protobuf format %s size %ld. tid %u pid %u",
+                      ::openmldb::base::DebugString(record.ToString()).c_str(), record.ToString().size(), tid_,
+                      pid_);
+                if (entry != NULL) {
+                    request->mutable_entries()->RemoveLast();
+                }
+                break;
+            }
+            DEBUGLOG("entry log index %lld", log_index);
+            if (log_index <= *sync_log_offset) {
+                DEBUGLOG("skip duplicate log offset %lld", log_index);
+                if (entry != NULL) {
+                    request->mutable_entries()->RemoveLast();
+                }
+                continue;
+            }
+            // the log index should incr by 1
+            if ((*sync_log_offset + 1) != log_index) {
+                PDLOG(WARNING, "log missing expect offset %lu but %ld. tid %u pid %u", *sync_log_offset + 1,
+                      log_index, tid_, pid_);
+                if (entry != NULL) {
+                    request->mutable_entries()->RemoveLast();
+                }
+                if (go_back_cnt_ > FLAGS_go_back_max_try_cnt) {
+                    log_reader_.GoBackToStart();
+                    go_back_cnt_ = 0;
+                    PDLOG(WARNING, "go back to start. tid %u pid %u endpoint %s", tid_, pid_, endpoint_.c_str());
+                } else {
+                    log_reader_.GoBackToLastBlock();
+                    go_back_cnt_++;
+                }
+                need_wait = true;
+                break;
+            }
+            *sync_log_offset = log_index;
+            if (raw != NULL) {
+                uint32_t size = record.size();
+                raw->append(&size, sizeof(size));
+                raw->append(record.data(), record.size());
+                request->set_raw_entry_num(request->raw_entry_num() + 1);
+            }
+        } else if (status.IsWaitRecord()) {
+            DEBUGLOG("got a coffee time for[%s]", endpoint_.c_str());
+            need_wait = true;
+            break;
+        } else if (status.IsInvalidRecord()) {
+            DEBUGLOG("fail to get record. %s. tid %u pid %u", status.ToString().c_str(), tid_, pid_);
+            need_wait = true;
+            if (go_back_cnt_ > FLAGS_go_back_max_try_cnt) {
+                log_reader_.GoBackToStart();
+                go_back_cnt_ = 0;
+                PDLOG(WARNING, "go back to start. tid %u pid %u endpoint %s", tid_, pid_, endpoint_.c_str());
+            } else {
+                log_reader_.GoBackToLastBlock();
+                go_back_cnt_++;
+            }
+            break;
+        } else {
+            PDLOG(WARNING, "fail to get record: %s. tid %u pid %u", status.ToString().c_str(), tid_, pid_);
+            need_wait = true;
+            break;
+        }
+        i++;
+        go_back_cnt_ = 0;
+    }
+    return need_wait;
+}
+
+int ReplicateNode::PipelineSyncData(uint64_t log_offset) {
+    bool need_wait = false;
+    // the failed requests are resent before the new ones
+    while (inflight_.size() < window_) {
+        InflightRequest inflight;
+        if (!retry_.empty()) {
+            inflight = retry_.front();
+            retry_.pop_front();
+            if (inflight.end_offset <= last_sync_offset_) {
+                continue;
+            }
+        } else if (!need_wait && sent_offset_ < log_offset) {
+            inflight.request = std::make_shared<::openmldb::api::AppendEntriesRequest>();
+            inflight.request->set_tid(tid_);
+            inflight.request->set_pid(pid_);
+            inflight.request->set_pre_log_index(sent_offset_);
+            if (!FLAGS_zk_cluster.empty()) {
+                inflight.request->set_term(term_->load(std::memory_order_relaxed));
+            }
+            inflight.end_offset = sent_offset_;
+            need_wait = ReadEntries(log_offset, &inflight.end_offset, inflight.request.get(),
+                                    FLAGS_binlog_sync_raw_record && raw_record_ ? &inflight.raw_entries : NULL);
+            if (inflight.end_offset == sent_offset_) {
+                break;
+            }
+            if (inflight.request->raw_entry_num() == 0 && FLAGS_binlog_sync_compress && compress_) {
+                CompressEntries(inflight.request.get());
+            }
+            sent_offset_ = inflight.end_offset;
+        } else {
+            break;
+        }
+        auto response = std::make_shared<::openmldb::api::AppendEntriesResponse>();
+        auto cntl = std::make_shared<brpc::Controller>();
+        cntl->set_timeout_ms(FLAGS_request_timeout_ms);
+        cntl->set_max_retry(FLAGS_request_max_retry);
+        // the blocks of the records are shared with the attachment
+        cntl->request_attachment().append(inflight.raw_entries);
+        inflight.callback = new ::openmldb::RpcCallback<::openmldb::api::AppendEntriesResponse>(response, cntl);
+        // the reference is released after the response is handled
+        inflight.callback->Ref();
+        if (!rpc_client_.SendRequest(&::openmldb::api::TabletServer_Stub::AppendEntries, cntl.get(),
+                                     inflight.request.get(), response.get(), inflight.callback)) {
+            inflight.callback->UnRef();
+            inflight.callback->UnRef();
+            inflight.callback = nullptr;
+            retry_.push_front(inflight);
+            need_wait = true;
+            break;
+        }
+        inflight_.push_back(inflight);
+    }
+    if (inflight_.empty()) {
+        return need_wait ? 1 : 0;
+    }
+    InflightRequest inflight = inflight_.front();
+    inflight_.pop_front();
+    const auto& cntl = inflight.callback->GetController();
+    const auto& response = inflight.callback->GetResponse();
+    brpc::Join(cntl->call_id());
+    bool ok = !cntl->Failed() && response->code() == 0;
+    if (!cntl->Failed() && response->code() == ::openmldb::base::ReturnCode::kLogIsNotContinuous) {
+        // the follower waits for the requests before, so it's really behind them, e.g. it lost the
+        // binlog not synced to disk
+        PDLOG(WARNING, "log of node %s is behind %lu, sync from its offset %lu. tid %u pid %u", endpoint_.c_str(),
+              inflight.request->pre_log_index(), response->log_offset(), tid_, pid_);
+        uint64_t offset = response->log_offset();
+        inflight.callback->UnRef();
+        inflight.callback = nullptr;
+        ResetSyncOffset(offset);
+        return 0;
+    }
+    if (ok && response->log_offset() < inflight.end_offset) {
+        // the follower of an old version returns ok without waiting for the requests before, and it
+        // ignores the compressed entries and the raw records, so it's only synced to the offset it returns
+        PDLOG(WARNING, "node %s is at offset %lu after the request to offset %lu, sync from it. tid %u pid %u",
+              endpoint_.c_str(), response->log_offset(), inflight.end_offset, tid_, pid_);
+        if (inflight.request->has_compressed_entries()) {
+            compress_ = false;
+        }
+        if (inflight.request->raw_entry_num() > 0) {
+            raw_record_ = false;
+        }
+        uint64_t offset = response->log_offset();
+        inflight.callback->UnRef();
+        inflight.callback = nullptr;
+        ResetSyncOffset(offset);
+        return 0;
+    }
+    if (!ok) {
+        PDLOG(WARNING, "fail to sync log to node %s to offset %lu. error %s %s. tid %u pid %u", endpoint_.c_str(),
+              inflight.end_offset, cntl->ErrorText().c_str(), response->msg().c_str(), tid_, pid_);
+    }
+    inflight.callback->UnRef();
+    inflight.callback = nullptr;
+    if (ok) {
+        DEBUGLOG("sync log to node[%s] to offset %lu", endpoint_.c_str(), inflight.end_offset);
+        last_sync_offset_ = std::max(last_sync_offset_, inflight.end_offset);
+        if (!rep_node_.load(std::memory_order_relaxed) &&
+            (last_sync_offset_ > follower_offset_->load(std::memory_order_relaxed))) {
+            follower_offset_->store(last_sync_offset_, std::memory_order_relaxed);
+        }
+        if (window_ < std::max(FLAGS_binlog_sync_window_size, 1u)) {
+            window_++;
+        }
+        return 0;
+    }
+    // the follower rejects the requests after a missing one, so they are all resent
+    ClearInflight();
+    retry_.push_front(inflight);
+    window_ = std::max(window_ / 2, 1u);
+    return 1;
+}
+
+void ReplicateNode::ResetSyncOffset(uint64_t offset) {
+    ClearInflight();
+    retry_.clear();
+    cache_.clear();
+    last_sync_offset_ = offset;
+    sent_offset_ = offset;
+    go_back_cnt_ = 0;
+    log_reader_.ResetOffset(offset);
+}
+
+void ReplicateNode::ClearInflight() {
+    // the requests in flight are older than the ones to resend
+    for (auto it = inflight_.rbegin(); it != inflight_.rend(); ++it) {
+        brpc::Join(it->callback->GetController()->call_id());
+        it->callback->UnRef();
+        it->callback = nullptr;
+        retry_.push_front(*it);
+    }
+    inflight_.clear();
+}
+
+void ReplicateNode::CompressEntries(::openmldb::api::AppendEntriesRequest* request) {
+    ::openmldb::api::AppendEntriesRequest entries;
+    entries.mutable_entries()->Swap(request->mutable_entries());
+    std::string buffer;
+    entries.SerializeToString(&buffer);
+    snappy::Compress(buffer.data(), buffer.size(), request->mutable_compressed_entries());
+}
+
+bool ReplicateNode::DecompressEntries(const ::openmldb::api::AppendEntriesRequest& request,
+                                      ::openmldb::api::AppendEntriesRequest* entries) {
+    std::string buffer;
+    if (!snappy::Uncompress(request.compressed_entries().data(), request.compressed_entries().size(), &buffer)) {
+        return false;
+    }
+    return entries->ParseFromString(buffer);
+}
+
+bool ReplicateNode::ParseRawEntries(const butil::IOBuf& raw, uint32_t raw_entry_num, std::vector<std::string>* records,
+                                    ::openmldb::api::AppendEntriesRequest* entries) {
+    butil::IOBuf buf(raw);
+    records->resize(raw_entry_num);
+    for (uint32_t i = 0; i < raw_entry_num; i++) {
+        uint32_t size = 0;
+        if (buf.cutn(&size, sizeof(size)) != sizeof(size) || buf.cutn(&(*records)[i], size) != size) {
+            return false;
+        }
+        if (!entries->add_entries()->ParseFromString((*records)[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
 void ReplicateNode::Stop() {
     is_running_.store(false, std::memory_order_relaxed);
     if (worker_ == 0) {
@@ -18,11 +18,14 @@
 #define SRC_REPLICA_REPLICATE_NODE_H_
 
 #include <atomic>
+#include <deque>
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "base/skiplist.h"
 #include "bthread/bthread.h"
+#include "butil/iobuf.h"
 #include "bthread/condition_variable.h"
 #include "log/log_reader.h"
 #include "log/log_writer.h"
@@ -69,12 +72,61 @@ class ReplicateNode {
 
     ReplicateNode& operator=(const ReplicateNode&) = delete;
 
+    // replace the entries of request with compressed_entries
+    static void CompressEntries(::openmldb::api::AppendEntriesRequest* request);
+
+    // parse the compressed entries of request into entries
+    static bool DecompressEntries(const ::openmldb::api::AppendEntriesRequest& request,
+                                  ::openmldb::api::AppendEntriesRequest* entries);
+
+    // parse the raw_entry_num binlog records in raw into records and entries
+    static bool ParseRawEntries(const butil::IOBuf& raw, uint32_t raw_entry_num, std::vector<std::string>* records,
+                                ::openmldb::api::AppendEntriesRequest* entries);
+
  private:
+    // a request sent without waiting for the response
+    struct InflightRequest {
+        std::shared_ptr<::openmldb::api::AppendEntriesRequest> request;
+        // the binlog records sent in the attachment if raw_entry_num of request is set
+        butil::IOBuf raw_entries;
+        // the log index of the last entry of request
+        uint64_t end_offset;
+        ::openmldb::RpcCallback<::openmldb::api::AppendEntriesResponse>* callback;
+    };
+
     int MatchLogOffsetFromNode();
 
+    // read the records after sync_log_offset into request, at most binlog_sync_batch_size ones
+    // and not over log_offset. sync_log_offset is set to the last one read. the records are
+    // appended to raw as they are if it's not null. return true if it should wait for new records
+    bool ReadEntries(uint64_t log_offset, uint64_t* sync_log_offset, ::openmldb::api::AppendEntriesRequest* request,
+                     butil::IOBuf* raw);
+
+    // keep up to window_ requests in flight and wait for the oldest one. the requests after a
+    // failed one are resent in order, and the window is halved. the records after the log
+    // offset of the follower are sent again if it's behind the requests or it isn't synced to the
+    // end of a request
+    int PipelineSyncData(uint64_t log_offset);
+
+    // wait for the requests in flight and move them to the ones to resend
+    void ClearInflight();
+
+    // drop the requests in flight and to resend, and send the records after offset again
+    void ResetSyncOffset(uint64_t offset);
+
  private:
     LogReader log_reader_;
     std::vector<::openmldb::api::AppendEntriesRequest> cache_;
+    // the requests of pipeline mode in flight and to resend, in the order of offsets
+    std::deque<InflightRequest> inflight_;
+    std::deque<InflightRequest> retry_;
+    uint32_t window_;
+    // false if the follower doesn't apply the compressed entries
+    bool compress_;
+    // false if the follower doesn't apply the raw records
+    bool raw_record_;
+    // the offset of the last record read from binlog
+    uint64_t sent_offset_;
     std::string endpoint_;
     uint64_t last_sync_offset_;
     bool log_matched_;
@@ -0,0 +1,115 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "storage/cold_block.h"
+
+namespace openmldb {
+namespace storage {
+
+static inline void PutVarint64(std::string* dst, uint64_t v) {
+    while (v >= 0x80) {
+        dst->push_back(static_cast<char>(v | 0x80));
+        v >>= 7;
+    }
+    dst->push_back(static_cast<char>(v));
+}
+
+static inline uint64_t GetVarint64(const std::string& src, uint32_t* offset) {
+    uint64_t v = 0;
+    for (uint32_t shift = 0; shift <= 63; shift += 7) {
+        uint64_t byte = static_cast<uint8_t>(src[(*offset)++]);
+        v |= (byte & 0x7F) << shift;
+        if (byte < 0x80) {
+            break;
+        }
+    }
+    return v;
+}
+
+void ColdBlock::Append(uint64_t ts, DataBlock* row) {
+    if (rows_.empty()) {
+        max_ts_ = ts;
+        min_ts_ = ts;
+    }
+    // delta to the previous ts, the previous ts of the first row is max_ts_
+    PutVarint64(&ts_col_, min_ts_ - ts);
+    min_ts_ = ts;
+    rows_.push_back(row);
+}
+
+void ColdBlock::Seal() {
+    ts_col_.shrink_to_fit();
+    rows_.shrink_to_fit();
+}
+
+uint64_t ColdBlock::GetByteSize() const {
+    return sizeof(ColdBlock) + ts_col_.capacity() + rows_.capacity() * sizeof(DataBlock*);
+}
+
+void ColdBlock::DecodeTs(std::vector<uint64_t>* ts_vec) const {
+    ts_vec->reserve(ts_vec->size() + rows_.size());
+    uint32_t offset = 0;
+    uint64_t ts = max_ts_;
+    for (uint32_t i = 0; i < rows_.size(); i++) {
+        ts -= GetVarint64(ts_col_, &offset);
+        ts_vec->push_back(ts);
+    }
+}
+
+void ColdBlock::Iterator::Reset(const ColdBlock* block) {
+    block_ = block;
+    idx_ = 0;
+    offset_ = 0;
+    if (block_ != NULL) {
+        ts_ = block_->max_ts_ - GetVarint64(block_->ts_col_, &offset_);
+    }
+}
+
+void ColdBlock::Iterator::Next() {
+    if (idx_ + 1 < block_->rows_.size()) {
+        idx_++;
+        ts_ -= GetVarint64(block_->ts_col_, &offset_);
+    } else {
+        Reset(block_->next);
+    }
+}
+
+void ColdBlock::Iterator::SeekToFirst(const ColdBlock* head) { Reset(head); }
+
+void ColdBlock::Iterator::Seek(const ColdBlock* head, uint64_t ts) {
+    const ColdBlock* block = head;
+    while (block != NULL && block->min_ts_ > ts) {
+        block = block->next;
+    }
+    Reset(block);
+    while (Valid() && ts_ > ts) {
+        Next();
+    }
+}
+
+void ColdBlock::Iterator::SeekToLast(const ColdBlock* head) {
+    const ColdBlock* block = head;
+    while (block != NULL && block->next != NULL) {
+        block = block->next;
+    }
+    Reset(block);
+    while (Valid() && idx_ + 1 < block_->rows_.size()) {
+        Next();
+    }
+}
+
+}  // namespace storage
+}  // namespace openmldb
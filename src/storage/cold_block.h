@@ -0,0 +1,100 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_STORAGE_COLD_BLOCK_H_
+#define SRC_STORAGE_COLD_BLOCK_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+namespace openmldb {
+namespace storage {
+
+struct DataBlock;
+
+// ColdBlock is an immutable column oriented block which holds the old rows of one key entry.
+// the ts column is sorted in descending order and encoded as varint deltas, the row column
+// keeps the pointers of rows which are shared with the other indexes of the table.
+// the blocks of one key entry are linked from the newest to the oldest
+class ColdBlock {
+ public:
+    // the max count of rows in one block
+    static const uint32_t MAX_ROWS = 1024;
+
+    ColdBlock() : next(NULL), max_ts_(0), min_ts_(0) {}
+    ~ColdBlock() {}
+    ColdBlock(const ColdBlock&) = delete;
+    ColdBlock& operator=(const ColdBlock&) = delete;
+
+    // ts must not be larger than the ts of last appended row
+    void Append(uint64_t ts, DataBlock* row);
+
+    // release the memory reserved by Append, the block must not be changed after sealed
+    void Seal();
+
+    inline uint32_t GetCount() const { return rows_.size(); }
+    inline bool IsFull() const { return rows_.size() >= MAX_ROWS; }
+    inline uint64_t GetMaxTs() const { return max_ts_; }
+    inline uint64_t GetMinTs() const { return min_ts_; }
+    inline DataBlock* GetRow(uint32_t idx) const { return rows_[idx]; }
+
+    // the memory used by the block, not including the rows
+    uint64_t GetByteSize() const;
+
+    // decode ts column into ts_vec which has the same order with rows
+    void DecodeTs(std::vector<uint64_t>* ts_vec) const;
+
+    // the iterator over a chain of blocks in descending order of ts
+    class Iterator {
+     public:
+        Iterator() : block_(NULL), idx_(0), offset_(0), ts_(0) {}
+        ~Iterator() {}
+
+        bool Valid() const { return block_ != NULL; }
+        void Next();
+        const uint64_t& GetKey() const { return ts_; }
+        DataBlock* GetValue() const { return block_->rows_[idx_]; }
+
+        void SeekToFirst(const ColdBlock* head);
+        // seek to the first row whose ts is not larger than ts
+        void Seek(const ColdBlock* head, uint64_t ts);
+        void SeekToLast(const ColdBlock* head);
+
+     private:
+        void Reset(const ColdBlock* block);
+
+     private:
+        const ColdBlock* block_;
+        uint32_t idx_;
+        uint32_t offset_;
+        uint64_t ts_;
+    };
+
+ public:
+    ColdBlock* next;
+
+ private:
+    uint64_t max_ts_;
+    uint64_t min_ts_;
+    std::string ts_col_;
+    std::vector<DataBlock*> rows_;
+};
+
+}  // namespace storage
+}  // namespace openmldb
+#endif  // SRC_STORAGE_COLD_BLOCK_H_
@@ -0,0 +1,181 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "storage/disk_row_cache.h"
+
+#include <string.h>
+
+#include "base/hash.h"
+
+namespace openmldb {
+namespace storage {
+
+static const uint32_t ROW_CACHE_SHARD_CNT = 16;
+static const uint32_t ROW_CACHE_SEED = 0x5bd1e995;
+// the count-min sketch has SKETCH_DEPTH rows of SKETCH_WIDTH counters in every shard
+static const uint32_t SKETCH_DEPTH = 4;
+static const uint32_t SKETCH_WIDTH = 4096;
+static const uint32_t SKETCH_INCR_LIMIT = SKETCH_WIDTH * 8;
+
+uint64_t CachedRows::GetByteSize() const {
+    uint64_t size = sizeof(CachedRows);
+    for (const auto& row : rows) {
+        size += sizeof(Row) + row.key.size() + row.value.size();
+    }
+    return size;
+}
+
+DiskRowCache::DiskRowCache(uint64_t capacity, uint32_t max_row_cnt, uint32_t admit_cnt)
+    : shard_capacity_(capacity / ROW_CACHE_SHARD_CNT),
+      max_row_cnt_(max_row_cnt == 0 ? 1 : max_row_cnt),
+      admit_cnt_(admit_cnt),
+      shards_(new Shard[ROW_CACHE_SHARD_CNT]),
+      hit_cnt_(0),
+      miss_cnt_(0) {
+    for (uint32_t i = 0; i < ROW_CACHE_SHARD_CNT; i++) {
+        shards_[i].sketch.resize(SKETCH_DEPTH * SKETCH_WIDTH, 0);
+    }
+}
+
+DiskRowCache::~DiskRowCache() { delete[] shards_; }
+
+std::string DiskRowCache::EncodeKey(uint32_t inner_pos, const Slice& prefix) {
+    std::string key;
+    key.resize(sizeof(uint32_t) + prefix.size());
+    memcpy(&key[0], &inner_pos, sizeof(uint32_t));
+    memcpy(&key[sizeof(uint32_t)], prefix.data(), prefix.size());
+    return key;
+}
+
+DiskRowCache::Shard* DiskRowCache::GetShard(const std::string& key, uint32_t* hash) {
+    *hash = ::openmldb::base::hash(key.data(), key.size(), ROW_CACHE_SEED);
+    return &shards_[*hash % ROW_CACHE_SHARD_CNT];
+}
+
+uint32_t DiskRowCache::IncrFrequency(Shard* shard, const std::string& key, uint32_t hash) {
+    uint32_t freq = UINT32_MAX;
+    // derive the hash of every row from two hashes
+    uint32_t hash2 = ::openmldb::base::hash(key.data(), key.size(), hash);
+    for (uint32_t i = 0; i < SKETCH_DEPTH; i++) {
+        uint8_t& counter = shard->sketch[i * SKETCH_WIDTH + (hash + i * hash2) % SKETCH_WIDTH];
+        if (counter < UINT8_MAX) {
+            counter++;
+        }
+        if (counter < freq) {
+            freq = counter;
+        }
+    }
+    // age the counters so the keys which are not hot any more can't keep the admission
+    if (++shard->sketch_incr >= SKETCH_INCR_LIMIT) {
+        for (auto& counter : shard->sketch) {
+            counter >>= 1;
+        }
+        shard->sketch_incr = 0;
+    }
+    return freq;
+}
+
+std::shared_ptr<const CachedRows> DiskRowCache::Get(uint32_t inner_pos, const Slice& prefix, bool* admit,
+                                                    uint64_t* version) {
+    std::string key = EncodeKey(inner_pos, prefix);
+    uint32_t hash = 0;
+    Shard* shard = GetShard(key, &hash);
+    std::lock_guard<std::mutex> lock(shard->mu);
+    auto iter = shard->entries.find(key);
+    if (iter != shard->entries.end()) {
+        shard->lru.splice(shard->lru.begin(), shard->lru, iter->second);
+        hit_cnt_.fetch_add(1, std::memory_order_relaxed);
+        return iter->second->rows;
+    }
+    miss_cnt_.fetch_add(1, std::memory_order_relaxed);
+    *admit = shard_capacity_ > 0 && IncrFrequency(shard, key, hash) >= admit_cnt_;
+    *version = shard->version;
+    return std::shared_ptr<const CachedRows>();
+}
+
+bool DiskRowCache::Insert(uint32_t inner_pos, const Slice& prefix, uint64_t version,
+                          std::shared_ptr<const CachedRows> rows) {
+    std::string key = EncodeKey(inner_pos, prefix);
+    uint32_t hash = 0;
+    Shard* shard = GetShard(key, &hash);
+    uint64_t byte_size = rows->GetByteSize() + key.size() * 2 + sizeof(Entry);
+    if (byte_size > shard_capacity_) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(shard->mu);
+    if (shard->version != version) {
+        return false;
+    }
+    auto iter = shard->entries.find(key);
+    if (iter != shard->entries.end()) {
+        // filled by another reader with the same version
+        shard->byte_size -= iter->second->byte_size;
+        shard->lru.erase(iter->second);
+        shard->entries.erase(iter);
+    }
+    shard->lru.push_front(Entry{key, std::move(rows), byte_size});
+    shard->entries.emplace(std::move(key), shard->lru.begin());
+    shard->byte_size += byte_size;
+    Evict(shard);
+    return true;
+}
+
+void DiskRowCache::Evict(Shard* shard) {
+    while (shard->byte_size > shard_capacity_ && !shard->lru.empty()) {
+        const Entry& entry = shard->lru.back();
+        shard->byte_size -= entry.byte_size;
+        shard->entries.erase(entry.key);
+        shard->lru.pop_back();
+    }
+}
+
+void DiskRowCache::Invalidate(uint32_t inner_pos, const Slice& prefix) {
+    std::string key = EncodeKey(inner_pos, prefix);
+    uint32_t hash = 0;
+    Shard* shard = GetShard(key, &hash);
+    std::lock_guard<std::mutex> lock(shard->mu);
+    shard->version++;
+    auto iter = shard->entries.find(key);
+    if (iter != shard->entries.end()) {
+        shard->byte_size -= iter->second->byte_size;
+        shard->lru.erase(iter->second);
+        shard->entries.erase(iter);
+    }
+}
+
+void DiskRowCache::Clear() {
+    for (uint32_t i = 0; i < ROW_CACHE_SHARD_CNT; i++) {
+        Shard* shard = &shards_[i];
+        std::lock_guard<std::mutex> lock(shard->mu);
+        shard->version++;
+        shard->entries.clear();
+        shard->lru.clear();
+        shard->byte_size = 0;
+    }
+}
+
+uint64_t DiskRowCache::GetByteSize() const {
+    uint64_t byte_size = 0;
+    for (uint32_t i = 0; i < ROW_CACHE_SHARD_CNT; i++) {
+        Shard* shard = &shards_[i];
+        std::lock_guard<std::mutex> lock(shard->mu);
+        byte_size += shard->byte_size;
+    }
+    return byte_size;
+}
+
+}  // namespace storage
+}  // namespace openmldb
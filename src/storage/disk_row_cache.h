@@ -0,0 +1,120 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_STORAGE_DISK_ROW_CACHE_H_
+#define SRC_STORAGE_DISK_ROW_CACHE_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "base/slice.h"
+
+namespace openmldb {
+namespace storage {
+
+using ::openmldb::base::Slice;
+
+// the newest rows of one key prefix of a disk table, i.e. pk or pk + ts_pos
+struct CachedRows {
+    struct Row {
+        uint64_t ts;
+        // the combined key in rocksdb
+        std::string key;
+        std::string value;
+    };
+    // in descending order of ts
+    std::vector<Row> rows;
+    // all rows of the prefix are cached
+    bool complete = false;
+
+    uint64_t GetByteSize() const;
+};
+
+// DiskRowCache keeps the newest rows of the hot key prefixes of a disk table in memory.
+// a prefix is admitted after it's looked up admit_cnt times, which is counted by a
+// count-min sketch with aging. the entries are evicted in lru order when the bytes are
+// over capacity. the writers must invalidate the prefixes they change after the write,
+// and the readers filling the cache pass the version got before the read, so a fill
+// racing with a write is dropped
+class DiskRowCache {
+ public:
+    DiskRowCache(uint64_t capacity, uint32_t max_row_cnt, uint32_t admit_cnt);
+    ~DiskRowCache();
+    DiskRowCache(const DiskRowCache&) = delete;
+    DiskRowCache& operator=(const DiskRowCache&) = delete;
+
+    // return nullptr if the prefix is not cached. if so, admit is set whether the prefix
+    // should be filled and version is set for Insert
+    std::shared_ptr<const CachedRows> Get(uint32_t inner_pos, const Slice& prefix, bool* admit, uint64_t* version);
+
+    // return false if the rows are dropped as a write happened after the version was got
+    bool Insert(uint32_t inner_pos, const Slice& prefix, uint64_t version, std::shared_ptr<const CachedRows> rows);
+
+    void Invalidate(uint32_t inner_pos, const Slice& prefix);
+
+    void Clear();
+
+    inline uint32_t GetMaxRowCnt() const { return max_row_cnt_; }
+    inline uint64_t GetHitCnt() const { return hit_cnt_.load(std::memory_order_relaxed); }
+    inline uint64_t GetMissCnt() const { return miss_cnt_.load(std::memory_order_relaxed); }
+    uint64_t GetByteSize() const;
+
+ private:
+    struct Entry {
+        std::string key;
+        std::shared_ptr<const CachedRows> rows;
+        uint64_t byte_size;
+    };
+
+    struct Shard {
+        std::mutex mu;
+        // the most recently used one is at front
+        std::list<Entry> lru;
+        std::unordered_map<std::string, std::list<Entry>::iterator> entries;
+        uint64_t byte_size = 0;
+        // increased by every invalidation in the shard
+        uint64_t version = 0;
+        // count-min sketch, the counters are halved after sketch_incr_limit increments
+        std::vector<uint8_t> sketch;
+        uint32_t sketch_incr = 0;
+    };
+
+    static std::string EncodeKey(uint32_t inner_pos, const Slice& prefix);
+    Shard* GetShard(const std::string& key, uint32_t* hash);
+    // increase the frequency of the key and return the estimated one
+    uint32_t IncrFrequency(Shard* shard, const std::string& key, uint32_t hash);
+    void Evict(Shard* shard);
+
+ private:
+    const uint64_t shard_capacity_;
+    const uint32_t max_row_cnt_;
+    const uint32_t admit_cnt_;
+    Shard* shards_;
+    std::atomic<uint64_t> hit_cnt_;
+    std::atomic<uint64_t> miss_cnt_;
+};
+
+}  // namespace storage
+}  // namespace openmldb
+#endif  // SRC_STORAGE_DISK_ROW_CACHE_H_
@@ -15,6 +15,7 @@
  */
 
 #include "storage/disk_table.h"
+#include <algorithm>
 #include <utility>
 #include "base/file_util.h"
 #include "base/glog_wapper.h"  // NOLINT
@@ -29,14 +30,128 @@ DECLARE_uint32(block_cache_mb);
 DECLARE_uint32(write_buffer_mb);
 DECLARE_uint32(block_cache_shardbits);
 DECLARE_bool(verify_compression);
+DECLARE_uint32(disk_table_bloom_bits_per_key);
+DECLARE_uint32(disk_table_block_size_kb);
+DECLARE_uint32(disk_periodic_compaction_interval);
+DECLARE_uint32(disk_row_cache_mb);
+DECLARE_uint32(disk_row_cache_row_cnt);
+DECLARE_uint32(disk_row_cache_admit_cnt);
+DECLARE_uint32(disk_write_group_delay_us);
+DECLARE_uint32(disk_write_group_max_rows);
 
 namespace openmldb {
 namespace storage {
 
 static rocksdb::Options ssd_option_template;
 static rocksdb::Options hdd_option_template;
+// the block cache in it is shared by all disk tables
+static rocksdb::BlockBasedTableOptions table_option_template;
 static bool options_template_initialized = false;
 
+// the prefix of the combined keys of pk, see KeyTsPrefixTransform
+static std::string GetKeyPrefix(const std::string& pk, bool has_ts_idx, uint32_t ts_idx) {
+    std::string prefix = has_ts_idx ? CombineKeyTs(pk, 0, ts_idx) : CombineKeyTs(pk, 0);
+    prefix.resize(prefix.size() - TS_LEN);
+    return prefix;
+}
+
+// return a iterator serving the rows of the prefix from the row cache, the rows are loaded into
+// the cache if the prefix is admitted. return NULL if the rows are not cached
+static rocksdb::Iterator* NewCachedRowIterator(rocksdb::DB* db, rocksdb::ColumnFamilyHandle* cf,
+                                               DiskRowCache* row_cache, uint32_t inner_pos,
+                                               const rocksdb::ReadOptions& ro, const std::string& prefix) {
+    if (row_cache == NULL) {
+        return NULL;
+    }
+    bool admit = false;
+    uint64_t version = 0;
+    std::shared_ptr<const CachedRows> rows = row_cache->Get(inner_pos, prefix, &admit, &version);
+    if (!rows && admit) {
+        // read the latest rows rather than the ones in a snapshot, which may be taken before the version
+        rocksdb::ReadOptions load_ro = ro;
+        load_ro.snapshot = NULL;
+        rocksdb::Iterator* it = db->NewIterator(load_ro, cf);
+        std::shared_ptr<CachedRows> new_rows = std::make_shared<CachedRows>();
+        new_rows->complete = true;
+        std::string start = CombineKeyTs(prefix, UINT64_MAX);
+        for (it->Seek(rocksdb::Slice(start)); it->Valid(); it->Next()) {
+            rocksdb::Slice key = it->key();
+            if (key.size() != prefix.size() + TS_LEN || memcmp(key.data(), prefix.data(), prefix.size()) != 0) {
+                break;
+            }
+            if (new_rows->rows.size() >= row_cache->GetMaxRowCnt()) {
+                new_rows->complete = false;
+                break;
+            }
+            uint64_t ts = 0;
+            memcpy(static_cast<void*>(&ts), key.data() + prefix.size(), TS_LEN);
+            memrev64ifbe(static_cast<void*>(&ts));
+            new_rows->rows.push_back({ts, key.ToString(), it->value().ToString()});
+        }
+        bool ok = it->status().ok();
+        delete it;
+        if (!ok) {
+            return NULL;
+        }
+        row_cache->Insert(inner_pos, prefix, version, new_rows);
+        rows = new_rows;
+    }
+    if (!rows) {
+        return NULL;
+    }
+    return new CachedRowIterator(rows, prefix, db, cf, ro);
+}
+
+TTLCompactionFilter::TTLCompactionFilter(const std::shared_ptr<InnerIndexSt>& inner_index)
+    : has_ts_idx_(inner_index->GetIndex().size() > 1), ttls_(), last_prefix_(), record_idx_(0) {
+    uint64_t cur_time = ::baidu::common::timer::get_micros() / 1000;
+    for (const auto& index : inner_index->GetIndex()) {
+        auto ttl = index->GetTTL();
+        if (!ttl->NeedGc()) {
+            continue;
+        }
+        uint32_t ts_idx = 0;
+        if (has_ts_idx_) {
+            auto ts_col = index->GetTsColumn();
+            if (!ts_col) {
+                continue;
+            }
+            ts_idx = ts_col->GetId();
+        }
+        TTLSt expire_ttl(*ttl);
+        expire_ttl.abs_ttl = ttl->abs_ttl == 0 || ttl->abs_ttl > cur_time ? 0 : cur_time - ttl->abs_ttl;
+        ttls_.emplace(ts_idx, expire_ttl);
+    }
+}
+
+bool TTLCompactionFilter::Filter(int /*level*/, const rocksdb::Slice& key, const rocksdb::Slice& /*existing_value*/,
+                                 std::string* /*new_value*/, bool* /*value_changed*/) const {
+    uint32_t len = has_ts_idx_ ? TS_LEN + TS_POS_LEN : TS_LEN;
+    if (key.size() < len) {
+        return false;
+    }
+    // the prefix is pk or pk + ts_pos like KeyTsPrefixTransform
+    rocksdb::Slice prefix(key.data(), key.size() - TS_LEN);
+    if (record_idx_ > 0 && prefix == rocksdb::Slice(last_prefix_)) {
+        record_idx_++;
+    } else {
+        last_prefix_.assign(prefix.data(), prefix.size());
+        record_idx_ = 1;
+    }
+    uint32_t ts_idx = 0;
+    if (has_ts_idx_) {
+        memcpy(static_cast<void*>(&ts_idx), key.data() + key.size() - len, TS_POS_LEN);
+    }
+    auto iter = ttls_.find(ts_idx);
+    if (iter == ttls_.end()) {
+        return false;
+    }
+    uint64_t ts = 0;
+    memcpy(static_cast<void*>(&ts), key.data() + key.size() - TS_LEN, TS_LEN);
+    memrev64ifbe(static_cast<void*>(&ts));
+    return iter->second.IsExpired(ts, record_idx_);
+}
+
 DiskTable::DiskTable(const std::string& name, uint32_t id, uint32_t pid, const std::map<std::string, uint32_t>& mapping,
                      uint64_t ttl, ::openmldb::type::TTLType ttl_type, ::openmldb::common::StorageMode storage_mode,
                      const std::string& table_path)
@@ -98,13 +213,17 @@ void DiskTable::initOptionTemplate() {
         ssd_option_template.max_bytes_for_level_base >> 4;  // number of L1 files = 16
 
     rocksdb::BlockBasedTableOptions table_options;
-    // table_options.cache_index_and_filter_blocks = true;
-    // table_options.pin_l0_filter_and_index_blocks_in_cache = true;
     table_options.block_cache = cache;
-    // table_options.filter_policy.reset(rocksdb::NewBloomFilterPolicy(10,
-    // false));
+    // the filter is built on the prefix of keys, see KeyTsPrefixTransform and InitColumnFamilyDescriptor
     table_options.whole_key_filtering = false;
-    table_options.block_size = 256 << 10;
+    // partition the index and filter blocks, only the top level of them is pinned in the block cache
+    // and the partitions are loaded on demand
+    table_options.index_type = rocksdb::BlockBasedTableOptions::kTwoLevelIndexSearch;
+    table_options.cache_index_and_filter_blocks = true;
+    table_options.cache_index_and_filter_blocks_with_high_priority = true;
+    table_options.pin_top_level_index_and_filter = true;
+    table_options.pin_l0_filter_and_index_blocks_in_cache = true;
+    table_options.block_size = FLAGS_disk_table_block_size_kb << 10;
     table_options.use_delta_encoding = false;
 #ifdef PZFPGA_ENABLE
     if (FLAGS_file_compression.compare("pz") == 0) {
@@ -128,7 +247,6 @@ void DiskTable::initOptionTemplate() {
     hdd_option_template.env->SetBackgroundThreads(1, rocksdb::Env::Priority::HIGH);  // flush threads
     hdd_option_template.env->SetBackgroundThreads(1, rocksdb::Env::Priority::LOW);   // compaction threads
     hdd_option_template.memtable_prefix_bloom_size_ratio = 0.02;
-    hdd_option_template.optimize_filters_for_hits = true;
     hdd_option_template.level_compaction_dynamic_level_bytes = true;
     hdd_option_template.max_file_opening_threads =
         1;  // set to the number of disks on which the db root folder is mounted
@@ -142,6 +260,7 @@ void DiskTable::initOptionTemplate() {
     hdd_option_template.target_file_size_base = 256 << 20;
     hdd_option_template.max_bytes_for_level_base = 1024 << 20;
     hdd_option_template.table_factory.reset(rocksdb::NewBlockBasedTableFactory(table_options));
+    table_option_template = table_options;
 
     options_template_initialized = true;
 }
@@ -162,12 +281,25 @@ bool DiskTable::InitColumnFamilyDescriptor() {
         }
         cfo.comparator = &cmp_;
         cfo.prefix_extractor.reset(new KeyTsPrefixTransform());
+        rocksdb::BlockBasedTableOptions table_options = table_option_template;
+        // the bloom filter of the prefix, i.e. pk or pk + ts_pos, lets the lookups of a pk
+        // skip the data blocks of the sst files which have no row of it
+        if (FLAGS_disk_table_bloom_bits_per_key > 0) {
+            table_options.filter_policy.reset(
+                rocksdb::NewBloomFilterPolicy(FLAGS_disk_table_bloom_bits_per_key, false));
+            table_options.partition_filters = true;
+        }
+        if (table_meta_ && table_meta_->block_size_kb() > 0) {
+            table_options.block_size = table_meta_->block_size_kb() << 10;
+        }
+        cfo.table_factory.reset(rocksdb::NewBlockBasedTableFactory(table_options));
         const auto& indexs = inner_index->GetIndex();
         auto index_def = indexs.front();
-        if (index_def->GetTTLType() == ::openmldb::storage::TTLType::kAbsoluteTime ||
-            index_def->GetTTLType() == ::openmldb::storage::TTLType::kAbsOrLat) {
-            cfo.compaction_filter_factory = std::make_shared<AbsoluteTTLFilterFactory>(inner_index);
-        }
+        cfo.compaction_filter_factory = std::make_shared<TTLFilterFactory>(inner_index);
+        // it must be set explicitly, rocksdb compacts the files with a compaction filter every 30 days by default
+        uint64_t periodic_compaction_sec = GetPeriodicCompactionSec(inner_index);
+        cfo.periodic_compaction_seconds = periodic_compaction_sec;
+        periodic_compaction_sec_[inner_index->GetId()] = periodic_compaction_sec;
         cf_ds_.push_back(rocksdb::ColumnFamilyDescriptor(index_def->GetName(), cfo));
         DEBUGLOG("add cf_name %s. tid %u pid %u", index_def->GetName().c_str(), id_, pid_);
     }
@@ -198,6 +330,15 @@ bool DiskTable::Init() {
     }
     PDLOG(INFO, "Open DB. tid %u pid %u ColumnFamilyHandle size %u with data path %s", id_, pid_, GetIdxCnt(),
           path.c_str());
+    uint32_t row_cache_mb = FLAGS_disk_row_cache_mb;
+    if (table_meta_ && table_meta_->has_row_cache_mb()) {
+        row_cache_mb = table_meta_->row_cache_mb();
+    }
+    if (row_cache_mb > 0) {
+        row_cache_.reset(new DiskRowCache(static_cast<uint64_t>(row_cache_mb) << 20, FLAGS_disk_row_cache_row_cnt,
+                                          FLAGS_disk_row_cache_admit_cnt));
+        PDLOG(INFO, "enable row cache with %u MB. tid %u pid %u", row_cache_mb, id_, pid_);
+    }
     return true;
 }
 
@@ -207,6 +348,9 @@ bool DiskTable::Put(const std::string& pk, uint64_t time, const char* data, uint
     rocksdb::Slice spk = rocksdb::Slice(combine_key);
     s = db_->Put(write_opts_, cf_hs_[1], spk, rocksdb::Slice(data, size));
     if (s.ok()) {
+        if (row_cache_) {
+            row_cache_->Invalidate(0, pk);
+        }
         offset_.fetch_add(1, std::memory_order_relaxed);
         return true;
     } else {
@@ -216,54 +360,215 @@ bool DiskTable::Put(const std::string& pk, uint64_t time, const char* data, uint
 }
 
 bool DiskTable::Put(uint64_t time, const std::string& value, const Dimensions& dimensions) {
-    rocksdb::WriteBatch batch;
-    rocksdb::Status s;
-    Dimensions::const_iterator it = dimensions.begin();
-    for (; it != dimensions.end(); ++it) {
-        const int8_t* data = reinterpret_cast<const int8_t*>(value.data());
-        uint8_t version = codec::RowView::GetSchemaVersion(data);
-        auto decoder = GetVersionDecoder(version);
-        if (decoder == nullptr) {
-            PDLOG(WARNING, "invalid schema version %u, tid %u pid %u", version, id_, pid_);
-            return false;
+    std::vector<PutKey> keys;
+    if (!EncodeRow(time, value, dimensions, &keys)) {
+        return false;
+    }
+    return WriteKeys(keys, 1);
+}
+
+bool DiskTable::PutBatch(const PutBatchRows& rows, uint32_t* put_cnt) {
+    *put_cnt = 0;
+    std::vector<PutKey> keys;
+    uint32_t row_cnt = 0;
+    bool ok = true;
+    for (const auto& row : rows) {
+        if (!EncodeRow(row.time(), row.value(), row.dimensions(), &keys)) {
+            ok = false;
+            break;
         }
+        row_cnt++;
+    }
+    if (row_cnt == 0) {
+        return ok;
+    }
+    if (!WriteKeys(keys, row_cnt)) {
+        return false;
+    }
+    *put_cnt = row_cnt;
+    return ok;
+}
+
+bool DiskTable::EncodeRow(uint64_t time, const std::string& value, const Dimensions& dimensions,
+                          std::vector<PutKey>* keys) {
+    const int8_t* data = reinterpret_cast<const int8_t*>(value.data());
+    uint8_t version = codec::RowView::GetSchemaVersion(data);
+    auto decoder = GetVersionDecoder(version);
+    if (decoder == nullptr) {
+        PDLOG(WARNING, "invalid schema version %u, tid %u pid %u", version, id_, pid_);
+        return false;
+    }
+    size_t old_size = keys->size();
+    for (auto it = dimensions.begin(); it != dimensions.end(); ++it) {
         int32_t inner_pos = table_index_.GetInnerIndexPos(it->idx());
         auto inner_index = table_index_.GetInnerIndex(inner_pos);
-
         for (const auto& index_def : inner_index->GetIndex()) {
             if (!index_def) {
                 PDLOG(WARNING, "failed putting key %s to dimension %u in table tid %u pid %u", it->key().c_str(),
                       it->idx(), id_, pid_);
+                keys->resize(old_size);
                 return false;
             }
             auto ts_col = index_def->GetTsColumn();
-            std::string combine_key;
-            if (ts_col) {
-                int64_t ts = 0;
-                if (ts_col->IsAutoGenTs()) {
-                    ts = time;
-                } else if (decoder->GetInteger(data, ts_col->GetId(), ts_col->GetType(), &ts) != 0) {
-                    PDLOG(WARNING, "get ts failed. tid %u pid %u", id_, pid_);
-                    return false;
-                }
-                if (inner_index->GetIndex().size() > 1) {
-                    combine_key = CombineKeyTs(it->key(), ts, ts_col->GetId());
-                } else {
-                    combine_key = CombineKeyTs(it->key(), ts);
-                }
-                rocksdb::Slice spk = rocksdb::Slice(combine_key);
-                batch.Put(cf_hs_[inner_pos + 1], spk, value);
+            if (!ts_col) {
+                continue;
+            }
+            int64_t ts = 0;
+            if (ts_col->IsAutoGenTs()) {
+                ts = time;
+            } else if (decoder->GetInteger(data, ts_col->GetId(), ts_col->GetType(), &ts) != 0) {
+                PDLOG(WARNING, "get ts failed. tid %u pid %u", id_, pid_);
+                keys->resize(old_size);
+                return false;
+            }
+            if (inner_index->GetIndex().size() > 1) {
+                keys->push_back({static_cast<uint32_t>(inner_pos), CombineKeyTs(it->key(), ts, ts_col->GetId()),
+                                 &value});
+            } else {
+                keys->push_back({static_cast<uint32_t>(inner_pos), CombineKeyTs(it->key(), ts), &value});
             }
         }
     }
-    s = db_->Write(write_opts_, &batch);
-    if (s.ok()) {
-        offset_.fetch_add(1, std::memory_order_relaxed);
-        return true;
+    return true;
+}
+
+bool DiskTable::WriteKeys(const std::vector<PutKey>& keys, uint32_t row_cnt) {
+    rocksdb::Status s;
+    if (FLAGS_disk_write_group_delay_us > 0) {
+        s = GroupWrite(keys, row_cnt);
     } else {
+        rocksdb::WriteBatch batch;
+        for (const auto& put_key : keys) {
+            batch.Put(cf_hs_[put_key.inner_pos + 1], rocksdb::Slice(put_key.key), rocksdb::Slice(*put_key.value));
+        }
+        s = db_->Write(write_opts_, &batch);
+    }
+    if (!s.ok()) {
         DEBUGLOG("Put failed. tid %u pid %u msg %s", id_, pid_, s.ToString().c_str());
         return false;
     }
+    if (row_cache_) {
+        for (const auto& put_key : keys) {
+            row_cache_->Invalidate(put_key.inner_pos, Slice(put_key.key.data(), put_key.key.size() - TS_LEN));
+        }
+    }
+    offset_.fetch_add(row_cnt, std::memory_order_relaxed);
+    return true;
+}
+
+rocksdb::Status DiskTable::GroupWrite(const std::vector<PutKey>& keys, uint32_t row_cnt) {
+    // the writers are bthreads, so they wait without blocking the worker pthreads
+    std::unique_lock<bthread::Mutex> lock(write_mu_);
+    bool is_leader = false;
+    if (!pending_group_) {
+        pending_group_ = std::make_shared<WriteGroup>();
+        is_leader = true;
+    }
+    std::shared_ptr<WriteGroup> group = pending_group_;
+    for (const auto& put_key : keys) {
+        group->batch.Put(cf_hs_[put_key.inner_pos + 1], rocksdb::Slice(put_key.key), rocksdb::Slice(*put_key.value));
+    }
+    group->row_cnt += row_cnt;
+    if (!is_leader) {
+        if (group->row_cnt >= FLAGS_disk_write_group_max_rows) {
+            write_cv_.notify_all();
+        }
+        while (!group->done) {
+            write_cv_.wait(lock);
+        }
+        return group->status;
+    }
+    // wait for the rows of other writers until the group is full or the delay is over
+    uint64_t deadline = ::baidu::common::timer::get_micros() + FLAGS_disk_write_group_delay_us;
+    while (group->row_cnt < FLAGS_disk_write_group_max_rows) {
+        uint64_t now = ::baidu::common::timer::get_micros();
+        if (now >= deadline) {
+            break;
+        }
+        write_cv_.wait_for(lock, deadline - now);
+    }
+    // the groups are written one by one in the order they are formed, so the rows of the same key and ts
+    // are written in the order of binlog. the group keeps collecting rows until the previous one is written
+    while (group_writing_) {
+        write_cv_.wait(lock);
+    }
+    // the writers coming later join the next group
+    pending_group_.reset();
+    group_writing_ = true;
+    lock.unlock();
+    rocksdb::Status s = db_->Write(write_opts_, &group->batch);
+    lock.lock();
+    group_writing_ = false;
+    group->status = s;
+    group->done = true;
+    write_cv_.notify_all();
+    return s;
+}
+
+bool DiskTable::BuildSstFiles(const PutBatchRows& rows, const std::string& dir,
+                              std::map<uint32_t, std::string>* files) {
+    std::vector<PutKey> keys;
+    for (const auto& row : rows) {
+        if (!EncodeRow(row.time(), row.value(), row.dimensions(), &keys)) {
+            return false;
+        }
+    }
+    if (!::openmldb::base::MkdirRecur(dir)) {
+        PDLOG(WARNING, "fail to create dir %s. tid %u pid %u", dir.c_str(), id_, pid_);
+        return false;
+    }
+    // sort by inner index, then in the order of the keys in the db. the last one of the same keys wins
+    std::stable_sort(keys.begin(), keys.end(), [this](const PutKey& a, const PutKey& b) {
+        if (a.inner_pos != b.inner_pos) {
+            return a.inner_pos < b.inner_pos;
+        }
+        return cmp_.Compare(rocksdb::Slice(a.key), rocksdb::Slice(b.key)) < 0;
+    });
+    size_t pos = 0;
+    while (pos < keys.size()) {
+        uint32_t inner_pos = keys[pos].inner_pos;
+        rocksdb::Options options(options_, cf_ds_[inner_pos + 1].options);
+        rocksdb::SstFileWriter writer(rocksdb::EnvOptions(), options, cf_hs_[inner_pos + 1]);
+        std::string path = dir + "/" + std::to_string(inner_pos) + ".sst";
+        rocksdb::Status s = writer.Open(path);
+        for (; s.ok() && pos < keys.size() && keys[pos].inner_pos == inner_pos; pos++) {
+            if (pos + 1 < keys.size() && keys[pos + 1].inner_pos == inner_pos && keys[pos + 1].key == keys[pos].key) {
+                continue;
+            }
+            s = writer.Put(rocksdb::Slice(keys[pos].key), rocksdb::Slice(*keys[pos].value));
+        }
+        if (s.ok()) {
+            s = writer.Finish();
+        }
+        if (!s.ok()) {
+            PDLOG(WARNING, "fail to build sst file %s. tid %u pid %u msg %s", path.c_str(), id_, pid_,
+                  s.ToString().c_str());
+            return false;
+        }
+        files->emplace(inner_pos, path);
+    }
+    return true;
+}
+
+bool DiskTable::IngestSstFiles(const std::map<uint32_t, std::string>& files) {
+    rocksdb::IngestExternalFileOptions ingest_opts;
+    ingest_opts.move_files = true;
+    for (const auto& kv : files) {
+        if (kv.first + 1 >= cf_hs_.size()) {
+            PDLOG(WARNING, "invalid inner pos %u. tid %u pid %u", kv.first, id_, pid_);
+            return false;
+        }
+        rocksdb::Status s = db_->IngestExternalFile(cf_hs_[kv.first + 1], {kv.second}, ingest_opts);
+        if (!s.ok()) {
+            PDLOG(WARNING, "fail to ingest sst file %s. tid %u pid %u msg %s", kv.second.c_str(), id_, pid_,
+                  s.ToString().c_str());
+            return false;
+        }
+    }
+    if (row_cache_) {
+        row_cache_->Clear();
+    }
+    return true;
 }
 
 bool DiskTable::Delete(const std::string& pk, uint32_t idx) {
@@ -273,6 +578,7 @@ bool DiskTable::Delete(const std::string& pk, uint32_t idx) {
         return false;
     }
     auto inner_index = table_index_.GetInnerIndex(index_def->GetInnerPos());
+    std::vector<std::string> prefixs;
     if (inner_index && inner_index->GetIndex().size() > 1) {
         const auto& indexs = inner_index->GetIndex();
         for (const auto& index : indexs) {
@@ -283,14 +589,21 @@ bool DiskTable::Delete(const std::string& pk, uint32_t idx) {
             std::string combine_key1 = CombineKeyTs(pk, UINT64_MAX, ts_col->GetId());
             std::string combine_key2 = CombineKeyTs(pk, 0, ts_col->GetId());
             batch.DeleteRange(cf_hs_[idx + 1], rocksdb::Slice(combine_key1), rocksdb::Slice(combine_key2));
+            prefixs.push_back(GetKeyPrefix(pk, true, ts_col->GetId()));
         }
     } else {
         std::string combine_key1 = CombineKeyTs(pk, UINT64_MAX);
         std::string combine_key2 = CombineKeyTs(pk, 0);
         batch.DeleteRange(cf_hs_[idx + 1], rocksdb::Slice(combine_key1), rocksdb::Slice(combine_key2));
+        prefixs.push_back(pk);
     }
     rocksdb::Status s = db_->Write(write_opts_, &batch);
     if (s.ok()) {
+        if (row_cache_) {
+            for (const auto& prefix : prefixs) {
+                row_cache_->Invalidate(idx, prefix);
+            }
+        }
         offset_.fetch_add(1, std::memory_order_relaxed);
         return true;
     } else {
@@ -300,24 +613,70 @@ bool DiskTable::Delete(const std::string& pk, uint32_t idx) {
 }
 
 bool DiskTable::Get(uint32_t idx, const std::string& pk, uint64_t ts, std::string& value) {
-    Ticket ticket;
-    auto it = NewIterator(idx, pk, ticket);
-    it->Seek(ts);
-    if ((it->Valid()) && (it->GetKey() == ts)) {
-        value = it->GetValue().ToString();
-        delete it;
-        return true;
-    } else {
-        delete it;
+    std::shared_ptr<IndexDef> index_def = table_index_.GetIndex(idx);
+    if (!index_def) {
+        PDLOG(WARNING, "index %u not found in table, tid %u pid %u", idx, id_, pid_);
         return false;
     }
+    uint32_t inner_pos = index_def->GetInnerPos();
+    auto inner_index = table_index_.GetInnerIndex(inner_pos);
+    std::string combine_key;
+    if (inner_index && inner_index->GetIndex().size() > 1) {
+        auto ts_col = index_def->GetTsColumn();
+        if (!ts_col) {
+            return false;
+        }
+        combine_key = CombineKeyTs(pk, ts, ts_col->GetId());
+    } else {
+        combine_key = CombineKeyTs(pk, ts);
+    }
+    // a point lookup checks the prefix bloom filter and needs no iterator or snapshot
+    rocksdb::Status s = db_->Get(rocksdb::ReadOptions(), cf_hs_[inner_pos + 1], rocksdb::Slice(combine_key), &value);
+    return s.ok();
 }
 
 bool DiskTable::Get(const std::string& pk, uint64_t ts, std::string& value) { return Get(0, pk, ts, value); }
 
 void DiskTable::SchedGc() {
-    GcHead();
+    // the expired rows are removed in compactions by TTLCompactionFilter, so there is no scan here
     UpdateTTL();
+    UpdatePeriodicCompaction();
+}
+
+uint64_t DiskTable::GetPeriodicCompactionSec(const std::shared_ptr<InnerIndexSt>& inner_index) const {
+    if (FLAGS_disk_periodic_compaction_interval == 0) {
+        return 0;
+    }
+    for (const auto& index : inner_index->GetIndex()) {
+        if (index->GetTTL()->NeedGc()) {
+            return FLAGS_disk_periodic_compaction_interval * 60ull;
+        }
+    }
+    return 0;
+}
+
+void DiskTable::UpdatePeriodicCompaction() {
+    auto inner_indexs = table_index_.GetAllInnerIndex();
+    for (const auto& inner_index : *inner_indexs) {
+        uint32_t idx = inner_index->GetId();
+        if (idx + 1 >= cf_hs_.size()) {
+            continue;
+        }
+        uint64_t periodic_compaction_sec = GetPeriodicCompactionSec(inner_index);
+        auto iter = periodic_compaction_sec_.find(idx);
+        if (iter != periodic_compaction_sec_.end() && iter->second == periodic_compaction_sec) {
+            continue;
+        }
+        rocksdb::Status s = db_->SetOptions(
+            cf_hs_[idx + 1], {{"periodic_compaction_seconds", std::to_string(periodic_compaction_sec)}});
+        if (!s.ok()) {
+            PDLOG(WARNING, "set periodic compaction failed. tid %u pid %u msg %s", id_, pid_, s.ToString().c_str());
+            continue;
+        }
+        PDLOG(INFO, "set periodic compaction of index %u to %lu seconds. tid %u pid %u", idx,
+              periodic_compaction_sec, id_, pid_);
+        periodic_compaction_sec_[idx] = periodic_compaction_sec;
+    }
 }
 
 void DiskTable::GcHead() {
@@ -328,7 +687,8 @@ void DiskTable::GcHead() {
         rocksdb::ReadOptions ro = rocksdb::ReadOptions();
         const rocksdb::Snapshot* snapshot = db_->GetSnapshot();
         ro.snapshot = snapshot;
-        // ro.prefix_same_as_start = true;
+        // the iterator goes through all keys, so the prefix bloom filter must be skipped
+        ro.total_order_seek = true;
         ro.pin_data = true;
         rocksdb::Iterator* it = db_->NewIterator(ro, cf_hs_[idx + 1]);
         it->SeekToFirst();
@@ -434,14 +794,14 @@ void DiskTable::GcHead() {
         delete it;
         db_->ReleaseSnapshot(snapshot);
     }
+    if (row_cache_) {
+        // the rows deleted are not tracked
+        row_cache_->Clear();
+    }
     uint64_t time_used = ::baidu::common::timer::get_micros() / 1000 - start_time;
     PDLOG(INFO, "Gc used %lu second. tid %u pid %u", time_used / 1000, id_, pid_);
 }
 
-void DiskTable::GcTTLOrHead() {}
-
-void DiskTable::GcTTLAndHead() {}
-
 // ttl as ms
 uint64_t DiskTable::GetExpireTime(const TTLSt& ttl_st) {
     if (ttl_st.abs_ttl == 0 || ttl_st.ttl_type == ::openmldb::storage::TTLType::kLatestTime) {
@@ -484,17 +844,27 @@ TableIterator* DiskTable::NewIterator(uint32_t idx, const std::string& pk, Ticke
     }
     uint32_t inner_pos = index_def->GetInnerPos();
     auto inner_index = table_index_.GetInnerIndex(inner_pos);
+    std::shared_ptr<ColumnDef> ts_col;
+    if (inner_index && inner_index->GetIndex().size() > 1) {
+        ts_col = index_def->GetTsColumn();
+    }
     rocksdb::ReadOptions ro = rocksdb::ReadOptions();
-    const rocksdb::Snapshot* snapshot = db_->GetSnapshot();
-    ro.snapshot = snapshot;
     ro.prefix_same_as_start = true;
     ro.pin_data = true;
-    rocksdb::Iterator* it = db_->NewIterator(ro, cf_hs_[inner_pos + 1]);
-    if (inner_index && inner_index->GetIndex().size() > 1) {
-        auto ts_col = index_def->GetTsColumn();
-        if (ts_col) {
-            return new DiskTableIterator(db_, it, snapshot, pk, ts_col->GetId());
-        }
+    // no snapshot is needed if the rows are in the row cache
+    const rocksdb::Snapshot* snapshot = NULL;
+    rocksdb::Iterator* it = NULL;
+    if (row_cache_) {
+        it = NewCachedRowIterator(db_, cf_hs_[inner_pos + 1], row_cache_.get(), inner_pos, ro,
+                                  GetKeyPrefix(pk, ts_col != nullptr, ts_col ? ts_col->GetId() : 0));
+    }
+    if (it == NULL) {
+        snapshot = db_->GetSnapshot();
+        ro.snapshot = snapshot;
+        it = db_->NewIterator(ro, cf_hs_[inner_pos + 1]);
+    }
+    if (ts_col) {
+        return new DiskTableIterator(db_, it, snapshot, pk, ts_col->GetId());
     }
     return new DiskTableIterator(db_, it, snapshot, pk);
 }
@@ -512,7 +882,7 @@ TraverseIterator* DiskTable::NewTraverseIterator(uint32_t index) {
     rocksdb::ReadOptions ro = rocksdb::ReadOptions();
     const rocksdb::Snapshot* snapshot = db_->GetSnapshot();
     ro.snapshot = snapshot;
-    // ro.prefix_same_as_start = true;
+    ro.total_order_seek = true;
     ro.pin_data = true;
     rocksdb::Iterator* it = db_->NewIterator(ro, cf_hs_[inner_pos + 1]);
     if (inner_index && inner_index->GetIndex().size() > 1) {
@@ -525,6 +895,97 @@ TraverseIterator* DiskTable::NewTraverseIterator(uint32_t index) {
     return new DiskTableTraverseIterator(db_, it, snapshot, ttl->ttl_type, expire_time, expire_cnt);
 }
 
+CachedRowIterator::CachedRowIterator(const std::shared_ptr<const CachedRows>& rows, const std::string& prefix,
+                                     rocksdb::DB* db, rocksdb::ColumnFamilyHandle* cf, const rocksdb::ReadOptions& ro)
+    : rows_(rows), prefix_(prefix), db_(db), cf_(cf), ro_(ro), pos_(rows->rows.size()), it_(NULL) {}
+
+CachedRowIterator::~CachedRowIterator() { delete it_; }
+
+rocksdb::Iterator* CachedRowIterator::GetDBIterator() {
+    if (it_ == NULL) {
+        it_ = db_->NewIterator(ro_, cf_);
+    }
+    return it_;
+}
+
+bool CachedRowIterator::Valid() const {
+    if (it_ != NULL) {
+        return it_->Valid();
+    }
+    return pos_ < rows_->rows.size();
+}
+
+void CachedRowIterator::SeekToFirst() { GetDBIterator()->SeekToFirst(); }
+
+void CachedRowIterator::SeekToLast() { GetDBIterator()->SeekToLast(); }
+
+void CachedRowIterator::SeekForPrev(const rocksdb::Slice& target) { GetDBIterator()->SeekForPrev(target); }
+
+void CachedRowIterator::Seek(const rocksdb::Slice& target) {
+    if (it_ == NULL && target.size() == prefix_.size() + TS_LEN &&
+        memcmp(target.data(), prefix_.data(), prefix_.size()) == 0) {
+        uint64_t ts = 0;
+        memcpy(static_cast<void*>(&ts), target.data() + prefix_.size(), TS_LEN);
+        memrev64ifbe(static_cast<void*>(&ts));
+        const auto& rows = rows_->rows;
+        // the first row with ts not greater than the target
+        auto iter = std::lower_bound(rows.begin(), rows.end(), ts,
+                                     [](const CachedRows::Row& row, uint64_t value) { return row.ts > value; });
+        pos_ = iter - rows.begin();
+        if (pos_ < rows.size() || rows_->complete) {
+            return;
+        }
+    }
+    GetDBIterator()->Seek(target);
+}
+
+void CachedRowIterator::Next() {
+    if (it_ != NULL) {
+        it_->Next();
+        return;
+    }
+    pos_++;
+    if (pos_ == rows_->rows.size() && !rows_->complete) {
+        // continue with the rows after the cached ones
+        const std::string& last_key = rows_->rows.back().key;
+        GetDBIterator()->Seek(rocksdb::Slice(last_key));
+        if (it_->Valid() && it_->key() == rocksdb::Slice(last_key)) {
+            it_->Next();
+        }
+    }
+}
+
+void CachedRowIterator::Prev() {
+    if (it_ == NULL) {
+        if (pos_ >= rows_->rows.size()) {
+            return;
+        }
+        GetDBIterator()->Seek(rocksdb::Slice(rows_->rows[pos_].key));
+    }
+    it_->Prev();
+}
+
+rocksdb::Slice CachedRowIterator::key() const {
+    if (it_ != NULL) {
+        return it_->key();
+    }
+    return rocksdb::Slice(rows_->rows[pos_].key);
+}
+
+rocksdb::Slice CachedRowIterator::value() const {
+    if (it_ != NULL) {
+        return it_->value();
+    }
+    return rocksdb::Slice(rows_->rows[pos_].value);
+}
+
+rocksdb::Status CachedRowIterator::status() const {
+    if (it_ != NULL) {
+        return it_->status();
+    }
+    return rocksdb::Status::OK();
+}
+
 DiskTableIterator::DiskTableIterator(rocksdb::DB* db, rocksdb::Iterator* it, const rocksdb::Snapshot* snapshot,
                                      const std::string& pk)
     : db_(db), it_(it), snapshot_(snapshot), pk_(pk), ts_(0) {}
@@ -537,7 +998,9 @@ DiskTableIterator::DiskTableIterator(rocksdb::DB* db, rocksdb::Iterator* it, con
 
 DiskTableIterator::~DiskTableIterator() {
     delete it_;
-    db_->ReleaseSnapshot(snapshot_);
+    if (snapshot_ != NULL) {
+        db_->ReleaseSnapshot(snapshot_);
+    }
 }
 
 bool DiskTableIterator::Valid() {
@@ -846,17 +1309,23 @@ void DiskTableTraverseIterator::NextPK() {
     rocksdb::ReadOptions ro = rocksdb::ReadOptions();
     const rocksdb::Snapshot* snapshot = db_->GetSnapshot();
     ro.snapshot = snapshot;
-    // ro.prefix_same_as_start = true;
+    ro.total_order_seek = true;
     ro.pin_data = true;
     rocksdb::Iterator* it = db_->NewIterator(ro, cf_hs_[inner_pos + 1]);
+    DiskTableKeyIterator* key_it = NULL;
     if (inner_index && inner_index->GetIndex().size() > 1) {
         auto ts_col = index_def->GetTsColumn();
         if (ts_col) {
-            return new DiskTableKeyIterator(db_, it, snapshot, ttl->ttl_type, expire_time, expire_cnt,
-                                                 ts_col->GetId(), cf_hs_[inner_pos + 1]);
+            key_it = new DiskTableKeyIterator(db_, it, snapshot, ttl->ttl_type, expire_time, expire_cnt,
+                                              ts_col->GetId(), cf_hs_[inner_pos + 1]);
         }
     }
-    return new DiskTableKeyIterator(db_, it, snapshot, ttl->ttl_type, expire_time, expire_cnt, cf_hs_[inner_pos + 1]);
+    if (key_it == NULL) {
+        key_it = new DiskTableKeyIterator(db_, it, snapshot, ttl->ttl_type, expire_time, expire_cnt,
+                                          cf_hs_[inner_pos + 1]);
+    }
+    key_it->SetRowCache(row_cache_.get(), inner_pos);
+    return key_it;
 }
 
 DiskTableKeyIterator::DiskTableKeyIterator(rocksdb::DB* db, rocksdb::Iterator* it,
@@ -955,25 +1424,34 @@ const hybridse::codec::Row DiskTableKeyIterator::GetKey() {
     return row;
 }
 
-std::unique_ptr<::hybridse::vm::RowIterator> DiskTableKeyIterator::GetValue() {
+rocksdb::Iterator* DiskTableKeyIterator::NewRowIterator(const rocksdb::Snapshot** snapshot) {
     rocksdb::ReadOptions ro = rocksdb::ReadOptions();
-    const rocksdb::Snapshot* snapshot = db_->GetSnapshot();
-    ro.snapshot = snapshot;
-    // ro.prefix_same_as_start = true;
+    ro.prefix_same_as_start = true;
     ro.pin_data = true;
-    rocksdb::Iterator* it = db_->NewIterator(ro, column_handle_);
+    *snapshot = NULL;
+    if (row_cache_ != NULL) {
+        rocksdb::Iterator* it = NewCachedRowIterator(db_, column_handle_, row_cache_, inner_pos_, ro,
+                                                     GetKeyPrefix(pk_, has_ts_idx_, ts_idx_));
+        if (it != NULL) {
+            return it;
+        }
+    }
+    *snapshot = db_->GetSnapshot();
+    ro.snapshot = *snapshot;
+    return db_->NewIterator(ro, column_handle_);
+}
+
+std::unique_ptr<::hybridse::vm::RowIterator> DiskTableKeyIterator::GetValue() {
+    const rocksdb::Snapshot* snapshot = NULL;
+    rocksdb::Iterator* it = NewRowIterator(&snapshot);
     std::unique_ptr<DiskTableRowIterator> wit(new DiskTableRowIterator(db_, it, snapshot, ttl_type_, expire_time_,
                                                                        expire_cnt_, pk_, ts_, has_ts_idx_, ts_idx_));
     return wit;
 }
 
 ::hybridse::vm::RowIterator* DiskTableKeyIterator::GetRawValue() {
-    rocksdb::ReadOptions ro = rocksdb::ReadOptions();
-    const rocksdb::Snapshot* snapshot = db_->GetSnapshot();
-    ro.snapshot = snapshot;
-    // ro.prefix_same_as_start = true;
-    ro.pin_data = true;
-    rocksdb::Iterator* it = db_->NewIterator(ro, column_handle_);
+    const rocksdb::Snapshot* snapshot = NULL;
+    rocksdb::Iterator* it = NewRowIterator(&snapshot);
     return new DiskTableRowIterator(db_, it, snapshot, ttl_type_, expire_time_, expire_cnt_, pk_, ts_, has_ts_idx_,
                                     ts_idx_);
 }
@@ -996,7 +1474,9 @@ DiskTableRowIterator::DiskTableRowIterator(rocksdb::DB* db, rocksdb::Iterator* i
 
 DiskTableRowIterator::~DiskTableRowIterator() {
     delete it_;
-    db_->ReleaseSnapshot(snapshot_);
+    if (snapshot_ != NULL) {
+        db_->ReleaseSnapshot(snapshot_);
+    }
 }
 
 bool DiskTableRowIterator::Valid() const {
@@ -1127,7 +1607,7 @@ int DiskTable::GetCount(uint32_t index, const std::string& pk, uint64_t& count)
     rocksdb::ReadOptions ro = rocksdb::ReadOptions();
     const rocksdb::Snapshot* snapshot = db_->GetSnapshot();
     ro.snapshot = snapshot;
-    // ro.prefix_same_as_start = true;
+    ro.prefix_same_as_start = true;
     ro.pin_data = true;
     rocksdb::Iterator* it = db_->NewIterator(ro, cf_hs_[inner_pos + 1]);
 
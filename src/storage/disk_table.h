@@ -19,11 +19,14 @@
 #include <atomic>
 #include <map>
 #include <memory>
+#include <mutex>  // NOLINT
 #include <string>
 #include <vector>
 #include "base/endianconv.h"
 #include "base/slice.h"
 #include "boost/lexical_cast.hpp"
+#include "bthread/bthread.h"
+#include "bthread/condition_variable.h"
 #include "common/timer.h"  // NOLINT
 #include "gflags/gflags.h"
 #include "proto/common.pb.h"
@@ -34,9 +37,11 @@
 #include "rocksdb/options.h"
 #include "rocksdb/slice.h"
 #include "rocksdb/slice_transform.h"
+#include "rocksdb/sst_file_writer.h"
 #include "rocksdb/status.h"
 #include "rocksdb/table.h"
 #include "rocksdb/utilities/checkpoint.h"
+#include "storage/disk_row_cache.h"
 #include "storage/iterator.h"
 #include "storage/table.h"
 
@@ -143,74 +148,83 @@ class KeyTsPrefixTransform : public rocksdb::SliceTransform {
     bool SameResultWhenAppended(const rocksdb::Slice& prefix) const override { return InDomain(prefix); }
 };
 
-class AbsoluteTTLCompactionFilter : public rocksdb::CompactionFilter {
+// TTLCompactionFilter removes the expired rows of all ttl types during compactions.
+// the keys come in order in a compaction, the rows of one pk (and ts_pos) are adjacent and
+// sorted by ts in descending order, so the position of a row in them is taken as its record_idx.
+// the rows of the pk out of the compaction are not counted, the position is not greater than
+// the real one and no row in the latest lat_ttl ones is removed
+class TTLCompactionFilter : public rocksdb::CompactionFilter {
  public:
-    explicit AbsoluteTTLCompactionFilter(std::shared_ptr<InnerIndexSt> inner_index) : inner_index_(inner_index) {}
-    virtual ~AbsoluteTTLCompactionFilter() {}
+    explicit TTLCompactionFilter(const std::shared_ptr<InnerIndexSt>& inner_index);
+    virtual ~TTLCompactionFilter() {}
 
-    const char* Name() const override { return "AbsoluteTTLCompactionFilter"; }
+    const char* Name() const override { return "TTLCompactionFilter"; }
 
-    bool Filter(int /*level*/, const rocksdb::Slice& key, const rocksdb::Slice& /*existing_value*/,
-                std::string* /*new_value*/, bool* /*value_changed*/) const override {
-        if (key.size() < TS_LEN) {
-            return false;
-        }
-        uint64_t real_ttl = 0;
-        const auto& indexs = inner_index_->GetIndex();
-        if (indexs.size() > 1) {
-            if (key.size() < TS_LEN + TS_POS_LEN) {
-                return false;
-            }
-            uint32_t ts_idx = *((uint32_t*)(key.data() + key.size() - TS_LEN -  // NOLINT
-                                          TS_POS_LEN));
-            bool has_found = false;
-            for (const auto index : indexs) {
-                auto ts_col = index->GetTsColumn();
-                if (!ts_col) {
-                    return false;
-                }
-                if (ts_col->GetId() == ts_idx) {
-                    real_ttl = index->GetTTL()->abs_ttl;
-                    has_found = true;
-                    break;
-                }
-            }
-            if (!has_found) {
-                return false;
-            }
-        } else {
-            real_ttl = indexs.front()->GetTTL()->abs_ttl;
-        }
-        if (real_ttl < 1) {
-            return false;
-        }
-        uint64_t ts = 0;
-        memcpy(static_cast<void*>(&ts), key.data() + key.size() - TS_LEN, TS_LEN);
-        memrev64ifbe(static_cast<void*>(&ts));
-        uint64_t cur_time = ::baidu::common::timer::get_micros() / 1000;
-        if (ts < cur_time - real_ttl) {
-            return true;
-        }
-        return false;
-    }
+    bool Filter(int level, const rocksdb::Slice& key, const rocksdb::Slice& existing_value, std::string* new_value,
+                bool* value_changed) const override;
+
+    // return false if no index of the inner index needs gc
+    bool NeedGc() const { return !ttls_.empty(); }
 
  private:
-    std::shared_ptr<InnerIndexSt> inner_index_;
+    bool has_ts_idx_;
+    // ts_pos -> ttl with the abs_ttl converted to the expire time, the ts_pos is 0 without ts_idx
+    std::map<uint32_t, TTLSt> ttls_;
+    // the filter is used by one compaction thread only
+    mutable std::string last_prefix_;
+    mutable uint32_t record_idx_;
 };
 
-class AbsoluteTTLFilterFactory : public rocksdb::CompactionFilterFactory {
+class TTLFilterFactory : public rocksdb::CompactionFilterFactory {
  public:
-    explicit AbsoluteTTLFilterFactory(const std::shared_ptr<InnerIndexSt>& inner_index) : inner_index_(inner_index) {}
+    explicit TTLFilterFactory(const std::shared_ptr<InnerIndexSt>& inner_index) : inner_index_(inner_index) {}
     std::unique_ptr<rocksdb::CompactionFilter> CreateCompactionFilter(
         const rocksdb::CompactionFilter::Context& context) override {
-        return std::unique_ptr<rocksdb::CompactionFilter>(new AbsoluteTTLCompactionFilter(inner_index_));
+        // the ttl is read for every compaction, so the updated ttl takes effect in the next one
+        std::unique_ptr<TTLCompactionFilter> filter(new TTLCompactionFilter(inner_index_));
+        if (!filter->NeedGc()) {
+            return std::unique_ptr<rocksdb::CompactionFilter>();
+        }
+        return std::unique_ptr<rocksdb::CompactionFilter>(filter.release());
     }
-    const char* Name() const override { return "AbsoluteTTLFilterFactory"; }
+    const char* Name() const override { return "TTLFilterFactory"; }
 
  private:
     std::shared_ptr<InnerIndexSt> inner_index_;
 };
 
+// CachedRowIterator serves the rows of one key prefix from the row cache as a rocksdb iterator.
+// it switches to a rocksdb iterator if it's moved beyond the cached rows
+class CachedRowIterator : public rocksdb::Iterator {
+ public:
+    CachedRowIterator(const std::shared_ptr<const CachedRows>& rows, const std::string& prefix, rocksdb::DB* db,
+                      rocksdb::ColumnFamilyHandle* cf, const rocksdb::ReadOptions& ro);
+    ~CachedRowIterator() override;
+    bool Valid() const override;
+    void SeekToFirst() override;
+    void SeekToLast() override;
+    void Seek(const rocksdb::Slice& target) override;
+    void SeekForPrev(const rocksdb::Slice& target) override;
+    void Next() override;
+    void Prev() override;
+    rocksdb::Slice key() const override;
+    rocksdb::Slice value() const override;
+    rocksdb::Status status() const override;
+
+ private:
+    rocksdb::Iterator* GetDBIterator();
+
+ private:
+    std::shared_ptr<const CachedRows> rows_;
+    std::string prefix_;
+    rocksdb::DB* db_;
+    rocksdb::ColumnFamilyHandle* cf_;
+    rocksdb::ReadOptions ro_;
+    uint32_t pos_;
+    // not NULL after it switches to rocksdb
+    rocksdb::Iterator* it_;
+};
+
 class DiskTableIterator : public TableIterator {
  public:
     DiskTableIterator(rocksdb::DB* db, rocksdb::Iterator* it, const rocksdb::Snapshot* snapshot, const std::string& pk);
@@ -330,8 +344,15 @@ class DiskTableKeyIterator : public ::hybridse::vm::WindowIterator {
 
     const hybridse::codec::Row GetKey() override;
 
+    // serve the rows of keys from the row cache
+    void SetRowCache(DiskRowCache* row_cache, uint32_t inner_pos) {
+        row_cache_ = row_cache;
+        inner_pos_ = inner_pos;
+    }
+
  private:
     void NextPK();
+    rocksdb::Iterator* NewRowIterator(const rocksdb::Snapshot** snapshot);
 
  private:
     rocksdb::DB* db_;
@@ -345,6 +366,8 @@ class DiskTableKeyIterator : public ::hybridse::vm::WindowIterator {
     uint64_t ts_;
     uint32_t ts_idx_;
     rocksdb::ColumnFamilyHandle* column_handle_;
+    DiskRowCache* row_cache_ = nullptr;
+    uint32_t inner_pos_ = 0;
 };
 
 class DiskTable : public Table {
@@ -369,6 +392,21 @@ class DiskTable : public Table {
 
     bool Put(uint64_t time, const std::string& value, const Dimensions& dimensions) override;
 
+    // the rows are written in one WriteBatch. put_cnt is the count of rows before the
+    // first invalid one, or 0 if the write is failed
+    bool PutBatch(const PutBatchRows& rows, uint32_t* put_cnt) override;
+
+    // build one sorted sst file of the rows for every inner index in dir, without writing
+    // the db. files is set with inner pos -> the path of the file.
+    // the rows loaded by BuildSstFiles and IngestSstFiles are local to this table, they are
+    // not written to binlog and the offset isn't advanced, so they are not replicated to the
+    // followers. they are only for the loads done on every replica by itself
+    bool BuildSstFiles(const PutBatchRows& rows, const std::string& dir,
+                       std::map<uint32_t, std::string>* files);
+
+    // move the files built by BuildSstFiles into the db
+    bool IngestSstFiles(const std::map<uint32_t, std::string>& files);
+
     bool Get(uint32_t idx, const std::string& pk, uint64_t ts,
              std::string& value);  // NOLINT
 
@@ -402,9 +440,9 @@ class DiskTable : public Table {
 
     void SchedGc() override;
 
+    // remove the rows out of lat_ttl by a full scan, the expired rows are removed in
+    // compactions by TTLCompactionFilter without it
     void GcHead();
-    void GcTTLAndHead();
-    void GcTTLOrHead();
 
     bool IsExpire(const ::openmldb::api::LogEntry& entry) override;
 
@@ -425,6 +463,37 @@ class DiskTable : public Table {
 
     int GetCount(uint32_t index, const std::string& pk, uint64_t& count) override; // NOLINT
 
+    uint64_t GetRowCacheHitCnt() const { return row_cache_ ? row_cache_->GetHitCnt() : 0; }
+    uint64_t GetRowCacheMissCnt() const { return row_cache_ ? row_cache_->GetMissCnt() : 0; }
+    uint64_t GetRowCacheByteSize() const { return row_cache_ ? row_cache_->GetByteSize() : 0; }
+
+ private:
+    // a key encoded from a row, the value is the row itself
+    struct PutKey {
+        uint32_t inner_pos;
+        std::string key;
+        const std::string* value;
+    };
+
+    // the rows of the writers joining in the bounded delay, they are written in one WriteBatch
+    struct WriteGroup {
+        rocksdb::WriteBatch batch;
+        uint32_t row_cnt = 0;
+        bool done = false;
+        rocksdb::Status status;
+    };
+
+    bool EncodeRow(uint64_t time, const std::string& value, const Dimensions& dimensions,
+                   std::vector<PutKey>* keys);
+    // write the keys of row_cnt rows and invalidate them in the row cache
+    bool WriteKeys(const std::vector<PutKey>& keys, uint32_t row_cnt);
+    rocksdb::Status GroupWrite(const std::vector<PutKey>& keys, uint32_t row_cnt);
+
+    // the sst files of the inner indexes with ttl are compacted periodically, so the expired
+    // rows in the files out of the regular compactions are removed too
+    uint64_t GetPeriodicCompactionSec(const std::shared_ptr<InnerIndexSt>& inner_index) const;
+    void UpdatePeriodicCompaction();
+
  private:
     rocksdb::DB* db_;
     rocksdb::WriteOptions write_opts_;
@@ -434,6 +503,16 @@ class DiskTable : public Table {
     KeyTSComparator cmp_;
     std::atomic<uint64_t> offset_;
     std::string table_path_;
+    // inner index id -> periodic_compaction_seconds of its column family
+    std::map<uint32_t, uint64_t> periodic_compaction_sec_;
+    // NULL if the row cache is disabled
+    std::unique_ptr<DiskRowCache> row_cache_;
+    bthread::Mutex write_mu_;
+    bthread::ConditionVariable write_cv_;
+    // the group new writers join, its first writer writes it
+    std::shared_ptr<WriteGroup> pending_group_;
+    // true if a group is being written
+    bool group_writing_ = false;
 };
 
 }  // namespace storage
@@ -17,6 +17,7 @@
 #include "storage/disk_table.h"
 #include <gflags/gflags.h>
 #include <iostream>
+#include <thread>  // NOLINT
 #include <utility>
 #include "base/file_util.h"
 #include "base/glog_wapper.h"  // NOLINT
@@ -24,6 +25,8 @@
 #include "codec/sdk_codec.h"
 #include "common/timer.h"  // NOLINT
 #include "gtest/gtest.h"
+#include "rocksdb/perf_context.h"
+#include "rocksdb/perf_level.h"
 #include "storage/ticket.h"
 #include "test/util.h"
 
@@ -33,6 +36,10 @@ DECLARE_string(ssd_root_path);
 DECLARE_string(hdd_root_path);
 DECLARE_uint32(max_traverse_cnt);
 DECLARE_int32(gc_safe_offset);
+DECLARE_uint32(disk_table_bloom_bits_per_key);
+DECLARE_uint32(disk_row_cache_row_cnt);
+DECLARE_uint32(disk_row_cache_admit_cnt);
+DECLARE_uint32(disk_write_group_delay_us);
 
 namespace openmldb {
 namespace storage {
@@ -1024,7 +1031,7 @@ TEST_F(DiskTableTest, GcHeadMulTs) {
             }
         }
     }
-    table->SchedGc();
+    table->GcHead();
     iter = table->NewIterator(0, "card0", ticket);
     iter->SeekToFirst();
     while (iter->Valid()) {
@@ -1072,6 +1079,65 @@ TEST_F(DiskTableTest, GcHeadMulTs) {
     RemoveData(table_path);
 }
 
+TEST_F(DiskTableTest, CompactFilterAllTTLType) {
+    ::openmldb::api::TableMeta table_meta;
+    table_meta.set_tid(18);
+    table_meta.set_pid(1);
+    table_meta.set_storage_mode(::openmldb::common::kHDD);
+    table_meta.set_format_version(1);
+    SchemaCodec::SetColumnDesc(table_meta.add_column_desc(), "card", ::openmldb::type::kString);
+    SchemaCodec::SetColumnDesc(table_meta.add_column_desc(), "mcc", ::openmldb::type::kString);
+    SchemaCodec::SetColumnDesc(table_meta.add_column_desc(), "addr", ::openmldb::type::kString);
+    SchemaCodec::SetColumnDesc(table_meta.add_column_desc(), "ts1", ::openmldb::type::kBigInt);
+    SchemaCodec::SetColumnDesc(table_meta.add_column_desc(), "ts2", ::openmldb::type::kBigInt);
+    SchemaCodec::SetIndex(table_meta.add_column_key(), "card", "card", "ts1", ::openmldb::type::kLatestTime, 0, 3);
+    SchemaCodec::SetIndex(table_meta.add_column_key(), "card1", "card", "ts2", ::openmldb::type::kLatestTime, 0, 5);
+    SchemaCodec::SetIndex(table_meta.add_column_key(), "mcc", "mcc", "ts1", ::openmldb::type::kAbsAndLat, 10, 5);
+    SchemaCodec::SetIndex(table_meta.add_column_key(), "addr", "addr", "ts1", ::openmldb::type::kAbsOrLat, 10, 5);
+
+    std::string table_path = FLAGS_hdd_root_path + "/18_1";
+    DiskTable* table = new DiskTable(table_meta, table_path);
+    ASSERT_TRUE(table->Init());
+    codec::SDKCodec codec(table_meta);
+
+    uint64_t cur_time = ::baidu::common::timer::get_micros() / 1000;
+    uint64_t step = 3 * 60 * 1000;
+    for (int idx = 0; idx < 100; idx++) {
+        Dimensions dims;
+        std::vector<std::string> keys = {"card", "card", "mcc", "addr"};
+        for (uint32_t pos = 0; pos < keys.size(); pos++) {
+            ::openmldb::api::Dimension* dim = dims.Add();
+            dim->set_key(keys[pos] + std::to_string(idx));
+            dim->set_idx(pos);
+        }
+        // the rows from the fifth one are older than 10 minutes
+        for (int i = 0; i < 10; i++) {
+            std::string ts = std::to_string(cur_time - i * step);
+            std::vector<std::string> row = {"card" + std::to_string(idx), "mcc" + std::to_string(idx),
+                                            "addr" + std::to_string(idx), ts, ts};
+            std::string value;
+            ASSERT_EQ(0, codec.EncodeRow(row, &value));
+            ASSERT_TRUE(table->Put(cur_time - i * step, value, dims));
+        }
+    }
+    table->CompactDB();
+    // latest 3, latest 5, expired by abs and the latest 5, expired by abs or the latest 5
+    std::vector<int> keep_cnt = {3, 5, 5, 4};
+    std::vector<std::string> keys = {"card", "card", "mcc", "addr"};
+    for (int idx = 0; idx < 100; idx++) {
+        for (uint32_t pos = 0; pos < keys.size(); pos++) {
+            std::string key = keys[pos] + std::to_string(idx);
+            for (int i = 0; i < 10; i++) {
+                std::string value;
+                ASSERT_EQ(i < keep_cnt[pos], table->Get(pos, key, cur_time - i * step, value))
+                    << "index " << pos << " key " << key << " row " << i;
+            }
+        }
+    }
+    delete table;
+    RemoveData(table_path);
+}
+
 TEST_F(DiskTableTest, GcHead) {
     std::map<std::string, uint32_t> mapping;
     mapping.insert(std::make_pair("idx0", 0));
@@ -1198,6 +1264,272 @@ TEST_F(DiskTableTest, CheckPoint) {
     RemoveData(table_path);
 }
 
+TEST_F(DiskTableTest, PrefixBloomLookup) {
+    uint32_t old_bloom_bits = FLAGS_disk_table_bloom_bits_per_key;
+    const int key_cnt = 10000;
+    uint64_t block_reads[2] = {0, 0};
+    uint64_t lookup_time[2] = {0, 0};
+    std::string value(100, 'v');
+    for (int i = 0; i < 2; i++) {
+        // the second table has no bloom filter
+        FLAGS_disk_table_bloom_bits_per_key = i == 0 ? 10 : 0;
+        uint32_t tid = 16 + i;
+        ::openmldb::api::TableMeta table_meta;
+        table_meta.set_tid(tid);
+        table_meta.set_pid(1);
+        table_meta.set_storage_mode(::openmldb::common::kSSD);
+        table_meta.set_format_version(1);
+        table_meta.set_block_size_kb(4);
+        SchemaCodec::SetColumnDesc(table_meta.add_column_desc(), "card", ::openmldb::type::kString);
+        SchemaCodec::SetColumnDesc(table_meta.add_column_desc(), "ts1", ::openmldb::type::kBigInt);
+        SchemaCodec::SetIndex(table_meta.add_column_key(), "card", "card", "ts1", ::openmldb::type::kLatestTime, 0, 0);
+        std::string table_path = FLAGS_ssd_root_path + "/" + std::to_string(tid) + "_1";
+        DiskTable* table = new DiskTable(table_meta, table_path);
+        ASSERT_TRUE(table->Init());
+        for (int idx = 0; idx < key_cnt; idx++) {
+            ASSERT_TRUE(table->Put("card" + std::to_string(idx * 2), 9527, value.data(), value.size()));
+        }
+        table->CompactDB();
+        std::string result;
+        rocksdb::SetPerfLevel(rocksdb::PerfLevel::kEnableCount);
+        rocksdb::get_perf_context()->Reset();
+        uint64_t start = ::baidu::common::timer::get_micros();
+        for (int idx = 0; idx < key_cnt; idx++) {
+            // the odd keys are between the rows in the data blocks but not in the table
+            ASSERT_FALSE(table->Get(0, "card" + std::to_string(idx * 2 + 1), 9527, result));
+        }
+        lookup_time[i] = ::baidu::common::timer::get_micros() - start;
+        block_reads[i] = rocksdb::get_perf_context()->block_read_count;
+        rocksdb::SetPerfLevel(rocksdb::PerfLevel::kDisable);
+        for (int idx = 0; idx < 10; idx++) {
+            ASSERT_TRUE(table->Get(0, "card" + std::to_string(idx * 2), 9527, result));
+            ASSERT_EQ(value, result);
+        }
+        delete table;
+        RemoveData(table_path);
+    }
+    FLAGS_disk_table_bloom_bits_per_key = old_bloom_bits;
+    PDLOG(INFO, "lookup %d missing keys, with bloom filter: block reads %lu time %lu us, "
+          "without bloom filter: block reads %lu time %lu us",
+          key_cnt, block_reads[0], lookup_time[0], block_reads[1], lookup_time[1]);
+    ASSERT_LT(block_reads[0], block_reads[1]);
+}
+
+TEST_F(DiskTableTest, RowCache) {
+    uint32_t old_row_cnt = FLAGS_disk_row_cache_row_cnt;
+    uint32_t old_admit_cnt = FLAGS_disk_row_cache_admit_cnt;
+    FLAGS_disk_row_cache_row_cnt = 5;
+    FLAGS_disk_row_cache_admit_cnt = 2;
+    ::openmldb::api::TableMeta table_meta;
+    table_meta.set_tid(19);
+    table_meta.set_pid(1);
+    table_meta.set_storage_mode(::openmldb::common::kSSD);
+    table_meta.set_format_version(1);
+    table_meta.set_row_cache_mb(16);
+    SchemaCodec::SetColumnDesc(table_meta.add_column_desc(), "card", ::openmldb::type::kString);
+    SchemaCodec::SetColumnDesc(table_meta.add_column_desc(), "ts1", ::openmldb::type::kBigInt);
+    SchemaCodec::SetIndex(table_meta.add_column_key(), "card", "card", "ts1", ::openmldb::type::kLatestTime, 0, 0);
+    std::string table_path = FLAGS_ssd_root_path + "/19_1";
+    DiskTable* table = new DiskTable(table_meta, table_path);
+    ASSERT_TRUE(table->Init());
+    for (int k = 0; k < 10; k++) {
+        std::string value = "value" + std::to_string(k);
+        if (k < 3) {
+            ASSERT_TRUE(table->Put("card0", 9527 + k, value.c_str(), value.size()));
+        }
+        ASSERT_TRUE(table->Put("card1", 9527 + k, value.c_str(), value.size()));
+    }
+    // card0 is admitted at the second lookup and served from the cache after that
+    for (int round = 0; round < 4; round++) {
+        Ticket ticket;
+        TableIterator* it = table->NewIterator(0, "card0", ticket);
+        it->SeekToFirst();
+        for (int k = 2; k >= 0; k--) {
+            ASSERT_TRUE(it->Valid());
+            ASSERT_EQ(9527 + k, (int64_t)it->GetKey());
+            ASSERT_EQ("value" + std::to_string(k), it->GetValue().ToString());
+            it->Next();
+        }
+        ASSERT_FALSE(it->Valid());
+        delete it;
+    }
+    ASSERT_EQ(2u, table->GetRowCacheHitCnt());
+    ASSERT_EQ(2u, table->GetRowCacheMissCnt());
+    ASSERT_GT(table->GetRowCacheByteSize(), 0u);
+    // the put invalidates the cached rows
+    std::string new_value = "value_new";
+    ASSERT_TRUE(table->Put("card0", 9600, new_value.c_str(), new_value.size()));
+    {
+        Ticket ticket;
+        TableIterator* it = table->NewIterator(0, "card0", ticket);
+        it->SeekToFirst();
+        ASSERT_TRUE(it->Valid());
+        ASSERT_EQ(9600, (int64_t)it->GetKey());
+        ASSERT_EQ("value_new", it->GetValue().ToString());
+        it->Seek(9528);
+        ASSERT_TRUE(it->Valid());
+        ASSERT_EQ(9528, (int64_t)it->GetKey());
+        delete it;
+    }
+    ASSERT_EQ(3u, table->GetRowCacheMissCnt());
+    // only the newest 5 rows of card1 are cached, the older ones are read from rocksdb
+    for (int round = 0; round < 3; round++) {
+        Ticket ticket;
+        TableIterator* it = table->NewIterator(0, "card1", ticket);
+        it->SeekToFirst();
+        int cnt = 0;
+        while (it->Valid()) {
+            ASSERT_EQ(9536 - cnt, (int64_t)it->GetKey());
+            ASSERT_EQ("value" + std::to_string(9 - cnt), it->GetValue().ToString());
+            cnt++;
+            it->Next();
+        }
+        ASSERT_EQ(10, cnt);
+        it->Seek(9530);
+        ASSERT_TRUE(it->Valid());
+        ASSERT_EQ(9530, (int64_t)it->GetKey());
+        delete it;
+    }
+    ASSERT_EQ(3u, table->GetRowCacheHitCnt());
+    ASSERT_EQ(5u, table->GetRowCacheMissCnt());
+    delete table;
+    RemoveData(table_path);
+    FLAGS_disk_row_cache_row_cnt = old_row_cnt;
+    FLAGS_disk_row_cache_admit_cnt = old_admit_cnt;
+}
+
+TEST_F(DiskTableTest, PutBatch) {
+    uint32_t old_delay = FLAGS_disk_write_group_delay_us;
+    FLAGS_disk_write_group_delay_us = 1000;
+    std::map<std::string, uint32_t> mapping;
+    mapping.insert(std::make_pair("idx0", 0));
+    mapping.insert(std::make_pair("idx1", 1));
+    std::string table_path = FLAGS_hdd_root_path + "/20_1";
+    DiskTable* table = new DiskTable("yjtable20", 20, 1, mapping, 0, ::openmldb::type::TTLType::kAbsoluteTime,
+                                     ::openmldb::common::StorageMode::kHDD, table_path);
+    ASSERT_TRUE(table->Init());
+    auto meta = ::openmldb::test::GetTableMeta({"idx0", "idx1"});
+    ::openmldb::codec::SDKCodec sdk_codec(meta);
+    const int thread_cnt = 4;
+    const int batch_cnt = 10;
+    const int row_cnt = 50;
+    std::vector<std::thread> threads;
+    std::atomic<uint32_t> put_cnt(0);
+    for (int i = 0; i < thread_cnt; i++) {
+        threads.emplace_back([&, i] {
+            for (int j = 0; j < batch_cnt; j++) {
+                PutBatchRows rows;
+                for (int k = 0; k < row_cnt; k++) {
+                    std::string key0 = "key" + std::to_string(k % 5);
+                    std::string key1 = "thread" + std::to_string(i);
+                    ::openmldb::api::PutBatchRow* row = rows.Add();
+                    row->set_time(j * row_cnt + k + 1);
+                    ASSERT_EQ(0, sdk_codec.EncodeRow({key0, key1}, row->mutable_value()));
+                    auto dimension = row->add_dimensions();
+                    dimension->set_key(key0);
+                    dimension->set_idx(0);
+                    dimension = row->add_dimensions();
+                    dimension->set_key(key1);
+                    dimension->set_idx(1);
+                }
+                uint32_t cnt = 0;
+                ASSERT_TRUE(table->PutBatch(rows, &cnt));
+                ASSERT_EQ((uint32_t)row_cnt, cnt);
+                put_cnt.fetch_add(cnt);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    ASSERT_EQ((uint32_t)(thread_cnt * batch_cnt * row_cnt), put_cnt.load());
+    ASSERT_EQ((uint64_t)(thread_cnt * batch_cnt * row_cnt), table->GetOffset());
+    for (int i = 0; i < thread_cnt; i++) {
+        Ticket ticket;
+        TableIterator* it = table->NewIterator(1, "thread" + std::to_string(i), ticket);
+        it->SeekToFirst();
+        int cnt = 0;
+        while (it->Valid()) {
+            ASSERT_EQ((uint64_t)(batch_cnt * row_cnt - cnt), it->GetKey());
+            cnt++;
+            it->Next();
+        }
+        ASSERT_EQ(batch_cnt * row_cnt, cnt);
+        delete it;
+    }
+    delete table;
+    RemoveData(table_path);
+    FLAGS_disk_write_group_delay_us = old_delay;
+}
+
+TEST_F(DiskTableTest, IngestSstFiles) {
+    std::map<std::string, uint32_t> mapping;
+    mapping.insert(std::make_pair("idx0", 0));
+    mapping.insert(std::make_pair("idx1", 1));
+    std::string table_path = FLAGS_hdd_root_path + "/21_1";
+    DiskTable* table = new DiskTable("yjtable21", 21, 1, mapping, 0, ::openmldb::type::TTLType::kAbsoluteTime,
+                                     ::openmldb::common::StorageMode::kHDD, table_path);
+    ASSERT_TRUE(table->Init());
+    auto meta = ::openmldb::test::GetTableMeta({"idx0", "idx1"});
+    ::openmldb::codec::SDKCodec sdk_codec(meta);
+    std::string value;
+    ASSERT_EQ(0, sdk_codec.EncodeRow({"key0", "card0"}, &value));
+    Dimensions dimensions;
+    auto dimension = dimensions.Add();
+    dimension->set_key("key0");
+    dimension->set_idx(0);
+    ASSERT_TRUE(table->Put(1000, value, dimensions));
+    // the rows are not in order, and the last one of the rows with the same key wins
+    PutBatchRows rows;
+    for (int i = 0; i < 100; i++) {
+        std::string key0 = "key" + std::to_string(i % 10);
+        std::string key1 = "card" + std::to_string(i % 10);
+        ::openmldb::api::PutBatchRow* row = rows.Add();
+        row->set_time(i % 3 == 0 ? 1 : 100 - i);
+        ASSERT_EQ(0, sdk_codec.EncodeRow({key0, key1}, row->mutable_value()));
+        auto row_dimension = row->add_dimensions();
+        row_dimension->set_key(key0);
+        row_dimension->set_idx(0);
+        row_dimension = row->add_dimensions();
+        row_dimension->set_key(key1);
+        row_dimension->set_idx(1);
+    }
+    std::map<uint32_t, std::string> files;
+    ASSERT_TRUE(table->BuildSstFiles(rows, table_path + "/sst", &files));
+    ASSERT_EQ(2u, files.size());
+    Ticket ticket;
+    TableIterator* it = table->NewIterator(1, "card0", ticket);
+    it->SeekToFirst();
+    ASSERT_FALSE(it->Valid());
+    delete it;
+    ASSERT_TRUE(table->IngestSstFiles(files));
+    for (int idx = 0; idx < 2; idx++) {
+        for (int i = 0; i < 10; i++) {
+            std::string key = (idx == 0 ? "key" : "card") + std::to_string(i);
+            it = table->NewIterator(idx, key, ticket);
+            it->SeekToFirst();
+            int cnt = 0;
+            while (it->Valid()) {
+                cnt++;
+                it->Next();
+            }
+            delete it;
+            // the rows of time 1 are merged into one, the row put before is kept
+            uint32_t expect = 0;
+            for (int j = i; j < 100; j += 10) {
+                expect += j % 3 == 0 ? 0 : 1;
+            }
+            expect += 1;
+            if (idx == 0 && i == 0) {
+                expect++;
+            }
+            ASSERT_EQ(expect, (uint32_t)cnt) << key;
+        }
+    }
+    delete table;
+    RemoveData(table_path);
+}
+
 }  // namespace storage
 }  // namespace openmldb
 
@@ -0,0 +1,102 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "storage/epoch.h"
+
+#include <vector>
+
+namespace openmldb {
+namespace storage {
+
+EpochManager::EpochManager() : epoch_(0), readers_(), retired_cnt_(0), mu_(), retired_() {
+    for (uint32_t i = 0; i < SLOT_CNT; i++) {
+        readers_[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+EpochManager::~EpochManager() { ReclaimAll(); }
+
+uint64_t EpochManager::Pin() {
+    while (true) {
+        uint64_t epoch = epoch_.load(std::memory_order_seq_cst);
+        readers_[epoch % SLOT_CNT].fetch_add(1, std::memory_order_seq_cst);
+        // the epoch may advance before the pin is visible, retry so that TryAdvance
+        // never misses a reader of the previous epoch
+        if (epoch_.load(std::memory_order_seq_cst) == epoch) {
+            return epoch;
+        }
+        readers_[epoch % SLOT_CNT].fetch_sub(1, std::memory_order_release);
+    }
+}
+
+void EpochManager::UnPin(uint64_t epoch) {
+    if (readers_[epoch % SLOT_CNT].fetch_sub(1, std::memory_order_acq_rel) > 1 ||
+        retired_cnt_.load(std::memory_order_relaxed) == 0) {
+        return;
+    }
+    // the last reader of the epoch releases the memory held back by it,
+    // but it never waits for the others
+    std::unique_lock<std::mutex> lock(mu_, std::try_to_lock);
+    if (lock.owns_lock()) {
+        lock.unlock();
+        Reclaim(false);
+    }
+}
+
+void EpochManager::Retire(std::function<void()>&& deleter) {
+    std::lock_guard<std::mutex> lock(mu_);
+    // the epoch only advances with mu_ held, so the retired list is ordered by epoch
+    retired_.emplace_back(epoch_.load(std::memory_order_seq_cst), std::move(deleter));
+    retired_cnt_.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t EpochManager::Reclaim() { return Reclaim(false); }
+
+uint64_t EpochManager::ReclaimAll() { return Reclaim(true); }
+
+void EpochManager::TryAdvance() {
+    uint64_t epoch = epoch_.load(std::memory_order_seq_cst);
+    if (readers_[(epoch + SLOT_CNT - 1) % SLOT_CNT].load(std::memory_order_seq_cst) == 0) {
+        epoch_.store(epoch + 1, std::memory_order_seq_cst);
+    }
+}
+
+uint64_t EpochManager::Reclaim(bool all) {
+    std::vector<std::function<void()>> deleters;
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        if (retired_.empty()) {
+            return 0;
+        }
+        // advance twice at most, the memory retired in the current epoch is released
+        // at once if there is no reader
+        TryAdvance();
+        TryAdvance();
+        uint64_t epoch = epoch_.load(std::memory_order_relaxed);
+        while (!retired_.empty() && (all || retired_.front().first + 2 <= epoch)) {
+            deleters.push_back(std::move(retired_.front().second));
+            retired_.pop_front();
+        }
+        retired_cnt_.fetch_sub(deleters.size(), std::memory_order_relaxed);
+    }
+    for (auto& deleter : deleters) {
+        deleter();
+    }
+    return deleters.size();
+}
+
+}  // namespace storage
+}  // namespace openmldb
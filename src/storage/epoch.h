@@ -0,0 +1,92 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_STORAGE_EPOCH_H_
+#define SRC_STORAGE_EPOCH_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>  // NOLINT
+#include <utility>
+
+namespace openmldb {
+namespace storage {
+
+// EpochManager defers the release of memory unlinked from a concurrent structure
+// until no reader can observe it.
+// a reader pins the current epoch before it reads the structure and unpins it when
+// done. a writer retires the memory it unlinked with the current epoch. the epoch
+// advances only if no reader is left in the previous one, so the memory retired in
+// epoch e is not observable once the epoch reaches e + 2.
+// readers are not bound to threads, a pin may be held across threads.
+class EpochManager {
+ public:
+    EpochManager();
+    // release all retired memory, the readers must be gone
+    ~EpochManager();
+    EpochManager(const EpochManager&) = delete;
+    EpochManager& operator=(const EpochManager&) = delete;
+
+    // return the pinned epoch which should be passed to UnPin
+    uint64_t Pin();
+    void UnPin(uint64_t epoch);
+
+    // the deleter is called once the memory can not be observed by readers
+    void Retire(std::function<void()>&& deleter);
+
+    // release the retired memory which is not observable, return the count of released
+    uint64_t Reclaim();
+
+    // release all retired memory no matter whether the readers are left
+    uint64_t ReclaimAll();
+
+    inline uint64_t GetEpoch() const { return epoch_.load(std::memory_order_relaxed); }
+    inline uint64_t GetRetiredCnt() const { return retired_cnt_.load(std::memory_order_relaxed); }
+
+ private:
+    void TryAdvance();
+    uint64_t Reclaim(bool all);
+
+ private:
+    // readers can only be in the current epoch and the previous one, the third slot
+    // is for the stale pins which are going to be retried in Pin
+    static const uint32_t SLOT_CNT = 3;
+
+    std::atomic<uint64_t> epoch_;
+    std::atomic<uint64_t> readers_[SLOT_CNT];
+    std::atomic<uint64_t> retired_cnt_;
+    std::mutex mu_;
+    std::deque<std::pair<uint64_t, std::function<void()>>> retired_;
+};
+
+class EpochGuard {
+ public:
+    explicit EpochGuard(EpochManager* epoch) : epoch_(epoch), pinned_(epoch->Pin()) {}
+    ~EpochGuard() { epoch_->UnPin(pinned_); }
+    EpochGuard(const EpochGuard&) = delete;
+    EpochGuard& operator=(const EpochGuard&) = delete;
+
+ private:
+    EpochManager* epoch_;
+    uint64_t pinned_;
+};
+
+}  // namespace storage
+}  // namespace openmldb
+#endif  // SRC_STORAGE_EPOCH_H_
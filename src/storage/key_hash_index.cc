@@ -0,0 +1,197 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "storage/key_hash_index.h"
+
+#include <algorithm>
+
+#include "base/glog_wapper.h"
+#include "base/hash.h"
+#include "common/timer.h"
+
+namespace openmldb {
+namespace storage {
+
+static const uint32_t KEY_HASH_SEED = 0xe17a1465;
+// the buckets migrated by one insert. a grow starts when the keys reach the count of buckets,
+// so the migration is finished long before the next grow
+static const uint32_t KEY_HASH_MIGRATE_BUCKET_CNT = 4;
+
+KeyHashIndex::Table::Table(uint32_t cnt) : bucket_cnt(cnt), buckets(new std::atomic<Node*>[cnt]) {
+    for (uint32_t i = 0; i < bucket_cnt; i++) {
+        buckets[i].store(NULL, std::memory_order_relaxed);
+    }
+}
+
+KeyHashIndex::Table::~Table() { delete[] buckets; }
+
+KeyHashIndex::KeyHashIndex(EpochManager* epoch, uint32_t bucket_cnt)
+    : table_(NULL), old_table_(NULL), migrate_pos_(0), grow_start_time_(0), size_(0), bucket_cnt_(0), epoch_(epoch) {
+    uint32_t cnt = 1;
+    while (cnt < bucket_cnt) {
+        cnt <<= 1;
+    }
+    table_.store(new Table(cnt), std::memory_order_release);
+    bucket_cnt_.store(cnt, std::memory_order_relaxed);
+}
+
+KeyHashIndex::~KeyHashIndex() {
+    Table* old_table = old_table_.load(std::memory_order_relaxed);
+    if (old_table != NULL) {
+        FreeTable(old_table);
+    }
+    FreeTable(table_.load(std::memory_order_relaxed));
+}
+
+uint32_t KeyHashIndex::Hash(const Slice& key) { return ::openmldb::base::hash(key.data(), key.size(), KEY_HASH_SEED); }
+
+void KeyHashIndex::FreeTable(Table* table) {
+    for (uint32_t i = 0; i < table->bucket_cnt; i++) {
+        Node* node = table->buckets[i].load(std::memory_order_relaxed);
+        while (node != NULL) {
+            Node* tmp = node;
+            node = node->next.load(std::memory_order_relaxed);
+            delete tmp;
+        }
+    }
+    delete table;
+}
+
+void KeyHashIndex::Insert(const Slice& key, void* value) {
+    if (old_table_.load(std::memory_order_relaxed) != NULL) {
+        Migrate(KEY_HASH_MIGRATE_BUCKET_CNT);
+    } else if (size_.load(std::memory_order_relaxed) >= table_.load(std::memory_order_relaxed)->bucket_cnt) {
+        Grow();
+    }
+    Table* table = table_.load(std::memory_order_relaxed);
+    uint32_t hash = Hash(key);
+    std::atomic<Node*>& bucket = table->buckets[hash & (table->bucket_cnt - 1)];
+    Node* node = new Node(key, value, hash);
+    node->next.store(bucket.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    // the node is visible to readers after it's initialized
+    bucket.store(node, std::memory_order_release);
+    size_.fetch_add(1, std::memory_order_relaxed);
+}
+
+KeyHashIndex::Node* KeyHashIndex::Unlink(Table* table, const Slice& key, uint32_t hash) {
+    std::atomic<Node*>* pre = &table->buckets[hash & (table->bucket_cnt - 1)];
+    Node* node = pre->load(std::memory_order_relaxed);
+    while (node != NULL) {
+        if (node->hash == hash && node->key == key) {
+            pre->store(node->next.load(std::memory_order_relaxed), std::memory_order_release);
+            return node;
+        }
+        pre = &node->next;
+        node = pre->load(std::memory_order_relaxed);
+    }
+    return NULL;
+}
+
+bool KeyHashIndex::Remove(const Slice& key) {
+    uint32_t hash = Hash(key);
+    Node* node = Unlink(table_.load(std::memory_order_relaxed), key, hash);
+    // the key is in both tables if its bucket is migrated
+    Table* old_table = old_table_.load(std::memory_order_relaxed);
+    Node* old_node = old_table == NULL ? NULL : Unlink(old_table, key, hash);
+    if (node == NULL && old_node == NULL) {
+        return false;
+    }
+    size_.fetch_sub(1, std::memory_order_relaxed);
+    // the readers may be on the nodes
+    epoch_->Retire([node, old_node]() {
+        delete node;
+        delete old_node;
+    });
+    return true;
+}
+
+KeyHashIndex::Node* KeyHashIndex::Find(const Table* table, const Slice& key, uint32_t hash) {
+    Node* node = table->buckets[hash & (table->bucket_cnt - 1)].load(std::memory_order_acquire);
+    while (node != NULL) {
+        if (node->hash == hash && node->key == key) {
+            return node;
+        }
+        node = node->next.load(std::memory_order_acquire);
+    }
+    return NULL;
+}
+
+void* KeyHashIndex::Get(const Slice& key) const {
+    // table_ is loaded first, the old table of a migration is published before its new table
+    Table* table = table_.load(std::memory_order_acquire);
+    Table* old_table = old_table_.load(std::memory_order_acquire);
+    uint32_t hash = Hash(key);
+    Node* node = Find(table, key, hash);
+    // the migration only copies the nodes, so the keys not found in the new table are still in the old one
+    if (node == NULL && old_table != NULL && old_table != table) {
+        node = Find(old_table, key, hash);
+    }
+    return node == NULL ? NULL : node->value;
+}
+
+void KeyHashIndex::Grow() {
+    Table* table = table_.load(std::memory_order_relaxed);
+    Table* new_table = new Table(table->bucket_cnt << 1);
+    grow_start_time_ = ::baidu::common::timer::get_micros();
+    migrate_pos_ = 0;
+    old_table_.store(table, std::memory_order_relaxed);
+    table_.store(new_table, std::memory_order_release);
+    bucket_cnt_.store(new_table->bucket_cnt, std::memory_order_relaxed);
+}
+
+void KeyHashIndex::Migrate(uint32_t cnt) {
+    Table* old_table = old_table_.load(std::memory_order_relaxed);
+    Table* table = table_.load(std::memory_order_relaxed);
+    uint32_t end = std::min(migrate_pos_ + cnt, old_table->bucket_cnt);
+    for (; migrate_pos_ < end; migrate_pos_++) {
+        Node* node = old_table->buckets[migrate_pos_].load(std::memory_order_relaxed);
+        while (node != NULL) {
+            std::atomic<Node*>& bucket = table->buckets[node->hash & (table->bucket_cnt - 1)];
+            Node* copy = new Node(node->key, node->value, node->hash);
+            copy->next.store(bucket.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            bucket.store(copy, std::memory_order_release);
+            node = node->next.load(std::memory_order_relaxed);
+        }
+    }
+    if (migrate_pos_ < old_table->bucket_cnt) {
+        return;
+    }
+    PDLOG(INFO, "key hash index grows from %u to %u buckets with %lu keys, time used %lu us", old_table->bucket_cnt,
+          table->bucket_cnt, size_.load(std::memory_order_relaxed),
+          ::baidu::common::timer::get_micros() - grow_start_time_);
+    old_table_.store(NULL, std::memory_order_release);
+    epoch_->Retire([old_table]() { FreeTable(old_table); });
+}
+
+void KeyHashIndex::Clear() {
+    Table* old_table = old_table_.load(std::memory_order_relaxed);
+    if (old_table != NULL) {
+        old_table_.store(NULL, std::memory_order_relaxed);
+        FreeTable(old_table);
+    }
+    Table* table = table_.load(std::memory_order_relaxed);
+    table_.store(new Table(table->bucket_cnt), std::memory_order_release);
+    FreeTable(table);
+    size_.store(0, std::memory_order_relaxed);
+}
+
+uint64_t KeyHashIndex::GetByteSize() const {
+    return sizeof(KeyHashIndex) + bucket_cnt_.load(std::memory_order_relaxed) * sizeof(std::atomic<Node*>) +
+           size_.load(std::memory_order_relaxed) * sizeof(Node);
+}
+
+}  // namespace storage
+}  // namespace openmldb
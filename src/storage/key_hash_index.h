@@ -0,0 +1,104 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_STORAGE_KEY_HASH_INDEX_H_
+#define SRC_STORAGE_KEY_HASH_INDEX_H_
+
+#include <stdint.h>
+
+#include <atomic>
+
+#include "base/slice.h"
+#include "storage/epoch.h"
+
+namespace openmldb {
+namespace storage {
+
+using ::openmldb::base::Slice;
+
+// KeyHashIndex maps the keys of a segment to their key entries for point lookups,
+// the ordered traversal is still served by the skiplist of the segment.
+// it's a chained hash table with lock-free readers. the writers must be serialized
+// by the caller. the nodes and the bucket arrays unlinked by writers are retired to
+// epoch, so the readers must pin it during the lookup.
+// the index grows incrementally. a grow only allocates the doubled bucket array, then
+// every insert migrates a few buckets of the old table until all of them are copied,
+// the lookups check the old table as well as long as the migration isn't finished.
+// the memory of keys is owned by the caller and must outlive their mappings
+class KeyHashIndex {
+ public:
+    KeyHashIndex(EpochManager* epoch, uint32_t bucket_cnt);
+    ~KeyHashIndex();
+    KeyHashIndex(const KeyHashIndex&) = delete;
+    KeyHashIndex& operator=(const KeyHashIndex&) = delete;
+
+    // the key must not be in the index
+    void Insert(const Slice& key, void* value);
+
+    bool Remove(const Slice& key);
+
+    // return NULL if the key is not found
+    void* Get(const Slice& key) const;
+
+    // remove all keys, the readers must be gone
+    void Clear();
+
+    inline uint64_t GetSize() const { return size_.load(std::memory_order_relaxed); }
+
+    uint64_t GetByteSize() const;
+
+ private:
+    struct Node {
+        Node(const Slice& k, void* v, uint32_t h) : key(k), value(v), hash(h), next(NULL) {}
+        Slice key;
+        void* value;
+        uint32_t hash;
+        std::atomic<Node*> next;
+    };
+
+    struct Table {
+        explicit Table(uint32_t cnt);
+        ~Table();
+        // the count of buckets is a power of two
+        uint32_t bucket_cnt;
+        std::atomic<Node*>* buckets;
+    };
+
+    static uint32_t Hash(const Slice& key);
+    static Node* Find(const Table* table, const Slice& key, uint32_t hash);
+    // unlink the node of key from table, return NULL if the key is not in table
+    static Node* Unlink(Table* table, const Slice& key, uint32_t hash);
+    // double the buckets, the nodes of the old table are migrated by the following inserts
+    void Grow();
+    // copy the nodes of the next cnt buckets of the old table, the nodes are copied so the readers
+    // on the old table are not affected
+    void Migrate(uint32_t cnt);
+    static void FreeTable(Table* table);
+
+    std::atomic<Table*> table_;
+    // the table being migrated to table_, NULL if there is no migration
+    std::atomic<Table*> old_table_;
+    // the next bucket of old_table_ to migrate
+    uint32_t migrate_pos_;
+    uint64_t grow_start_time_;
+    std::atomic<uint64_t> size_;
+    std::atomic<uint32_t> bucket_cnt_;
+    EpochManager* epoch_;
+};
+
+}  // namespace storage
+}  // namespace openmldb
+#endif  // SRC_STORAGE_KEY_HASH_INDEX_H_
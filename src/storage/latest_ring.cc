@@ -0,0 +1,160 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "storage/latest_ring.h"
+
+#include <thread>  // NOLINT
+
+namespace openmldb {
+namespace storage {
+
+LatestRing::LatestRing(uint32_t capacity)
+    : capacity_(capacity == 0 ? 1 : capacity),
+      seq_(0),
+      head_(0),
+      size_(0),
+      times_(new std::atomic<uint64_t>[capacity_]),
+      rows_(new std::atomic<DataBlock*>[capacity_]) {
+    for (uint32_t i = 0; i < capacity_; i++) {
+        times_[i].store(0, std::memory_order_relaxed);
+        rows_[i].store(NULL, std::memory_order_relaxed);
+    }
+}
+
+LatestRing::~LatestRing() {
+    delete[] times_;
+    delete[] rows_;
+}
+
+uint64_t LatestRing::GetByteSize(uint32_t capacity) {
+    return sizeof(LatestRing) + (uint64_t)capacity * (sizeof(std::atomic<uint64_t>) + sizeof(std::atomic<DataBlock*>));
+}
+
+void LatestRing::BeginWrite() {
+    seq_.store(seq_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void LatestRing::EndWrite() { seq_.store(seq_.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+DataBlock* LatestRing::Insert(uint64_t time, DataBlock* row, bool* rejected) {
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    uint32_t size = size_.load(std::memory_order_relaxed);
+    // the new row goes before the rows with the same time like skiplist
+    uint32_t pos = 0;
+    while (pos < size && times_[Slot(head, pos)].load(std::memory_order_relaxed) > time) {
+        pos++;
+    }
+    *rejected = pos == capacity_;
+    if (*rejected) {
+        return row;
+    }
+    DataBlock* evicted = NULL;
+    BeginWrite();
+    if (pos == 0) {
+        // the common case, the latest row moves the head back and overwrites the oldest one if full
+        head = Slot(head, capacity_ - 1);
+        if (size == capacity_) {
+            evicted = rows_[head].load(std::memory_order_relaxed);
+        } else {
+            size++;
+        }
+        head_.store(head, std::memory_order_relaxed);
+    } else {
+        if (size == capacity_) {
+            evicted = rows_[Slot(head, size - 1)].load(std::memory_order_relaxed);
+        } else {
+            size++;
+        }
+        for (uint32_t i = size - 1; i > pos; i--) {
+            uint32_t from = Slot(head, i - 1);
+            uint32_t to = Slot(head, i);
+            times_[to].store(times_[from].load(std::memory_order_relaxed), std::memory_order_relaxed);
+            rows_[to].store(rows_[from].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+    }
+    times_[Slot(head, pos)].store(time, std::memory_order_relaxed);
+    rows_[Slot(head, pos)].store(row, std::memory_order_relaxed);
+    size_.store(size, std::memory_order_relaxed);
+    EndWrite();
+    return evicted;
+}
+
+void LatestRing::Trim(uint32_t keep_cnt, std::vector<DataBlock*>* rows) {
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    uint32_t size = size_.load(std::memory_order_relaxed);
+    if (size <= keep_cnt) {
+        return;
+    }
+    for (uint32_t i = keep_cnt; i < size; i++) {
+        rows->push_back(rows_[Slot(head, i)].load(std::memory_order_relaxed));
+    }
+    BeginWrite();
+    size_.store(keep_cnt, std::memory_order_relaxed);
+    EndWrite();
+}
+
+void LatestRing::Read(std::vector<std::pair<uint64_t, DataBlock*>>* rows) const {
+    while (true) {
+        uint64_t seq = seq_.load(std::memory_order_acquire);
+        if (seq & 1) {
+            std::this_thread::yield();
+            continue;
+        }
+        rows->clear();
+        uint32_t head = head_.load(std::memory_order_relaxed);
+        uint32_t size = size_.load(std::memory_order_relaxed);
+        for (uint32_t i = 0; i < size; i++) {
+            uint32_t slot = Slot(head, i);
+            rows->emplace_back(times_[slot].load(std::memory_order_relaxed),
+                               rows_[slot].load(std::memory_order_relaxed));
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (seq_.load(std::memory_order_relaxed) == seq) {
+            return;
+        }
+    }
+}
+
+DataBlock* LatestRing::Get(uint64_t time) const {
+    while (true) {
+        uint64_t seq = seq_.load(std::memory_order_acquire);
+        if (seq & 1) {
+            std::this_thread::yield();
+            continue;
+        }
+        DataBlock* row = NULL;
+        uint32_t head = head_.load(std::memory_order_relaxed);
+        uint32_t size = size_.load(std::memory_order_relaxed);
+        for (uint32_t i = 0; i < size; i++) {
+            uint32_t slot = Slot(head, i);
+            uint64_t cur = times_[slot].load(std::memory_order_relaxed);
+            if (cur == time) {
+                row = rows_[slot].load(std::memory_order_relaxed);
+                break;
+            } else if (cur < time) {
+                break;
+            }
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (seq_.load(std::memory_order_relaxed) == seq) {
+            return row;
+        }
+    }
+}
+
+}  // namespace storage
+}  // namespace openmldb
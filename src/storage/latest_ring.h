@@ -0,0 +1,82 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_STORAGE_LATEST_RING_H_
+#define SRC_STORAGE_LATEST_RING_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <utility>
+#include <vector>
+
+namespace openmldb {
+namespace storage {
+
+struct DataBlock;
+
+// LatestRing keeps the latest rows of one key of a latest-N index in a fixed capacity
+// ring, the rows are sorted by time in descending order. a put into a full ring evicts
+// the oldest row, so the index needs no gc.
+// the writers must be serialized by the caller. the readers are lock-free, they copy
+// the rows out under a seqlock and retry if a writer is in progress. the rows evicted
+// may be still in use by readers, the caller must release them after the readers are gone
+class LatestRing {
+ public:
+    explicit LatestRing(uint32_t capacity);
+    ~LatestRing();
+    LatestRing(const LatestRing&) = delete;
+    LatestRing& operator=(const LatestRing&) = delete;
+
+    // return the row evicted, or NULL if no row is evicted. rejected is set to true if the
+    // ring is full and the input row is older than all rows in it, the input row itself is
+    // returned then and it's never visible to the readers
+    DataBlock* Insert(uint64_t time, DataBlock* row, bool* rejected);
+
+    // remove the rows after the latest keep_cnt ones and append them to rows
+    void Trim(uint32_t keep_cnt, std::vector<DataBlock*>* rows);
+
+    // copy the rows in descending order of time
+    void Read(std::vector<std::pair<uint64_t, DataBlock*>>* rows) const;
+
+    // return NULL if there is no row of the time
+    DataBlock* Get(uint64_t time) const;
+
+    inline uint32_t GetCapacity() const { return capacity_; }
+
+    // only consistent for the writers
+    inline uint32_t GetSize() const { return size_.load(std::memory_order_relaxed); }
+
+    static uint64_t GetByteSize(uint32_t capacity);
+
+ private:
+    inline uint32_t Slot(uint32_t head, uint32_t pos) const { return (head + pos) % capacity_; }
+    void BeginWrite();
+    void EndWrite();
+
+ private:
+    const uint32_t capacity_;
+    // odd while a writer is in progress
+    std::atomic<uint64_t> seq_;
+    std::atomic<uint32_t> head_;
+    std::atomic<uint32_t> size_;
+    std::atomic<uint64_t>* times_;
+    std::atomic<DataBlock*>* rows_;
+};
+
+}  // namespace storage
+}  // namespace openmldb
+#endif  // SRC_STORAGE_LATEST_RING_H_
@@ -32,6 +32,10 @@ DECLARE_uint32(key_entry_max_height);
 DECLARE_uint32(absolute_default_skiplist_height);
 DECLARE_uint32(latest_default_skiplist_height);
 DECLARE_uint32(max_traverse_cnt);
+DECLARE_uint32(cold_tier_age);
+DECLARE_uint32(gc_tick_key_cnt);
+DECLARE_uint32(gc_tick_interval);
+DECLARE_uint32(latest_ring_max_cnt);
 
 namespace openmldb {
 namespace storage {
@@ -47,13 +51,23 @@ MemTable::MemTable(const std::string& name, uint32_t id, uint32_t pid, uint32_t
       enable_gc_(true),
       record_cnt_(0),
       segment_released_(false),
-      record_byte_size_(0) {}
+      record_byte_size_(0),
+      gc_running_(false),
+      gc_backlog_key_cnt_(0),
+      gc_tick_cnt_(0),
+      gc_tick_time_(0),
+      gc_max_tick_time_(0) {}
 
 MemTable::MemTable(const ::openmldb::api::TableMeta& table_meta)
     : Table(table_meta.storage_mode(), table_meta.name(), table_meta.tid(), table_meta.pid(), 0, true, 60 * 1000,
             std::map<std::string, uint32_t>(), ::openmldb::type::TTLType::kAbsoluteTime,
             ::openmldb::type::CompressType::kNoCompress),
-      segments_(MAX_INDEX_NUM, NULL) {
+      segments_(MAX_INDEX_NUM, NULL),
+      gc_running_(false),
+      gc_backlog_key_cnt_(0),
+      gc_tick_cnt_(0),
+      gc_tick_time_(0),
+      gc_max_tick_time_(0) {
     seg_cnt_ = 8;
     enable_gc_ = true;
     record_cnt_ = 0;
@@ -116,6 +130,14 @@ bool MemTable::Init() {
                 PDLOG(INFO, "init %u, %u segment. height %u tid %u pid %u", i, j, cur_key_entry_max_height, id_, pid_);
             }
         }
+        uint32_t ring_cap = GetLatestRingCapacity(*(inner_indexs->at(i)));
+        if (ring_cap > 0) {
+            for (uint32_t j = 0; j < seg_cnt_; j++) {
+                seg_arr[j]->EnableLatestRing(ring_cap);
+            }
+            PDLOG(INFO, "keep the latest %u rows of a key in ring for inner index %u. tid %u pid %u", ring_cap, i, id_,
+                  pid_);
+        }
         segments_[i] = seg_arr;
         key_entry_max_height_ = cur_key_entry_max_height;
     }
@@ -150,16 +172,6 @@ bool MemTable::Put(uint64_t time, const std::string& value, const Dimensions& di
         PDLOG(WARNING, "invalid value. tid %u pid %u", id_, pid_);
         return false;
     }
-    std::map<int32_t, Slice> inner_index_key_map;
-    for (auto iter = dimensions.begin(); iter != dimensions.end(); iter++) {
-        int32_t inner_pos = table_index_.GetInnerIndexPos(iter->idx());
-        if (inner_pos < 0) {
-            PDLOG(WARNING, "invalid dimension. dimension idx %u, tid %u pid %u", iter->idx(), id_, pid_);
-            return false;
-        }
-        inner_index_key_map.emplace(inner_pos, iter->key());
-    }
-    uint32_t real_ref_cnt = 0;
     const int8_t* data = reinterpret_cast<const int8_t*>(value.data());
     uint8_t version = codec::RowView::GetSchemaVersion(data);
     auto decoder = GetVersionDecoder(version);
@@ -167,56 +179,200 @@ bool MemTable::Put(uint64_t time, const std::string& value, const Dimensions& di
         PDLOG(WARNING, "invalid schema version %u, tid %u pid %u", version, id_, pid_);
         return false;
     }
-    std::map<int32_t, uint64_t> ts_map;
-    for (const auto& kv : inner_index_key_map) {
-        auto inner_index = table_index_.GetInnerIndex(kv.first);
-        if (!inner_index) {
-            PDLOG(WARNING, "invalid inner index pos %d. tid %u pid %u", kv.first, id_, pid_);
+    auto plan = table_index_.GetPutPlan();
+    const std::string* keys[MAX_INDEX_NUM];
+    uint64_t ts[MAX_INDEX_NUM];
+    int32_t ref_cnt = ResolvePutRow(*plan, *decoder, time, data, dimensions, keys, ts);
+    if (ref_cnt < 0) {
+        return false;
+    }
+    DataBlock* block = nullptr;
+    for (uint32_t pos = 0; pos < plan->inner_indexs.size(); pos++) {
+        if (keys[pos] == nullptr) {
+            continue;
+        }
+        uint32_t seg_idx = GetSegIdx(*keys[pos]);
+        if (block == nullptr) {
+            // the row is shared by all dimensions, take memory from the first segment
+            block = segments_[pos][seg_idx]->AllocDataBlock(ref_cnt, value.c_str(), value.length());
+        }
+        PutRow(*plan, pos, seg_idx, *keys[pos], ts, block);
+    }
+    record_cnt_.fetch_add(1, std::memory_order_relaxed);
+    record_byte_size_.fetch_add(GetRecordSize(value.length()));
+    return true;
+}
+
+bool MemTable::PutBatch(const PutBatchRows& rows, uint32_t* put_cnt) {
+    *put_cnt = 0;
+    if (rows.empty()) {
+        return true;
+    }
+    auto plan = table_index_.GetPutPlan();
+    uint32_t inner_cnt = plan->inner_indexs.size();
+    uint32_t ts_cnt = plan->ts_cols.size();
+    std::vector<const std::string*> keys(rows.size() * inner_cnt);
+    std::vector<uint64_t> ts(rows.size() * ts_cnt);
+    std::vector<int32_t> ref_cnts(rows.size(), 0);
+    std::shared_ptr<codec::RowView> decoder;
+    uint8_t decoder_version = 0;
+    for (int i = 0; i < rows.size(); i++) {
+        const auto& row = rows.Get(i);
+        if (row.dimensions().empty() || row.value().length() < codec::HEADER_LENGTH) {
+            PDLOG(WARNING, "invalid row %d in batch. tid %u pid %u", i, id_, pid_);
             return false;
         }
-        for (const auto& index_def : inner_index->GetIndex()) {
-            auto ts_col = index_def->GetTsColumn();
-            if (ts_col) {
-                int64_t ts = 0;
-                if (ts_col->IsAutoGenTs()) {
-                    ts = time;
-                } else if (decoder->GetInteger(data, ts_col->GetId(), ts_col->GetType(), &ts) != 0) {
-                    PDLOG(WARNING, "get ts failed. tid %u pid %u", id_, pid_);
-                    return false;
-                }
-                ts_map.emplace(ts_col->GetId(), ts);
+        const int8_t* data = reinterpret_cast<const int8_t*>(row.value().data());
+        uint8_t version = codec::RowView::GetSchemaVersion(data);
+        if (!decoder || version != decoder_version) {
+            decoder = GetVersionDecoder(version);
+            if (decoder == nullptr) {
+                PDLOG(WARNING, "invalid schema version %u of row %d, tid %u pid %u", version, i, id_, pid_);
+                return false;
             }
-            if (index_def->IsReady()) {
-                real_ref_cnt++;
+            decoder_version = version;
+        }
+        ref_cnts[i] = ResolvePutRow(*plan, *decoder, row.time(), data, row.dimensions(),
+                                    keys.data() + i * inner_cnt, ts.data() + i * ts_cnt);
+        if (ref_cnts[i] < 0) {
+            PDLOG(WARNING, "invalid row %d in batch. tid %u pid %u", i, id_, pid_);
+            return false;
+        }
+    }
+    struct PutOp {
+        uint32_t inner_pos;
+        uint32_t seg_idx;
+        int row;
+    };
+    std::vector<PutOp> ops;
+    for (int i = 0; i < rows.size(); i++) {
+        for (uint32_t pos = 0; pos < inner_cnt; pos++) {
+            const std::string* key = keys[i * inner_cnt + pos];
+            if (key != nullptr) {
+                ops.push_back({pos, GetSegIdx(*key), i});
             }
         }
     }
-    if (ts_map.empty()) {
-        return false;
+    // the order of the rows in one segment is kept
+    std::stable_sort(ops.begin(), ops.end(), [](const PutOp& a, const PutOp& b) {
+        return a.inner_pos < b.inner_pos || (a.inner_pos == b.inner_pos && a.seg_idx < b.seg_idx);
+    });
+    std::vector<DataBlock*> blocks(rows.size(), nullptr);
+    for (const auto& op : ops) {
+        DataBlock*& block = blocks[op.row];
+        if (block == nullptr) {
+            const std::string& value = rows.Get(op.row).value();
+            block = segments_[op.inner_pos][op.seg_idx]->AllocDataBlock(ref_cnts[op.row], value.c_str(),
+                                                                         value.length());
+        }
+        PutRow(*plan, op.inner_pos, op.seg_idx, *keys[op.row * inner_cnt + op.inner_pos], ts.data() + op.row * ts_cnt,
+               block);
     }
-    auto* block = new DataBlock(real_ref_cnt, value.c_str(), value.length());
-    for (const auto& kv : inner_index_key_map) {
-        auto inner_index = table_index_.GetInnerIndex(kv.first);
-        bool need_put = false;
-        for (const auto& index_def : inner_index->GetIndex()) {
-            if (index_def->IsReady()) {
-                // TODO(hw): if we don't find this ts(has_found_ts==false), but it's ready, will put too?
-                need_put = true;
-                break;
+    uint64_t byte_size = 0;
+    for (const auto& row : rows) {
+        byte_size += GetRecordSize(row.value().length());
+    }
+    record_cnt_.fetch_add(rows.size(), std::memory_order_relaxed);
+    record_byte_size_.fetch_add(byte_size);
+    *put_cnt = rows.size();
+    return true;
+}
+
+int32_t MemTable::ResolvePutRow(const PutPlan& plan, const codec::RowView& decoder, uint64_t time,
+                                const int8_t* data, const Dimensions& dimensions, const std::string** keys,
+                                uint64_t* ts) {
+    for (uint32_t pos = 0; pos < plan.inner_indexs.size(); pos++) {
+        keys[pos] = nullptr;
+    }
+    int32_t ref_cnt = 0;
+    bool has_ts = false;
+    for (const auto& dimension : dimensions) {
+        int32_t inner_pos = dimension.idx() < plan.inner_pos.size() ? plan.inner_pos[dimension.idx()] : -1;
+        if (inner_pos < 0 || inner_pos >= static_cast<int32_t>(plan.inner_indexs.size())) {
+            PDLOG(WARNING, "invalid dimension. dimension idx %u, tid %u pid %u", dimension.idx(), id_, pid_);
+            return -1;
+        }
+        if (keys[inner_pos] != nullptr) {
+            continue;
+        }
+        const auto& inner_index = plan.inner_indexs[inner_pos];
+        for (uint32_t ts_pos : inner_index.ts_pos) {
+            const auto& ts_col = plan.ts_cols[ts_pos];
+            int64_t cur_ts = 0;
+            if (ts_col->IsAutoGenTs()) {
+                cur_ts = time;
+            } else if (decoder.GetInteger(data, ts_col->GetId(), ts_col->GetType(), &cur_ts) != 0) {
+                PDLOG(WARNING, "get ts failed. tid %u pid %u", id_, pid_);
+                return -1;
             }
+            ts[ts_pos] = cur_ts;
+            has_ts = true;
         }
-        if (need_put) {
-            uint32_t seg_idx = 0;
-            if (seg_cnt_ > 1) {
-                seg_idx = ::openmldb::base::hash(kv.second.data(), kv.second.size(), SEED) % seg_cnt_;
+        uint32_t ready_cnt = 0;
+        for (const auto& index_def : inner_index.indexs) {
+            if (index_def->IsReady()) {
+                ready_cnt++;
             }
-            Segment* segment = segments_[kv.first][seg_idx];
-            segment->Put(::openmldb::base::Slice(kv.second), ts_map, block);
         }
+        if (ready_cnt > 0 && !inner_index.ts_pos.empty()) {
+            keys[inner_pos] = &dimension.key();
+            ref_cnt += ready_cnt;
+        }
+    }
+    if (!has_ts) {
+        return -1;
+    }
+    return ref_cnt;
+}
+
+int32_t MemTable::ResolveRow(const PutPlan& plan, uint64_t time, const std::string& value,
+                             const Dimensions& dimensions, const std::string** keys, uint64_t* ts) {
+    if (dimensions.empty() || value.length() < codec::HEADER_LENGTH) {
+        return -1;
+    }
+    const int8_t* data = reinterpret_cast<const int8_t*>(value.data());
+    auto decoder = GetVersionDecoder(codec::RowView::GetSchemaVersion(data));
+    if (decoder == nullptr) {
+        return -1;
+    }
+    return ResolvePutRow(plan, *decoder, time, data, dimensions, keys, ts);
+}
+
+void MemTable::PutResolvedRow(const PutPlan& plan, const Slice** keys, const uint64_t* ts, int32_t ref_cnt,
+                              const char* data, uint32_t size) {
+    DataBlock* block = nullptr;
+    for (uint32_t pos = 0; pos < plan.inner_indexs.size(); pos++) {
+        if (keys[pos] == nullptr) {
+            continue;
+        }
+        uint32_t seg_idx = GetSegIdx(*keys[pos]);
+        if (block == nullptr) {
+            block = segments_[pos][seg_idx]->AllocDataBlock(ref_cnt, data, size);
+        }
+        PutRow(plan, pos, seg_idx, *keys[pos], ts, block);
+    }
+    if (block == nullptr) {
+        return;
     }
     record_cnt_.fetch_add(1, std::memory_order_relaxed);
-    record_byte_size_.fetch_add(GetRecordSize(value.length()));
-    return true;
+    record_byte_size_.fetch_add(GetRecordSize(size));
+}
+
+void MemTable::PutRow(const PutPlan& plan, uint32_t inner_pos, uint32_t seg_idx, const Slice& key,
+                      const uint64_t* ts, DataBlock* block) {
+    const auto& ts_pos = plan.inner_indexs[inner_pos].ts_pos;
+    uint64_t segment_ts[MAX_INDEX_NUM];
+    for (uint32_t i = 0; i < ts_pos.size(); i++) {
+        segment_ts[i] = ts[ts_pos[i]];
+    }
+    segments_[inner_pos][seg_idx]->Put(key, segment_ts, block);
+}
+
+uint32_t MemTable::GetSegIdx(const Slice& key) const {
+    if (seg_cnt_ > 1) {
+        return ::openmldb::base::hash(key.data(), key.size(), SEED) % seg_cnt_;
+    }
+    return 0;
 }
 
 bool MemTable::Delete(const std::string& pk, uint32_t idx) {
@@ -254,12 +410,56 @@ uint64_t MemTable::Release() {
     return total_cnt;
 }
 
+// the statistics of one round of gc shared by the gc tasks of inner indexes
+struct MemTableGcContext {
+    std::atomic<uint32_t> pending{0};
+    std::atomic<uint64_t> gc_idx_cnt{0};
+    std::atomic<uint64_t> gc_record_cnt{0};
+    std::atomic<uint64_t> gc_record_byte_size{0};
+    std::atomic<uint64_t> cold_idx_cnt{0};
+    // the keys to visit in this gc and the keys visited
+    std::atomic<uint64_t> total_key_cnt{0};
+    std::atomic<uint64_t> visited_key_cnt{0};
+    std::atomic<uint64_t> max_tick_time{0};
+    uint64_t start_time = 0;
+    uint64_t cold_time = 0;
+    uint32_t tick_key_cnt = 0;
+    MemTable::GcExecutor executor;
+    std::function<void()> done;
+};
+
 void MemTable::SchedGc() {
+    // gc all keys of a segment in one tick, the executor runs the tasks in place
+    StartGc([](const std::function<void()>& task, uint32_t) { task(); }, std::function<void()>(), 0);
+}
+
+void MemTable::SchedGc(const GcExecutor& executor, const std::function<void()>& done) {
+    StartGc(executor, done, FLAGS_gc_tick_key_cnt);
+}
+
+void MemTable::StartGc(const GcExecutor& executor, const std::function<void()>& done, uint32_t tick_key_cnt) {
+    if (gc_running_.exchange(true, std::memory_order_acq_rel)) {
+        // the cursors of segments are owned by the running gc
+        PDLOG(INFO, "gc is running, skip it for table %s, tid %u, pid %u", name_.c_str(), id_, pid_);
+        if (done) {
+            done();
+        }
+        return;
+    }
     uint64_t consumed = ::baidu::common::timer::get_micros();
     PDLOG(INFO, "start making gc for table %s, tid %u, pid %u", name_.c_str(), id_, pid_);
     uint64_t gc_idx_cnt = 0;
     uint64_t gc_record_cnt = 0;
     uint64_t gc_record_byte_size = 0;
+    auto ctx = std::make_shared<MemTableGcContext>();
+    ctx->start_time = consumed;
+    ctx->tick_key_cnt = tick_key_cnt;
+    ctx->executor = executor;
+    ctx->done = done;
+    if (FLAGS_cold_tier_age > 0) {
+        ctx->cold_time = ::baidu::common::timer::get_micros() / 1000 - (uint64_t)FLAGS_cold_tier_age * 60 * 1000;
+    }
+    std::vector<std::pair<uint32_t, std::map<uint32_t, TTLSt>>> gc_tasks;
     auto inner_indexs = table_index_.GetAllInnerIndex();
     for (uint32_t i = 0; i < inner_indexs->size(); i++) {
         const std::vector<std::shared_ptr<IndexDef>>& real_index = inner_indexs->at(i)->GetIndex();
@@ -299,29 +499,157 @@ void MemTable::SchedGc() {
         if (deleted_num == real_index.size() || ttl_st_map.empty()) {
             continue;
         }
+        gc_tasks.emplace_back(i, std::move(ttl_st_map));
+    }
+    uint64_t total_key_cnt = 0;
+    for (const auto& gc_task : gc_tasks) {
         for (uint32_t j = 0; j < seg_cnt_; j++) {
-            uint64_t seg_gc_time = ::baidu::common::timer::get_micros() / 1000;
-            Segment* segment = segments_[i][j];
-            segment->IncrGcVersion();
-            segment->GcFreeList(gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
-            if (ttl_st_map.size() == 1) {
-                segment->ExecuteGc(ttl_st_map.begin()->second, gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
-            } else {
-                segment->ExecuteGc(ttl_st_map, gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+            total_key_cnt += segments_[gc_task.first][j]->GetPkCnt();
+        }
+    }
+    ctx->total_key_cnt.store(total_key_cnt, std::memory_order_relaxed);
+    gc_backlog_key_cnt_.store(total_key_cnt, std::memory_order_relaxed);
+    ctx->gc_idx_cnt.fetch_add(gc_idx_cnt, std::memory_order_relaxed);
+    ctx->gc_record_cnt.fetch_add(gc_record_cnt, std::memory_order_relaxed);
+    ctx->gc_record_byte_size.fetch_add(gc_record_byte_size, std::memory_order_relaxed);
+    // one more for the scheduler itself, so the gc will not finish before all tasks are submitted
+    ctx->pending.store(gc_tasks.size() + 1, std::memory_order_relaxed);
+    for (auto& gc_task : gc_tasks) {
+        uint32_t idx = gc_task.first;
+        auto ttl_st_map = std::make_shared<const std::map<uint32_t, TTLSt>>(std::move(gc_task.second));
+        executor([this, ctx, idx, ttl_st_map]() { GcIndex(idx, 0, ttl_st_map, ctx); }, 0);
+    }
+    FinishGc(ctx.get());
+}
+
+void MemTable::GcIndex(uint32_t idx, uint32_t seg_idx,
+                       const std::shared_ptr<const std::map<uint32_t, TTLSt>>& ttl_st_map,
+                       const std::shared_ptr<MemTableGcContext>& ctx) {
+    uint64_t gc_idx_cnt = 0;
+    uint64_t gc_record_cnt = 0;
+    uint64_t gc_record_byte_size = 0;
+    uint64_t cold_idx_cnt = 0;
+    while (seg_idx < seg_cnt_) {
+        uint64_t tick_time = ::baidu::common::timer::get_micros();
+        Segment* segment = segments_[idx][seg_idx];
+        segment->GcFreeList(gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+        uint32_t visited_key_cnt = 0;
+        bool finished = false;
+        if (ttl_st_map->size() == 1) {
+            finished = segment->ExecuteGc(ttl_st_map->begin()->second, ctx->tick_key_cnt, visited_key_cnt, gc_idx_cnt,
+                                          gc_record_cnt, gc_record_byte_size);
+        } else {
+            finished = segment->ExecuteGc(*ttl_st_map, ctx->tick_key_cnt, visited_key_cnt, gc_idx_cnt, gc_record_cnt,
+                                          gc_record_byte_size);
+        }
+        if (finished && ctx->cold_time > 0) {
+            // only the rows of absolute ttl index are moved to cold blocks
+            for (const auto& kv : *ttl_st_map) {
+                if (kv.second.ttl_type != ::openmldb::storage::TTLType::kAbsoluteTime) {
+                    continue;
+                }
+                cold_idx_cnt += ttl_st_map->size() == 1 ? segment->CompactCold(ctx->cold_time)
+                                                        : segment->CompactCold(kv.first, ctx->cold_time);
             }
-            seg_gc_time = ::baidu::common::timer::get_micros() / 1000 - seg_gc_time;
-            PDLOG(INFO, "gc segment[%u][%u] done consumed %lu for table %s tid %u pid %u", i, j, seg_gc_time,
-                  name_.c_str(), id_, pid_);
         }
+        tick_time = ::baidu::common::timer::get_micros() - tick_time;
+        UpdateGcTick(ctx.get(), visited_key_cnt, tick_time);
+        DEBUGLOG("gc segment[%u][%u] tick visited %u keys consumed %lu us for table %s tid %u pid %u", idx, seg_idx,
+                 visited_key_cnt, tick_time, name_.c_str(), id_, pid_);
+        if (finished) {
+            PDLOG(INFO, "gc segment[%u][%u] done for table %s tid %u pid %u", idx, seg_idx, name_.c_str(), id_, pid_);
+            seg_idx++;
+        }
+        if (ctx->tick_key_cnt > 0 && seg_idx < seg_cnt_) {
+            break;
+        }
+    }
+    ctx->gc_idx_cnt.fetch_add(gc_idx_cnt, std::memory_order_relaxed);
+    ctx->gc_record_cnt.fetch_add(gc_record_cnt, std::memory_order_relaxed);
+    ctx->gc_record_byte_size.fetch_add(gc_record_byte_size, std::memory_order_relaxed);
+    ctx->cold_idx_cnt.fetch_add(cold_idx_cnt, std::memory_order_relaxed);
+    if (seg_idx < seg_cnt_) {
+        // yield the gc thread to the other indexes and tables, the next tick goes on from the cursor
+        ctx->executor([this, ctx, idx, seg_idx, ttl_st_map]() { GcIndex(idx, seg_idx, ttl_st_map, ctx); },
+                      FLAGS_gc_tick_interval);
+        return;
+    }
+    FinishGc(ctx.get());
+}
+
+void MemTable::UpdateGcTick(MemTableGcContext* ctx, uint32_t visited_key_cnt, uint64_t tick_time) {
+    uint64_t total_key_cnt = ctx->total_key_cnt.load(std::memory_order_relaxed);
+    uint64_t visited = ctx->visited_key_cnt.fetch_add(visited_key_cnt, std::memory_order_relaxed) + visited_key_cnt;
+    // the keys put during gc are visited too, so the backlog is an estimation
+    gc_backlog_key_cnt_.store(total_key_cnt > visited ? total_key_cnt - visited : 0, std::memory_order_relaxed);
+    gc_tick_cnt_.fetch_add(1, std::memory_order_relaxed);
+    gc_tick_time_.fetch_add(tick_time, std::memory_order_relaxed);
+    uint64_t max_tick_time = ctx->max_tick_time.load(std::memory_order_relaxed);
+    while (tick_time > max_tick_time &&
+           !ctx->max_tick_time.compare_exchange_weak(max_tick_time, tick_time, std::memory_order_relaxed)) {
+    }
+}
+
+void MemTable::FinishGc(MemTableGcContext* ctx) {
+    if (ctx->pending.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return;
     }
-    consumed = ::baidu::common::timer::get_micros() - consumed;
+    uint64_t gc_idx_cnt = ctx->gc_idx_cnt.load(std::memory_order_relaxed);
+    uint64_t gc_record_cnt = ctx->gc_record_cnt.load(std::memory_order_relaxed);
+    uint64_t consumed = ::baidu::common::timer::get_micros() - ctx->start_time;
+    uint64_t max_tick_time = ctx->max_tick_time.load(std::memory_order_relaxed);
     record_cnt_.fetch_sub(gc_record_cnt, std::memory_order_relaxed);
-    record_byte_size_.fetch_sub(gc_record_byte_size, std::memory_order_relaxed);
+    record_byte_size_.fetch_sub(ctx->gc_record_byte_size.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    gc_backlog_key_cnt_.store(0, std::memory_order_relaxed);
+    gc_max_tick_time_.store(max_tick_time, std::memory_order_relaxed);
     PDLOG(INFO,
-          "gc finished, gc_idx_cnt %lu, gc_record_cnt %lu consumed %lu ms for "
-          "table %s tid %u pid %u",
-          gc_idx_cnt, gc_record_cnt, consumed / 1000, name_.c_str(), id_, pid_);
+          "gc finished, gc_idx_cnt %lu, gc_record_cnt %lu, cold_idx_cnt %lu, visited_key_cnt %lu, max_tick_time %lu "
+          "us consumed %lu ms for table %s tid %u pid %u",
+          gc_idx_cnt, gc_record_cnt, ctx->cold_idx_cnt.load(std::memory_order_relaxed),
+          ctx->visited_key_cnt.load(std::memory_order_relaxed), max_tick_time, consumed / 1000, name_.c_str(), id_,
+          pid_);
     UpdateTTL();
+    CheckLatestRing();
+    gc_running_.store(false, std::memory_order_release);
+    if (ctx->done) {
+        ctx->done();
+    }
+}
+
+uint32_t MemTable::GetLatestRingCapacity(const InnerIndexSt& inner_index) {
+    const std::vector<std::shared_ptr<IndexDef>>& real_index = inner_index.GetIndex();
+    if (FLAGS_latest_ring_max_cnt == 0 || real_index.size() != 1 || inner_index.GetTsIdx().size() > 1) {
+        return 0;
+    }
+    auto ttl = real_index[0]->GetTTL();
+    if (ttl->ttl_type != ::openmldb::storage::TTLType::kLatestTime || ttl->lat_ttl == 0 ||
+        ttl->lat_ttl > FLAGS_latest_ring_max_cnt) {
+        return 0;
+    }
+    return ttl->lat_ttl;
+}
+
+void MemTable::CheckLatestRing() {
+    auto inner_indexs = table_index_.GetAllInnerIndex();
+    for (uint32_t i = 0; i < inner_indexs->size(); i++) {
+        if (segments_[i] == NULL) {
+            continue;
+        }
+        uint32_t ring_cap = segments_[i][0]->GetLatestRingCapacity();
+        if (ring_cap == 0) {
+            continue;
+        }
+        // a smaller latest count is applied by gc, otherwise the rows go back to skiplists
+        uint32_t new_cap = GetLatestRingCapacity(*(inner_indexs->at(i)));
+        if (new_cap > 0 && new_cap <= ring_cap) {
+            continue;
+        }
+        for (uint32_t j = 0; j < seg_cnt_; j++) {
+            segments_[i][j]->DisableLatestRing();
+        }
+        PDLOG(INFO, "the ttl of inner index %u is changed, move the rows in ring to skiplist. tid %u pid %u", i, id_,
+              pid_);
+    }
 }
 
 // tll as ms
@@ -805,6 +1133,7 @@ void MemTableKeyIterator::SeekToFirst() {
         pk_it_ = NULL;
     }
     for (seg_idx_ = 0; seg_idx_ < seg_cnt_; seg_idx_++) {
+        ticket_.Pin(segments_[seg_idx_]->GetEpoch());
         pk_it_ = segments_[seg_idx_]->GetKeyEntries()->NewIterator();
         pk_it_->SeekToFirst();
         if (pk_it_->Valid()) return;
@@ -823,6 +1152,7 @@ void MemTableKeyIterator::Seek(const std::string& key) {
         seg_idx_ = ::openmldb::base::hash(key.c_str(), key.length(), SEED) % seg_cnt_;
     }
     Slice spk(key);
+    ticket_.Pin(segments_[seg_idx_]->GetEpoch());
     pk_it_ = segments_[seg_idx_]->GetKeyEntries()->NewIterator();
     pk_it_->Seek(spk);
     if (!pk_it_->Valid()) {
@@ -838,15 +1168,14 @@ bool MemTableKeyIterator::Valid() {
 void MemTableKeyIterator::Next() { NextPK(); }
 
 ::hybridse::vm::RowIterator* MemTableKeyIterator::GetRawValue() {
-    TimeEntries::Iterator* it = NULL;
+    KeyEntryIterator* it = NULL;
     if (segments_[seg_idx_]->GetTsCnt() > 1) {
         KeyEntry* entry = ((KeyEntry**)pk_it_->GetValue())[ts_idx_];  // NOLINT
-        it = entry->entries.NewIterator();
+        it = new KeyEntryIterator(entry);
         ticket_.Push(entry);
     } else {
-        it = ((KeyEntry*)pk_it_->GetValue())  // NOLINT
-                 ->entries.NewIterator();
-        ticket_.Push((KeyEntry*)pk_it_->GetValue());  // NOLINT
+        it = new KeyEntryIterator((KeyEntry*)pk_it_->GetValue());  // NOLINT
+        ticket_.Push((KeyEntry*)pk_it_->GetValue());             // NOLINT
     }
     it->SeekToFirst();
     return new MemTableWindowIterator(it, ttl_type_, expire_time_, expire_cnt_);
@@ -873,6 +1202,7 @@ void MemTableKeyIterator::NextPK() {
             pk_it_ = NULL;
             seg_idx_++;
             if (seg_idx_ < seg_cnt_) {
+                ticket_.Pin(segments_[seg_idx_]->GetEpoch());
                 pk_it_ = segments_[seg_idx_]->GetKeyEntries()->NewIterator();
                 pk_it_->SeekToFirst();
                 if (!pk_it_->Valid()) {
@@ -937,6 +1267,7 @@ void MemTableTraverseIterator::NextPK() {
             pk_it_ = NULL;
             seg_idx_++;
             if (seg_idx_ < seg_cnt_) {
+                ticket_.Pin(segments_[seg_idx_]->GetEpoch());
                 pk_it_ = segments_[seg_idx_]->GetKeyEntries()->NewIterator();
                 pk_it_->SeekToFirst();
                 if (!pk_it_->Valid()) {
@@ -952,12 +1283,11 @@ void MemTableTraverseIterator::NextPK() {
         }
         if (segments_[seg_idx_]->GetTsCnt() > 1) {
             KeyEntry* entry = ((KeyEntry**)pk_it_->GetValue())[0];  // NOLINT
-            it_ = entry->entries.NewIterator();
+            it_ = new KeyEntryIterator(entry);
             ticket_.Push(entry);
         } else {
-            it_ = ((KeyEntry*)pk_it_->GetValue())  // NOLINT
-                      ->entries.NewIterator();
-            ticket_.Push((KeyEntry*)pk_it_->GetValue());  // NOLINT
+            it_ = new KeyEntryIterator((KeyEntry*)pk_it_->GetValue());  // NOLINT
+            ticket_.Push((KeyEntry*)pk_it_->GetValue());              // NOLINT
         }
         it_->SeekToFirst();
         record_idx_ = 1;
@@ -982,17 +1312,17 @@ void MemTableTraverseIterator::Seek(const std::string& key, uint64_t ts) {
         seg_idx_ = ::openmldb::base::hash(key.c_str(), key.length(), SEED) % seg_cnt_;
     }
     Slice spk(key);
+    ticket_.Pin(segments_[seg_idx_]->GetEpoch());
     pk_it_ = segments_[seg_idx_]->GetKeyEntries()->NewIterator();
     pk_it_->Seek(spk);
     if (pk_it_->Valid()) {
         if (segments_[seg_idx_]->GetTsCnt() > 1) {
             KeyEntry* entry = ((KeyEntry**)pk_it_->GetValue())[ts_idx_];  // NOLINT
             ticket_.Push(entry);
-            it_ = entry->entries.NewIterator();
+            it_ = new KeyEntryIterator(entry);
         } else {
-            ticket_.Push((KeyEntry*)pk_it_->GetValue());  // NOLINT
-            it_ = ((KeyEntry*)pk_it_->GetValue())         // NOLINT
-                      ->entries.NewIterator();
+            ticket_.Push((KeyEntry*)pk_it_->GetValue());               // NOLINT
+            it_ = new KeyEntryIterator((KeyEntry*)pk_it_->GetValue());  // NOLINT
         }
         if (spk.compare(pk_it_->GetKey()) != 0 || ts == 0) {
             it_->SeekToFirst();
@@ -1059,17 +1389,17 @@ void MemTableTraverseIterator::SeekToFirst() {
         it_ = NULL;
     }
     for (seg_idx_ = 0; seg_idx_ < seg_cnt_; seg_idx_++) {
+        ticket_.Pin(segments_[seg_idx_]->GetEpoch());
         pk_it_ = segments_[seg_idx_]->GetKeyEntries()->NewIterator();
         pk_it_->SeekToFirst();
         while (pk_it_->Valid()) {
             if (segments_[seg_idx_]->GetTsCnt() > 1) {
                 KeyEntry* entry = ((KeyEntry**)pk_it_->GetValue())[ts_idx_];  // NOLINT
                 ticket_.Push(entry);
-                it_ = entry->entries.NewIterator();
+                it_ = new KeyEntryIterator(entry);
             } else {
-                ticket_.Push((KeyEntry*)pk_it_->GetValue());  // NOLINT
-                it_ = ((KeyEntry*)pk_it_->GetValue())         // NOLINT
-                          ->entries.NewIterator();
+                ticket_.Push((KeyEntry*)pk_it_->GetValue());               // NOLINT
+                it_ = new KeyEntryIterator((KeyEntry*)pk_it_->GetValue());  // NOLINT
             }
             it_->SeekToFirst();
             traverse_cnt_++;
@@ -18,6 +18,7 @@
 #define SRC_STORAGE_MEM_TABLE_H_
 
 #include <atomic>
+#include <functional>
 #include <map>
 #include <memory>
 #include <string>
@@ -38,9 +39,11 @@ namespace storage {
 
 typedef google::protobuf::RepeatedPtrField<::openmldb::api::Dimension> Dimensions;
 
+struct MemTableGcContext;
+
 class MemTableWindowIterator : public ::hybridse::vm::RowIterator {
  public:
-    MemTableWindowIterator(TimeEntries::Iterator* it, ::openmldb::storage::TTLType ttl_type, uint64_t expire_time,
+    MemTableWindowIterator(KeyEntryIterator* it, ::openmldb::storage::TTLType ttl_type, uint64_t expire_time,
                            uint64_t expire_cnt)
         : it_(it), record_idx_(1), expire_value_(expire_time, expire_cnt, ttl_type), row_() {}
 
@@ -74,7 +77,7 @@ class MemTableWindowIterator : public ::hybridse::vm::RowIterator {
     bool IsSeekable() const override { return true; }
 
  private:
-    TimeEntries::Iterator* it_;
+    KeyEntryIterator* it_;
     uint32_t record_idx_;
     TTLSt expire_value_;
     ::hybridse::codec::Row row_;
@@ -108,7 +111,7 @@ class MemTableKeyIterator : public ::hybridse::vm::WindowIterator {
     uint32_t const seg_cnt_;
     uint32_t seg_idx_;
     KeyEntries::Iterator* pk_it_;
-    TimeEntries::Iterator* it_;
+    KeyEntryIterator* it_;
     ::openmldb::storage::TTLType ttl_type_;
     uint64_t expire_time_;
     uint64_t expire_cnt_;
@@ -137,7 +140,7 @@ class MemTableTraverseIterator : public TraverseIterator {
     uint32_t const seg_cnt_;
     uint32_t seg_idx_;
     KeyEntries::Iterator* pk_it_;
-    TimeEntries::Iterator* it_;
+    KeyEntryIterator* it_;
     uint32_t record_idx_;
     uint32_t ts_idx_;
     // uint64_t expire_value_;
@@ -162,6 +165,22 @@ class MemTable : public Table {
 
     bool Put(uint64_t time, const std::string& value, const Dimensions& dimensions) override;
 
+    // all rows are checked before any of them is put, so the batch is put entirely or not at all.
+    // the indexes and the decoders are resolved once for the batch, and the rows are put into
+    // the segments one segment after another
+    bool PutBatch(const PutBatchRows& rows, uint32_t* put_cnt) override;
+
+    std::shared_ptr<const PutPlan> GetPutPlan() const { return table_index_.GetPutPlan(); }
+
+    // resolve a row by plan without putting it, see ResolvePutRow. it's used to save the rows
+    // in a snapshot image, which are put by PutResolvedRow when the table is recovered
+    int32_t ResolveRow(const PutPlan& plan, uint64_t time, const std::string& value, const Dimensions& dimensions,
+                       const std::string** keys, uint64_t* ts);
+
+    // put a row resolved by ResolveRow with a plan of the same layout, the null keys are skipped
+    void PutResolvedRow(const PutPlan& plan, const Slice** keys, const uint64_t* ts, int32_t ref_cnt,
+                        const char* data, uint32_t size);
+
     bool GetBulkLoadInfo(::openmldb::api::BulkLoadInfoResponse* response);
 
     bool BulkLoad(const std::vector<DataBlock*>& data_blocks,
@@ -183,6 +202,20 @@ class MemTable : public Table {
 
     void SchedGc() override;
 
+    // run one task per inner index by executor, so the indexes can be gc concurrently.
+    // if gc_tick_key_cnt is set, a task gc at most gc_tick_key_cnt keys of a segment
+    // and submits the next tick with a delay of gc_tick_interval in millisecond.
+    // done is invoked by the last finished task
+    typedef std::function<void(const std::function<void()>& task, uint32_t delay_ms)> GcExecutor;
+    void SchedGc(const GcExecutor& executor, const std::function<void()>& done);
+
+    // the keys left to visit in the running gc
+    uint64_t GetGcBacklogKeyCnt() const { return gc_backlog_key_cnt_.load(std::memory_order_relaxed); }
+    uint64_t GetGcTickCnt() const { return gc_tick_cnt_.load(std::memory_order_relaxed); }
+    // the total time of gc ticks and the max time of one tick in last gc, in microsecond
+    uint64_t GetGcTickTime() const { return gc_tick_time_.load(std::memory_order_relaxed); }
+    uint64_t GetGcMaxTickTime() const { return gc_max_tick_time_.load(std::memory_order_relaxed); }
+
     int GetCount(uint32_t index, const std::string& pk, uint64_t& count) override;  // NOLINT
 
     uint64_t GetRecordIdxCnt() override;
@@ -220,6 +253,32 @@ class MemTable : public Table {
  private:
     bool CheckAbsolute(const TTLSt& ttl, uint64_t ts);
 
+    // resolve the keys and the ts of a row by the put plan. keys is indexed by inner index position
+    // and it's null if the row is not put into the inner index, ts is indexed by the ts column
+    // position of plan. return the count of the ready indexes of the row, -1 if the row is invalid
+    int32_t ResolvePutRow(const PutPlan& plan, const codec::RowView& decoder, uint64_t time, const int8_t* data,
+                          const Dimensions& dimensions, const std::string** keys, uint64_t* ts);
+
+    void PutRow(const PutPlan& plan, uint32_t inner_pos, uint32_t seg_idx, const Slice& key, const uint64_t* ts,
+                DataBlock* block);
+
+    uint32_t GetSegIdx(const Slice& key) const;
+
+    void StartGc(const GcExecutor& executor, const std::function<void()>& done, uint32_t tick_key_cnt);
+
+    // gc the segments of index idx from seg_idx, it returns after one tick if incremental gc is enabled
+    void GcIndex(uint32_t idx, uint32_t seg_idx, const std::shared_ptr<const std::map<uint32_t, TTLSt>>& ttl_st_map,
+                 const std::shared_ptr<MemTableGcContext>& ctx);
+
+    void UpdateGcTick(MemTableGcContext* ctx, uint32_t visited_key_cnt, uint64_t tick_time);
+
+    // return the ring capacity of the latest-N index, 0 means the rows are kept in skiplists
+    uint32_t GetLatestRingCapacity(const InnerIndexSt& inner_index);
+    // the rings of the index whose ttl is changed are disabled
+    void CheckLatestRing();
+
+    void FinishGc(MemTableGcContext* ctx);
+
     bool CheckLatest(uint32_t index_id, const std::string& key, uint64_t ts);
 
  private:
@@ -231,6 +290,12 @@ class MemTable : public Table {
     bool segment_released_;
     std::atomic<uint64_t> record_byte_size_;
     uint32_t key_entry_max_height_;
+    // only one gc runs at a time
+    std::atomic<bool> gc_running_;
+    std::atomic<uint64_t> gc_backlog_key_cnt_;
+    std::atomic<uint64_t> gc_tick_cnt_;
+    std::atomic<uint64_t> gc_tick_time_;
+    std::atomic<uint64_t> gc_max_tick_time_;
 };
 
 }  // namespace storage
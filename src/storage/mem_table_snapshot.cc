@@ -23,7 +23,9 @@
 #include <snappy.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <set>
+#include <thread>  // NOLINT
 #include <utility>
 
 #include "base/count_down_latch.h"
@@ -53,6 +55,9 @@ DECLARE_uint32(load_table_batch);
 DECLARE_uint32(load_table_thread_num);
 DECLARE_uint32(load_table_queue_size);
 DECLARE_string(snapshot_compression);
+DECLARE_bool(snapshot_image);
+DECLARE_uint32(snapshot_part_num);
+DECLARE_uint32(snapshot_delta_max_num);
 
 namespace openmldb {
 namespace storage {
@@ -60,6 +65,59 @@ namespace storage {
 const std::string SNAPSHOT_SUBFIX = ".sdb";  // NOLINT
 const uint32_t KEY_NUM_DISPLAY = 1000000;    // NOLINT
 const std::string MANIFEST = "MANIFEST";     // NOLINT
+const std::string IMAGE_SUBFIX = ".img";     // NOLINT
+const uint32_t SNAPSHOT_PART_SEED = 0xe17a1465;
+// the records of binlog are dispatched to the parts in batches
+const uint32_t SNAPSHOT_PART_BATCH = 1024;
+const uint32_t SNAPSHOT_PART_QUEUE_SIZE = 8;
+
+class MemTableSnapshot::SnapshotReader {
+ public:
+    SnapshotReader(const std::string& snapshot_path, const std::vector<std::string>& snapshot_names)
+        : snapshot_path_(snapshot_path), snapshot_names_(snapshot_names), idx_(0), seq_file_(NULL), reader_(NULL) {}
+    ~SnapshotReader() { Close(); }
+    SnapshotReader(const SnapshotReader&) = delete;
+    SnapshotReader& operator=(const SnapshotReader&) = delete;
+
+    // return Eof after all records of the last file are read
+    ::openmldb::log::Status ReadRecord(::openmldb::base::Slice* record, std::string* scratch) {
+        while (true) {
+            if (reader_ == NULL) {
+                if (idx_ >= snapshot_names_.size()) {
+                    return ::openmldb::log::Status::Eof();
+                }
+                std::string path = snapshot_path_ + snapshot_names_[idx_++];
+                FILE* fd = fopen(path.c_str(), "rb");
+                if (fd == NULL) {
+                    PDLOG(WARNING, "fail to open path %s for error %s", path.c_str(), strerror(errno));
+                    return ::openmldb::log::Status::IOError("fail to open file", path);
+                }
+                seq_file_ = ::openmldb::log::NewSeqFile(path, fd);
+                reader_ = new ::openmldb::log::Reader(seq_file_, NULL, false, 0, IsCompressed(path));
+            }
+            ::openmldb::log::Status status = reader_->ReadRecord(record, scratch);
+            if (!status.IsEof()) {
+                return status;
+            }
+            Close();
+        }
+    }
+
+ private:
+    void Close() {
+        delete reader_;
+        reader_ = NULL;
+        // will close the fd
+        delete seq_file_;
+        seq_file_ = NULL;
+    }
+
+    std::string snapshot_path_;
+    std::vector<std::string> snapshot_names_;
+    uint32_t idx_;
+    ::openmldb::log::SequentialFile* seq_file_;
+    ::openmldb::log::Reader* reader_;
+};
 
 MemTableSnapshot::MemTableSnapshot(uint32_t tid, uint32_t pid, LogParts* log_part, const std::string& db_root_path)
     : Snapshot(tid, pid), log_part_(log_part), db_root_path_(db_root_path) {}
@@ -86,94 +144,173 @@ bool MemTableSnapshot::Recover(std::shared_ptr<Table> table, uint64_t& latest_of
         return false;
     }
     if (ret == 0) {
-        RecoverFromSnapshot(manifest.name(), manifest.count(), table);
+        if (!manifest.has_image_name() || !RecoverFromImage(manifest.image_name(), manifest.count(), table)) {
+            RecoverFromSnapshot(manifest, table);
+        }
+        RecoverFromDeltas(manifest, table);
         latest_offset = manifest.offset();
         offset_ = latest_offset;
     }
     return true;
 }
 
-void MemTableSnapshot::RecoverFromSnapshot(const std::string& snapshot_name, uint64_t expect_cnt,
-                                           std::shared_ptr<Table> table) {
-    std::string full_path = snapshot_path_ + "/" + snapshot_name;
+void MemTableSnapshot::RecoverFromSnapshot(const ::openmldb::api::Manifest& manifest, std::shared_ptr<Table> table) {
+    std::vector<std::string> snapshot_names = GetDataFiles(manifest);
     std::atomic<uint64_t> g_succ_cnt(0);
     std::atomic<uint64_t> g_failed_cnt(0);
-    RecoverSingleSnapshot(full_path, table, &g_succ_cnt, &g_failed_cnt);
+    {
+        // the data files are read by different threads, and the records of them are put by the same pool
+        ::openmldb::base::TaskPool load_pool(FLAGS_load_table_thread_num, FLAGS_load_table_batch);
+        std::atomic<uint32_t> file_idx(0);
+        auto read_files = [&]() {
+            for (uint32_t idx = file_idx.fetch_add(1); idx < snapshot_names.size(); idx = file_idx.fetch_add(1)) {
+                RecoverSingleSnapshot(snapshot_path_ + snapshot_names[idx], table, &load_pool, &g_succ_cnt,
+                                      &g_failed_cnt);
+            }
+        };
+        uint32_t reader_num = std::min(static_cast<uint32_t>(snapshot_names.size()), FLAGS_load_table_thread_num);
+        std::vector<std::thread> readers;
+        for (uint32_t i = 1; i < reader_num; i++) {
+            readers.emplace_back(read_files);
+        }
+        read_files();
+        for (auto& reader : readers) {
+            reader.join();
+        }
+        load_pool.Stop();
+    }
     PDLOG(INFO, "[Recover] progress done stat: success count %lu, failed count %lu",
           g_succ_cnt.load(std::memory_order_relaxed), g_failed_cnt.load(std::memory_order_relaxed));
-    if (g_succ_cnt.load(std::memory_order_relaxed) != expect_cnt) {
-        PDLOG(WARNING, "snapshot %s , expect cnt %lu but succ_cnt %lu", snapshot_name.c_str(), expect_cnt,
+    if (g_succ_cnt.load(std::memory_order_relaxed) != manifest.count()) {
+        PDLOG(WARNING, "snapshot %s , expect cnt %lu but succ_cnt %lu", manifest.name().c_str(), manifest.count(),
               g_succ_cnt.load(std::memory_order_relaxed));
     }
 }
 
-void MemTableSnapshot::RecoverSingleSnapshot(const std::string& path, std::shared_ptr<Table> table,
-                                             std::atomic<uint64_t>* g_succ_cnt, std::atomic<uint64_t>* g_failed_cnt) {
-    ::openmldb::base::TaskPool load_pool_(FLAGS_load_table_thread_num, FLAGS_load_table_batch);
-    std::atomic<uint64_t> succ_cnt, failed_cnt;
-    succ_cnt = failed_cnt = 0;
-
-    do {
-        if (table == NULL) {
-            PDLOG(WARNING, "table input is NULL");
+void MemTableSnapshot::RecoverFromDeltas(const ::openmldb::api::Manifest& manifest, std::shared_ptr<Table> table) {
+    if (manifest.deltas_size() == 0) {
+        return;
+    }
+    SnapshotReader reader(snapshot_path_, GetDeltaFiles(manifest));
+    std::string buffer;
+    ::openmldb::api::LogEntry entry;
+    uint64_t succ_cnt = 0;
+    uint64_t failed_cnt = 0;
+    while (true) {
+        buffer.clear();
+        ::openmldb::base::Slice record;
+        ::openmldb::log::Status status = reader.ReadRecord(&record, &buffer);
+        if (status.IsEof()) {
             break;
         }
-        FILE* fd = fopen(path.c_str(), "rb");
-        if (fd == NULL) {
-            PDLOG(WARNING, "fail to open path %s for error %s", path.c_str(), strerror(errno));
-            break;
+        if (!status.ok()) {
+            PDLOG(WARNING, "fail to read record for tid %u, pid %u with error %s", tid_, pid_,
+                  status.ToString().c_str());
+            failed_cnt++;
+            continue;
         }
-        bool compressed = IsCompressed(path);
-        ::openmldb::log::SequentialFile* seq_file = ::openmldb::log::NewSeqFile(path, fd);
-        ::openmldb::log::Reader reader(seq_file, NULL, false, 0, compressed);
-        std::string buffer;
-        // second
-        uint64_t consumed = ::baidu::common::timer::now_time();
-        std::vector<std::string*> recordPtr;
-        recordPtr.reserve(FLAGS_load_table_batch);
-
-        while (true) {
-            buffer.clear();
-            ::openmldb::base::Slice record;
-            ::openmldb::log::Status status = reader.ReadRecord(&record, &buffer);
-            if (status.IsWaitRecord() || status.IsEof()) {
-                consumed = ::baidu::common::timer::now_time() - consumed;
-                PDLOG(INFO,
-                      "read path %s for table tid %u pid %u completed, "
-                      "succ_cnt %lu, failed_cnt %lu, consumed %us",
-                      path.c_str(), tid_, pid_, succ_cnt.load(std::memory_order_relaxed),
-                      failed_cnt.load(std::memory_order_relaxed), consumed);
-                break;
-            }
-
-            if (!status.ok()) {
-                PDLOG(WARNING, "fail to read record for tid %u, pid %u with error %s", tid_, pid_,
-                      status.ToString().c_str());
-                failed_cnt.fetch_add(1, std::memory_order_relaxed);
-                continue;
-            }
-            std::string* sp = new std::string(record.data(), record.size());
-            recordPtr.push_back(sp);
-            if (recordPtr.size() >= FLAGS_load_table_batch) {
-                load_pool_.AddTask(
-                    boost::bind(&MemTableSnapshot::Put, this, path, table, recordPtr, &succ_cnt, &failed_cnt));
-                recordPtr.clear();
+        if (!entry.ParseFromString(record.ToString())) {
+            PDLOG(WARNING, "fail to parse record for tid %u, pid %u", tid_, pid_);
+            failed_cnt++;
+            continue;
+        }
+        if (entry.has_method_type() && entry.method_type() == ::openmldb::api::MethodType::kDelete) {
+            if (entry.dimensions_size() == 0) {
+                PDLOG(WARNING, "no dimesion. tid %u pid %u offset %lu", tid_, pid_, entry.log_index());
+            } else {
+                table->Delete(entry.dimensions(0).key(), entry.dimensions(0).idx());
             }
+        } else {
+            table->Put(entry);
         }
-        if (recordPtr.size() > 0) {
-            load_pool_.AddTask(
-                boost::bind(&MemTableSnapshot::Put, this, path, table, recordPtr, &succ_cnt, &failed_cnt));
+        succ_cnt++;
+    }
+    PDLOG(INFO, "[Recover] load %d delta snapshots done: success count %lu, failed count %lu. tid %u pid %u",
+          manifest.deltas_size(), succ_cnt, failed_cnt, tid_, pid_);
+}
+
+bool MemTableSnapshot::RecoverFromImage(const std::string& image_name, uint64_t expect_cnt,
+                                        std::shared_ptr<Table> table) {
+    std::shared_ptr<MemTable> mem_table = std::dynamic_pointer_cast<MemTable>(table);
+    std::string full_path = snapshot_path_ + image_name;
+    if (!mem_table || !::openmldb::base::IsExists(full_path)) {
+        return false;
+    }
+    std::atomic<uint64_t> succ_cnt(0);
+    std::atomic<uint64_t> failed_cnt(0);
+    uint64_t start_time = ::baidu::common::timer::get_micros();
+    if (!LoadSnapshotImage(full_path, mem_table, expect_cnt, FLAGS_load_table_thread_num, &succ_cnt, &failed_cnt)) {
+        PDLOG(WARNING, "fail to load image %s, recover from snapshot. tid %u pid %u", image_name.c_str(), tid_, pid_);
+        return false;
+    }
+    PDLOG(INFO, "[Recover] load image %s done: success count %lu, failed count %lu, consumed %lu ms. tid %u pid %u",
+          image_name.c_str(), succ_cnt.load(), failed_cnt.load(),
+          (::baidu::common::timer::get_micros() - start_time) / 1000, tid_, pid_);
+    // the count of the image is checked before any row is put, so it can only be wrong here if
+    // the image is changed while it's loaded
+    if (succ_cnt.load() + failed_cnt.load() != expect_cnt) {
+        PDLOG(ERROR, "image %s, expect cnt %lu but load cnt %lu. tid %u pid %u", image_name.c_str(), expect_cnt,
+              succ_cnt.load() + failed_cnt.load(), tid_, pid_);
+        return false;
+    }
+    return true;
+}
+
+void MemTableSnapshot::RecoverSingleSnapshot(const std::string& path, std::shared_ptr<Table> table,
+                                             ::openmldb::base::TaskPool* load_pool,
+                                             std::atomic<uint64_t>* g_succ_cnt, std::atomic<uint64_t>* g_failed_cnt) {
+    if (table == NULL) {
+        PDLOG(WARNING, "table input is NULL");
+        return;
+    }
+    FILE* fd = fopen(path.c_str(), "rb");
+    if (fd == NULL) {
+        PDLOG(WARNING, "fail to open path %s for error %s", path.c_str(), strerror(errno));
+        return;
+    }
+    bool compressed = IsCompressed(path);
+    ::openmldb::log::SequentialFile* seq_file = ::openmldb::log::NewSeqFile(path, fd);
+    ::openmldb::log::Reader reader(seq_file, NULL, false, 0, compressed);
+    std::string buffer;
+    // second
+    uint64_t consumed = ::baidu::common::timer::now_time();
+    uint64_t read_cnt = 0;
+    std::vector<std::string*> recordPtr;
+    recordPtr.reserve(FLAGS_load_table_batch);
+
+    while (true) {
+        buffer.clear();
+        ::openmldb::base::Slice record;
+        ::openmldb::log::Status status = reader.ReadRecord(&record, &buffer);
+        if (status.IsWaitRecord() || status.IsEof()) {
+            consumed = ::baidu::common::timer::now_time() - consumed;
+            PDLOG(INFO,
+                  "read path %s for table tid %u pid %u completed, "
+                  "read_cnt %lu, consumed %us",
+                  path.c_str(), tid_, pid_, read_cnt, consumed);
+            break;
         }
-        // will close the fd atomic
-        delete seq_file;
-        if (g_succ_cnt) {
-            g_succ_cnt->fetch_add(succ_cnt, std::memory_order_relaxed);
+
+        if (!status.ok()) {
+            PDLOG(WARNING, "fail to read record for tid %u, pid %u with error %s", tid_, pid_,
+                  status.ToString().c_str());
+            g_failed_cnt->fetch_add(1, std::memory_order_relaxed);
+            continue;
         }
-        if (g_failed_cnt) {
-            g_failed_cnt->fetch_add(failed_cnt, std::memory_order_relaxed);
+        read_cnt++;
+        std::string* sp = new std::string(record.data(), record.size());
+        recordPtr.push_back(sp);
+        if (recordPtr.size() >= FLAGS_load_table_batch) {
+            load_pool->AddTask(
+                boost::bind(&MemTableSnapshot::Put, this, path, table, recordPtr, g_succ_cnt, g_failed_cnt));
+            recordPtr.clear();
         }
-    } while (false);
-    load_pool_.Stop();
+    }
+    if (recordPtr.size() > 0) {
+        load_pool->AddTask(boost::bind(&MemTableSnapshot::Put, this, path, table, recordPtr, g_succ_cnt, g_failed_cnt));
+    }
+    // will close the fd atomic
+    delete seq_file;
 }
 
 void MemTableSnapshot::Put(std::string& path, std::shared_ptr<Table>& table, std::vector<std::string*> recordPtr,
@@ -196,29 +333,17 @@ void MemTableSnapshot::Put(std::string& path, std::shared_ptr<Table>& table, std
     }
 }
 
-int MemTableSnapshot::TTLSnapshot(std::shared_ptr<Table> table, const ::openmldb::api::Manifest& manifest,
-                                  WriteHandle* wh, uint64_t& count, uint64_t& expired_key_num,
-                                  uint64_t& deleted_key_num) {
-    std::string full_path = snapshot_path_ + manifest.name();
-    FILE* fd = fopen(full_path.c_str(), "rb");
-    if (fd == NULL) {
-        PDLOG(WARNING, "fail to open path %s for error %s", full_path.c_str(), strerror(errno));
-        return -1;
+void MemTableSnapshot::TTLSnapshot(std::shared_ptr<Table> table, const std::string& snapshot_name,
+                                   const std::set<uint32_t>* deleted_index, SnapshotPart* part,
+                                   SnapshotImageWriter* image) {
+    if (part->has_error) {
+        return;
     }
-    bool compressed = IsCompressed(full_path);
-    ::openmldb::log::SequentialFile* seq_file = ::openmldb::log::NewSeqFile(manifest.name(), fd);
-    ::openmldb::log::Reader reader(seq_file, NULL, false, 0, compressed);
-
+    SnapshotReader reader(snapshot_path_, {snapshot_name});
     std::string buffer;
     std::string tmp_buf;
     ::openmldb::api::LogEntry entry;
-    bool has_error = false;
-    std::set<uint32_t> deleted_index;
-    for (const auto& it : table->GetAllIndex()) {
-        if (it->GetStatus() != ::openmldb::storage::IndexStatus::kReady) {
-            deleted_index.insert(it->GetId());
-        }
-    }
+    uint64_t read_cnt = 0;
     while (true) {
         ::openmldb::base::Slice record;
         ::openmldb::log::Status status = reader.ReadRecord(&record, &buffer);
@@ -228,50 +353,89 @@ int MemTableSnapshot::TTLSnapshot(std::shared_ptr<Table> table, const ::openmldb
         if (!status.ok()) {
             PDLOG(WARNING, "fail to read record for tid %u, pid %u with error %s", tid_, pid_,
                   status.ToString().c_str());
-            has_error = true;
+            part->has_error = true;
             break;
         }
         if (!entry.ParseFromString(record.ToString())) {
             PDLOG(WARNING, "fail parse record for tid %u, pid %u with value %s", tid_, pid_,
                   ::openmldb::base::DebugString(record.ToString()).c_str());
-            has_error = true;
+            part->has_error = true;
             break;
         }
-        int ret = RemoveDeletedKey(entry, deleted_index, &tmp_buf);
-        if (ret == 1) {
-            deleted_key_num++;
-            continue;
-        } else if (ret == 2) {
-            record.reset(tmp_buf.data(), tmp_buf.size());
-        }
-        if (table->IsExpire(entry)) {
-            expired_key_num++;
-            continue;
-        }
-        status = wh->Write(record);
-        if (!status.ok()) {
-            PDLOG(WARNING, "fail to write snapshot. status[%s]", status.ToString().c_str());
-            has_error = true;
+        read_cnt++;
+        if (!WriteSnapshotRecord(table, entry, record, *deleted_index, part, image, &tmp_buf)) {
             break;
         }
-        if ((count + expired_key_num + deleted_key_num) % KEY_NUM_DISPLAY == 0) {
-            PDLOG(INFO, "tackled key num[%lu] total[%lu]", count + expired_key_num, manifest.count());
+    }
+    part->read_cnt += read_cnt;
+    PDLOG(INFO, "load snapshot %s to %s done. load key num[%lu]. tid %u pid %u", snapshot_name.c_str(),
+          part->name.c_str(), read_cnt, tid_, pid_);
+}
+
+void MemTableSnapshot::WriteSnapshotPart(std::shared_ptr<Table> table, std::vector<SnapshotRecord*> records,
+                                         const std::set<uint32_t>* deleted_index, SnapshotPart* part,
+                                         SnapshotImageWriter* image) {
+    std::string tmp_buf;
+    for (SnapshotRecord* record : records) {
+        if (!part->has_error) {
+            WriteSnapshotRecord(table, record->entry, ::openmldb::base::Slice(record->data), *deleted_index, part,
+                                image, &tmp_buf);
         }
-        count++;
+        delete record;
     }
-    delete seq_file;
-    if (expired_key_num + count + deleted_key_num != manifest.count()) {
-        PDLOG(WARNING,
-              "key num not match! total key num[%lu] load key num[%lu] ttl key "
-              "num[%lu]",
-              manifest.count(), count, expired_key_num);
-        has_error = true;
+}
+
+bool MemTableSnapshot::WriteSnapshotRecord(const std::shared_ptr<Table>& table, const ::openmldb::api::LogEntry& entry,
+                                           ::openmldb::base::Slice record, const std::set<uint32_t>& deleted_index,
+                                           SnapshotPart* part, SnapshotImageWriter* image, std::string* tmp_buf) {
+    int ret = RemoveDeletedKey(entry, deleted_index, tmp_buf);
+    if (ret == 1) {
+        part->deleted_key_num++;
+        return true;
+    } else if (ret == 2) {
+        record.reset(tmp_buf->data(), tmp_buf->size());
     }
-    if (has_error) {
-        return -1;
+    if (table->IsExpire(entry)) {
+        part->expired_key_num++;
+        return true;
+    }
+    ::openmldb::log::Status status = part->wh->Write(record);
+    if (!status.ok()) {
+        PDLOG(WARNING, "fail to write snapshot %s. status[%s]", part->name.c_str(), status.ToString().c_str());
+        part->has_error = true;
+        return false;
+    }
+    AppendImage(image, entry, ret == 2 ? tmp_buf : NULL);
+    part->count++;
+    if ((part->count + part->expired_key_num + part->deleted_key_num) % KEY_NUM_DISPLAY == 0) {
+        PDLOG(INFO, "snapshot %s has write key num[%lu] expired key num[%lu]", part->name.c_str(), part->count,
+              part->expired_key_num);
+    }
+    return true;
+}
+
+bool MemTableSnapshot::CollectDeltaDeletedKey(const ::openmldb::api::Manifest& manifest) {
+    SnapshotReader reader(snapshot_path_, GetDeltaFiles(manifest));
+    std::string buffer;
+    ::openmldb::api::LogEntry entry;
+    while (true) {
+        ::openmldb::base::Slice record;
+        ::openmldb::log::Status status = reader.ReadRecord(&record, &buffer);
+        if (status.IsEof()) {
+            return true;
+        }
+        if (!status.ok() || !entry.ParseFromString(record.ToString())) {
+            PDLOG(WARNING, "fail to read delta snapshot. status %s tid %u pid %u", status.ToString().c_str(), tid_,
+                  pid_);
+            return false;
+        }
+        if (entry.has_method_type() && entry.method_type() == ::openmldb::api::MethodType::kDelete &&
+            entry.dimensions_size() > 0) {
+            std::string combined_key = entry.dimensions(0).key() + "|" + std::to_string(entry.dimensions(0).idx());
+            uint64_t& offset = deleted_keys_[combined_key];
+            offset = std::max(offset, entry.log_index());
+        }
     }
-    PDLOG(INFO, "load snapshot success. load key num[%lu] ttl key num[%lu]", count, expired_key_num);
-    return 0;
 }
 
 uint64_t MemTableSnapshot::CollectDeletedKey(uint64_t end_offset) {
@@ -353,56 +517,49 @@ int MemTableSnapshot::MakeSnapshot(std::shared_ptr<Table> table, uint64_t& out_o
         return -1;
     }
     making_snapshot_.store(true, std::memory_order_release);
-    std::string now_time = ::openmldb::base::GetNowTime();
-    std::string snapshot_name = now_time.substr(0, now_time.length() - 2) + ".sdb";
-    if (FLAGS_snapshot_compression != "off") {
-        snapshot_name.append(".");
-        snapshot_name.append(FLAGS_snapshot_compression);
+    ::openmldb::api::Manifest manifest;
+    int ret = 0;
+    if (FLAGS_snapshot_delta_max_num > 0 && GetLocalManifest(snapshot_path_ + MANIFEST, manifest) == 0 &&
+        static_cast<uint32_t>(manifest.deltas_size()) < FLAGS_snapshot_delta_max_num) {
+        ret = MakeDeltaSnapshot(table, manifest, &out_offset, end_offset);
+    } else {
+        // the delta snapshots are merged into the new full snapshot
+        ret = MakeFullSnapshot(table, &out_offset, end_offset, term);
     }
-    std::string snapshot_name_tmp = snapshot_name + ".tmp";
-    std::string full_path = snapshot_path_ + snapshot_name;
-    std::string tmp_file_path = snapshot_path_ + snapshot_name_tmp;
-    FILE* fd = fopen(tmp_file_path.c_str(), "ab+");
+    making_snapshot_.store(false, std::memory_order_release);
+    return ret;
+}
+
+int MemTableSnapshot::MergeDeltaSnapshot(std::shared_ptr<Table> table) {
+    ::openmldb::api::Manifest manifest;
+    if (GetLocalManifest(snapshot_path_ + MANIFEST, manifest) != 0 || manifest.deltas_size() == 0) {
+        return 0;
+    }
+    uint64_t out_offset = 0;
+    return MakeFullSnapshot(table, &out_offset, 0, 0);
+}
+
+int MemTableSnapshot::MakeDeltaSnapshot(std::shared_ptr<Table> table, const ::openmldb::api::Manifest& manifest,
+                                        uint64_t* out_offset, uint64_t end_offset) {
+    std::string compression_suffix = FLAGS_snapshot_compression == "off" ? "" : "." + FLAGS_snapshot_compression;
+    std::string tmp_name = "delta" + SNAPSHOT_SUBFIX + compression_suffix + ".tmp";
+    std::string tmp_file_path = snapshot_path_ + tmp_name;
+    FILE* fd = fopen(tmp_file_path.c_str(), "wb");
     if (fd == NULL) {
         PDLOG(WARNING, "fail to create file %s", tmp_file_path.c_str());
-        making_snapshot_.store(false, std::memory_order_release);
         return -1;
     }
-    uint64_t collected_offset = CollectDeletedKey(end_offset);
     uint64_t start_time = ::baidu::common::timer::now_time();
-    WriteHandle* wh = new WriteHandle(FLAGS_snapshot_compression, snapshot_name_tmp, fd);
-    ::openmldb::api::Manifest manifest;
-    bool has_error = false;
-    uint64_t write_count = 0;
-    uint64_t expired_key_num = 0;
-    uint64_t deleted_key_num = 0;
-    uint64_t last_term = term;
-    int result = GetLocalManifest(snapshot_path_ + MANIFEST, manifest);
-    if (result == 0) {
-        // filter old snapshot
-        if (TTLSnapshot(table, manifest, wh, write_count, expired_key_num, deleted_key_num) < 0) {
-            has_error = true;
-        }
-        last_term = manifest.term();
-        DEBUGLOG("old manifest term is %lu", last_term);
-    } else if (result < 0) {
-        // parse manifest error
-        has_error = true;
-    }
-
-    // get deleted index
-    std::set<uint32_t> deleted_index;
-    for (const auto& it : table->GetAllIndex()) {
-        if (it->GetStatus() == ::openmldb::storage::IndexStatus::kDeleted) {
-            deleted_index.insert(it->GetId());
-        }
-    }
+    WriteHandle* wh = new WriteHandle(FLAGS_snapshot_compression, tmp_name, fd);
     ::openmldb::log::LogReader log_reader(log_part_, log_path_, false);
     log_reader.SetOffset(offset_);
     uint64_t cur_offset = offset_;
+    uint64_t last_term = manifest.term();
+    uint64_t write_count = 0;
+    bool has_error = false;
     std::string buffer;
-    std::string tmp_buf;
-    while (!has_error && cur_offset < collected_offset) {
+    // the records since the last snapshot are kept as they are, including the deletions
+    while (end_offset == 0 || cur_offset < end_offset) {
         buffer.clear();
         ::openmldb::base::Slice record;
         ::openmldb::log::Status status = log_reader.ReadNextRecord(&record, &buffer);
@@ -422,24 +579,10 @@ int MemTableSnapshot::MakeSnapshot(std::shared_ptr<Table> table, uint64_t& out_o
                 continue;
             }
             cur_offset = entry.log_index();
-            if (entry.has_method_type() && entry.method_type() == ::openmldb::api::MethodType::kDelete) {
-                continue;
-            }
             if (entry.has_term()) {
                 last_term = entry.term();
             }
-            int ret = RemoveDeletedKey(entry, deleted_index, &tmp_buf);
-            if (ret == 1) {
-                deleted_key_num++;
-                continue;
-            } else if (ret == 2) {
-                record.reset(tmp_buf.data(), tmp_buf.size());
-            }
-            if (table->IsExpire(entry)) {
-                expired_key_num++;
-                continue;
-            }
-            ::openmldb::log::Status status = wh->Write(record);
+            status = wh->Write(record);
             if (!status.ok()) {
                 PDLOG(WARNING, "fail to write snapshot. path[%s] status[%s]", tmp_file_path.c_str(),
                       status.ToString().c_str());
@@ -447,9 +590,6 @@ int MemTableSnapshot::MakeSnapshot(std::shared_ptr<Table> table, uint64_t& out_o
                 break;
             }
             write_count++;
-            if ((write_count + expired_key_num + deleted_key_num) % KEY_NUM_DISPLAY == 0) {
-                PDLOG(INFO, "has write key num[%lu] expired key num[%lu]", write_count, expired_key_num);
-            }
         } else if (status.IsEof()) {
             continue;
         } else if (status.IsWaitRecord()) {
@@ -458,10 +598,6 @@ int MemTableSnapshot::MakeSnapshot(std::shared_ptr<Table> table, uint64_t& out_o
             // judge end_log_index greater than cur_log_index
             if (end_log_index >= 0 && end_log_index > cur_log_index) {
                 log_reader.RollRLogFile();
-                PDLOG(WARNING,
-                      "read new binlog file. tid[%u] pid[%u] cur_log_index[%d] "
-                      "end_log_index[%d] cur_offset[%lu]",
-                      tid_, pid_, cur_log_index, end_log_index, cur_offset);
                 continue;
             }
             DEBUGLOG("has read all record!");
@@ -472,48 +608,337 @@ int MemTableSnapshot::MakeSnapshot(std::shared_ptr<Table> table, uint64_t& out_o
             break;
         }
     }
-    if (wh != NULL) {
-        wh->EndLog();
-        delete wh;
-        wh = NULL;
+    wh->EndLog();
+    delete wh;
+    if (has_error || write_count == 0) {
+        unlink(tmp_file_path.c_str());
+        *out_offset = offset_;
+        return has_error ? -1 : 0;
     }
-    int ret = 0;
-    if (has_error) {
+    std::string delta_name = "delta_" + std::to_string(cur_offset) + SNAPSHOT_SUBFIX + compression_suffix;
+    if (rename(tmp_file_path.c_str(), (snapshot_path_ + delta_name).c_str()) != 0) {
+        PDLOG(WARNING, "rename[%s] failed", delta_name.c_str());
         unlink(tmp_file_path.c_str());
-        ret = -1;
-    } else {
-        if (rename(tmp_file_path.c_str(), full_path.c_str()) == 0) {
-            if (GenManifest(snapshot_name, write_count, cur_offset, last_term) == 0) {
-                // delete old snapshot
-                if (manifest.has_name() && manifest.name() != snapshot_name) {
-                    DEBUGLOG("old snapshot[%s] has deleted", manifest.name().c_str());
-                    unlink((snapshot_path_ + manifest.name()).c_str());
+        return -1;
+    }
+    ::openmldb::api::Manifest new_manifest(manifest);
+    new_manifest.set_offset(cur_offset);
+    new_manifest.set_term(last_term);
+    ::openmldb::api::SnapshotDelta* delta = new_manifest.add_deltas();
+    delta->set_name(delta_name);
+    delta->set_count(write_count);
+    delta->set_offset(cur_offset);
+    if (WriteManifest(new_manifest) != 0) {
+        PDLOG(WARNING, "WriteManifest failed. delete snapshot file[%s]", delta_name.c_str());
+        unlink((snapshot_path_ + delta_name).c_str());
+        return -1;
+    }
+    PDLOG(INFO, "make delta snapshot[%s] success. update offset from %lu to %lu. use %lu second. write key %lu",
+          delta_name.c_str(), offset_, cur_offset, ::baidu::common::timer::now_time() - start_time, write_count);
+    offset_ = cur_offset;
+    *out_offset = cur_offset;
+    return 0;
+}
+
+int MemTableSnapshot::MakeFullSnapshot(std::shared_ptr<Table> table, uint64_t* out_offset, uint64_t end_offset,
+                                       uint64_t term) {
+    std::string now_time = ::openmldb::base::GetNowTime();
+    std::string snapshot_time = now_time.substr(0, now_time.length() - 2);
+    std::string image_name;
+    std::unique_ptr<SnapshotImageWriter> image;
+    std::shared_ptr<MemTable> mem_table = std::dynamic_pointer_cast<MemTable>(table);
+    if (FLAGS_snapshot_image && mem_table) {
+        image_name = snapshot_time + SNAPSHOT_SUBFIX + IMAGE_SUBFIX;
+        image.reset(new SnapshotImageWriter(mem_table, snapshot_path_ + image_name + ".tmp", FLAGS_load_table_batch));
+        if (!image->Open()) {
+            image.reset();
+        }
+    }
+    // the records are split into parts by key, the first part has the name of the snapshot without parts
+    uint32_t part_num = FLAGS_snapshot_part_num == 0 ? 1 : FLAGS_snapshot_part_num;
+    std::vector<SnapshotPart> parts(part_num);
+    std::vector<std::string> snapshot_names;
+    bool has_error = false;
+    for (uint32_t i = 0; i < part_num; i++) {
+        std::string snapshot_name = snapshot_time + (i == 0 ? "" : "_" + std::to_string(i)) + SNAPSHOT_SUBFIX;
+        if (FLAGS_snapshot_compression != "off") {
+            snapshot_name.append(".");
+            snapshot_name.append(FLAGS_snapshot_compression);
+        }
+        std::string snapshot_name_tmp = snapshot_name + ".tmp";
+        std::string tmp_file_path = snapshot_path_ + snapshot_name_tmp;
+        FILE* fd = fopen(tmp_file_path.c_str(), "ab+");
+        if (fd == NULL) {
+            PDLOG(WARNING, "fail to create file %s", tmp_file_path.c_str());
+            has_error = true;
+            break;
+        }
+        parts[i].name = snapshot_name;
+        parts[i].wh = new WriteHandle(FLAGS_snapshot_compression, snapshot_name_tmp, fd);
+        snapshot_names.push_back(snapshot_name);
+    }
+    if (has_error) {
+        for (uint32_t i = 0; i < snapshot_names.size(); i++) {
+            delete parts[i].wh;
+            unlink((snapshot_path_ + snapshot_names[i] + ".tmp").c_str());
+        }
+        return -1;
+    }
+    uint64_t collected_offset = CollectDeletedKey(end_offset);
+    uint64_t start_time = ::baidu::common::timer::now_time();
+    ::openmldb::api::Manifest manifest;
+    uint64_t last_term = term;
+    // the keys of the indexes which are not ready are removed from the old snapshot, and the keys
+    // of the deleted indexes from binlog
+    std::set<uint32_t> snapshot_deleted_index;
+    std::set<uint32_t> binlog_deleted_index;
+    for (const auto& it : table->GetAllIndex()) {
+        if (it->GetStatus() != ::openmldb::storage::IndexStatus::kReady) {
+            snapshot_deleted_index.insert(it->GetId());
+        }
+        if (it->GetStatus() == ::openmldb::storage::IndexStatus::kDeleted) {
+            binlog_deleted_index.insert(it->GetId());
+        }
+    }
+    uint64_t cur_offset = offset_;
+    {
+        // every part is written by its own thread, so the records of it are kept in order
+        std::vector<std::unique_ptr<::openmldb::base::TaskPool>> pools;
+        for (uint32_t i = 0; i < part_num; i++) {
+            pools.emplace_back(new ::openmldb::base::TaskPool(1, SNAPSHOT_PART_QUEUE_SIZE));
+        }
+        int result = GetLocalManifest(snapshot_path_ + MANIFEST, manifest);
+        if (result == 0 && !CollectDeltaDeletedKey(manifest)) {
+            has_error = true;
+        } else if (result == 0) {
+            // filter old snapshot, the data files of it are filtered in parallel
+            std::vector<std::string> old_names = GetDataFiles(manifest);
+            for (uint32_t i = 0; i < old_names.size(); i++) {
+                pools[i % part_num]->AddTask(boost::bind(&MemTableSnapshot::TTLSnapshot, this, table, old_names[i],
+                                                         &snapshot_deleted_index, &parts[i % part_num], image.get()));
+            }
+            last_term = manifest.term();
+            DEBUGLOG("old manifest term is %lu", last_term);
+        } else if (result < 0) {
+            // parse manifest error
+            has_error = true;
+        }
+
+        std::vector<std::vector<SnapshotRecord*>> batches(part_num);
+        // dispatch a record of the delta snapshots or binlog to the part of its key
+        auto dispatch = [&](const ::openmldb::base::Slice& record, ::openmldb::api::LogEntry* entry) {
+            const std::string& key = entry->dimensions_size() > 0 ? entry->dimensions(0).key() : entry->pk();
+            uint32_t idx = ::openmldb::base::hash(key.data(), key.size(), SNAPSHOT_PART_SEED) % part_num;
+            SnapshotRecord* snapshot_record = new SnapshotRecord();
+            snapshot_record->data.assign(record.data(), record.size());
+            snapshot_record->entry.Swap(entry);
+            batches[idx].push_back(snapshot_record);
+            if (batches[idx].size() >= SNAPSHOT_PART_BATCH) {
+                pools[idx]->AddTask(boost::bind(&MemTableSnapshot::WriteSnapshotPart, this, table, batches[idx],
+                                                &binlog_deleted_index, &parts[idx], image.get()));
+                batches[idx].clear();
+            }
+        };
+        std::string buffer;
+        if (!has_error && manifest.deltas_size() > 0) {
+            // the delta snapshots are merged in order before binlog
+            SnapshotReader delta_reader(snapshot_path_, GetDeltaFiles(manifest));
+            ::openmldb::api::LogEntry entry;
+            uint64_t delta_cnt = 0;
+            while (true) {
+                ::openmldb::base::Slice record;
+                ::openmldb::log::Status status = delta_reader.ReadRecord(&record, &buffer);
+                if (status.IsEof()) {
+                    break;
                 }
-                uint64_t consumed = ::baidu::common::timer::now_time() - start_time;
-                PDLOG(INFO,
-                      "make snapshot[%s] success. update offset from %lu to %lu."
-                      "use %lu second. write key %lu expired key %lu deleted key "
-                      "%lu",
-                      snapshot_name.c_str(), offset_, cur_offset, consumed, write_count, expired_key_num,
-                      deleted_key_num);
-                offset_ = cur_offset;
-                out_offset = cur_offset;
+                if (!status.ok() || !entry.ParseFromString(record.ToString())) {
+                    PDLOG(WARNING, "fail to read delta snapshot. status %s tid %u pid %u", status.ToString().c_str(),
+                          tid_, pid_);
+                    has_error = true;
+                    break;
+                }
+                delta_cnt++;
+                if (!entry.has_method_type() || entry.method_type() != ::openmldb::api::MethodType::kDelete) {
+                    dispatch(record, &entry);
+                }
+            }
+            uint64_t expect_cnt = 0;
+            for (const auto& delta : manifest.deltas()) {
+                expect_cnt += delta.count();
+            }
+            if (!has_error && delta_cnt != expect_cnt) {
+                PDLOG(WARNING, "delta key num not match! total key num[%lu] load key num[%lu]", expect_cnt, delta_cnt);
+                has_error = true;
+            }
+        }
+        ::openmldb::log::LogReader log_reader(log_part_, log_path_, false);
+        log_reader.SetOffset(offset_);
+        while (!has_error && cur_offset < collected_offset) {
+            buffer.clear();
+            ::openmldb::base::Slice record;
+            ::openmldb::log::Status status = log_reader.ReadNextRecord(&record, &buffer);
+            if (status.ok()) {
+                ::openmldb::api::LogEntry entry;
+                if (!entry.ParseFromString(record.ToString())) {
+                    PDLOG(WARNING, "fail to parse LogEntry. record[%s] size[%ld]",
+                          ::openmldb::base::DebugString(record.ToString()).c_str(), record.ToString().size());
+                    has_error = true;
+                    break;
+                }
+                if (entry.log_index() <= cur_offset) {
+                    continue;
+                }
+                if (cur_offset + 1 != entry.log_index()) {
+                    PDLOG(WARNING, "log missing expect offset %lu but %ld", cur_offset + 1, entry.log_index());
+                    continue;
+                }
+                cur_offset = entry.log_index();
+                if (entry.has_method_type() && entry.method_type() == ::openmldb::api::MethodType::kDelete) {
+                    continue;
+                }
+                if (entry.has_term()) {
+                    last_term = entry.term();
+                }
+                dispatch(record, &entry);
+            } else if (status.IsEof()) {
+                continue;
+            } else if (status.IsWaitRecord()) {
+                int end_log_index = log_reader.GetEndLogIndex();
+                int cur_log_index = log_reader.GetLogIndex();
+                // judge end_log_index greater than cur_log_index
+                if (end_log_index >= 0 && end_log_index > cur_log_index) {
+                    log_reader.RollRLogFile();
+                    PDLOG(WARNING,
+                          "read new binlog file. tid[%u] pid[%u] cur_log_index[%d] "
+                          "end_log_index[%d] cur_offset[%lu]",
+                          tid_, pid_, cur_log_index, end_log_index, cur_offset);
+                    continue;
+                }
+                DEBUGLOG("has read all record!");
+                break;
             } else {
-                PDLOG(WARNING, "GenManifest failed. delete snapshot file[%s]", full_path.c_str());
-                unlink(full_path.c_str());
-                ret = -1;
+                PDLOG(WARNING, "fail to get record. status is %s", status.ToString().c_str());
+                has_error = true;
+                break;
+            }
+        }
+        for (uint32_t idx = 0; idx < part_num; idx++) {
+            if (!batches[idx].empty()) {
+                pools[idx]->AddTask(boost::bind(&MemTableSnapshot::WriteSnapshotPart, this, table, batches[idx],
+                                                &binlog_deleted_index, &parts[idx], image.get()));
+            }
+        }
+        // wait for the tasks of all parts
+        pools.clear();
+    }
+    uint64_t read_count = 0;
+    uint64_t write_count = 0;
+    uint64_t expired_key_num = 0;
+    uint64_t deleted_key_num = 0;
+    for (auto& part : parts) {
+        part.wh->EndLog();
+        delete part.wh;
+        part.wh = NULL;
+        has_error = has_error || part.has_error;
+        read_count += part.read_cnt;
+        write_count += part.count;
+        expired_key_num += part.expired_key_num;
+        deleted_key_num += part.deleted_key_num;
+    }
+    if (!has_error && read_count != manifest.count()) {
+        PDLOG(WARNING, "key num not match! total key num[%lu] load key num[%lu]", manifest.count(), read_count);
+        has_error = true;
+    }
+    if (!image || has_error) {
+        image_name.clear();
+    } else if (image->GetRowCnt() != write_count || !image->Finish() ||
+               rename((snapshot_path_ + image_name + ".tmp").c_str(), (snapshot_path_ + image_name).c_str()) != 0) {
+        // the snapshot is made without the image if it's failed
+        PDLOG(WARNING, "fail to write image %s. tid %u pid %u", image_name.c_str(), tid_, pid_);
+        image.reset();
+        unlink((snapshot_path_ + image_name + ".tmp").c_str());
+        image_name.clear();
+    }
+    // the image is removed if it's not finished
+    image.reset();
+    int ret = 0;
+    uint32_t renamed_num = 0;
+    if (!has_error) {
+        for (; renamed_num < part_num; renamed_num++) {
+            const std::string& snapshot_name = snapshot_names[renamed_num];
+            if (rename((snapshot_path_ + snapshot_name + ".tmp").c_str(), (snapshot_path_ + snapshot_name).c_str()) !=
+                0) {
+                PDLOG(WARNING, "rename[%s] failed", snapshot_name.c_str());
+                break;
             }
+        }
+    }
+    if (has_error || renamed_num < part_num) {
+        ret = -1;
+    } else {
+        std::vector<std::string> part_names(snapshot_names.begin() + 1, snapshot_names.end());
+        if (GenManifest(snapshot_names[0], write_count, cur_offset, last_term, image_name, part_names) == 0) {
+            RemoveOldSnapshot(manifest, snapshot_names, image_name);
+            uint64_t consumed = ::baidu::common::timer::now_time() - start_time;
+            PDLOG(INFO,
+                  "make snapshot[%s] with %u parts success. update offset from %lu to %lu."
+                  "use %lu second. write key %lu expired key %lu deleted key "
+                  "%lu",
+                  snapshot_names[0].c_str(), part_num, offset_, cur_offset, consumed, write_count, expired_key_num,
+                  deleted_key_num);
+            offset_ = cur_offset;
+            *out_offset = cur_offset;
         } else {
-            PDLOG(WARNING, "rename[%s] failed", snapshot_name.c_str());
-            unlink(tmp_file_path.c_str());
+            PDLOG(WARNING, "GenManifest failed. delete snapshot file[%s]", snapshot_names[0].c_str());
             ret = -1;
         }
     }
+    if (ret != 0) {
+        for (uint32_t i = 0; i < part_num; i++) {
+            unlink((snapshot_path_ + snapshot_names[i] + (i < renamed_num ? "" : ".tmp")).c_str());
+        }
+        if (!image_name.empty()) {
+            unlink((snapshot_path_ + image_name).c_str());
+        }
+    }
     deleted_keys_.clear();
-    making_snapshot_.store(false, std::memory_order_release);
     return ret;
 }
 
+void MemTableSnapshot::AppendImage(SnapshotImageWriter* image, const ::openmldb::api::LogEntry& entry,
+                                   const std::string* buffer) {
+    if (image == NULL) {
+        return;
+    }
+    if (buffer == NULL) {
+        image->Append(entry);
+        return;
+    }
+    ::openmldb::api::LogEntry new_entry;
+    if (new_entry.ParseFromString(*buffer)) {
+        image->Append(new_entry);
+    } else {
+        image->Abort();
+    }
+}
+
+void MemTableSnapshot::RemoveOldSnapshot(const ::openmldb::api::Manifest& manifest,
+                                         const std::vector<std::string>& snapshot_names,
+                                         const std::string& image_name) {
+    std::vector<std::string> old_names = GetDataFiles(manifest);
+    std::vector<std::string> delta_names = GetDeltaFiles(manifest);
+    old_names.insert(old_names.end(), delta_names.begin(), delta_names.end());
+    for (const auto& name : old_names) {
+        if (std::find(snapshot_names.begin(), snapshot_names.end(), name) == snapshot_names.end()) {
+            DEBUGLOG("old snapshot[%s] has deleted", name.c_str());
+            unlink((snapshot_path_ + name).c_str());
+        }
+    }
+    if (manifest.has_image_name() && manifest.image_name() != image_name) {
+        unlink((snapshot_path_ + manifest.image_name()).c_str());
+    }
+}
+
 int MemTableSnapshot::RemoveDeletedKey(const ::openmldb::api::LogEntry& entry, const std::set<uint32_t>& deleted_index,
                                        std::string* buffer) {
     uint64_t cur_offset = entry.log_index();
@@ -670,15 +1095,7 @@ base::Status MemTableSnapshot::ExtractIndexFromSnapshot(std::shared_ptr<Table> t
         }
         index_vec.push_back(index_def);
     }
-    std::string full_path = snapshot_path_ + manifest.name();
-    FILE* fd = fopen(full_path.c_str(), "rb");
-    if (fd == NULL) {
-        PDLOG(WARNING, "fail to open path %s for error %s", full_path.c_str(), strerror(errno));
-        return base::Status(base::ReturnCode::kError, "fail to open file");
-    }
-    ::openmldb::log::SequentialFile* seq_file = ::openmldb::log::NewSeqFile(manifest.name(), fd);
-    bool compressed = IsCompressed(full_path);
-    ::openmldb::log::Reader reader(seq_file, NULL, false, 0, compressed);
+    SnapshotReader reader(snapshot_path_, GetDataFiles(manifest));
     std::string buffer;
     ::openmldb::api::LogEntry entry;
     bool has_error = false;
@@ -770,7 +1187,6 @@ base::Status MemTableSnapshot::ExtractIndexFromSnapshot(std::shared_ptr<Table> t
         }
         (*count)++;
     }
-    delete seq_file;
     if (*expired_key_num + write_count + *deleted_key_num != manifest.count()) {
         PDLOG(WARNING, "key num not match! total key[%lu] load key[%lu] ttl key[%lu] delete key [%lu], tid %u pid %u",
                 manifest.count(), *count, *expired_key_num, *deleted_key_num, tid, pid);
@@ -790,15 +1206,7 @@ int MemTableSnapshot::ExtractIndexFromSnapshot(std::shared_ptr<Table> table, con
                                                uint64_t& expired_key_num, uint64_t& deleted_key_num) {
     uint32_t tid = table->GetId();
     uint32_t pid = table->GetPid();
-    std::string full_path = snapshot_path_ + manifest.name();
-    FILE* fd = fopen(full_path.c_str(), "rb");
-    if (fd == NULL) {
-        PDLOG(WARNING, "fail to open path %s for error %s", full_path.c_str(), strerror(errno));
-        return -1;
-    }
-    ::openmldb::log::SequentialFile* seq_file = ::openmldb::log::NewSeqFile(manifest.name(), fd);
-    bool compressed = IsCompressed(full_path);
-    ::openmldb::log::Reader reader(seq_file, NULL, false, 0, compressed);
+    SnapshotReader reader(snapshot_path_, GetDataFiles(manifest));
     std::string buffer;
     ::openmldb::api::LogEntry entry;
     bool has_error = false;
@@ -928,7 +1336,6 @@ int MemTableSnapshot::ExtractIndexFromSnapshot(std::shared_ptr<Table> table, con
         }
         count++;
     }
-    delete seq_file;
     if (expired_key_num + count + deleted_key_num + schame_size_less_count + other_error_count != manifest.count()) {
         LOG(WARNING) << "key num not match ! total key num[" << manifest.count() << "] load key num[" << count
                      << "] ttl key num[" << expired_key_num << "] schema size less num[" << schame_size_less_count
@@ -1105,6 +1512,12 @@ int MemTableSnapshot::ExtractIndexData(std::shared_ptr<Table> table,
         PDLOG(INFO, "snapshot is doing now. tid %u, pid %u", tid, pid);
         return -1;
     }
+    // the index data is extracted from the full snapshot
+    if (MergeDeltaSnapshot(table) < 0) {
+        PDLOG(WARNING, "fail to merge the delta snapshots. tid %u, pid %u", tid, pid);
+        making_snapshot_.store(false, std::memory_order_release);
+        return -1;
+    }
     std::string snapshot_name = GenSnapshotName();
     std::string snapshot_name_tmp = snapshot_name + ".tmp";
     std::string full_path = snapshot_path_ + snapshot_name;
@@ -1160,11 +1573,7 @@ int MemTableSnapshot::ExtractIndexData(std::shared_ptr<Table> table,
     } else {
         if (rename(tmp_file_path.c_str(), full_path.c_str()) == 0) {
             if (GenManifest(snapshot_name, write_count, cur_offset, last_term) == 0) {
-                // delete old snapshot
-                if (manifest.has_name() && manifest.name() != snapshot_name) {
-                    DEBUGLOG("old snapshot[%s] has deleted", manifest.name().c_str());
-                    unlink((snapshot_path_ + manifest.name()).c_str());
-                }
+                RemoveOldSnapshot(manifest, {snapshot_name}, "");
                 uint64_t consumed = ::baidu::common::timer::now_time() - start_time;
                 PDLOG(INFO,
                       "make snapshot[%s] success. update offset from %lu to %lu."
@@ -1197,6 +1606,12 @@ int MemTableSnapshot::ExtractIndexData(std::shared_ptr<Table> table, const ::ope
         PDLOG(INFO, "snapshot is doing now. tid %u, pid %u", tid, pid);
         return -1;
     }
+    // the index data is extracted from the full snapshot
+    if (MergeDeltaSnapshot(table) < 0) {
+        PDLOG(WARNING, "fail to merge the delta snapshots. tid %u, pid %u", tid, pid);
+        making_snapshot_.store(false, std::memory_order_release);
+        return -1;
+    }
     std::string now_time = ::openmldb::base::GetNowTime();
     std::string snapshot_name = now_time.substr(0, now_time.length() - 2) + ".sdb";
     if (FLAGS_snapshot_compression != "off") {
@@ -1426,11 +1841,7 @@ int MemTableSnapshot::ExtractIndexData(std::shared_ptr<Table> table, const ::ope
     } else {
         if (rename(tmp_file_path.c_str(), full_path.c_str()) == 0) {
             if (GenManifest(snapshot_name, write_count, cur_offset, last_term) == 0) {
-                // delete old snapshot
-                if (manifest.has_name() && manifest.name() != snapshot_name) {
-                    DEBUGLOG("old snapshot[%s] has deleted", manifest.name().c_str());
-                    unlink((snapshot_path_ + manifest.name()).c_str());
-                }
+                RemoveOldSnapshot(manifest, {snapshot_name}, "");
                 uint64_t consumed = ::baidu::common::timer::now_time() - start_time;
                 PDLOG(INFO,
                       "make snapshot[%s] success. update offset from %lu to %lu."
@@ -1545,17 +1956,9 @@ bool MemTableSnapshot::DumpSnapshotIndexData(std::shared_ptr<Table> table,
         return false;
     }
     *snapshot_offset = manifest.offset();
-    std::string path = snapshot_path_ + "/" + manifest.name();
     uint64_t succ_cnt = 0;
     uint64_t failed_cnt = 0;
-    FILE* fd = fopen(path.c_str(), "rb");
-    if (fd == NULL) {
-        PDLOG(WARNING, "fail to open path %s for error %s", path.c_str(), strerror(errno));
-        return false;
-    }
-    ::openmldb::log::SequentialFile* seq_file = ::openmldb::log::NewSeqFile(path, fd);
-    bool compressed = IsCompressed(path);
-    ::openmldb::log::Reader reader(seq_file, NULL, false, 0, compressed);
+    SnapshotReader reader(snapshot_path_, GetDataFiles(manifest));
     ::openmldb::api::LogEntry entry;
     std::string buffer;
     std::string entry_buff;
@@ -1566,11 +1969,16 @@ bool MemTableSnapshot::DumpSnapshotIndexData(std::shared_ptr<Table> table,
         ::openmldb::log::Status status = reader.ReadRecord(&record, &buffer);
         if (status.IsWaitRecord() || status.IsEof()) {
             PDLOG(INFO,
-                  "read path %s for table tid %u pid %u completed, succ_cnt "
+                  "read snapshot %s for table tid %u pid %u completed, succ_cnt "
                   "%lu, failed_cnt %lu",
-                  path.c_str(), tid_, pid_, succ_cnt, failed_cnt);
+                  manifest.name().c_str(), tid_, pid_, succ_cnt, failed_cnt);
             break;
         }
+        if (status.IsIOError()) {
+            PDLOG(WARNING, "fail to read snapshot for tid %u, pid %u with error %s", tid_, pid_,
+                  status.ToString().c_str());
+            return false;
+        }
         if (!status.ok()) {
             PDLOG(WARNING, "fail to read record for tid %u, pid %u with error %s", tid_, pid_,
                   status.ToString().c_str());
@@ -1593,7 +2001,6 @@ bool MemTableSnapshot::DumpSnapshotIndexData(std::shared_ptr<Table> table,
         ::openmldb::base::Slice new_record(entry_str);
         status = whs[index_pid]->Write(new_record);
         if (!status.ok()) {
-            delete seq_file;
             PDLOG(WARNING,
                   "fail to dump index entrylog in snapshot to pid[%u]. tid "
                   "%u pid %u",
@@ -1602,7 +2009,6 @@ bool MemTableSnapshot::DumpSnapshotIndexData(std::shared_ptr<Table> table,
         }
         succ_cnt++;
     }
-    delete seq_file;
     return true;
 }
 
@@ -1614,6 +2020,12 @@ bool MemTableSnapshot::DumpIndexData(std::shared_ptr<Table> table, const ::openm
         PDLOG(INFO, "snapshot is doing now. tid %u, pid %u", tid, pid);
         return false;
     }
+    // the index data is dumped from the full snapshot
+    if (MergeDeltaSnapshot(table) < 0) {
+        PDLOG(WARNING, "fail to merge the delta snapshots. tid %u, pid %u", tid, pid);
+        making_snapshot_.store(false, std::memory_order_release);
+        return false;
+    }
     std::map<std::string, uint32_t> column_desc_map;
     auto table_meta = table->GetTableMeta();
     for (int32_t i = 0; i < table_meta->column_desc_size(); ++i) {
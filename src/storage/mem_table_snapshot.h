@@ -24,12 +24,14 @@
 #include <vector>
 
 #include "base/status.h"
+#include "base/taskpool.hpp"
 #include "codec/schema_codec.h"
 #include "log/log_reader.h"
 #include "log/log_writer.h"
 #include "log/sequential_file.h"
 #include "proto/tablet.pb.h"
 #include "storage/snapshot.h"
+#include "storage/snapshot_image.h"
 
 using ::openmldb::api::LogEntry;
 namespace openmldb {
@@ -50,17 +52,14 @@ class MemTableSnapshot : public Snapshot {
 
     bool Recover(std::shared_ptr<Table> table, uint64_t& latest_offset) override;
 
-    void RecoverFromSnapshot(const std::string& snapshot_name, uint64_t expect_cnt, std::shared_ptr<Table> table);
+    // load all data files of the snapshot of manifest to table in parallel
+    void RecoverFromSnapshot(const ::openmldb::api::Manifest& manifest, std::shared_ptr<Table> table);
 
     int MakeSnapshot(std::shared_ptr<Table> table,
                      uint64_t& out_offset,  // NOLINT
                      uint64_t end_offset,
                      uint64_t term = 0) override;
 
-    int TTLSnapshot(std::shared_ptr<Table> table, const ::openmldb::api::Manifest& manifest, WriteHandle* wh,
-                    uint64_t& count, uint64_t& expired_key_num,  // NOLINT
-                    uint64_t& deleted_key_num);                  // NOLINT
-
     void Put(std::string& path, std::shared_ptr<Table>& table,  // NOLINT
              std::vector<std::string*> recordPtr, std::atomic<uint64_t>* succ_cnt, std::atomic<uint64_t>* failed_cnt);
 
@@ -116,8 +115,72 @@ class MemTableSnapshot : public Snapshot {
                          std::string* buffer);
 
  private:
-    // load single snapshot to table
-    void RecoverSingleSnapshot(const std::string& path, std::shared_ptr<Table> table, std::atomic<uint64_t>* g_succ_cnt,
+    // read the records of the data files of a snapshot one by one
+    class SnapshotReader;
+
+    // a data file of the snapshot being made, the records of it are written by one thread
+    struct SnapshotPart {
+        std::string name;
+        WriteHandle* wh = NULL;
+        // the records read from the old snapshot
+        uint64_t read_cnt = 0;
+        uint64_t count = 0;
+        uint64_t expired_key_num = 0;
+        uint64_t deleted_key_num = 0;
+        bool has_error = false;
+    };
+
+    // a record of binlog dispatched to a part
+    struct SnapshotRecord {
+        std::string data;
+        ::openmldb::api::LogEntry entry;
+    };
+
+    // make a full snapshot, the delta snapshots are merged into it
+    int MakeFullSnapshot(std::shared_ptr<Table> table, uint64_t* out_offset, uint64_t end_offset, uint64_t term);
+
+    // make a delta snapshot of the binlog since the snapshot of manifest
+    int MakeDeltaSnapshot(std::shared_ptr<Table> table, const ::openmldb::api::Manifest& manifest,
+                          uint64_t* out_offset, uint64_t end_offset);
+
+    // make a full snapshot if there are delta snapshots, making_snapshot_ must be set
+    int MergeDeltaSnapshot(std::shared_ptr<Table> table);
+
+    // add the deleted keys of the delta snapshots of manifest to deleted_keys_
+    bool CollectDeltaDeletedKey(const ::openmldb::api::Manifest& manifest);
+
+    // apply the records of the delta snapshots of manifest to table in order
+    void RecoverFromDeltas(const ::openmldb::api::Manifest& manifest, std::shared_ptr<Table> table);
+
+    // filter the records of a data file of the old snapshot into part. image is NULL if no image
+    // is written with the snapshot
+    void TTLSnapshot(std::shared_ptr<Table> table, const std::string& snapshot_name,
+                     const std::set<uint32_t>* deleted_index, SnapshotPart* part, SnapshotImageWriter* image);
+
+    // write the records of binlog into part and delete them
+    void WriteSnapshotPart(std::shared_ptr<Table> table, std::vector<SnapshotRecord*> records,
+                           const std::set<uint32_t>* deleted_index, SnapshotPart* part, SnapshotImageWriter* image);
+
+    // write record to part if it's not deleted or expired, return false if it's failed
+    bool WriteSnapshotRecord(const std::shared_ptr<Table>& table, const ::openmldb::api::LogEntry& entry,
+                             ::openmldb::base::Slice record, const std::set<uint32_t>& deleted_index,
+                             SnapshotPart* part, SnapshotImageWriter* image, std::string* tmp_buf);
+
+    // return false if the image can't be used, then the table should be recovered from the snapshot
+    bool RecoverFromImage(const std::string& image_name, uint64_t expect_cnt, std::shared_ptr<Table> table);
+
+    // append the record written to the snapshot to image if it's not NULL. buffer is the record
+    // if the entry is rewritten with the deleted keys removed, or NULL
+    void AppendImage(SnapshotImageWriter* image, const ::openmldb::api::LogEntry& entry, const std::string* buffer);
+
+    // remove the files of the snapshot of manifest replaced by the new one, which has data files
+    // snapshot_names. image_name is empty if the new snapshot has no image
+    void RemoveOldSnapshot(const ::openmldb::api::Manifest& manifest, const std::vector<std::string>& snapshot_names,
+                           const std::string& image_name);
+
+    // load a data file of snapshot to table, the records are put by load_pool
+    void RecoverSingleSnapshot(const std::string& path, std::shared_ptr<Table> table,
+                               ::openmldb::base::TaskPool* load_pool, std::atomic<uint64_t>* g_succ_cnt,
                                std::atomic<uint64_t>* g_failed_cnt);
 
     uint64_t CollectDeletedKey(uint64_t end_offset);
@@ -125,7 +188,7 @@ class MemTableSnapshot : public Snapshot {
     int DecodeData(std::shared_ptr<Table> table, const openmldb::api::LogEntry& entry, uint32_t maxIdx,
                    std::vector<std::string>& row);  // NOLINT
 
-    inline bool IsCompressed(const std::string& path);
+    static bool IsCompressed(const std::string& path);
 
  private:
     LogParts* log_part_;
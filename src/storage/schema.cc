@@ -139,6 +139,7 @@ TableIndex::TableIndex() {
     }
     pk_index_ = std::shared_ptr<IndexDef>();
     col_name_vec_ = std::make_shared<std::vector<std::string>>();
+    put_plan_ = std::make_shared<const PutPlan>();
 }
 
 void TableIndex::ReSet() {
@@ -156,6 +157,7 @@ void TableIndex::ReSet() {
 
     auto new_vec = std::make_shared<std::vector<std::string>>();
     std::atomic_store_explicit(&col_name_vec_, new_vec, std::memory_order_relaxed);
+    BuildPutPlan();
 }
 
 int TableIndex::ParseFromMeta(const ::openmldb::api::TableMeta& table_meta) {
@@ -231,6 +233,7 @@ int TableIndex::ParseFromMeta(const ::openmldb::api::TableMeta& table_meta) {
         LOG(INFO) << "no index specified with default. tid " << tid << ", pid " << pid;
     }
     FillIndexVal(table_meta);
+    BuildPutPlan();
     if (!indexs_->empty()) {
         pk_index_ = indexs_->front();
     } else {
@@ -294,6 +297,44 @@ void TableIndex::AddInnerIndex(const std::shared_ptr<InnerIndexSt>& inner_index)
         new_inner_indexs = std::make_shared<std::vector<std::shared_ptr<InnerIndexSt>>>(*old_inner_indexs);
         new_inner_indexs->push_back(inner_index);
     } while (!atomic_compare_exchange_weak(&inner_indexs_, &old_inner_indexs, new_inner_indexs));
+    BuildPutPlan();
+}
+
+std::shared_ptr<const PutPlan> TableIndex::GetPutPlan() const {
+    return std::atomic_load_explicit(&put_plan_, std::memory_order_acquire);
+}
+
+void TableIndex::BuildPutPlan() {
+    auto plan = std::make_shared<PutPlan>();
+    std::map<uint32_t, uint32_t> ts_col_pos;
+    auto inner_indexs = GetAllInnerIndex();
+    for (const auto& inner_index : *inner_indexs) {
+        PutPlan::InnerIndex inner;
+        inner.indexs = inner_index->GetIndex();
+        for (const auto& index : inner.indexs) {
+            const auto& ts_col = index->GetTsColumn();
+            if (!ts_col) {
+                continue;
+            }
+            auto iter = ts_col_pos.find(ts_col->GetId());
+            if (iter == ts_col_pos.end()) {
+                iter = ts_col_pos.emplace(ts_col->GetId(), plan->ts_cols.size()).first;
+                plan->ts_cols.push_back(ts_col);
+            }
+            inner.ts_pos.push_back(iter->second);
+        }
+        plan->inner_indexs.push_back(std::move(inner));
+    }
+    uint32_t column_key_cnt = 0;
+    for (uint32_t i = 0; i < column_key_2_inner_index_.size(); i++) {
+        if (column_key_2_inner_index_[i]->load(std::memory_order_relaxed) >= 0) {
+            column_key_cnt = i + 1;
+        }
+    }
+    for (uint32_t i = 0; i < column_key_cnt; i++) {
+        plan->inner_pos.push_back(column_key_2_inner_index_[i]->load(std::memory_order_relaxed));
+    }
+    std::atomic_store_explicit(&put_plan_, std::shared_ptr<const PutPlan>(plan), std::memory_order_release);
 }
 
 std::shared_ptr<std::vector<std::shared_ptr<InnerIndexSt>>> TableIndex::GetAllInnerIndex() const {
@@ -319,7 +360,8 @@ void TableIndex::SetInnerIndexPos(uint32_t column_key_pos, uint32_t inner_pos) {
     if (column_key_pos >= column_key_2_inner_index_.size()) {
         return;
     }
-    return column_key_2_inner_index_.at(column_key_pos)->store(inner_pos, std::memory_order_relaxed);
+    column_key_2_inner_index_.at(column_key_pos)->store(inner_pos, std::memory_order_relaxed);
+    BuildPutPlan();
 }
 
 std::shared_ptr<IndexDef> TableIndex::GetIndex(uint32_t idx) {
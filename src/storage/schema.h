@@ -242,6 +242,21 @@ class InnerIndexSt {
 
 bool ColumnDefSortFunc(const ColumnDef& cd_a, const ColumnDef& cd_b);
 
+// PutPlan flattens the indexes of a table for the put path, it's rebuilt by TableIndex
+// whenever the indexes or the inner index positions change
+struct PutPlan {
+    struct InnerIndex {
+        std::vector<std::shared_ptr<IndexDef>> indexs;
+        // the positions in ts_cols of the ts columns, in the order of the ts of segment
+        std::vector<uint32_t> ts_pos;
+    };
+    // the inner index position of every column key, -1 if it has none
+    std::vector<int32_t> inner_pos;
+    std::vector<InnerIndex> inner_indexs;
+    // the distinct ts columns of all inner indexes
+    std::vector<std::shared_ptr<ColumnDef>> ts_cols;
+};
+
 class TableIndex {
  public:
     TableIndex();
@@ -263,9 +278,11 @@ class TableIndex {
     int32_t GetInnerIndexPos(uint32_t column_key_pos) const;
     void SetInnerIndexPos(uint32_t column_key_pos, uint32_t inner_pos);
     void AddInnerIndex(const std::shared_ptr<InnerIndexSt>& inner_index);
+    std::shared_ptr<const PutPlan> GetPutPlan() const;
 
  private:
     void FillIndexVal(const ::openmldb::api::TableMeta& table_meta);
+    void BuildPutPlan();
 
  private:
     std::shared_ptr<std::vector<std::shared_ptr<IndexDef>>> indexs_;
@@ -273,6 +290,7 @@ class TableIndex {
     std::vector<std::shared_ptr<std::atomic<int32_t>>> column_key_2_inner_index_;
     std::shared_ptr<IndexDef> pk_index_;
     std::shared_ptr<std::vector<std::string>> col_name_vec_;
+    std::shared_ptr<const PutPlan> put_plan_;
 };
 
 class PartitionSt {
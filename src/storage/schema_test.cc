@@ -250,6 +250,46 @@ TEST_F(SchemaTest, TsAndDefaultTs) {
     AssertInnerIndex(*(table_index.GetInnerIndex(2)), 2, index2, ts_vec2);
 }
 
+TEST_F(SchemaTest, PutPlan) {
+    ::openmldb::api::TableMeta table_meta;
+    for (int i = 0; i < 10; i++) {
+        auto column_desc = table_meta.add_column_desc();
+        column_desc->set_name("col" + std::to_string(i));
+        column_desc->set_data_type(::openmldb::type::kString);
+        if (i == 6 || i == 7) {
+            column_desc->set_data_type(::openmldb::type::kBigInt);
+        }
+    }
+    SchemaCodec::SetIndex(table_meta.add_column_key(), "key1", "col1", "col6", ::openmldb::type::kAbsoluteTime, 10, 0);
+    SchemaCodec::SetIndex(table_meta.add_column_key(), "key2", "col1", "col7", ::openmldb::type::kAbsoluteTime, 10, 0);
+    SchemaCodec::SetIndex(table_meta.add_column_key(), "key3", "col2", "col6", ::openmldb::type::kAbsoluteTime, 10, 0);
+    SchemaCodec::SetIndex(table_meta.add_column_key(), "key4", "col2", "", ::openmldb::type::kAbsoluteTime, 10, 0);
+    TableIndex table_index;
+    ASSERT_GE(table_index.ParseFromMeta(table_meta), 0);
+    auto plan = table_index.GetPutPlan();
+    ASSERT_EQ(std::vector<int32_t>({0, 0, 1, 1}), plan->inner_pos);
+    ASSERT_EQ(2u, plan->inner_indexs.size());
+    ASSERT_EQ(3u, plan->ts_cols.size());
+    ASSERT_EQ(6u, plan->ts_cols[0]->GetId());
+    ASSERT_EQ(7u, plan->ts_cols[1]->GetId());
+    ASSERT_TRUE(plan->ts_cols[2]->IsAutoGenTs());
+    ASSERT_EQ(std::vector<uint32_t>({0, 1}), plan->inner_indexs[0].ts_pos);
+    ASSERT_EQ(std::vector<uint32_t>({0, 2}), plan->inner_indexs[1].ts_pos);
+    ASSERT_EQ(2u, plan->inner_indexs[1].indexs.size());
+    // the plan is rebuilt when an inner index is added
+    auto index = std::make_shared<IndexDef>("key5", 4);
+    index->SetTsColumn(std::make_shared<ColumnDef>("col7", 7, ::openmldb::type::kBigInt, true));
+    ASSERT_EQ(0, table_index.AddIndex(index));
+    table_index.AddInnerIndex(std::make_shared<InnerIndexSt>(2, std::vector<std::shared_ptr<IndexDef>>({index})));
+    ASSERT_EQ(3u, table_index.GetPutPlan()->inner_indexs.size());
+    ASSERT_EQ(4u, table_index.GetPutPlan()->inner_pos.size());
+    table_index.SetInnerIndexPos(4, 2);
+    plan = table_index.GetPutPlan();
+    ASSERT_EQ(std::vector<int32_t>({0, 0, 1, 1, 2}), plan->inner_pos);
+    ASSERT_EQ(3u, plan->inner_indexs.size());
+    ASSERT_EQ(std::vector<uint32_t>({1}), plan->inner_indexs[2].ts_pos);
+}
+
 TEST_F(SchemaTest, ParseMultiTTL) {
     ::openmldb::api::TableMeta table_meta;
     for (int i = 0; i < 10; i++) {
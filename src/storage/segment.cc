@@ -19,58 +19,100 @@
 #include <gflags/gflags.h>
 
 #include "base/glog_wapper.h"
+#include "base/hash.h"
 #include "base/strings.h"
 #include "common/timer.h"
 #include "storage/record.h"
 
 DECLARE_int32(gc_safe_offset);
 DECLARE_uint32(skiplist_max_height);
-DECLARE_uint32(gc_deleted_pk_version_delta);
+DECLARE_bool(enable_segment_mem_pool);
+DECLARE_bool(enable_key_hash_index);
+DECLARE_uint32(key_hash_index_bucket_cnt);
 
 namespace openmldb {
 namespace storage {
 
 static const SliceComparator scmp;
+// different from the seed of choosing segment, otherwise keys of one segment fall in few key locks
+static const uint32_t KEY_MU_SEED = 0x9747b28c;
+
 Segment::Segment()
     : entries_(NULL),
+      key_index_(NULL),
       mu_(),
       idx_cnt_(0),
       idx_byte_size_(0),
       pk_cnt_(0),
       ts_cnt_(1),
-      gc_version_(0),
-      ttl_offset_(FLAGS_gc_safe_offset * 60 * 1000) {
+      epoch_(),
+      reclaimed_idx_cnt_(0),
+      reclaimed_record_cnt_(0),
+      reclaimed_record_byte_size_(0),
+      gc_cursor_(),
+      gc_tick_key_cnt_(0),
+      gc_visited_key_cnt_(0),
+      gc_pass_done_(true),
+      ring_cap_(0),
+      ttl_offset_(FLAGS_gc_safe_offset * 60 * 1000),
+      mem_pool_(FLAGS_enable_segment_mem_pool ? new ::openmldb::base::SlabMemoryPool() : NULL) {
     entries_ = new KeyEntries((uint8_t)FLAGS_skiplist_max_height, 4, scmp);
+    if (FLAGS_enable_key_hash_index) {
+        key_index_ = new KeyHashIndex(&epoch_, FLAGS_key_hash_index_bucket_cnt);
+    }
     key_entry_max_height_ = (uint8_t)FLAGS_skiplist_max_height;
-    entry_free_list_ = new KeyEntryNodeList(4, 4, tcmp);
 }
 
 Segment::Segment(uint8_t height)
     : entries_(NULL),
+      key_index_(NULL),
       mu_(),
       idx_cnt_(0),
       idx_byte_size_(0),
       pk_cnt_(0),
       key_entry_max_height_(height),
       ts_cnt_(1),
-      gc_version_(0),
-      ttl_offset_(FLAGS_gc_safe_offset * 60 * 1000) {
+      epoch_(),
+      reclaimed_idx_cnt_(0),
+      reclaimed_record_cnt_(0),
+      reclaimed_record_byte_size_(0),
+      gc_cursor_(),
+      gc_tick_key_cnt_(0),
+      gc_visited_key_cnt_(0),
+      gc_pass_done_(true),
+      ring_cap_(0),
+      ttl_offset_(FLAGS_gc_safe_offset * 60 * 1000),
+      mem_pool_(FLAGS_enable_segment_mem_pool ? new ::openmldb::base::SlabMemoryPool() : NULL) {
     entries_ = new KeyEntries((uint8_t)FLAGS_skiplist_max_height, 4, scmp);
-    entry_free_list_ = new KeyEntryNodeList(4, 4, tcmp);
+    if (FLAGS_enable_key_hash_index) {
+        key_index_ = new KeyHashIndex(&epoch_, FLAGS_key_hash_index_bucket_cnt);
+    }
 }
 
 Segment::Segment(uint8_t height, const std::vector<uint32_t>& ts_idx_vec)
     : entries_(NULL),
+      key_index_(NULL),
       mu_(),
       idx_cnt_(0),
       idx_byte_size_(0),
       pk_cnt_(0),
       key_entry_max_height_(height),
       ts_cnt_(ts_idx_vec.size()),
-      gc_version_(0),
-      ttl_offset_(FLAGS_gc_safe_offset * 60 * 1000) {
+      epoch_(),
+      reclaimed_idx_cnt_(0),
+      reclaimed_record_cnt_(0),
+      reclaimed_record_byte_size_(0),
+      gc_cursor_(),
+      gc_tick_key_cnt_(0),
+      gc_visited_key_cnt_(0),
+      gc_pass_done_(true),
+      ring_cap_(0),
+      ttl_offset_(FLAGS_gc_safe_offset * 60 * 1000),
+      mem_pool_(FLAGS_enable_segment_mem_pool ? new ::openmldb::base::SlabMemoryPool() : NULL) {
     entries_ = new KeyEntries((uint8_t)FLAGS_skiplist_max_height, 4, scmp);
-    entry_free_list_ = new KeyEntryNodeList(4, 4, tcmp);
+    if (FLAGS_enable_key_hash_index) {
+        key_index_ = new KeyHashIndex(&epoch_, FLAGS_key_hash_index_bucket_cnt);
+    }
     for (uint32_t i = 0; i < ts_idx_vec.size(); i++) {
         ts_idx_map_[ts_idx_vec[i]] = i;
         idx_cnt_vec_.push_back(std::make_shared<std::atomic<uint64_t>>(0));
@@ -78,8 +120,11 @@ Segment::Segment(uint8_t height, const std::vector<uint32_t>& ts_idx_vec)
 }
 
 Segment::~Segment() {
+    epoch_.ReclaimAll();
+    delete key_index_;
     delete entries_;
-    delete entry_free_list_;
+    // the rows still in use keep their slabs alive
+    delete mem_pool_;
 }
 
 uint64_t Segment::Release() {
@@ -105,61 +150,45 @@ uint64_t Segment::Release() {
         it->Next();
     }
     entries_->Clear();
+    if (key_index_ != NULL) {
+        key_index_->Clear();
+    }
     delete it;
 
-    KeyEntryNodeList::Iterator* f_it = entry_free_list_->NewIterator();
-    f_it->SeekToFirst();
-    while (f_it->Valid()) {
-        ::openmldb::base::Node<Slice, void*>* node = f_it->GetValue();
-        delete[] node->GetKey().data();
-        if (ts_cnt_ > 1) {
-            KeyEntry** entry_arr = (KeyEntry**)node->GetValue();  // NOLINT
-            for (uint32_t i = 0; i < ts_cnt_; i++) {
-                entry_arr[i]->Release();
-                delete entry_arr[i];
-            }
-            delete[] entry_arr;
-        } else {
-            KeyEntry* entry = (KeyEntry*)node->GetValue();  // NOLINT
-            entry->Release();
-            delete entry;
-        }
-        delete node;
-        f_it->Next();
-    }
-    delete f_it;
-    entry_free_list_->Clear();
+    // the readers must be gone
+    epoch_.ReclaimAll();
     idx_cnt_vec_.clear();
     return cnt;
 }
 
 void Segment::ReleaseAndCount(uint64_t& gc_idx_cnt, uint64_t& gc_record_cnt, uint64_t& gc_record_byte_size) {
+    uint64_t epoch = epoch_.Pin();
     KeyEntries::Iterator* it = entries_->NewIterator();
     it->SeekToFirst();
     while (it->Valid()) {
         Slice key = it->GetKey();
         ::openmldb::base::Node<Slice, void*>* entry_node = NULL;
         {
+            std::lock_guard<std::mutex> key_lock(GetKeyMutex(key));
             std::lock_guard<std::mutex> lock(mu_);
-            entry_node = entries_->Remove(key);
+            entry_node = RemoveKeyEntry(key);
         }
         if (entry_node != NULL) {
-            FreeEntry(entry_node, gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+            RetireEntry(entry_node);
         }
         it->Next();
-        pk_cnt_.fetch_sub(1, std::memory_order_relaxed);
     }
     delete it;
-    uint64_t cur_version = gc_version_.load(std::memory_order_relaxed);
-    GcEntryFreeList(cur_version, gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+    epoch_.UnPin(epoch);
     Release();
+    GcFreeList(gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
 }
 
 void Segment::Put(const Slice& key, uint64_t time, const char* data, uint32_t size) {
     if (ts_cnt_ > 1) {
         return;
     }
-    auto* db = new DataBlock(1, data, size);
+    auto* db = AllocDataBlock(1, data, size);
     Put(key, time, db);
 }
 
@@ -167,23 +196,97 @@ void Segment::Put(const Slice& key, uint64_t time, DataBlock* row) {
     if (ts_cnt_ > 1) {
         return;
     }
-    std::lock_guard<std::mutex> lock(mu_);
+    std::lock_guard<std::mutex> lock(GetKeyMutex(key));
     PutUnlock(key, time, row);
 }
 
+std::mutex& Segment::GetKeyMutex(const Slice& key) {
+    return key_mu_[::openmldb::base::hash(key.data(), key.size(), KEY_MU_SEED) % KEY_MU_CNT];
+}
+
+void* Segment::InsertKeyEntry(const Slice& key, uint32_t& byte_size) {
+    char* pk = new char[key.size()];
+    memcpy(pk, key.data(), key.size());
+    // need to delete memory when free node
+    Slice skey(pk, key.size());
+    void* entry = NULL;
+    if (ts_cnt_ > 1) {
+        KeyEntry** entry_arr = new KeyEntry*[ts_cnt_];
+        for (uint32_t i = 0; i < ts_cnt_; i++) {
+            entry_arr[i] = new KeyEntry(key_entry_max_height_);
+        }
+        entry = (void*)entry_arr;  // NOLINT
+    } else {
+        KeyEntry* key_entry = new KeyEntry(key_entry_max_height_);
+        uint32_t ring_cap = ring_cap_.load(std::memory_order_relaxed);
+        if (ring_cap > 0) {
+            key_entry->ring_.store(new LatestRing(ring_cap), std::memory_order_relaxed);
+            byte_size += LatestRing::GetByteSize(ring_cap);
+        }
+        entry = (void*)key_entry;  // NOLINT
+    }
+    uint8_t height = 0;
+    {
+        // puts of other keys may insert into entries_ at the same time
+        std::lock_guard<std::mutex> lock(mu_);
+        height = entries_->Insert(skey, entry);
+        if (key_index_ != NULL) {
+            key_index_->Insert(skey, entry);
+        }
+    }
+    if (ts_cnt_ > 1) {
+        byte_size += GetRecordPkMultiIdxSize(height, key.size(), key_entry_max_height_, ts_cnt_);
+    } else {
+        byte_size += GetRecordPkIdxSize(height, key.size(), key_entry_max_height_);
+    }
+    pk_cnt_.fetch_add(1, std::memory_order_relaxed);
+    return entry;
+}
+
+int Segment::GetKeyEntry(const Slice& key, void*& entry) {
+    if (key_index_ == NULL) {
+        return entries_->Get(key, entry);
+    }
+    entry = key_index_->Get(key);
+    return entry == NULL ? -1 : 0;
+}
+
+::openmldb::base::Node<Slice, void*>* Segment::RemoveKeyEntry(const Slice& key) {
+    if (key_index_ != NULL) {
+        key_index_->Remove(key);
+    }
+    return entries_->Remove(key);
+}
+
 void Segment::PutUnlock(const Slice& key, uint64_t time, DataBlock* row) {
     void* entry = nullptr;
     uint32_t byte_size = 0;
-    int ret = entries_->Get(key, entry);
+    // the lookup may pass the nodes of the other keys removed by gc
+    EpochGuard guard(&epoch_);
+    int ret = GetKeyEntry(key, entry);
     if (ret < 0 || entry == NULL) {
-        char* pk = new char[key.size()];
-        memcpy(pk, key.data(), key.size());
-        // need to delete memory when free node
-        Slice skey(pk, key.size());
-        entry = (void*)new KeyEntry(key_entry_max_height_);  // NOLINT
-        uint8_t height = entries_->Insert(skey, entry);
-        byte_size += GetRecordPkIdxSize(height, key.size(), key_entry_max_height_);
-        pk_cnt_.fetch_add(1, std::memory_order_relaxed);
+        entry = InsertKeyEntry(key, byte_size);
+    }
+    LatestRing* ring = ((KeyEntry*)entry)->GetRing();  // NOLINT
+    if (ring != NULL) {
+        bool rejected = false;
+        DataBlock* evicted = ring->Insert(time, row, &rejected);
+        if (rejected) {
+            // the row is never indexed, so it's released at once and isn't counted as a reclaimed index
+            uint32_t size = row->size;
+            if (UnRefDataBlock(row)) {
+                reclaimed_record_cnt_.fetch_add(1, std::memory_order_relaxed);
+                reclaimed_record_byte_size_.fetch_add(GetRecordSize(size), std::memory_order_relaxed);
+            }
+        } else if (evicted == NULL) {
+            idx_cnt_.fetch_add(1, std::memory_order_relaxed);
+            ((KeyEntry*)entry)->count_.fetch_add(1, std::memory_order_relaxed);  // NOLINT
+        } else {
+            reclaimed_idx_cnt_.fetch_add(1, std::memory_order_relaxed);
+            RetireRows(std::vector<DataBlock*>(1, evicted));
+        }
+        idx_byte_size_.fetch_add(byte_size, std::memory_order_relaxed);
+        return;
     }
     idx_cnt_.fetch_add(1, std::memory_order_relaxed);
     uint8_t height = ((KeyEntry*)entry)->entries.Insert(time, row);  // NOLINT
@@ -196,23 +299,14 @@ void Segment::PutUnlock(const Slice& key, uint64_t time, DataBlock* row) {
 void Segment::BulkLoadPut(unsigned int key_entry_id, const Slice& key, uint64_t time, DataBlock* row) {
     void* key_entry_or_list = nullptr;
     uint32_t byte_size = 0;
-    std::lock_guard<std::mutex> lock(mu_);  // TODO(hw): need lock?
-    int ret = entries_->Get(key, key_entry_or_list);
+    std::lock_guard<std::mutex> lock(GetKeyMutex(key));
+    EpochGuard guard(&epoch_);
+    int ret = GetKeyEntry(key, key_entry_or_list);
     if (ts_cnt_ == 1) {
         PutUnlock(key, time, row);
     } else {
         if (ret < 0 || key_entry_or_list == nullptr) {
-            char* pk = new char[key.size()];
-            memcpy(pk, key.data(), key.size());
-            Slice skey(pk, key.size());
-            auto** entry_arr_tmp = new KeyEntry*[ts_cnt_];
-            for (uint32_t i = 0; i < ts_cnt_; i++) {
-                entry_arr_tmp[i] = new KeyEntry(key_entry_max_height_);
-            }
-            auto entry_arr = (void*)entry_arr_tmp;  // NOLINT
-            uint8_t height = entries_->Insert(skey, entry_arr);
-            byte_size += GetRecordPkMultiIdxSize(height, key.size(), key_entry_max_height_, ts_cnt_);
-            pk_cnt_.fetch_add(1, std::memory_order_relaxed);
+            key_entry_or_list = InsertKeyEntry(key, byte_size);
         }
         uint8_t height = ((KeyEntry**)key_entry_or_list)[key_entry_id]->entries.Insert(  // NOLINT
             time, row);
@@ -237,7 +331,8 @@ void Segment::Put(const Slice& key, const std::map<int32_t, uint64_t>& ts_map, D
         return;
     }
     void* entry_arr = NULL;
-    std::lock_guard<std::mutex> lock(mu_);
+    std::lock_guard<std::mutex> lock(GetKeyMutex(key));
+    EpochGuard guard(&epoch_);
     for (const auto& kv : ts_map) {
         uint32_t byte_size = 0;
         auto pos = ts_idx_map_.find(kv.first);
@@ -245,19 +340,9 @@ void Segment::Put(const Slice& key, const std::map<int32_t, uint64_t>& ts_map, D
             continue;
         }
         if (entry_arr == NULL) {
-            int ret = entries_->Get(key, entry_arr);
+            int ret = GetKeyEntry(key, entry_arr);
             if (ret < 0 || entry_arr == NULL) {
-                char* pk = new char[key.size()];
-                memcpy(pk, key.data(), key.size());
-                Slice skey(pk, key.size());
-                KeyEntry** entry_arr_tmp = new KeyEntry*[ts_cnt_];
-                for (uint32_t i = 0; i < ts_cnt_; i++) {
-                    entry_arr_tmp[i] = new KeyEntry(key_entry_max_height_);
-                }
-                entry_arr = (void*)entry_arr_tmp;  // NOLINT
-                uint8_t height = entries_->Insert(skey, entry_arr);
-                byte_size += GetRecordPkMultiIdxSize(height, key.size(), key_entry_max_height_, ts_cnt_);
-                pk_cnt_.fetch_add(1, std::memory_order_relaxed);
+                entry_arr = InsertKeyEntry(key, byte_size);
             }
         }
         uint8_t height = ((KeyEntry**)entry_arr)[pos->second]->entries.Insert(  // NOLINT
@@ -270,15 +355,39 @@ void Segment::Put(const Slice& key, const std::map<int32_t, uint64_t>& ts_map, D
     }
 }
 
+void Segment::Put(const Slice& key, const uint64_t* ts, DataBlock* row) {
+    if (ts_cnt_ == 1) {
+        Put(key, ts[0], row);
+        return;
+    }
+    void* entry_arr = NULL;
+    uint32_t byte_size = 0;
+    std::lock_guard<std::mutex> lock(GetKeyMutex(key));
+    EpochGuard guard(&epoch_);
+    int ret = GetKeyEntry(key, entry_arr);
+    if (ret < 0 || entry_arr == NULL) {
+        entry_arr = InsertKeyEntry(key, byte_size);
+    }
+    for (uint32_t i = 0; i < ts_cnt_; i++) {
+        KeyEntry* entry = ((KeyEntry**)entry_arr)[i];  // NOLINT
+        uint8_t height = entry->entries.Insert(ts[i], row);
+        entry->count_.fetch_add(1, std::memory_order_relaxed);
+        byte_size += GetRecordTsIdxSize(height);
+        idx_cnt_vec_[i]->fetch_add(1, std::memory_order_relaxed);
+    }
+    idx_byte_size_.fetch_add(byte_size, std::memory_order_relaxed);
+}
+
 bool Segment::Get(const Slice& key, const uint64_t time, DataBlock** block) {
     if (block == NULL || ts_cnt_ > 1) {
         return false;
     }
+    EpochGuard guard(&epoch_);
     void* entry = NULL;
-    if (entries_->Get(key, entry) < 0 || entry == NULL) {
+    if (GetKeyEntry(key, entry) < 0 || entry == NULL) {
         return false;
     }
-    *block = ((KeyEntry*)entry)->entries.Get(time);  // NOLINT
+    *block = ((KeyEntry*)entry)->Get(time);  // NOLINT
     return true;
 }
 
@@ -293,27 +402,26 @@ bool Segment::Get(const Slice& key, uint32_t idx, const uint64_t time, DataBlock
     if (ts_cnt_ == 1) {
         return Get(key, time, block);
     }
+    EpochGuard guard(&epoch_);
     void* entry = NULL;
-    if (entries_->Get(key, entry) < 0 || entry == NULL) {
+    if (GetKeyEntry(key, entry) < 0 || entry == NULL) {
         return false;
     }
-    *block = ((KeyEntry**)entry)[pos->second]->entries.Get(time);  // NOLINT
+    *block = ((KeyEntry**)entry)[pos->second]->Get(time);  // NOLINT
     return true;
 }
 
 bool Segment::Delete(const Slice& key) {
     ::openmldb::base::Node<Slice, void*>* entry_node = NULL;
     {
+        std::lock_guard<std::mutex> key_lock(GetKeyMutex(key));
         std::lock_guard<std::mutex> lock(mu_);
-        entry_node = entries_->Remove(key);
+        entry_node = RemoveKeyEntry(key);
         if (entry_node == NULL) {
             return false;
         }
     }
-    {
-        std::lock_guard<std::mutex> lock(gc_mu_);
-        entry_free_list_->Insert(gc_version_.load(std::memory_order_relaxed), entry_node);
-    }
+    RetireEntry(entry_node);
     return true;
 }
 
@@ -325,18 +433,34 @@ void Segment::FreeList(::openmldb::base::Node<uint64_t, DataBlock*>* node, uint6
         idx_byte_size_.fetch_sub(GetRecordTsIdxSize(tmp->Height()));
         node = node->GetNextNoBarrier(0);
         DEBUGLOG("delete key %lu with height %u", tmp->GetKey(), tmp->Height());
-        if (tmp->GetValue()->dim_cnt_down > 1) {
-            tmp->GetValue()->dim_cnt_down--;
-        } else {
+        uint32_t size = tmp->GetValue()->size;
+        if (UnRefDataBlock(tmp->GetValue())) {
             DEBUGLOG("delele data block for key %lu", tmp->GetKey());
-            gc_record_byte_size += GetRecordSize(tmp->GetValue()->size);
-            delete tmp->GetValue();
+            gc_record_byte_size += GetRecordSize(size);
             gc_record_cnt++;
         }
         delete tmp;
     }
 }
 
+void Segment::FreeColdList(ColdBlock* block, uint64_t& gc_idx_cnt, uint64_t& gc_record_cnt,
+                           uint64_t& gc_record_byte_size) {
+    while (block != NULL) {
+        for (uint32_t i = 0; i < block->GetCount(); i++) {
+            gc_idx_cnt++;
+            uint32_t size = block->GetRow(i)->size;
+            if (UnRefDataBlock(block->GetRow(i))) {
+                gc_record_byte_size += GetRecordSize(size);
+                gc_record_cnt++;
+            }
+        }
+        idx_byte_size_.fetch_sub(block->GetByteSize());
+        ColdBlock* tmp = block;
+        block = block->next;
+        delete tmp;
+    }
+}
+
 void Segment::FreeEntry(::openmldb::base::Node<Slice, void*>* entry_node, uint64_t& gc_idx_cnt, uint64_t& gc_record_cnt,
                         uint64_t& gc_record_byte_size) {
     if (entry_node == NULL) {
@@ -357,6 +481,8 @@ void Segment::FreeEntry(::openmldb::base::Node<Slice, void*>* entry_node, uint64
                 FreeList(data_node, gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
             }
             delete it;
+            FreeColdList(entry->cold_.exchange(NULL, std::memory_order_relaxed), gc_idx_cnt, gc_record_cnt,
+                         gc_record_byte_size);
             delete entry;
             idx_cnt_vec_[i]->fetch_sub(gc_idx_cnt - old, std::memory_order_relaxed);
         }
@@ -375,6 +501,10 @@ void Segment::FreeEntry(::openmldb::base::Node<Slice, void*>* entry_node, uint64
             FreeList(data_node, gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
         }
         delete it;
+        FreeColdList(entry->cold_.exchange(NULL, std::memory_order_relaxed), gc_idx_cnt, gc_record_cnt,
+                     gc_record_byte_size);
+        FreeRing(entry->ring_.exchange(NULL, std::memory_order_relaxed), gc_idx_cnt, gc_record_cnt,
+                 gc_record_byte_size);
         delete entry;
         uint64_t byte_size =
             GetRecordPkIdxSize(entry_node->Height(), entry_node->GetKey().size(), key_entry_max_height_);
@@ -383,31 +513,147 @@ void Segment::FreeEntry(::openmldb::base::Node<Slice, void*>* entry_node, uint64
     }
 }
 
-void Segment::GcEntryFreeList(uint64_t version, uint64_t& gc_idx_cnt, uint64_t& gc_record_cnt,
-                              uint64_t& gc_record_byte_size) {
-    ::openmldb::base::Node<uint64_t, ::openmldb::base::Node<Slice, void*>*>* node = NULL;
-    {
-        std::lock_guard<std::mutex> lock(gc_mu_);
-        node = entry_free_list_->Split(version);
+void Segment::FreeRing(LatestRing* ring, uint64_t& gc_idx_cnt, uint64_t& gc_record_cnt,
+                       uint64_t& gc_record_byte_size) {
+    if (ring == NULL) {
+        return;
     }
-    while (node != NULL) {
-        ::openmldb::base::Node<Slice, void*>* entry_node = node->GetValue();
+    std::vector<std::pair<uint64_t, DataBlock*>> rows;
+    ring->Read(&rows);
+    for (const auto& kv : rows) {
+        gc_idx_cnt++;
+        uint32_t size = kv.second->size;
+        if (UnRefDataBlock(kv.second)) {
+            gc_record_byte_size += GetRecordSize(size);
+            gc_record_cnt++;
+        }
+    }
+    idx_byte_size_.fetch_sub(LatestRing::GetByteSize(ring->GetCapacity()), std::memory_order_relaxed);
+    delete ring;
+}
+
+uint64_t Segment::RetireRows(const std::vector<DataBlock*>& rows) {
+    if (rows.empty()) {
+        return 0;
+    }
+    epoch_.Retire([this, rows]() {
+        uint64_t gc_record_cnt = 0;
+        uint64_t gc_record_byte_size = 0;
+        for (DataBlock* row : rows) {
+            uint32_t size = row->size;
+            if (UnRefDataBlock(row)) {
+                gc_record_byte_size += GetRecordSize(size);
+                gc_record_cnt++;
+            }
+        }
+        reclaimed_record_cnt_.fetch_add(gc_record_cnt, std::memory_order_relaxed);
+        reclaimed_record_byte_size_.fetch_add(gc_record_byte_size, std::memory_order_relaxed);
+    });
+    return rows.size();
+}
+
+void Segment::EnableLatestRing(uint32_t capacity) {
+    if (ts_cnt_ > 1) {
+        return;
+    }
+    ring_cap_.store(capacity, std::memory_order_relaxed);
+}
+
+void Segment::DisableLatestRing() {
+    uint32_t ring_cap = ring_cap_.exchange(0, std::memory_order_relaxed);
+    if (ring_cap == 0) {
+        return;
+    }
+    // the puts which have seen the ring capacity are done after the key locks are passed
+    for (uint32_t i = 0; i < KEY_MU_CNT; i++) {
+        std::lock_guard<std::mutex> lock(key_mu_[i]);
+    }
+    EpochGuard guard(&epoch_);
+    uint64_t byte_size = 0;
+    uint64_t ring_byte_size = 0;
+    std::vector<std::pair<uint64_t, DataBlock*>> rows;
+    KeyEntries::Iterator* it = entries_->NewIterator();
+    it->SeekToFirst();
+    while (it->Valid()) {
+        KeyEntry* entry = (KeyEntry*)it->GetValue();  // NOLINT
+        {
+            std::lock_guard<std::mutex> lock(GetKeyMutex(it->GetKey()));
+            LatestRing* ring = entry->GetRing();
+            if (ring != NULL) {
+                // the rows are in skiplist before the ring is unlinked, so readers never miss them
+                ring->Read(&rows);
+                for (auto& kv : rows) {
+                    byte_size += GetRecordTsIdxSize(entry->entries.Insert(kv.first, kv.second));
+                }
+                entry->ring_.store(NULL, std::memory_order_release);
+                ring_byte_size += LatestRing::GetByteSize(ring->GetCapacity());
+                epoch_.Retire([ring]() { delete ring; });
+            }
+        }
+        it->Next();
+    }
+    delete it;
+    idx_byte_size_.fetch_add(byte_size, std::memory_order_relaxed);
+    idx_byte_size_.fetch_sub(ring_byte_size, std::memory_order_relaxed);
+}
+
+uint64_t Segment::RetireList(::openmldb::base::Node<uint64_t, DataBlock*>* node, ColdBlock* cold) {
+    if (node == NULL && cold == NULL) {
+        return 0;
+    }
+    uint64_t cnt = 0;
+    for (auto* cur = node; cur != NULL; cur = cur->GetNextNoBarrier(0)) {
+        cnt++;
+    }
+    for (auto* cur = cold; cur != NULL; cur = cur->next) {
+        cnt += cur->GetCount();
+    }
+    epoch_.Retire([this, node, cold]() {
+        // the index count has been updated when the rows are retired
+        uint64_t gc_idx_cnt = 0;
+        uint64_t gc_record_cnt = 0;
+        uint64_t gc_record_byte_size = 0;
+        FreeList(node, gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+        FreeColdList(cold, gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+        reclaimed_record_cnt_.fetch_add(gc_record_cnt, std::memory_order_relaxed);
+        reclaimed_record_byte_size_.fetch_add(gc_record_byte_size, std::memory_order_relaxed);
+    });
+    return cnt;
+}
+
+void Segment::RetireEntry(::openmldb::base::Node<Slice, void*>* entry_node) {
+    epoch_.Retire([this, entry_node]() {
+        uint64_t gc_idx_cnt = 0;
+        uint64_t gc_record_cnt = 0;
+        uint64_t gc_record_byte_size = 0;
         FreeEntry(entry_node, gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
         delete entry_node;
-        ::openmldb::base::Node<uint64_t, ::openmldb::base::Node<Slice, void*>*>* tmp = node;
-        node = node->GetNextNoBarrier(0);
-        delete tmp;
         pk_cnt_.fetch_sub(1, std::memory_order_relaxed);
-    }
+        reclaimed_idx_cnt_.fetch_add(gc_idx_cnt, std::memory_order_relaxed);
+        reclaimed_record_cnt_.fetch_add(gc_record_cnt, std::memory_order_relaxed);
+        reclaimed_record_byte_size_.fetch_add(gc_record_byte_size, std::memory_order_relaxed);
+    });
 }
 
-void Segment::GcFreeList(uint64_t& gc_idx_cnt, uint64_t& gc_record_cnt, uint64_t& gc_record_byte_size) {
-    uint64_t cur_version = gc_version_.load(std::memory_order_relaxed);
-    if (cur_version < FLAGS_gc_deleted_pk_version_delta) {
+void Segment::RetireColdBlocks(ColdBlock* head, ColdBlock* end) {
+    if (head == end) {
         return;
     }
-    uint64_t free_list_version = cur_version - FLAGS_gc_deleted_pk_version_delta;
-    GcEntryFreeList(free_list_version, gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+    epoch_.Retire([head, end]() {
+        ColdBlock* block = head;
+        while (block != end) {
+            ColdBlock* tmp = block;
+            block = block->next;
+            delete tmp;
+        }
+    });
+}
+
+void Segment::GcFreeList(uint64_t& gc_idx_cnt, uint64_t& gc_record_cnt, uint64_t& gc_record_byte_size) {
+    epoch_.Reclaim();
+    gc_idx_cnt += reclaimed_idx_cnt_.exchange(0, std::memory_order_relaxed);
+    gc_record_cnt += reclaimed_record_cnt_.exchange(0, std::memory_order_relaxed);
+    gc_record_byte_size += reclaimed_record_byte_size_.exchange(0, std::memory_order_relaxed);
 }
 
 void Segment::ExecuteGc(const TTLSt& ttl_st, uint64_t& gc_idx_cnt, uint64_t& gc_record_cnt,
@@ -474,26 +720,102 @@ void Segment::ExecuteGc(const std::map<uint32_t, TTLSt>& ttl_st_map, uint64_t& g
     GcAllType(ttl_st_map, gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
 }
 
+bool Segment::ExecuteGc(const TTLSt& ttl_st, uint32_t key_cnt, uint32_t& visited_key_cnt, uint64_t& gc_idx_cnt,
+                        uint64_t& gc_record_cnt, uint64_t& gc_record_byte_size) {
+    BeginGcTick(key_cnt);
+    ExecuteGc(ttl_st, gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+    return EndGcTick(visited_key_cnt);
+}
+
+bool Segment::ExecuteGc(const std::map<uint32_t, TTLSt>& ttl_st_map, uint32_t key_cnt, uint32_t& visited_key_cnt,
+                        uint64_t& gc_idx_cnt, uint64_t& gc_record_cnt, uint64_t& gc_record_byte_size) {
+    BeginGcTick(key_cnt);
+    ExecuteGc(ttl_st_map, gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+    return EndGcTick(visited_key_cnt);
+}
+
+void Segment::BeginGcTick(uint32_t key_cnt) {
+    gc_tick_key_cnt_ = key_cnt;
+    gc_visited_key_cnt_ = 0;
+    gc_pass_done_ = true;
+}
+
+bool Segment::EndGcTick(uint32_t& visited_key_cnt) {
+    visited_key_cnt = gc_visited_key_cnt_;
+    gc_tick_key_cnt_ = 0;
+    // nothing is traversed if the ttl needs no gc, the pass is finished as well
+    if (gc_pass_done_) {
+        gc_cursor_.clear();
+    }
+    return gc_pass_done_;
+}
+
+KeyEntries::Iterator* Segment::NewGcIterator() {
+    KeyEntries::Iterator* it = entries_->NewIterator();
+    if (gc_tick_key_cnt_ > 0 && !gc_cursor_.empty()) {
+        // the key of cursor may be removed already, go on with the next one
+        it->Seek(Slice(gc_cursor_));
+    } else {
+        it->SeekToFirst();
+    }
+    gc_visited_key_cnt_ = 0;
+    return it;
+}
+
+bool Segment::HasGcKey(KeyEntries::Iterator* it) {
+    if (!it->Valid()) {
+        return false;
+    }
+    if (gc_tick_key_cnt_ > 0 && gc_visited_key_cnt_ >= gc_tick_key_cnt_) {
+        return false;
+    }
+    gc_visited_key_cnt_++;
+    return true;
+}
+
+void Segment::SaveGcCursor(KeyEntries::Iterator* it) {
+    if (gc_tick_key_cnt_ > 0 && it->Valid()) {
+        // copy the key, the entry may be released before the next tick
+        Slice key = it->GetKey();
+        gc_cursor_.assign(key.data(), key.size());
+        gc_pass_done_ = false;
+    } else {
+        gc_cursor_.clear();
+    }
+}
+
 void Segment::Gc4Head(uint64_t keep_cnt, uint64_t& gc_idx_cnt, uint64_t& gc_record_cnt, uint64_t& gc_record_byte_size) {
     if (keep_cnt == 0) {
         PDLOG(WARNING, "[Gc4Head] segment gc4head is disabled");
         return;
     }
+    uint32_t ring_cap = ring_cap_.load(std::memory_order_relaxed);
+    if (ring_cap > 0 && keep_cnt >= ring_cap) {
+        // the rings never hold more rows than keep_cnt
+        GcFreeList(gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+        return;
+    }
     uint64_t consumed = ::baidu::common::timer::get_micros();
     uint64_t old = gc_idx_cnt;
-    KeyEntries::Iterator* it = entries_->NewIterator();
-    it->SeekToFirst();
-    while (it->Valid()) {
+    // the memory retired during the traversal is kept until it is done
+    uint64_t epoch = epoch_.Pin();
+    std::vector<DataBlock*> rows;
+    KeyEntries::Iterator* it = NewGcIterator();
+    while (HasGcKey(it)) {
         KeyEntry* entry = (KeyEntry*)it->GetValue();  // NOLINT
         ::openmldb::base::Node<uint64_t, DataBlock*>* node = NULL;
+        rows.clear();
         {
-            std::lock_guard<std::mutex> lock(mu_);
-            if (entry->refs_.load(std::memory_order_acquire) <= 0) {
+            std::lock_guard<std::mutex> lock(GetKeyMutex(it->GetKey()));
+            LatestRing* ring = entry->GetRing();
+            if (ring != NULL) {
+                ring->Trim(keep_cnt, &rows);
+            } else if (entry->IsColdMutable()) {
+                ThawCold(entry);
                 node = entry->entries.SplitByPos(keep_cnt);
             }
         }
-        uint64_t entry_gc_idx_cnt = 0;
-        FreeList(node, entry_gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+        uint64_t entry_gc_idx_cnt = RetireList(node, NULL) + RetireRows(rows);
         entry->count_.fetch_sub(entry_gc_idx_cnt, std::memory_order_relaxed);
         gc_idx_cnt += entry_gc_idx_cnt;
         it->Next();
@@ -501,16 +823,20 @@ void Segment::Gc4Head(uint64_t keep_cnt, uint64_t& gc_idx_cnt, uint64_t& gc_reco
     DEBUGLOG("[Gc4Head] segment gc keep cnt %lu consumed %lu, count %lu", keep_cnt,
              (::baidu::common::timer::get_micros() - consumed) / 1000, gc_idx_cnt - old);
     idx_cnt_.fetch_sub(gc_idx_cnt - old, std::memory_order_relaxed);
+    SaveGcCursor(it);
     delete it;
+    epoch_.UnPin(epoch);
+    GcFreeList(gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
 }
 
 void Segment::GcAllType(const std::map<uint32_t, TTLSt>& ttl_st_map, uint64_t& gc_idx_cnt, uint64_t& gc_record_cnt,
                         uint64_t& gc_record_byte_size) {
     uint64_t old = gc_idx_cnt;
+    // the memory retired during the traversal is kept until it is done
+    uint64_t epoch = epoch_.Pin();
     uint64_t consumed = ::baidu::common::timer::get_micros();
-    KeyEntries::Iterator* it = entries_->NewIterator();
-    it->SeekToFirst();
-    while (it->Valid()) {
+    KeyEntries::Iterator* it = NewGcIterator();
+    while (HasGcKey(it)) {
         KeyEntry** entry_arr = (KeyEntry**)it->GetValue();  // NOLINT
         Slice key = it->GetKey();
         it->Next();
@@ -525,37 +851,42 @@ void Segment::GcAllType(const std::map<uint32_t, TTLSt>& ttl_st_map, uint64_t& g
             }
             KeyEntry* entry = entry_arr[pos->second];
             ::openmldb::base::Node<uint64_t, DataBlock*>* node = NULL;
+            ColdBlock* cold = NULL;
             bool continue_flag = false;
             switch (kv.second.ttl_type) {
                 case ::openmldb::storage::TTLType::kAbsoluteTime: {
                     node = entry->entries.GetLast();
-                    if (node == NULL || node->GetKey() > kv.second.abs_ttl) {
+                    cold = entry->GetCold();
+                    if ((node == NULL || node->GetKey() > kv.second.abs_ttl) && cold == NULL) {
                         continue_flag = true;
                     } else {
                         node = NULL;
-                        std::lock_guard<std::mutex> lock(mu_);
-                        SplitList(entry, kv.second.abs_ttl, &node);
-                        if (entry->entries.IsEmpty()) {
+                        cold = NULL;
+                        std::lock_guard<std::mutex> lock(GetKeyMutex(key));
+                        SplitList(entry, kv.second.abs_ttl, &node, &cold);
+                        if (entry->IsEmpty()) {
                             empty_cnt++;
                         }
                     }
                     break;
                 }
                 case ::openmldb::storage::TTLType::kLatestTime: {
-                    std::lock_guard<std::mutex> lock(mu_);
-                    if (entry->refs_.load(std::memory_order_acquire) <= 0) {
+                    std::lock_guard<std::mutex> lock(GetKeyMutex(key));
+                    if (entry->IsColdMutable()) {
+                        ThawCold(entry);
                         node = entry->entries.SplitByPos(kv.second.lat_ttl);
                     }
                     break;
                 }
                 case ::openmldb::storage::TTLType::kAbsAndLat: {
                     node = entry->entries.GetLast();
-                    if (node == NULL || node->GetKey() > kv.second.abs_ttl) {
+                    if ((node == NULL || node->GetKey() > kv.second.abs_ttl) && entry->GetCold() == NULL) {
                         continue_flag = true;
                     } else {
                         node = NULL;
-                        std::lock_guard<std::mutex> lock(mu_);
-                        if (entry->refs_.load(std::memory_order_acquire) <= 0) {
+                        std::lock_guard<std::mutex> lock(GetKeyMutex(key));
+                        if (entry->IsColdMutable()) {
+                            ThawCold(entry);
                             node = entry->entries.SplitByKeyAndPos(kv.second.abs_ttl, kv.second.lat_ttl);
                         }
                     }
@@ -563,12 +894,13 @@ void Segment::GcAllType(const std::map<uint32_t, TTLSt>& ttl_st_map, uint64_t& g
                 }
                 case ::openmldb::storage::TTLType::kAbsOrLat: {
                     node = entry->entries.GetLast();
-                    if (node == NULL) {
+                    if (node == NULL && entry->GetCold() == NULL) {
                         continue_flag = true;
                     } else {
                         node = NULL;
-                        std::lock_guard<std::mutex> lock(mu_);
-                        if (entry->refs_.load(std::memory_order_acquire) <= 0) {
+                        std::lock_guard<std::mutex> lock(GetKeyMutex(key));
+                        if (entry->IsColdMutable()) {
+                            ThawCold(entry);
                             if (kv.second.abs_ttl == 0) {
                                 node = entry->entries.SplitByPos(kv.second.lat_ttl);
                             } else if (kv.second.lat_ttl == 0) {
@@ -577,20 +909,20 @@ void Segment::GcAllType(const std::map<uint32_t, TTLSt>& ttl_st_map, uint64_t& g
                                 node = entry->entries.SplitByKeyOrPos(kv.second.abs_ttl, kv.second.lat_ttl);
                             }
                         }
-                        if (entry->entries.IsEmpty()) {
+                        if (entry->IsEmpty()) {
                             empty_cnt++;
                         }
                     }
                     break;
                 }
                 default:
-                    return;
+                    PDLOG(WARNING, "ttl type %d is unsupported", kv.second.ttl_type);
+                    continue_flag = true;
             }
             if (continue_flag) {
                 continue;
             }
-            uint64_t entry_gc_idx_cnt = 0;
-            FreeList(node, entry_gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+            uint64_t entry_gc_idx_cnt = RetireList(node, cold);
             entry->count_.fetch_sub(entry_gc_idx_cnt, std::memory_order_relaxed);
             idx_cnt_vec_[pos->second]->fetch_sub(entry_gc_idx_cnt, std::memory_order_relaxed);
             gc_idx_cnt += entry_gc_idx_cnt;
@@ -599,32 +931,37 @@ void Segment::GcAllType(const std::map<uint32_t, TTLSt>& ttl_st_map, uint64_t& g
             bool is_empty = true;
             ::openmldb::base::Node<Slice, void*>* entry_node = NULL;
             {
+                std::lock_guard<std::mutex> key_lock(GetKeyMutex(key));
                 std::lock_guard<std::mutex> lock(mu_);
                 for (uint32_t i = 0; i < ts_cnt_; i++) {
-                    if (!entry_arr[i]->entries.IsEmpty()) {
+                    if (!entry_arr[i]->IsEmpty()) {
                         is_empty = false;
                         break;
                     }
                 }
                 if (is_empty) {
-                    entry_node = entries_->Remove(key);
+                    entry_node = RemoveKeyEntry(key);
                 }
             }
             if (entry_node != NULL) {
-                std::lock_guard<std::mutex> lock(gc_mu_);
-                entry_free_list_->Insert(gc_version_.load(std::memory_order_relaxed), entry_node);
+                RetireEntry(entry_node);
             }
         }
     }
     DEBUGLOG("[GcAll] segment gc consumed %lu, count %lu", (::baidu::common::timer::get_micros() - consumed) / 1000,
              gc_idx_cnt - old);
+    SaveGcCursor(it);
     delete it;
+    epoch_.UnPin(epoch);
+    GcFreeList(gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
 }
 
-void Segment::SplitList(KeyEntry* entry, uint64_t ts, ::openmldb::base::Node<uint64_t, DataBlock*>** node) {
-    // skip entry that ocupied by reader
-    if (entry->refs_.load(std::memory_order_acquire) <= 0) {
-        *node = entry->entries.Split(ts);
+void Segment::SplitList(KeyEntry* entry, uint64_t ts, ::openmldb::base::Node<uint64_t, DataBlock*>** node,
+                        ColdBlock** cold) {
+    // the rows split out are retired, so the readers on them are safe
+    *node = entry->entries.Split(ts);
+    if (entry->IsColdMutable()) {
+        *cold = SplitCold(entry, ts);
     }
 }
 
@@ -633,16 +970,18 @@ void Segment::Gc4TTL(const uint64_t time, uint64_t& gc_idx_cnt, uint64_t& gc_rec
                      uint64_t& gc_record_byte_size) {
     uint64_t consumed = ::baidu::common::timer::get_micros();
     uint64_t old = gc_idx_cnt;
-    KeyEntries::Iterator* it = entries_->NewIterator();
-    it->SeekToFirst();
-    while (it->Valid()) {
+    // the memory retired during the traversal is kept until it is done
+    uint64_t epoch = epoch_.Pin();
+    KeyEntries::Iterator* it = NewGcIterator();
+    while (HasGcKey(it)) {
         KeyEntry* entry = (KeyEntry*)it->GetValue();  // NOLINT
         Slice key = it->GetKey();
         it->Next();
         ::openmldb::base::Node<uint64_t, DataBlock*>* node = entry->entries.GetLast();
-        if (node == NULL) {
+        ColdBlock* cold = entry->GetCold();
+        if (node == NULL && cold == NULL) {
             continue;
-        } else if (node->GetKey() > time) {
+        } else if (node != NULL && node->GetKey() > time && cold == NULL) {
             DEBUGLOG(
                 "[Gc4TTL] segment gc with key %lu need not ttl, last node "
                 "key %lu",
@@ -650,27 +989,30 @@ void Segment::Gc4TTL(const uint64_t time, uint64_t& gc_idx_cnt, uint64_t& gc_rec
             continue;
         }
         node = NULL;
+        cold = NULL;
         ::openmldb::base::Node<Slice, void*>* entry_node = NULL;
         {
+            std::lock_guard<std::mutex> key_lock(GetKeyMutex(key));
             std::lock_guard<std::mutex> lock(mu_);
-            SplitList(entry, time, &node);
-            if (entry->entries.IsEmpty()) {
-                entry_node = entries_->Remove(key);
+            SplitList(entry, time, &node, &cold);
+            if (entry->IsEmpty()) {
+                entry_node = RemoveKeyEntry(key);
             }
         }
         if (entry_node != NULL) {
-            std::lock_guard<std::mutex> lock(gc_mu_);
-            entry_free_list_->Insert(gc_version_.load(std::memory_order_relaxed), entry_node);
+            RetireEntry(entry_node);
         }
-        uint64_t entry_gc_idx_cnt = 0;
-        FreeList(node, entry_gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+        uint64_t entry_gc_idx_cnt = RetireList(node, cold);
         entry->count_.fetch_sub(entry_gc_idx_cnt, std::memory_order_relaxed);
         gc_idx_cnt += entry_gc_idx_cnt;
     }
     DEBUGLOG("[Gc4TTL] segment gc with key %lu ,consumed %lu, count %lu", time,
              (::baidu::common::timer::get_micros() - consumed) / 1000, gc_idx_cnt - old);
     idx_cnt_.fetch_sub(gc_idx_cnt - old, std::memory_order_relaxed);
+    SaveGcCursor(it);
     delete it;
+    epoch_.UnPin(epoch);
+    GcFreeList(gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
 }
 
 void Segment::Gc4TTLAndHead(const uint64_t time, const uint64_t keep_cnt, uint64_t& gc_idx_cnt, uint64_t& gc_record_cnt,
@@ -681,15 +1023,18 @@ void Segment::Gc4TTLAndHead(const uint64_t time, const uint64_t keep_cnt, uint64
     }
     uint64_t consumed = ::baidu::common::timer::get_micros();
     uint64_t old = gc_idx_cnt;
-    KeyEntries::Iterator* it = entries_->NewIterator();
-    it->SeekToFirst();
-    while (it->Valid()) {
+    // the memory retired during the traversal is kept until it is done
+    uint64_t epoch = epoch_.Pin();
+    KeyEntries::Iterator* it = NewGcIterator();
+    while (HasGcKey(it)) {
         KeyEntry* entry = (KeyEntry*)it->GetValue();  // NOLINT
+        Slice key = it->GetKey();
         ::openmldb::base::Node<uint64_t, DataBlock*>* node = entry->entries.GetLast();
         it->Next();
-        if (node == NULL) {
+        bool has_cold = entry->GetCold() != NULL;
+        if (node == NULL && !has_cold) {
             continue;
-        } else if (node->GetKey() > time) {
+        } else if (node != NULL && node->GetKey() > time && !has_cold) {
             DEBUGLOG(
                 "[Gc4TTLAndHead] segment gc with key %lu need not ttl, last "
                 "node key %lu",
@@ -698,13 +1043,13 @@ void Segment::Gc4TTLAndHead(const uint64_t time, const uint64_t keep_cnt, uint64
         }
         node = NULL;
         {
-            std::lock_guard<std::mutex> lock(mu_);
-            if (entry->refs_.load(std::memory_order_acquire) <= 0) {
+            std::lock_guard<std::mutex> lock(GetKeyMutex(key));
+            if (entry->IsColdMutable()) {
+                ThawCold(entry);
                 node = entry->entries.SplitByKeyAndPos(time, keep_cnt);
             }
         }
-        uint64_t entry_gc_idx_cnt = 0;
-        FreeList(node, entry_gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+        uint64_t entry_gc_idx_cnt = RetireList(node, NULL);
         entry->count_.fetch_sub(entry_gc_idx_cnt, std::memory_order_relaxed);
         gc_idx_cnt += entry_gc_idx_cnt;
     }
@@ -713,7 +1058,10 @@ void Segment::Gc4TTLAndHead(const uint64_t time, const uint64_t keep_cnt, uint64
         "count %lu",
         time, keep_cnt, (::baidu::common::timer::get_micros() - consumed) / 1000, gc_idx_cnt - old);
     idx_cnt_.fetch_sub(gc_idx_cnt - old, std::memory_order_relaxed);
+    SaveGcCursor(it);
     delete it;
+    epoch_.UnPin(epoch);
+    GcFreeList(gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
 }
 
 void Segment::Gc4TTLOrHead(const uint64_t time, const uint64_t keep_cnt, uint64_t& gc_idx_cnt, uint64_t& gc_record_cnt,
@@ -730,33 +1078,34 @@ void Segment::Gc4TTLOrHead(const uint64_t time, const uint64_t keep_cnt, uint64_
     }
     uint64_t consumed = ::baidu::common::timer::get_micros();
     uint64_t old = gc_idx_cnt;
-    KeyEntries::Iterator* it = entries_->NewIterator();
-    it->SeekToFirst();
-    while (it->Valid()) {
+    // the memory retired during the traversal is kept until it is done
+    uint64_t epoch = epoch_.Pin();
+    KeyEntries::Iterator* it = NewGcIterator();
+    while (HasGcKey(it)) {
         KeyEntry* entry = (KeyEntry*)it->GetValue();  // NOLINT
         Slice key = it->GetKey();
         it->Next();
         ::openmldb::base::Node<uint64_t, DataBlock*>* node = entry->entries.GetLast();
-        if (node == NULL) {
+        if (node == NULL && entry->GetCold() == NULL) {
             continue;
         }
         node = NULL;
         ::openmldb::base::Node<Slice, void*>* entry_node = NULL;
         {
+            std::lock_guard<std::mutex> key_lock(GetKeyMutex(key));
             std::lock_guard<std::mutex> lock(mu_);
-            if (entry->refs_.load(std::memory_order_acquire) <= 0) {
+            if (entry->IsColdMutable()) {
+                ThawCold(entry);
                 node = entry->entries.SplitByKeyOrPos(time, keep_cnt);
             }
-            if (entry->entries.IsEmpty()) {
-                entry_node = entries_->Remove(key);
+            if (entry->IsEmpty()) {
+                entry_node = RemoveKeyEntry(key);
             }
         }
         if (entry_node != NULL) {
-            std::lock_guard<std::mutex> lock(gc_mu_);
-            entry_free_list_->Insert(gc_version_.load(std::memory_order_relaxed), entry_node);
+            RetireEntry(entry_node);
         }
-        uint64_t entry_gc_idx_cnt = 0;
-        FreeList(node, entry_gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+        uint64_t entry_gc_idx_cnt = RetireList(node, NULL);
         entry->count_.fetch_sub(entry_gc_idx_cnt, std::memory_order_relaxed);
         gc_idx_cnt += entry_gc_idx_cnt;
     }
@@ -765,15 +1114,215 @@ void Segment::Gc4TTLOrHead(const uint64_t time, const uint64_t keep_cnt, uint64_
         "count %lu",
         time, keep_cnt, (::baidu::common::timer::get_micros() - consumed) / 1000, gc_idx_cnt - old);
     idx_cnt_.fetch_sub(gc_idx_cnt - old, std::memory_order_relaxed);
+    SaveGcCursor(it);
     delete it;
+    epoch_.UnPin(epoch);
+    GcFreeList(gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+}
+
+ColdBlock* Segment::SplitCold(KeyEntry* entry, uint64_t ts) {
+    ColdBlock* pre = NULL;
+    ColdBlock* block = entry->cold_.load(std::memory_order_relaxed);
+    while (block != NULL && block->GetMinTs() > ts) {
+        pre = block;
+        block = block->next;
+    }
+    if (block == NULL) {
+        return NULL;
+    }
+    ColdBlock* result = block;
+    if (block->GetMaxTs() > ts) {
+        // only part of the block need to be split out, so split the block into two
+        std::vector<uint64_t> ts_vec;
+        block->DecodeTs(&ts_vec);
+        ColdBlock* newer = new ColdBlock();
+        result = new ColdBlock();
+        for (uint32_t i = 0; i < ts_vec.size(); i++) {
+            if (ts_vec[i] > ts) {
+                newer->Append(ts_vec[i], block->GetRow(i));
+            } else {
+                result->Append(ts_vec[i], block->GetRow(i));
+            }
+        }
+        newer->Seal();
+        result->Seal();
+        result->next = block->next;
+        idx_byte_size_.fetch_add(newer->GetByteSize() + result->GetByteSize(), std::memory_order_relaxed);
+        idx_byte_size_.fetch_sub(block->GetByteSize(), std::memory_order_relaxed);
+        RetireColdBlocks(block, block->next);
+        block = newer;
+    } else {
+        block = NULL;
+    }
+    if (pre == NULL) {
+        entry->cold_.store(block, std::memory_order_release);
+    } else {
+        pre->next = block;
+    }
+    return result;
+}
+
+void Segment::ThawCold(KeyEntry* entry) {
+    ColdBlock* block = entry->cold_.load(std::memory_order_relaxed);
+    if (block == NULL) {
+        return;
+    }
+    entry->cold_.store(NULL, std::memory_order_release);
+    RetireColdBlocks(block, NULL);
+    std::vector<uint64_t> ts_vec;
+    while (block != NULL) {
+        ts_vec.clear();
+        block->DecodeTs(&ts_vec);
+        uint64_t byte_size = 0;
+        for (uint32_t i = 0; i < ts_vec.size(); i++) {
+            DataBlock* row = block->GetRow(i);
+            uint8_t height = entry->entries.Insert(ts_vec[i], row);
+            byte_size += GetRecordTsIdxSize(height);
+        }
+        idx_byte_size_.fetch_add(byte_size, std::memory_order_relaxed);
+        idx_byte_size_.fetch_sub(block->GetByteSize(), std::memory_order_relaxed);
+        block = block->next;
+    }
+}
+
+uint64_t Segment::CompactEntry(const Slice& key, KeyEntry* entry, uint64_t time) {
+    ::openmldb::base::Node<uint64_t, DataBlock*>* node = NULL;
+    uint64_t cnt = 0;
+    {
+        std::lock_guard<std::mutex> lock(GetKeyMutex(key));
+        // skip entry that ocupied by reader
+        if (entry->refs_.load(std::memory_order_acquire) > 0) {
+            return 0;
+        }
+        node = entry->entries.Split(time);
+        if (node == NULL) {
+            return 0;
+        }
+        uint64_t min_ts = node->GetKey();
+        for (auto* cur = node; cur != NULL; cur = cur->GetNextNoBarrier(0)) {
+            min_ts = cur->GetKey();
+            cnt++;
+        }
+        // the cold blocks which are not older than the split rows have to be rebuilt.
+        // it only happens when some rows are put out of order
+        std::vector<uint64_t> cold_ts;
+        std::vector<DataBlock*> cold_rows;
+        ColdBlock* old = entry->cold_.load(std::memory_order_relaxed);
+        ColdBlock* rest = old;
+        while (rest != NULL && rest->GetMaxTs() > min_ts) {
+            rest->DecodeTs(&cold_ts);
+            for (uint32_t i = 0; i < rest->GetCount(); i++) {
+                cold_rows.push_back(rest->GetRow(i));
+            }
+            rest = rest->next;
+        }
+        ColdBlock* head = NULL;
+        ColdBlock* tail = NULL;
+        auto cur = node;
+        uint32_t pos = 0;
+        while (cur != NULL || pos < cold_ts.size()) {
+            if (tail == NULL || tail->IsFull()) {
+                ColdBlock* block = new ColdBlock();
+                if (tail == NULL) {
+                    head = block;
+                } else {
+                    tail->Seal();
+                    idx_byte_size_.fetch_add(tail->GetByteSize(), std::memory_order_relaxed);
+                    tail->next = block;
+                }
+                tail = block;
+            }
+            if (cur != NULL && (pos >= cold_ts.size() || cur->GetKey() >= cold_ts[pos])) {
+                tail->Append(cur->GetKey(), cur->GetValue());
+                cur = cur->GetNextNoBarrier(0);
+            } else {
+                tail->Append(cold_ts[pos], cold_rows[pos]);
+                pos++;
+            }
+        }
+        tail->Seal();
+        idx_byte_size_.fetch_add(tail->GetByteSize(), std::memory_order_relaxed);
+        tail->next = rest;
+        entry->cold_.store(head, std::memory_order_release);
+        RetireColdBlocks(old, rest);
+        for (ColdBlock* block = old; block != rest; block = block->next) {
+            idx_byte_size_.fetch_sub(block->GetByteSize(), std::memory_order_relaxed);
+        }
+    }
+    // the rows are moved to cold blocks, only the nodes are released
+    epoch_.Retire([this, node]() {
+        auto* cur = node;
+        while (cur != NULL) {
+            auto* tmp = cur;
+            idx_byte_size_.fetch_sub(GetRecordTsIdxSize(tmp->Height()), std::memory_order_relaxed);
+            cur = cur->GetNextNoBarrier(0);
+            delete tmp;
+        }
+    });
+    return cnt;
+}
+
+uint64_t Segment::CompactCold(uint64_t time) {
+    if (ts_cnt_ > 1) {
+        return 0;
+    }
+    uint64_t consumed = ::baidu::common::timer::get_micros();
+    uint64_t cnt = 0;
+    EpochGuard guard(&epoch_);
+    KeyEntries::Iterator* it = entries_->NewIterator();
+    it->SeekToFirst();
+    while (it->Valid()) {
+        KeyEntry* entry = (KeyEntry*)it->GetValue();  // NOLINT
+        Slice key = it->GetKey();
+        it->Next();
+        ::openmldb::base::Node<uint64_t, DataBlock*>* node = entry->entries.GetLast();
+        if (node == NULL || entry->entries.IsEmpty() || node->GetKey() > time) {
+            continue;
+        }
+        cnt += CompactEntry(key, entry, time);
+    }
+    delete it;
+    DEBUGLOG("[CompactCold] segment compact with key %lu, consumed %lu, count %lu", time,
+             (::baidu::common::timer::get_micros() - consumed) / 1000, cnt);
+    return cnt;
+}
+
+uint64_t Segment::CompactCold(uint32_t idx, uint64_t time) {
+    auto pos = ts_idx_map_.find(idx);
+    if (pos == ts_idx_map_.end()) {
+        return 0;
+    }
+    if (ts_cnt_ == 1) {
+        return CompactCold(time);
+    }
+    uint64_t consumed = ::baidu::common::timer::get_micros();
+    uint64_t cnt = 0;
+    EpochGuard guard(&epoch_);
+    KeyEntries::Iterator* it = entries_->NewIterator();
+    it->SeekToFirst();
+    while (it->Valid()) {
+        KeyEntry* entry = ((KeyEntry**)it->GetValue())[pos->second];  // NOLINT
+        Slice key = it->GetKey();
+        it->Next();
+        ::openmldb::base::Node<uint64_t, DataBlock*>* node = entry->entries.GetLast();
+        if (node == NULL || entry->entries.IsEmpty() || node->GetKey() > time) {
+            continue;
+        }
+        cnt += CompactEntry(key, entry, time);
+    }
+    delete it;
+    DEBUGLOG("[CompactCold] segment compact idx %u with key %lu, consumed %lu, count %lu", idx, time,
+             (::baidu::common::timer::get_micros() - consumed) / 1000, cnt);
+    return cnt;
 }
 
 int Segment::GetCount(const Slice& key, uint64_t& count) {
     if (ts_cnt_ > 1) {
         return -1;
     }
+    EpochGuard guard(&epoch_);
     void* entry = NULL;
-    if (entries_->Get(key, entry) < 0 || entry == NULL) {
+    if (GetKeyEntry(key, entry) < 0 || entry == NULL) {
         return -1;
     }
     count = ((KeyEntry*)entry)->count_.load(std::memory_order_relaxed);  // NOLINT
@@ -788,8 +1337,9 @@ int Segment::GetCount(const Slice& key, uint32_t idx, uint64_t& count) {
     if (ts_cnt_ == 1) {
         return GetCount(key, count);
     }
+    EpochGuard guard(&epoch_);
     void* entry_arr = NULL;
-    if (entries_->Get(key, entry_arr) < 0 || entry_arr == NULL) {
+    if (GetKeyEntry(key, entry_arr) < 0 || entry_arr == NULL) {
         return -1;
     }
     count = ((KeyEntry**)entry_arr)[pos->second]->count_.load(  // NOLINT
@@ -802,12 +1352,13 @@ MemTableIterator* Segment::NewIterator(const Slice& key, Ticket& ticket) {
     if (entries_ == NULL || ts_cnt_ > 1) {
         return new MemTableIterator(NULL);
     }
+    ticket.Pin(&epoch_);
     void* entry = NULL;
-    if (entries_->Get(key, entry) < 0 || entry == NULL) {
+    if (GetKeyEntry(key, entry) < 0 || entry == NULL) {
         return new MemTableIterator(NULL);
     }
-    ticket.Push((KeyEntry*)entry);                                           // NOLINT
-    return new MemTableIterator(((KeyEntry*)entry)->entries.NewIterator());  // NOLINT
+    ticket.Push((KeyEntry*)entry);                                      // NOLINT
+    return new MemTableIterator(new KeyEntryIterator((KeyEntry*)entry));  // NOLINT
 }
 
 MemTableIterator* Segment::NewIterator(const Slice& key, uint32_t idx, Ticket& ticket) {
@@ -818,15 +1369,16 @@ MemTableIterator* Segment::NewIterator(const Slice& key, uint32_t idx, Ticket& t
     if (ts_cnt_ == 1) {
         return NewIterator(key, ticket);
     }
+    ticket.Pin(&epoch_);
     void* entry_arr = NULL;
-    if (entries_->Get(key, entry_arr) < 0 || entry_arr == NULL) {
+    if (GetKeyEntry(key, entry_arr) < 0 || entry_arr == NULL) {
         return new MemTableIterator(NULL);
     }
-    ticket.Push(((KeyEntry**)entry_arr)[pos->second]);                                         // NOLINT
-    return new MemTableIterator(((KeyEntry**)entry_arr)[pos->second]->entries.NewIterator());  // NOLINT
+    ticket.Push(((KeyEntry**)entry_arr)[pos->second]);                                    // NOLINT
+    return new MemTableIterator(new KeyEntryIterator(((KeyEntry**)entry_arr)[pos->second]));  // NOLINT
 }
 
-MemTableIterator::MemTableIterator(TimeEntries::Iterator* it) : it_(it) {}
+MemTableIterator::MemTableIterator(KeyEntryIterator* it) : it_(it) {}
 
 MemTableIterator::~MemTableIterator() {
     if (it_ != NULL) {
@@ -875,5 +1427,91 @@ void MemTableIterator::SeekToLast() {
     it_->SeekToLast();
 }
 
+KeyEntryIterator::KeyEntryIterator(KeyEntry* entry)
+    : entry_(entry),
+      hot_it_(entry->entries.NewIterator()),
+      cold_it_(),
+      hot_cur_(false),
+      ring_(entry->GetRing()),
+      ring_rows_(),
+      ring_pos_(0) {}
+
+KeyEntryIterator::~KeyEntryIterator() { delete hot_it_; }
+
+void KeyEntryIterator::Pick() {
+    if (ring_ != NULL) {
+        return;
+    }
+    // the row in skiplist goes first if it has the same time with the cold one
+    hot_cur_ = hot_it_->Valid() && (!cold_it_.Valid() || hot_it_->GetKey() >= cold_it_.GetKey());
+}
+
+void KeyEntryIterator::Advance() {
+    if (ring_ != NULL) {
+        ring_pos_++;
+    } else if (hot_cur_) {
+        hot_it_->Next();
+    } else {
+        cold_it_.Next();
+    }
+}
+
+void KeyEntryIterator::Next() {
+    Advance();
+    Pick();
+}
+
+void KeyEntryIterator::Seek(const uint64_t time) {
+    if (ring_ != NULL) {
+        ring_->Read(&ring_rows_);
+        ring_pos_ = 0;
+        while (ring_pos_ < ring_rows_.size() && ring_rows_[ring_pos_].first > time) {
+            ring_pos_++;
+        }
+        Pick();
+        return;
+    }
+    hot_it_->Seek(time);
+    cold_it_.Seek(entry_->GetCold(), time);
+    Pick();
+}
+
+void KeyEntryIterator::SeekToFirst() {
+    if (ring_ != NULL) {
+        ring_->Read(&ring_rows_);
+        ring_pos_ = 0;
+        Pick();
+        return;
+    }
+    hot_it_->SeekToFirst();
+    cold_it_.SeekToFirst(entry_->GetCold());
+    Pick();
+}
+
+void KeyEntryIterator::SeekToLast() {
+    if (ring_ != NULL) {
+        ring_->Read(&ring_rows_);
+        // only the last row is valid like skiplist
+        ring_pos_ = ring_rows_.empty() ? 0 : ring_rows_.size() - 1;
+        Pick();
+        return;
+    }
+    hot_it_->SeekToLast();
+    // the tail of skiplist points to the head node after all nodes are split out
+    if (hot_it_->Valid() && entry_->entries.IsEmpty()) {
+        hot_it_->Next();
+    }
+    cold_it_.SeekToLast(entry_->GetCold());
+    if (hot_it_->Valid() && cold_it_.Valid()) {
+        // only keep the one with the smallest time valid
+        if (hot_it_->GetKey() < cold_it_.GetKey()) {
+            cold_it_ = ColdBlock::Iterator();
+        } else {
+            hot_it_->Next();
+        }
+    }
+    Pick();
+}
+
 }  // namespace storage
 }  // namespace openmldb
@@ -21,12 +21,19 @@
 #include <map>
 #include <memory>
 #include <mutex>  // NOLINT
+#include <string>
+#include <utility>
 #include <vector>
 
+#include "base/mem_pool.h"
 #include "base/skiplist.h"
 #include "base/slice.h"
 #include "proto/tablet.pb.h"
+#include "storage/cold_block.h"
+#include "storage/epoch.h"
 #include "storage/iterator.h"
+#include "storage/key_hash_index.h"
+#include "storage/latest_ring.h"
 #include "storage/schema.h"
 #include "storage/ticket.h"
 
@@ -41,18 +48,21 @@ class Segment;
 class Ticket;
 
 struct DataBlock {
-    // dimension count down
-    uint8_t dim_cnt_down;
+    // dimension count down, the indexes holding the block are gc concurrently
+    std::atomic<uint8_t> dim_cnt_down;
+    // the block and its data are allocated together from a SlabMemoryPool
+    bool in_pool;
     uint32_t size;
     char* data;
 
-    DataBlock(uint8_t dim_cnt, const char* input, uint32_t len) : dim_cnt_down(dim_cnt), size(len), data(NULL) {
+    DataBlock(uint8_t dim_cnt, const char* input, uint32_t len)
+        : dim_cnt_down(dim_cnt), in_pool(false), size(len), data(NULL) {
         data = new char[len];
         memcpy(data, input, len);
     }
 
     DataBlock(uint8_t dim_cnt, char* input, uint32_t len, bool skip_copy)
-        : dim_cnt_down(dim_cnt), size(len), data(NULL) {
+        : dim_cnt_down(dim_cnt), in_pool(false), size(len), data(NULL) {
         if (skip_copy) {
             data = input;
         } else {
@@ -62,11 +72,46 @@ struct DataBlock {
     }
 
     ~DataBlock() {
-        delete[] data;
+        if (!in_pool) {
+            delete[] data;
+        }
         data = NULL;
     }
 };
 
+// allocate the block header and the row data in one piece of memory from pool.
+// it falls back to heap if pool is NULL or the row is too large for a slab
+static inline DataBlock* NewDataBlock(::openmldb::base::SlabMemoryPool* pool, uint8_t dim_cnt, const char* input,
+                                      uint32_t len) {
+    char* mem = pool == NULL ? NULL : pool->Alloc(sizeof(DataBlock) + len);
+    if (mem == NULL) {
+        return new DataBlock(dim_cnt, input, len);
+    }
+    char* buf = mem + sizeof(DataBlock);
+    memcpy(buf, input, len);
+    DataBlock* block = new (mem) DataBlock(dim_cnt, buf, len, true);
+    block->in_pool = true;
+    return block;
+}
+
+static inline void DeleteDataBlock(DataBlock* block) {
+    if (block->in_pool) {
+        block->~DataBlock();
+        ::openmldb::base::SlabMemoryPool::Free(block);
+    } else {
+        delete block;
+    }
+}
+
+// drop the reference of one index, the last one deletes the block. return true if the block is deleted
+static inline bool UnRefDataBlock(DataBlock* block) {
+    if (block->dim_cnt_down.fetch_sub(1, std::memory_order_acq_rel) > 1) {
+        return false;
+    }
+    DeleteDataBlock(block);
+    return true;
+}
+
 // the desc time comparator
 struct TimeComparator {
     int operator()(const uint64_t& a, const uint64_t& b) const {
@@ -82,9 +127,11 @@ struct TimeComparator {
 static const TimeComparator tcmp;
 typedef ::openmldb::base::Skiplist<uint64_t, DataBlock*, TimeComparator> TimeEntries;
 
+class KeyEntryIterator;
+
 class MemTableIterator : public TableIterator {
  public:
-    explicit MemTableIterator(TimeEntries::Iterator* it);
+    explicit MemTableIterator(KeyEntryIterator* it);
     virtual ~MemTableIterator();
     void Seek(const uint64_t time) override;
     bool Valid() override;
@@ -95,13 +142,13 @@ class MemTableIterator : public TableIterator {
     void SeekToLast() override;
 
  private:
-    TimeEntries::Iterator* it_;
+    KeyEntryIterator* it_;
 };
 
 class KeyEntry {
  public:
-    KeyEntry() : entries(12, 4, tcmp), refs_(0), count_(0) {}
-    explicit KeyEntry(uint8_t height) : entries(height, 4, tcmp), refs_(0), count_(0) {}
+    KeyEntry() : entries(12, 4, tcmp), refs_(0), count_(0), cold_(NULL), ring_(NULL) {}
+    explicit KeyEntry(uint8_t height) : entries(height, 4, tcmp), refs_(0), count_(0), cold_(NULL), ring_(NULL) {}
     ~KeyEntry() {}
 
     // just return the count of datablock
@@ -111,17 +158,33 @@ class KeyEntry {
         it->SeekToFirst();
         while (it->Valid()) {
             cnt += 1;
-            DataBlock* block = it->GetValue();
             // Avoid double free
-            if (block->dim_cnt_down > 1) {
-                block->dim_cnt_down--;
-            } else {
-                delete block;
-            }
+            UnRefDataBlock(it->GetValue());
             it->Next();
         }
         entries.Clear();
         delete it;
+        ColdBlock* cold = cold_.load(std::memory_order_relaxed);
+        while (cold != NULL) {
+            for (uint32_t i = 0; i < cold->GetCount(); i++) {
+                cnt += 1;
+                UnRefDataBlock(cold->GetRow(i));
+            }
+            ColdBlock* tmp = cold;
+            cold = cold->next;
+            delete tmp;
+        }
+        cold_.store(NULL, std::memory_order_relaxed);
+        LatestRing* ring = ring_.exchange(NULL, std::memory_order_relaxed);
+        if (ring != NULL) {
+            std::vector<std::pair<uint64_t, DataBlock*>> rows;
+            ring->Read(&rows);
+            for (const auto& kv : rows) {
+                cnt += 1;
+                UnRefDataBlock(kv.second);
+            }
+            delete ring;
+        }
         return cnt;
     }
 
@@ -129,21 +192,100 @@ class KeyEntry {
 
     void UnRef() { refs_.fetch_sub(1, std::memory_order_relaxed); }
 
+    // the cold blocks are relinked in place, so it's only allowed when no reader is on the entry
+    bool IsColdMutable() { return GetCold() == NULL || refs_.load(std::memory_order_acquire) <= 0; }
+
     uint64_t GetCount() { return count_.load(std::memory_order_relaxed); }
 
+    ColdBlock* GetCold() const { return cold_.load(std::memory_order_acquire); }
+
+    LatestRing* GetRing() const { return ring_.load(std::memory_order_acquire); }
+
+    bool IsEmpty() {
+        LatestRing* ring = GetRing();
+        return entries.IsEmpty() && GetCold() == NULL && (ring == NULL || ring->GetSize() == 0);
+    }
+
+    DataBlock* Get(uint64_t time) {
+        LatestRing* ring = GetRing();
+        if (ring != NULL) {
+            return ring->Get(time);
+        }
+        DataBlock* block = NULL;
+        if (entries.Get(time, block) == 0) {
+            return block;
+        }
+        ColdBlock::Iterator it;
+        it.Seek(GetCold(), time);
+        if (it.Valid() && it.GetKey() == time) {
+            return it.GetValue();
+        }
+        return NULL;
+    }
+
  public:
     TimeEntries entries;
+    // the readers on the entry, the cold blocks are not relinked while it's referenced
     std::atomic<uint64_t> refs_;
     std::atomic<uint64_t> count_;
+    // the old rows moved out of entries, it's only changed with the key lock held and no reader
+    std::atomic<ColdBlock*> cold_;
+    // the rows of a latest-N index are kept in the ring instead of entries if it's not NULL,
+    // it's only changed with the key lock held
+    std::atomic<LatestRing*> ring_;
     friend Segment;
 };
 
+// iterate the rows of key entry in descending order of time by merging
+// the skiplist and the cold blocks.
+// if the entry keeps rows in a ring, the rows are copied out on seek
+class KeyEntryIterator {
+ public:
+    explicit KeyEntryIterator(KeyEntry* entry);
+    ~KeyEntryIterator();
+    KeyEntryIterator(const KeyEntryIterator&) = delete;
+    KeyEntryIterator& operator=(const KeyEntryIterator&) = delete;
+
+    bool Valid() const {
+        return ring_ != NULL ? ring_pos_ < ring_rows_.size() : hot_cur_ || cold_it_.Valid();
+    }
+    void Next();
+    const uint64_t& GetKey() const {
+        if (ring_ != NULL) {
+            return ring_rows_[ring_pos_].first;
+        }
+        return hot_cur_ ? hot_it_->GetKey() : cold_it_.GetKey();
+    }
+    DataBlock* GetValue() const {
+        if (ring_ != NULL) {
+            return ring_rows_[ring_pos_].second;
+        }
+        return hot_cur_ ? hot_it_->GetValue() : cold_it_.GetValue();
+    }
+    void Seek(const uint64_t time);
+    void SeekToFirst();
+    void SeekToLast();
+
+ private:
+    void Pick();
+    void Advance();
+
+ private:
+    KeyEntry* entry_;
+    TimeEntries::Iterator* hot_it_;
+    ColdBlock::Iterator cold_it_;
+    // the current row is from skiplist
+    bool hot_cur_;
+    LatestRing* ring_;
+    std::vector<std::pair<uint64_t, DataBlock*>> ring_rows_;
+    uint32_t ring_pos_;
+};
+
 struct SliceComparator {
     int operator()(const ::openmldb::base::Slice& a, const ::openmldb::base::Slice& b) const { return a.compare(b); }
 };
 
 typedef ::openmldb::base::Skiplist<::openmldb::base::Slice, void*, SliceComparator> KeyEntries;
-typedef ::openmldb::base::Skiplist<uint64_t, ::openmldb::base::Node<Slice, void*>*, TimeComparator> KeyEntryNodeList;
 
 class Segment {
  public:
@@ -163,6 +305,14 @@ class Segment {
 
     void Put(const Slice& key, const std::map<int32_t, uint64_t>& ts_map, DataBlock* row);
 
+    // ts holds the time of every ts column of segment in order
+    void Put(const Slice& key, const uint64_t* ts, DataBlock* row);
+
+    // allocate row from the memory pool of segment if it is enabled
+    DataBlock* AllocDataBlock(uint8_t dim_cnt, const char* data, uint32_t size) {
+        return NewDataBlock(mem_pool_, dim_cnt, data, size);
+    }
+
     // Get time data
     bool Get(const Slice& key, uint64_t time, DataBlock** block);
 
@@ -176,6 +326,14 @@ class Segment {
                    uint64_t& gc_record_cnt, uint64_t& gc_record_byte_size);            // NOLINT
     void ExecuteGc(const std::map<uint32_t, TTLSt>& ttl_st_map, uint64_t& gc_idx_cnt,  // NOLINT
                    uint64_t& gc_record_cnt, uint64_t& gc_record_byte_size);            // NOLINT
+    // incremental gc, visit at most key_cnt keys from the key the last call stopped at and
+    // 0 means all keys. return true if the pass over all keys of the segment is finished
+    bool ExecuteGc(const TTLSt& ttl_st, uint32_t key_cnt, uint32_t& visited_key_cnt,  // NOLINT
+                   uint64_t& gc_idx_cnt, uint64_t& gc_record_cnt,                     // NOLINT
+                   uint64_t& gc_record_byte_size);                                    // NOLINT
+    bool ExecuteGc(const std::map<uint32_t, TTLSt>& ttl_st_map, uint32_t key_cnt,     // NOLINT
+                   uint32_t& visited_key_cnt, uint64_t& gc_idx_cnt,                   // NOLINT
+                   uint64_t& gc_record_cnt, uint64_t& gc_record_byte_size);           // NOLINT
 
     void Gc4TTL(const uint64_t time, uint64_t& gc_idx_cnt,  // NOLINT
                 uint64_t& gc_record_cnt,                    // NOLINT
@@ -226,53 +384,119 @@ class Segment {
 
     const std::map<uint32_t, uint32_t>& GetTsIdxMap() const { return ts_idx_map_; }
 
-    inline uint64_t GetIdxByteSize() { return idx_byte_size_.load(std::memory_order_relaxed); }
+    inline uint64_t GetIdxByteSize() {
+        return idx_byte_size_.load(std::memory_order_relaxed) + (key_index_ != NULL ? key_index_->GetByteSize() : 0);
+    }
 
     inline uint64_t GetPkCnt() { return pk_cnt_.load(std::memory_order_relaxed); }
 
+    // release the retired memory which can not be observed by readers any more
+    // and collect the statistics of the memory released since last call
     void GcFreeList(uint64_t& entry_gc_idx_cnt,      // NOLINT
                     uint64_t& gc_record_cnt,         // NOLINT
                     uint64_t& gc_record_byte_size);  // NOLINT
 
+    // the readers pin it with a Ticket before looking up the segment
+    EpochManager* GetEpoch() { return &epoch_; }
+
     KeyEntries* GetKeyEntries() { return entries_; }
 
     int GetCount(const Slice& key, uint64_t& count);                // NOLINT
     int GetCount(const Slice& key, uint32_t idx, uint64_t& count);  // NOLINT
 
-    void IncrGcVersion() { gc_version_.fetch_add(1, std::memory_order_relaxed); }
-
     void ReleaseAndCount(uint64_t& gc_idx_cnt,            // NOLINT
                          uint64_t& gc_record_cnt,         // NOLINT
                          uint64_t& gc_record_byte_size);  // NOLINT
 
+    // keep the rows of a key in a ring of capacity for the latest-N index with one ts column,
+    // it must be set before any put
+    void EnableLatestRing(uint32_t capacity);
+    // move the rows in rings back to skiplists, e.g. the ttl is changed
+    void DisableLatestRing();
+    inline uint32_t GetLatestRingCapacity() const { return ring_cap_.load(std::memory_order_relaxed); }
+
+    // move the rows whose time is not larger than the input time from skiplist
+    // to cold blocks, return the count of moved rows
+    uint64_t CompactCold(uint64_t time);
+    uint64_t CompactCold(uint32_t idx, uint64_t time);
+
  private:
     void FreeList(::openmldb::base::Node<uint64_t, DataBlock*>* node, uint64_t& gc_idx_cnt,  // NOLINT
                   uint64_t& gc_record_cnt,         // NOLINT
                   uint64_t& gc_record_byte_size);  // NOLINT
-    void SplitList(KeyEntry* entry, uint64_t ts, ::openmldb::base::Node<uint64_t, DataBlock*>** node);
-
-    void GcEntryFreeList(uint64_t version, uint64_t& gc_idx_cnt,  // NOLINT
-                         uint64_t& gc_record_cnt,                 // NOLINT
-                         uint64_t& gc_record_byte_size);          // NOLINT
+    void SplitList(KeyEntry* entry, uint64_t ts, ::openmldb::base::Node<uint64_t, DataBlock*>** node,
+                   ColdBlock** cold);
+    void FreeColdList(ColdBlock* block, uint64_t& gc_idx_cnt,  // NOLINT
+                      uint64_t& gc_record_cnt,                 // NOLINT
+                      uint64_t& gc_record_byte_size);          // NOLINT
+    uint64_t CompactEntry(const Slice& key, KeyEntry* entry, uint64_t time);
+    // the following functions need the key lock held and no reader on the entry
+    ColdBlock* SplitCold(KeyEntry* entry, uint64_t ts);
+    void ThawCold(KeyEntry* entry);
+
+    void BeginGcTick(uint32_t key_cnt);
+    bool EndGcTick(uint32_t& visited_key_cnt);  // NOLINT
+    // the gc traversal starts from the cursor and stops after gc_tick_key_cnt_ keys
+    KeyEntries::Iterator* NewGcIterator();
+    bool HasGcKey(KeyEntries::Iterator* it);
+    void SaveGcCursor(KeyEntries::Iterator* it);
+
+    std::mutex& GetKeyMutex(const Slice& key);
+    // look up the key entry by the hash index if it's enabled, the caller must pin epoch_
+    // or hold mu_ because the nodes of other keys may be released
+    int GetKeyEntry(const Slice& key, void*& entry);  // NOLINT
+    // remove the key from entries_ and the hash index, mu_ must be held
+    ::openmldb::base::Node<Slice, void*>* RemoveKeyEntry(const Slice& key);
+    // insert the key entry of a new key, the key lock must be held
+    void* InsertKeyEntry(const Slice& key, uint32_t& byte_size);  // NOLINT
+
+    // the memory unlinked from the segment is retired to epoch_ and released once
+    // no reader can observe it, return the count of rows retired
+    uint64_t RetireList(::openmldb::base::Node<uint64_t, DataBlock*>* node, ColdBlock* cold);
+    void RetireEntry(::openmldb::base::Node<Slice, void*>* entry_node);
+    // return the count of rows retired
+    uint64_t RetireRows(const std::vector<DataBlock*>& rows);
+    void FreeRing(LatestRing* ring, uint64_t& gc_idx_cnt,  // NOLINT
+                  uint64_t& gc_record_cnt,                 // NOLINT
+                  uint64_t& gc_record_byte_size);          // NOLINT
+    // retire the blocks from head to end, the rows are not released with them
+    void RetireColdBlocks(ColdBlock* head, ColdBlock* end);
     void FreeEntry(::openmldb::base::Node<Slice, void*>* entry_node, uint64_t& gc_idx_cnt,  // NOLINT
                    uint64_t& gc_record_cnt,         // NOLINT
                    uint64_t& gc_record_byte_size);  // NOLINT
 
  private:
+    static const uint32_t KEY_MU_CNT = 16;
+
     KeyEntries* entries_;
-    // only Put need mutex
+    // the point lookups of keys go to the hash index if it's enabled
+    KeyHashIndex* key_index_;
+    // protect the insertion and removal of entries_
     std::mutex mu_;
-    std::mutex gc_mu_;
+    // puts and gc on the entries of one key are serialized by the key lock. keys
+    // are striped over the locks, so puts to different keys run in parallel
+    std::mutex key_mu_[KEY_MU_CNT];
     std::atomic<uint64_t> idx_cnt_;
     std::atomic<uint64_t> idx_byte_size_;
     std::atomic<uint64_t> pk_cnt_;
     uint8_t key_entry_max_height_;
-    KeyEntryNodeList* entry_free_list_;
     uint32_t ts_cnt_;
-    std::atomic<uint64_t> gc_version_;
+    EpochManager epoch_;
+    // the statistics of the retired memory released by epoch_ and not collected by GcFreeList
+    std::atomic<uint64_t> reclaimed_idx_cnt_;
+    std::atomic<uint64_t> reclaimed_record_cnt_;
+    std::atomic<uint64_t> reclaimed_record_byte_size_;
+    // the state of incremental gc. the gc of one segment runs in one task at a time
+    std::string gc_cursor_;
+    uint32_t gc_tick_key_cnt_;
+    uint32_t gc_visited_key_cnt_;
+    bool gc_pass_done_;
+    // the capacity of the rings of new keys, 0 means the rows are kept in skiplists
+    std::atomic<uint32_t> ring_cap_;
     std::map<uint32_t, uint32_t> ts_idx_map_;
     std::vector<std::shared_ptr<std::atomic<uint64_t>>> idx_cnt_vec_;
     uint64_t ttl_offset_;
+    ::openmldb::base::SlabMemoryPool* mem_pool_;
 };
 
 }  // namespace storage
@@ -17,13 +17,25 @@
 #include "storage/segment.h"
 
 #include <iostream>
+#include <map>
+#include <memory>
 #include <string>
+#include <thread>  // NOLINT
+#include <vector>
 
 #include "base/glog_wapper.h"  // NOLINT
 #include "base/slice.h"
+#include "common/timer.h"
+#include "gflags/gflags.h"
 #include "gtest/gtest.h"
+#include "storage/key_hash_index.h"
+#include "storage/latest_ring.h"
 #include "storage/record.h"
 
+DECLARE_bool(enable_segment_mem_pool);
+DECLARE_bool(enable_key_hash_index);
+DECLARE_uint32(key_hash_index_bucket_cnt);
+
 using ::openmldb::base::Slice;
 
 namespace openmldb {
@@ -37,7 +49,7 @@ class SegmentTest : public ::testing::Test {
 
 TEST_F(SegmentTest, Size) {
     ASSERT_EQ(16, (int64_t)sizeof(DataBlock));
-    ASSERT_EQ(40, (int64_t)sizeof(KeyEntry));
+    ASSERT_EQ(56, (int64_t)sizeof(KeyEntry));
 }
 
 TEST_F(SegmentTest, DataBlock) {
@@ -51,6 +63,276 @@ TEST_F(SegmentTest, DataBlock) {
     delete db;
 }
 
+TEST_F(SegmentTest, NewDataBlock) {
+    ::openmldb::base::SlabMemoryPool pool;
+    DataBlock* db = NewDataBlock(&pool, 2, "test", 4);
+    ASSERT_TRUE(db->in_pool);
+    ASSERT_EQ(2, (int64_t)db->dim_cnt_down);
+    ASSERT_EQ("test", std::string(db->data, db->size));
+    ASSERT_EQ(reinterpret_cast<char*>(db) + sizeof(DataBlock), db->data);
+    DeleteDataBlock(db);
+    std::string large(::openmldb::base::SlabMemoryPool::MAX_ALLOC_SIZE, 'a');
+    db = NewDataBlock(&pool, 1, large.c_str(), large.size());
+    ASSERT_FALSE(db->in_pool);
+    ASSERT_EQ(large, std::string(db->data, db->size));
+    DeleteDataBlock(db);
+    db = NewDataBlock(NULL, 1, "test", 4);
+    ASSERT_FALSE(db->in_pool);
+    DeleteDataBlock(db);
+}
+
+TEST_F(SegmentTest, MemPoolPutAndGc) {
+    FLAGS_enable_segment_mem_pool = true;
+    int64_t slab_cnt = ::openmldb::base::MemorySlab::LiveSlabCnt().load();
+    {
+        Segment segment;
+        std::string value(100, 'v');
+        for (int i = 0; i < 10000; i++) {
+            segment.Put(Slice("pk" + std::to_string(i % 10)), 1000 + i, value.c_str(), value.size());
+        }
+        ASSERT_GT(::openmldb::base::MemorySlab::LiveSlabCnt().load(), slab_cnt + 10);
+        {
+            Ticket ticket;
+            MemTableIterator* it = segment.NewIterator("pk3", ticket);
+            it->SeekToFirst();
+            ASSERT_TRUE(it->Valid());
+            ASSERT_EQ(10993, (int64_t)it->GetKey());
+            ASSERT_EQ(value, it->GetValue().ToString());
+            delete it;
+        }
+        uint64_t gc_idx_cnt = 0;
+        uint64_t gc_record_cnt = 0;
+        uint64_t gc_record_byte_size = 0;
+        segment.Gc4TTL(10999, gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+        ASSERT_EQ(10000, (int64_t)gc_record_cnt);
+        ASSERT_EQ(10000 * GetRecordSize(value.size()), gc_record_byte_size);
+        // only the slab held by the pool is left
+        ASSERT_EQ(slab_cnt + 1, ::openmldb::base::MemorySlab::LiveSlabCnt().load());
+    }
+    ASSERT_EQ(slab_cnt, ::openmldb::base::MemorySlab::LiveSlabCnt().load());
+    FLAGS_enable_segment_mem_pool = false;
+}
+
+TEST_F(SegmentTest, KeyHashIndex) {
+    EpochManager epoch;
+    KeyHashIndex index(&epoch, 2);
+    std::vector<std::string> keys;
+    for (int i = 0; i < 1000; i++) {
+        keys.push_back("key" + std::to_string(i));
+    }
+    for (int i = 0; i < 1000; i++) {
+        index.Insert(Slice(keys[i]), &keys[i]);
+    }
+    ASSERT_EQ(1000u, index.GetSize());
+    // the old buckets are retired when the index grows
+    ASSERT_GT(epoch.GetRetiredCnt(), 0u);
+    for (int i = 0; i < 1000; i++) {
+        ASSERT_EQ(&keys[i], index.Get(Slice("key" + std::to_string(i))));
+    }
+    ASSERT_TRUE(index.Get(Slice("key1000")) == NULL);
+    for (int i = 0; i < 1000; i += 2) {
+        ASSERT_TRUE(index.Remove(Slice(keys[i])));
+    }
+    ASSERT_FALSE(index.Remove(Slice(keys[0])));
+    ASSERT_EQ(500u, index.GetSize());
+    for (int i = 0; i < 1000; i++) {
+        ASSERT_EQ(i % 2 == 0, index.Get(Slice(keys[i])) == NULL);
+    }
+    epoch.Reclaim();
+    ASSERT_EQ(0u, epoch.GetRetiredCnt());
+    index.Clear();
+    ASSERT_EQ(0u, index.GetSize());
+    ASSERT_TRUE(index.Get(Slice(keys[1])) == NULL);
+}
+
+TEST_F(SegmentTest, KeyHashIndexGrowIncrementally) {
+    EpochManager epoch;
+    KeyHashIndex index(&epoch, 256);
+    std::vector<std::string> keys;
+    for (int i = 0; i < 1000; i++) {
+        keys.push_back("key" + std::to_string(i));
+    }
+    // the index grows at the 257th key, the buckets of the old table are only partly migrated after 260 keys
+    for (int i = 0; i < 260; i++) {
+        index.Insert(Slice(keys[i]), &keys[i]);
+    }
+    ASSERT_EQ(0u, epoch.GetRetiredCnt());
+    for (int i = 0; i < 260; i++) {
+        ASSERT_EQ(&keys[i], index.Get(Slice(keys[i])));
+    }
+    for (int i = 0; i < 260; i += 2) {
+        ASSERT_TRUE(index.Remove(Slice(keys[i])));
+    }
+    ASSERT_EQ(130u, index.GetSize());
+    for (int i = 0; i < 260; i++) {
+        ASSERT_EQ(i % 2 == 0, index.Get(Slice(keys[i])) == NULL);
+    }
+    for (int i = 260; i < 1000; i++) {
+        index.Insert(Slice(keys[i]), &keys[i]);
+    }
+    ASSERT_EQ(870u, index.GetSize());
+    for (int i = 0; i < 1000; i++) {
+        ASSERT_EQ(i < 260 && i % 2 == 0, index.Get(Slice(keys[i])) == NULL);
+    }
+    epoch.Reclaim();
+    index.Clear();
+    ASSERT_EQ(0u, index.GetSize());
+    ASSERT_TRUE(index.Get(Slice(keys[1])) == NULL);
+}
+
+TEST_F(SegmentTest, PutAndGetWithKeyHashIndex) {
+    FLAGS_enable_key_hash_index = true;
+    uint32_t old_bucket_cnt = FLAGS_key_hash_index_bucket_cnt;
+    FLAGS_key_hash_index_bucket_cnt = 4;
+    {
+        Segment segment;
+        for (int i = 0; i < 100; i++) {
+            std::string key = "pk" + std::to_string(i);
+            segment.Put(Slice(key), 9768, "test1", 5);
+            segment.Put(Slice(key), 9769 + i, "test2", 5);
+        }
+        ASSERT_EQ(100, (int64_t)segment.GetPkCnt());
+        DataBlock* block = NULL;
+        ASSERT_TRUE(segment.Get(Slice("pk10"), 9768, &block));
+        ASSERT_EQ("test1", std::string(block->data, block->size));
+        ASSERT_FALSE(segment.Get(Slice("pk100"), 9768, &block));
+        {
+            Ticket ticket;
+            MemTableIterator* it = segment.NewIterator(Slice("pk10"), ticket);
+            it->SeekToFirst();
+            ASSERT_TRUE(it->Valid());
+            ASSERT_EQ(9779, (int64_t)it->GetKey());
+            delete it;
+        }
+        // the keys removed by gc are gone from the hash index too
+        uint64_t gc_idx_cnt = 0;
+        uint64_t gc_record_cnt = 0;
+        uint64_t gc_record_byte_size = 0;
+        segment.Gc4TTL(9818, gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+        ASSERT_EQ(50, (int64_t)segment.GetPkCnt());
+        uint64_t count = 0;
+        ASSERT_EQ(-1, segment.GetCount(Slice("pk49"), count));
+        ASSERT_EQ(0, segment.GetCount(Slice("pk50"), count));
+        ASSERT_EQ(1, (int64_t)count);
+        ASSERT_TRUE(segment.Delete(Slice("pk50")));
+        ASSERT_EQ(-1, segment.GetCount(Slice("pk50"), count));
+        segment.Put(Slice("pk50"), 9768, "test1", 5);
+        ASSERT_EQ(0, segment.GetCount(Slice("pk50"), count));
+        ASSERT_EQ(1, (int64_t)count);
+    }
+    FLAGS_key_hash_index_bucket_cnt = old_bucket_cnt;
+    FLAGS_enable_key_hash_index = false;
+}
+
+TEST_F(SegmentTest, LatestRing) {
+    std::vector<DataBlock*> blocks;
+    for (int i = 0; i < 8; i++) {
+        blocks.push_back(new DataBlock(1, "test", 4));
+    }
+    LatestRing ring(4);
+    bool rejected = true;
+    ASSERT_TRUE(ring.Insert(10, blocks[0], &rejected) == NULL);
+    ASSERT_FALSE(rejected);
+    ASSERT_TRUE(ring.Insert(12, blocks[1], &rejected) == NULL);
+    // the rows out of order are inserted by time
+    ASSERT_TRUE(ring.Insert(11, blocks[2], &rejected) == NULL);
+    ASSERT_TRUE(ring.Insert(13, blocks[3], &rejected) == NULL);
+    ASSERT_EQ(4u, ring.GetSize());
+    // the oldest row is evicted once the ring is full
+    ASSERT_EQ(blocks[0], ring.Insert(14, blocks[4], &rejected));
+    ASSERT_FALSE(rejected);
+    ASSERT_EQ(blocks[2], ring.Insert(12, blocks[5], &rejected));
+    ASSERT_FALSE(rejected);
+    // the row older than all rows is not kept
+    ASSERT_EQ(blocks[6], ring.Insert(9, blocks[6], &rejected));
+    ASSERT_TRUE(rejected);
+    std::vector<std::pair<uint64_t, DataBlock*>> rows;
+    ring.Read(&rows);
+    ASSERT_EQ(4u, rows.size());
+    std::vector<uint64_t> times;
+    for (const auto& kv : rows) {
+        times.push_back(kv.first);
+    }
+    ASSERT_EQ(std::vector<uint64_t>({14, 13, 12, 12}), times);
+    ASSERT_EQ(blocks[5], rows[2].second);
+    ASSERT_EQ(blocks[3], ring.Get(13));
+    ASSERT_TRUE(ring.Get(11) == NULL);
+    std::vector<DataBlock*> trimmed;
+    ring.Trim(2, &trimmed);
+    ASSERT_EQ(std::vector<DataBlock*>({blocks[5], blocks[1]}), trimmed);
+    ASSERT_EQ(2u, ring.GetSize());
+    ASSERT_TRUE(ring.Get(12) == NULL);
+    for (auto* block : blocks) {
+        delete block;
+    }
+}
+
+TEST_F(SegmentTest, PutAndGcWithLatestRing) {
+    Segment segment;
+    segment.EnableLatestRing(5);
+    for (int i = 0; i < 20; i++) {
+        segment.Put("PK1", 9760 + i, "test1", 5);
+        segment.Put("PK2", 9779 - i, "test2", 5);
+    }
+    ASSERT_EQ(10, (int64_t)segment.GetIdxCnt());
+    uint64_t count = 0;
+    ASSERT_EQ(0, segment.GetCount("PK2", count));
+    ASSERT_EQ(5, (int64_t)count);
+    for (const char* pk : {"PK1", "PK2"}) {
+        Ticket ticket;
+        MemTableIterator* it = segment.NewIterator(pk, ticket);
+        it->SeekToFirst();
+        std::vector<uint64_t> times;
+        while (it->Valid()) {
+            times.push_back(it->GetKey());
+            it->Next();
+        }
+        ASSERT_EQ(std::vector<uint64_t>({9779, 9778, 9777, 9776, 9775}), times);
+        it->Seek(9776);
+        ASSERT_TRUE(it->Valid());
+        ASSERT_EQ(9776, (int64_t)it->GetKey());
+        it->SeekToLast();
+        ASSERT_TRUE(it->Valid());
+        ASSERT_EQ(9775, (int64_t)it->GetKey());
+        delete it;
+    }
+    DataBlock* block = NULL;
+    ASSERT_TRUE(segment.Get("PK1", 9777, &block));
+    ASSERT_EQ("test1", std::string(block->data, block->size));
+    // the evicted rows of PK1 are released by gc, the rows of PK2 rejected by the full ring are
+    // released without being counted as indexes
+    uint64_t gc_idx_cnt = 0;
+    uint64_t gc_record_cnt = 0;
+    uint64_t gc_record_byte_size = 0;
+    segment.Gc4Head(5, gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+    ASSERT_EQ(15, (int64_t)gc_idx_cnt);
+    ASSERT_EQ(30, (int64_t)gc_record_cnt);
+    ASSERT_EQ(30 * GetRecordSize(5), (int64_t)gc_record_byte_size);
+    segment.Gc4Head(3, gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+    ASSERT_EQ(34, (int64_t)gc_record_cnt);
+    ASSERT_EQ(6, (int64_t)segment.GetIdxCnt());
+    // the rows go back to skiplist and are kept there
+    uint64_t byte_size = segment.GetIdxByteSize();
+    segment.DisableLatestRing();
+    ASSERT_EQ(0u, segment.GetLatestRingCapacity());
+    ASSERT_NE(byte_size, segment.GetIdxByteSize());
+    for (int i = 0; i < 10; i++) {
+        segment.Put("PK1", 9780 + i, "test1", 5);
+    }
+    ASSERT_EQ(0, segment.GetCount("PK1", count));
+    ASSERT_EQ(13, (int64_t)count);
+    {
+        Ticket ticket;
+        MemTableIterator* it = segment.NewIterator("PK2", ticket);
+        it->SeekToFirst();
+        ASSERT_TRUE(it->Valid());
+        ASSERT_EQ(9779, (int64_t)it->GetKey());
+        delete it;
+    }
+    segment.Gc4Head(3, gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+    ASSERT_EQ(44, (int64_t)gc_record_cnt);
+}
+
 TEST_F(SegmentTest, PutAndGet) {
     Segment segment;
     const char* test = "test";
@@ -100,25 +382,32 @@ TEST_F(SegmentTest, Delete) {
     segment.Put(pk, 9528, value.c_str(), value.size());
     segment.Put(pk, 9529, value.c_str(), value.size());
     ASSERT_EQ(1, (int64_t)segment.GetPkCnt());
-    Ticket ticket;
-    MemTableIterator* it = segment.NewIterator("test1", ticket);
-    int size = 0;
-    it->SeekToFirst();
-    while (it->Valid()) {
-        it->Next();
-        size++;
-    }
-    ASSERT_EQ(4, size);
-    delete it;
-    ASSERT_TRUE(segment.Delete(pk));
-    it = segment.NewIterator("test1", ticket);
-    ASSERT_FALSE(it->Valid());
-    delete it;
     uint64_t gc_idx_cnt = 0;
     uint64_t gc_record_cnt = 0;
     uint64_t gc_record_byte_size = 0;
-    segment.IncrGcVersion();
-    segment.IncrGcVersion();
+    {
+        Ticket ticket;
+        MemTableIterator* it = segment.NewIterator("test1", ticket);
+        int size = 0;
+        it->SeekToFirst();
+        while (it->Valid()) {
+            it->Next();
+            size++;
+        }
+        ASSERT_EQ(4, size);
+        ASSERT_TRUE(segment.Delete(pk));
+        // the deleted entry is kept for the ticket
+        segment.GcFreeList(gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+        ASSERT_EQ(0, (int64_t)gc_record_cnt);
+        it->SeekToFirst();
+        ASSERT_TRUE(it->Valid());
+        ASSERT_EQ(9529, (int64_t)it->GetKey());
+        delete it;
+        it = segment.NewIterator("test1", ticket);
+        ASSERT_FALSE(it->Valid());
+        delete it;
+    }
+    ASSERT_EQ(0, (int64_t)segment.GetPkCnt());
     segment.GcFreeList(gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
     ASSERT_EQ(4, (int64_t)gc_idx_cnt);
     ASSERT_EQ(4, (int64_t)gc_record_cnt);
@@ -350,6 +639,46 @@ TEST_F(SegmentTest, TestGc4TTLOrHead) {
     ASSERT_EQ(3 * GetRecordSize(5), (int64_t)gc_record_byte_size);
 }
 
+TEST_F(SegmentTest, IncrementalGc) {
+    Segment segment;
+    for (int i = 0; i < 10; i++) {
+        std::string key = "PK" + std::to_string(i);
+        segment.Put(key, 9768, "test1", 5);
+        segment.Put(key, 9769, "test2", 5);
+    }
+    uint64_t gc_idx_cnt = 0;
+    uint64_t gc_record_cnt = 0;
+    uint64_t gc_record_byte_size = 0;
+    uint32_t visited_key_cnt = 0;
+    TTLSt lat_ttl(0, 1, ::openmldb::storage::TTLType::kLatestTime);
+    // the pass goes on from where the last tick stopped
+    for (int i = 0; i < 3; i++) {
+        ASSERT_FALSE(segment.ExecuteGc(lat_ttl, 3, visited_key_cnt, gc_idx_cnt, gc_record_cnt, gc_record_byte_size));
+        ASSERT_EQ(3u, visited_key_cnt);
+        ASSERT_EQ(3 * (i + 1), (int64_t)gc_idx_cnt);
+    }
+    ASSERT_TRUE(segment.ExecuteGc(lat_ttl, 3, visited_key_cnt, gc_idx_cnt, gc_record_cnt, gc_record_byte_size));
+    ASSERT_EQ(1u, visited_key_cnt);
+    ASSERT_EQ(10, (int64_t)gc_idx_cnt);
+    ASSERT_EQ(10, (int64_t)gc_record_cnt);
+    ASSERT_EQ(10, (int64_t)segment.GetIdxCnt());
+    // the keys removed by the last tick are skipped
+    TTLSt abs_ttl(1, 0, ::openmldb::storage::TTLType::kAbsoluteTime);
+    ASSERT_FALSE(segment.ExecuteGc(abs_ttl, 4, visited_key_cnt, gc_idx_cnt, gc_record_cnt, gc_record_byte_size));
+    ASSERT_EQ(4u, visited_key_cnt);
+    ASSERT_EQ(6, (int64_t)segment.GetPkCnt());
+    ASSERT_FALSE(segment.ExecuteGc(abs_ttl, 4, visited_key_cnt, gc_idx_cnt, gc_record_cnt, gc_record_byte_size));
+    ASSERT_TRUE(segment.ExecuteGc(abs_ttl, 4, visited_key_cnt, gc_idx_cnt, gc_record_cnt, gc_record_byte_size));
+    ASSERT_EQ(2u, visited_key_cnt);
+    ASSERT_EQ(0, (int64_t)segment.GetPkCnt());
+    ASSERT_EQ(20, (int64_t)gc_record_cnt);
+    // key_cnt 0 gc all keys in one call
+    segment.Put("PK", 9768, "test1", 5);
+    ASSERT_TRUE(segment.ExecuteGc(abs_ttl, 0, visited_key_cnt, gc_idx_cnt, gc_record_cnt, gc_record_byte_size));
+    ASSERT_EQ(1u, visited_key_cnt);
+    ASSERT_EQ(21, (int64_t)gc_record_cnt);
+}
+
 TEST_F(SegmentTest, TestStat) {
     Segment segment;
     segment.Put("PK", 9768, "test1", 5);
@@ -369,6 +698,268 @@ TEST_F(SegmentTest, TestStat) {
     ASSERT_EQ(0, (int64_t)segment.GetIdxCnt());
 }
 
+TEST_F(SegmentTest, PutContention) {
+    const uint32_t thread_num = 8;
+    const uint32_t put_num = 20000;
+    Segment segment(8);
+    auto put = [&segment, put_num](uint32_t id) {
+        for (uint32_t i = 0; i < put_num; i++) {
+            // the keys with odd suffix are shared by all threads
+            std::string key = i % 2 == 0 ? "key" + std::to_string(id) + "_" + std::to_string(i % 100)
+                                         : "shared" + std::to_string(i % 100);
+            segment.Put(Slice(key), i, "value", 5);
+        }
+    };
+    uint64_t start = ::baidu::common::timer::get_micros();
+    std::vector<std::thread> threads;
+    for (uint32_t i = 0; i < thread_num; i++) {
+        threads.emplace_back(put, i);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    uint64_t consumed = ::baidu::common::timer::get_micros() - start;
+    PDLOG(INFO, "put %u rows with %u threads consumed %lu us, %lu puts per second", thread_num * put_num,
+          thread_num, consumed, (uint64_t)thread_num * put_num * 1000000 / (consumed + 1));
+    ASSERT_EQ(thread_num * put_num, segment.GetIdxCnt());
+    ASSERT_EQ(thread_num * 50 + 50, segment.GetPkCnt());
+    uint64_t cnt = 0;
+    ASSERT_EQ(0, segment.GetCount(Slice("shared1"), cnt));
+    ASSERT_EQ(thread_num * put_num / 100, cnt);
+    ASSERT_EQ(0, segment.GetCount(Slice("key3_0"), cnt));
+    ASSERT_EQ(put_num / 100, cnt);
+    ASSERT_EQ(thread_num * put_num, segment.Release());
+}
+
+TEST_F(SegmentTest, GcSharedRow) {
+    const uint32_t row_num = 10000;
+    Segment segment0(8);
+    Segment segment1(8);
+    for (uint32_t i = 0; i < row_num; i++) {
+        // the row is shared by two indexes like a table with two dimensions
+        DataBlock* row = new DataBlock(2, "value", 5);
+        segment0.Put(Slice("pk" + std::to_string(i % 10)), i + 1, row);
+        segment1.Put(Slice("key" + std::to_string(i % 7)), i + 1, row);
+    }
+    uint64_t gc_record_cnt[2] = {0, 0};
+    auto gc = [&gc_record_cnt, row_num](Segment* segment, uint32_t id) {
+        uint64_t gc_idx_cnt = 0;
+        uint64_t gc_record_byte_size = 0;
+        segment->Gc4TTL(row_num + 1, gc_idx_cnt, gc_record_cnt[id], gc_record_byte_size);
+    };
+    std::thread t0(gc, &segment0, 0);
+    std::thread t1(gc, &segment1, 1);
+    t0.join();
+    t1.join();
+    // every row is released by exactly one of the indexes
+    ASSERT_EQ(row_num, gc_record_cnt[0] + gc_record_cnt[1]);
+    ASSERT_EQ(0, (int64_t)segment0.GetIdxCnt());
+    ASSERT_EQ(0, (int64_t)segment1.GetIdxCnt());
+}
+
+TEST_F(SegmentTest, EpochReclaim) {
+    EpochManager epoch;
+    uint32_t released = 0;
+    uint64_t pinned = epoch.Pin();
+    epoch.Retire([&released]() { released++; });
+    ASSERT_EQ(0u, epoch.Reclaim());
+    ASSERT_EQ(1u, epoch.GetRetiredCnt());
+    {
+        // a reader pinned later can not observe the retired memory, so it does not hold it back
+        EpochGuard guard(&epoch);
+        epoch.UnPin(pinned);
+        ASSERT_EQ(1u, released);
+        epoch.Retire([&released]() { released++; });
+    }
+    ASSERT_EQ(2u, released);
+    ASSERT_EQ(0u, epoch.GetRetiredCnt());
+    epoch.Retire([&released]() { released++; });
+    ASSERT_EQ(1u, epoch.Reclaim());
+    ASSERT_EQ(3u, released);
+}
+
+TEST_F(SegmentTest, GcWithReader) {
+    Segment segment(8);
+    Slice pk("pk");
+    for (uint64_t ts = 1; ts <= 100; ts++) {
+        std::string value = "value" + std::to_string(ts);
+        segment.Put(pk, ts, value.c_str(), value.size());
+    }
+    uint64_t gc_idx_cnt = 0;
+    uint64_t gc_record_cnt = 0;
+    uint64_t gc_record_byte_size = 0;
+    {
+        Ticket ticket;
+        MemTableIterator* it = segment.NewIterator(pk, ticket);
+        it->Seek(60);
+        ASSERT_TRUE(it->Valid());
+        // the expired rows are split out though the reader is on them
+        segment.Gc4TTL(100, gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+        ASSERT_EQ(100, (int64_t)gc_idx_cnt);
+        ASSERT_EQ(0, (int64_t)gc_record_cnt);
+        ASSERT_EQ(0, (int64_t)segment.GetIdxCnt());
+        uint64_t cnt = 0;
+        while (it->Valid()) {
+            ASSERT_EQ("value" + std::to_string(it->GetKey()), it->GetValue().ToString());
+            it->Next();
+            cnt++;
+        }
+        ASSERT_EQ(60, (int64_t)cnt);
+        delete it;
+    }
+    // the last reader releases the retired rows
+    ASSERT_EQ(0, (int64_t)segment.GetPkCnt());
+    segment.GcFreeList(gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+    ASSERT_EQ(100, (int64_t)gc_record_cnt);
+    ASSERT_EQ(0, (int64_t)segment.Release());
+}
+
+TEST_F(SegmentTest, GcWithConcurrentReaders) {
+    Segment segment(8);
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> read_cnt(0);
+    auto read = [&segment, &stop, &read_cnt]() {
+        while (!stop.load(std::memory_order_relaxed)) {
+            for (uint32_t i = 0; i < 10; i++) {
+                Ticket ticket;
+                MemTableIterator* it = segment.NewIterator(Slice("pk" + std::to_string(i)), ticket);
+                it->SeekToFirst();
+                while (it->Valid()) {
+                    ASSERT_EQ(5, (int64_t)it->GetValue().size());
+                    it->Next();
+                    read_cnt.fetch_add(1, std::memory_order_relaxed);
+                }
+                delete it;
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (uint32_t i = 0; i < 2; i++) {
+        threads.emplace_back(read);
+    }
+    uint64_t gc_idx_cnt = 0;
+    uint64_t gc_record_cnt = 0;
+    uint64_t gc_record_byte_size = 0;
+    for (uint64_t ts = 1; ts <= 20000; ts++) {
+        segment.Put(Slice("pk" + std::to_string(ts % 10)), ts, "value", 5);
+        if (ts % 1000 == 0) {
+            segment.Gc4TTL(ts - 500, gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+        }
+        if (ts % 3000 == 0) {
+            segment.Delete(Slice("pk" + std::to_string(ts / 3000)));
+        }
+    }
+    stop.store(true);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    segment.GcFreeList(gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+    ASSERT_EQ(20000, (int64_t)(gc_record_cnt + segment.Release()));
+}
+
+TEST_F(SegmentTest, CompactCold) {
+    Segment segment(8);
+    Slice pk("pk");
+    for (uint64_t ts = 1; ts <= 3000; ts++) {
+        std::string value = "value" + std::to_string(ts);
+        segment.Put(pk, ts, value.c_str(), value.size());
+    }
+    uint64_t byte_size = segment.GetIdxByteSize();
+    ASSERT_EQ(0, (int64_t)segment.CompactCold(0));
+    ASSERT_EQ(2000, (int64_t)segment.CompactCold(2000));
+    ASSERT_EQ(0, (int64_t)segment.CompactCold(2000));
+    ASSERT_LT(segment.GetIdxByteSize(), byte_size);
+    ASSERT_EQ(3000, (int64_t)segment.GetIdxCnt());
+    // put some rows out of order and compact them again
+    segment.Put(pk, 1500, "value1500", 9);
+    segment.Put(pk, 2500, "value2500", 9);
+    ASSERT_EQ(502, (int64_t)segment.CompactCold(2500));
+    ASSERT_EQ(3002, (int64_t)segment.GetIdxCnt());
+    DataBlock* block = NULL;
+    ASSERT_TRUE(segment.Get(pk, 1024, &block));
+    ASSERT_TRUE(block != NULL);
+    ASSERT_EQ("value1024", std::string(block->data, block->size));
+    {
+        Ticket ticket;
+        std::unique_ptr<MemTableIterator> it(segment.NewIterator(pk, ticket));
+        it->SeekToFirst();
+        uint64_t cnt = 0;
+        uint64_t last_ts = UINT64_MAX;
+        while (it->Valid()) {
+            ASSERT_LE(it->GetKey(), last_ts);
+            last_ts = it->GetKey();
+            ASSERT_EQ("value" + std::to_string(last_ts), it->GetValue().ToString());
+            cnt++;
+            it->Next();
+        }
+        ASSERT_EQ(3002, (int64_t)cnt);
+        it->Seek(2999);
+        ASSERT_TRUE(it->Valid());
+        ASSERT_EQ(2999, (int64_t)it->GetKey());
+        it->Seek(1025);
+        ASSERT_TRUE(it->Valid());
+        ASSERT_EQ(1025, (int64_t)it->GetKey());
+        it->Next();
+        ASSERT_EQ(1024, (int64_t)it->GetKey());
+        it->SeekToLast();
+        ASSERT_TRUE(it->Valid());
+        ASSERT_EQ(1, (int64_t)it->GetKey());
+        it->Next();
+        ASSERT_FALSE(it->Valid());
+    }
+    uint64_t gc_idx_cnt = 0;
+    uint64_t gc_record_cnt = 0;
+    uint64_t gc_record_byte_size = 0;
+    segment.Gc4TTL(1000, gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+    ASSERT_EQ(1000, (int64_t)gc_idx_cnt);
+    ASSERT_EQ(1000, (int64_t)gc_record_cnt);
+    ASSERT_EQ(2002, (int64_t)segment.GetIdxCnt());
+    ASSERT_TRUE(segment.Get(pk, 1001, &block));
+    ASSERT_EQ("value1001", std::string(block->data, block->size));
+    // gc by count moves the cold rows back to skiplist
+    segment.Gc4Head(10, gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+    ASSERT_EQ(10, (int64_t)segment.GetIdxCnt());
+    ASSERT_EQ(2992, (int64_t)gc_idx_cnt);
+    segment.Gc4TTL(3000, gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+    ASSERT_EQ(0, (int64_t)segment.GetIdxCnt());
+    ASSERT_EQ(3002, (int64_t)gc_record_cnt);
+}
+
+TEST_F(SegmentTest, CompactColdTS) {
+    std::vector<uint32_t> ts_idx_vec = {1, 3};
+    Segment segment(8, ts_idx_vec);
+    Slice pk("pk");
+    for (uint64_t ts = 1; ts <= 100; ts++) {
+        std::map<int32_t, uint64_t> ts_map = {{1, ts}, {3, ts + 1000}};
+        DataBlock* db = new DataBlock(2, "test", 4);
+        segment.Put(pk, ts_map, db);
+    }
+    ASSERT_EQ(0, (int64_t)segment.CompactCold(2, 50));
+    ASSERT_EQ(50, (int64_t)segment.CompactCold(1, 50));
+    ASSERT_EQ(100, (int64_t)segment.CompactCold(3, 1100));
+    uint64_t cnt = 0;
+    ASSERT_EQ(0, segment.GetCount(pk, 3, cnt));
+    ASSERT_EQ(100, (int64_t)cnt);
+    std::map<uint32_t, TTLSt> ttl_st_map;
+    ttl_st_map.emplace(1, TTLSt(60, 0, ::openmldb::storage::TTLType::kAbsoluteTime));
+    ttl_st_map.emplace(3, TTLSt(1090, 0, ::openmldb::storage::TTLType::kAbsoluteTime));
+    uint64_t gc_idx_cnt = 0;
+    uint64_t gc_record_cnt = 0;
+    uint64_t gc_record_byte_size = 0;
+    segment.GcAllType(ttl_st_map, gc_idx_cnt, gc_record_cnt, gc_record_byte_size);
+    ASSERT_EQ(150, (int64_t)gc_idx_cnt);
+    ASSERT_EQ(60, (int64_t)gc_record_cnt);
+    uint64_t idx_cnt = 0;
+    ASSERT_EQ(0, segment.GetIdxCnt(1, idx_cnt));
+    ASSERT_EQ(40, (int64_t)idx_cnt);
+    ASSERT_EQ(0, segment.GetIdxCnt(3, idx_cnt));
+    ASSERT_EQ(10, (int64_t)idx_cnt);
+    DataBlock* block = NULL;
+    ASSERT_TRUE(segment.Get(pk, 3, 1095, &block));
+    ASSERT_TRUE(block != NULL);
+    ASSERT_EQ("test", std::string(block->data, block->size));    ASSERT_EQ(50, (int64_t)segment.Release());
+}
+
 TEST_F(SegmentTest, GetTsIdx) {
     std::vector<uint32_t> ts_idx_vec = {1, 3, 5};
     Segment segment(8, ts_idx_vec);
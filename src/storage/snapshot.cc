@@ -30,17 +30,27 @@ namespace storage {
 
 const std::string MANIFEST = "MANIFEST";  // NOLINT
 
-int Snapshot::GenManifest(const std::string& snapshot_name, uint64_t key_count, uint64_t offset, uint64_t term) {
+int Snapshot::GenManifest(const std::string& snapshot_name, uint64_t key_count, uint64_t offset, uint64_t term,
+                          const std::string& image_name, const std::vector<std::string>& part_names) {
     DEBUGLOG("record offset[%lu]. add snapshot[%s] key_count[%lu]", offset, snapshot_name.c_str(), key_count);
-    std::string full_path = snapshot_path_ + MANIFEST;
-    std::string tmp_file = snapshot_path_ + MANIFEST + ".tmp";
     ::openmldb::api::Manifest manifest;
-    std::string manifest_info;
     manifest.set_offset(offset);
     manifest.set_name(snapshot_name);
     manifest.set_count(key_count);
     manifest.set_term(term);
-    manifest_info.clear();
+    if (!image_name.empty()) {
+        manifest.set_image_name(image_name);
+    }
+    for (const auto& name : part_names) {
+        manifest.add_part_names(name);
+    }
+    return WriteManifest(manifest);
+}
+
+int Snapshot::WriteManifest(const ::openmldb::api::Manifest& manifest) {
+    std::string full_path = snapshot_path_ + MANIFEST;
+    std::string tmp_file = snapshot_path_ + MANIFEST + ".tmp";
+    std::string manifest_info;
     google::protobuf::TextFormat::PrintToString(manifest, &manifest_info);
     FILE* fd_write = fopen(tmp_file.c_str(), "w");
     if (fd_write == NULL) {
@@ -65,6 +75,25 @@ int Snapshot::GenManifest(const std::string& snapshot_name, uint64_t key_count,
     return -1;
 }
 
+std::vector<std::string> Snapshot::GetDataFiles(const ::openmldb::api::Manifest& manifest) {
+    std::vector<std::string> files;
+    if (manifest.has_name()) {
+        files.push_back(manifest.name());
+    }
+    for (const auto& name : manifest.part_names()) {
+        files.push_back(name);
+    }
+    return files;
+}
+
+std::vector<std::string> Snapshot::GetDeltaFiles(const ::openmldb::api::Manifest& manifest) {
+    std::vector<std::string> files;
+    for (const auto& delta : manifest.deltas()) {
+        files.push_back(delta.name());
+    }
+    return files;
+}
+
 int Snapshot::GetLocalManifest(const std::string& full_path, ::openmldb::api::Manifest& manifest) {
     int fd = open(full_path.c_str(), O_RDONLY);
     if (fd < 0) {
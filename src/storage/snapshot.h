@@ -18,6 +18,7 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "log/log_writer.h"
 #include "proto/tablet.pb.h"
@@ -38,7 +39,14 @@ class Snapshot {
     virtual bool Recover(std::shared_ptr<Table> table,
                          uint64_t& latest_offset) = 0;  // NOLINT
     uint64_t GetOffset() { return offset_; }
-    int GenManifest(const std::string& snapshot_name, uint64_t key_count, uint64_t offset, uint64_t term);
+    int GenManifest(const std::string& snapshot_name, uint64_t key_count, uint64_t offset, uint64_t term,
+                    const std::string& image_name = "", const std::vector<std::string>& part_names = {});
+    // write manifest to MANIFEST atomically
+    int WriteManifest(const ::openmldb::api::Manifest& manifest);
+    // the names of all data files of the full snapshot, the first one is the name of manifest
+    static std::vector<std::string> GetDataFiles(const ::openmldb::api::Manifest& manifest);
+    // the names of the delta snapshots in the order they are applied
+    static std::vector<std::string> GetDeltaFiles(const ::openmldb::api::Manifest& manifest);
     static int GetLocalManifest(const std::string& full_path,
                                 ::openmldb::api::Manifest& manifest);  // NOLINT
 
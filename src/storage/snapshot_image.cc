@@ -0,0 +1,394 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "storage/snapshot_image.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <thread>  // NOLINT
+
+#include "base/glog_wapper.h"
+#include "log/crc32c.h"
+
+namespace openmldb {
+namespace storage {
+
+static const uint32_t IMAGE_MAGIC = 0x4f4d4931;  // OMI1
+static const uint32_t IMAGE_VERSION = 2;
+static const uint64_t IMAGE_HEADER_SIZE = 4096;
+static const uint64_t IMAGE_ALIGN = 8;
+
+struct ImageHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t row_cnt;
+    // the end of the records, where the chunk table begins
+    uint64_t data_end;
+    uint32_t chunk_row_cnt;
+    uint32_t chunk_cnt;
+    uint32_t layout_size;
+    // the masked crc32c of the chunk table
+    uint32_t chunk_table_crc;
+};
+
+struct RecordHead {
+    // ref_cnt is -1 if the row is invalid in the table, it's kept to count the rows
+    int32_t ref_cnt;
+    uint32_t value_size;
+    uint16_t key_cnt;
+    uint16_t ts_cnt;
+    uint32_t reserved;
+};
+
+struct RecordKey {
+    uint32_t inner_pos;
+    uint32_t size;
+};
+
+static inline uint64_t AlignSize(uint64_t size) { return (size + IMAGE_ALIGN - 1) & ~(IMAGE_ALIGN - 1); }
+
+// everything of the put plan and the table a resolved row depends on
+static std::string EncodeLayout(const PutPlan& plan, uint32_t seg_cnt) {
+    std::vector<uint32_t> layout;
+    layout.push_back(seg_cnt);
+    layout.push_back(plan.inner_indexs.size());
+    for (const auto& inner_index : plan.inner_indexs) {
+        layout.push_back(inner_index.indexs.size());
+        for (const auto& index_def : inner_index.indexs) {
+            layout.push_back(index_def->GetId());
+            layout.push_back(index_def->IsReady() ? 1 : 0);
+        }
+        layout.push_back(inner_index.ts_pos.size());
+        layout.insert(layout.end(), inner_index.ts_pos.begin(), inner_index.ts_pos.end());
+    }
+    layout.push_back(plan.ts_cols.size());
+    for (const auto& ts_col : plan.ts_cols) {
+        layout.push_back(ts_col->GetId());
+        layout.push_back(ts_col->GetType());
+    }
+    return std::string(reinterpret_cast<const char*>(layout.data()), layout.size() * sizeof(uint32_t));
+}
+
+SnapshotImageWriter::SnapshotImageWriter(const std::shared_ptr<MemTable>& table, const std::string& path,
+                                         uint32_t chunk_row_cnt)
+    : table_(table),
+      plan_(table->GetPutPlan()),
+      layout_(EncodeLayout(*plan_, table->GetSegCnt())),
+      path_(path),
+      chunk_row_cnt_(chunk_row_cnt == 0 ? 1 : chunk_row_cnt),
+      fd_(NULL),
+      offset_(0),
+      row_cnt_(0),
+      chunk_crc_(0) {}
+
+SnapshotImageWriter::~SnapshotImageWriter() { Abort(); }
+
+bool SnapshotImageWriter::Open() {
+    fd_ = fopen(path_.c_str(), "wb");
+    if (fd_ == NULL) {
+        PDLOG(WARNING, "fail to open image %s for error %s", path_.c_str(), strerror(errno));
+        return false;
+    }
+    // the header is written in Finish
+    std::string header(IMAGE_HEADER_SIZE, '\0');
+    return Write(header.data(), header.size());
+}
+
+bool SnapshotImageWriter::Write(const void* data, size_t size) {
+    if (fwrite(data, 1, size, fd_) != size) {
+        PDLOG(WARNING, "fail to write image %s for error %s", path_.c_str(), strerror(errno));
+        return false;
+    }
+    offset_ += size;
+    return true;
+}
+
+bool SnapshotImageWriter::Append(const ::openmldb::api::LogEntry& entry) {
+    const PutPlan& plan = *plan_;
+    const std::string* keys[MAX_INDEX_NUM];
+    uint64_t ts[MAX_INDEX_NUM] = {0};
+    RecordHead head;
+    memset(&head, 0, sizeof(head));
+    head.ref_cnt = table_->ResolveRow(plan, entry.ts(), entry.value(), entry.dimensions(), keys, ts);
+    head.value_size = entry.value().size();
+    head.ts_cnt = head.ref_cnt >= 0 ? plan.ts_cols.size() : 0;
+    // the record is encoded out of the lock
+    std::string record(sizeof(head) + head.ts_cnt * sizeof(uint64_t), '\0');
+    if (head.ref_cnt >= 0) {
+        for (uint32_t pos = 0; pos < plan.inner_indexs.size(); pos++) {
+            if (keys[pos] != nullptr) {
+                RecordKey key = {pos, static_cast<uint32_t>(keys[pos]->size())};
+                record.append(reinterpret_cast<const char*>(&key), sizeof(key));
+                head.key_cnt++;
+            }
+        }
+        for (uint32_t pos = 0; pos < plan.inner_indexs.size(); pos++) {
+            if (keys[pos] != nullptr) {
+                record.append(*keys[pos]);
+            }
+        }
+    }
+    record.append(entry.value());
+    memcpy(&record[0], &head, sizeof(head));
+    memcpy(&record[sizeof(head)], ts, head.ts_cnt * sizeof(uint64_t));
+    record.resize(AlignSize(record.size()), '\0');
+    std::lock_guard<std::mutex> lock(mu_);
+    if (fd_ == NULL) {
+        return false;
+    }
+    if (row_cnt_ % chunk_row_cnt_ == 0) {
+        if (!chunks_.empty()) {
+            chunks_.back().crc = ::openmldb::log::Mask(chunk_crc_);
+        }
+        chunks_.push_back({offset_, 0, 0});
+        chunk_crc_ = 0;
+    }
+    if (!Write(record.data(), record.size())) {
+        Close(true);
+        return false;
+    }
+    chunk_crc_ = ::openmldb::log::Extend(chunk_crc_, record.data(), record.size());
+    row_cnt_++;
+    return true;
+}
+
+bool SnapshotImageWriter::Finish() {
+    std::lock_guard<std::mutex> lock(mu_);
+    if (fd_ == NULL) {
+        return false;
+    }
+    const std::string& layout = layout_;
+    if (sizeof(ImageHeader) + layout.size() > IMAGE_HEADER_SIZE) {
+        PDLOG(WARNING, "the layout of image %s is too large", path_.c_str());
+        return false;
+    }
+    ImageHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = IMAGE_MAGIC;
+    header.version = IMAGE_VERSION;
+    header.row_cnt = row_cnt_;
+    header.data_end = offset_;
+    header.chunk_row_cnt = chunk_row_cnt_;
+    header.chunk_cnt = chunks_.size();
+    header.layout_size = layout.size();
+    if (!chunks_.empty()) {
+        chunks_.back().crc = ::openmldb::log::Mask(chunk_crc_);
+    }
+    const char* chunk_table = reinterpret_cast<const char*>(chunks_.data());
+    size_t chunk_table_size = chunks_.size() * sizeof(ImageChunk);
+    header.chunk_table_crc = ::openmldb::log::Mask(::openmldb::log::Value(chunk_table, chunk_table_size));
+    if (!Write(chunk_table, chunk_table_size)) {
+        return false;
+    }
+    if (fseek(fd_, 0, SEEK_SET) != 0 || fwrite(&header, 1, sizeof(header), fd_) != sizeof(header) ||
+        fwrite(layout.data(), 1, layout.size(), fd_) != layout.size()) {
+        PDLOG(WARNING, "fail to write the header of image %s", path_.c_str());
+        return false;
+    }
+    if (fflush(fd_) == EOF || fsync(fileno(fd_)) == -1) {
+        PDLOG(WARNING, "fail to sync image %s", path_.c_str());
+        return false;
+    }
+    Close(false);
+    return true;
+}
+
+void SnapshotImageWriter::Abort() {
+    std::lock_guard<std::mutex> lock(mu_);
+    Close(true);
+}
+
+void SnapshotImageWriter::Close(bool remove) {
+    if (fd_ != NULL) {
+        fclose(fd_);
+        fd_ = NULL;
+        if (remove) {
+            unlink(path_.c_str());
+        }
+    }
+}
+
+// put the rows of chunk into table, return false if the records are broken. the records are
+// only checked if table is NULL
+static bool LoadChunk(const char* base, uint64_t begin, uint64_t end, uint32_t row_cnt, const PutPlan& plan,
+                      MemTable* table, std::atomic<uint64_t>* succ_cnt, std::atomic<uint64_t>* failed_cnt) {
+    const Slice* keys[MAX_INDEX_NUM];
+    Slice key_slices[MAX_INDEX_NUM];
+    uint64_t ts[MAX_INDEX_NUM];
+    uint32_t inner_cnt = plan.inner_indexs.size();
+    uint64_t offset = begin;
+    for (uint32_t loaded_cnt = 0; loaded_cnt < row_cnt; loaded_cnt++) {
+        if (offset + sizeof(RecordHead) > end) {
+            return false;
+        }
+        RecordHead head;
+        memcpy(&head, base + offset, sizeof(head));
+        uint64_t cur = offset + sizeof(head);
+        uint64_t size = sizeof(head) + head.ts_cnt * sizeof(uint64_t) + head.key_cnt * sizeof(RecordKey) +
+                        head.value_size;
+        if (offset + size > end || head.ts_cnt > MAX_INDEX_NUM || head.key_cnt > inner_cnt ||
+            (head.ref_cnt >= 0 && head.ts_cnt != plan.ts_cols.size())) {
+            return false;
+        }
+        memcpy(ts, base + cur, head.ts_cnt * sizeof(uint64_t));
+        cur += head.ts_cnt * sizeof(uint64_t);
+        const RecordKey* record_keys = reinterpret_cast<const RecordKey*>(base + cur);
+        cur += head.key_cnt * sizeof(RecordKey);
+        for (uint32_t pos = 0; pos < inner_cnt; pos++) {
+            keys[pos] = nullptr;
+        }
+        for (uint32_t k = 0; k < head.key_cnt; k++) {
+            uint32_t inner_pos = record_keys[k].inner_pos;
+            uint32_t key_size = record_keys[k].size;
+            if (inner_pos >= inner_cnt || cur + key_size + head.value_size > end) {
+                return false;
+            }
+            key_slices[inner_pos].reset(base + cur, key_size);
+            keys[inner_pos] = &key_slices[inner_pos];
+            cur += key_size;
+        }
+        offset = AlignSize(cur + head.value_size);
+        if (table == NULL) {
+            continue;
+        }
+        if (head.ref_cnt >= 0) {
+            table->PutResolvedRow(plan, keys, ts, head.ref_cnt, base + cur, head.value_size);
+            succ_cnt->fetch_add(1, std::memory_order_relaxed);
+        } else {
+            failed_cnt->fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    return offset == end;
+}
+
+// run task with the chunk ids on thread_num threads, return the count of the failed chunks
+template <typename T>
+static uint32_t ForEachChunk(uint32_t chunk_cnt, uint32_t thread_num, const T& task) {
+    std::atomic<uint32_t> next_chunk(0);
+    std::atomic<uint32_t> failed_chunk_cnt(0);
+    auto run = [&]() {
+        while (true) {
+            uint32_t chunk = next_chunk.fetch_add(1, std::memory_order_relaxed);
+            if (chunk >= chunk_cnt) {
+                break;
+            }
+            if (!task(chunk)) {
+                failed_chunk_cnt.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (uint32_t i = 1; i < thread_num; i++) {
+        threads.emplace_back(run);
+    }
+    run();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return failed_chunk_cnt.load(std::memory_order_relaxed);
+}
+
+bool LoadSnapshotImage(const std::string& path, const std::shared_ptr<MemTable>& table, uint64_t expect_cnt,
+                       uint32_t thread_num, std::atomic<uint64_t>* succ_cnt, std::atomic<uint64_t>* failed_cnt) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        PDLOG(WARNING, "fail to open image %s for error %s", path.c_str(), strerror(errno));
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<uint64_t>(st.st_size) < IMAGE_HEADER_SIZE) {
+        PDLOG(WARNING, "invalid image %s", path.c_str());
+        close(fd);
+        return false;
+    }
+    uint64_t file_size = st.st_size;
+    void* addr = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        PDLOG(WARNING, "fail to mmap image %s for error %s", path.c_str(), strerror(errno));
+        return false;
+    }
+    madvise(addr, file_size, MADV_WILLNEED);
+    const char* base = reinterpret_cast<const char*>(addr);
+    ImageHeader header;
+    memcpy(&header, base, sizeof(header));
+    std::shared_ptr<const PutPlan> plan = table->GetPutPlan();
+    std::string layout = EncodeLayout(*plan, table->GetSegCnt());
+    bool ok = true;
+    if (header.magic != IMAGE_MAGIC || header.version != IMAGE_VERSION || header.chunk_row_cnt == 0 ||
+        header.data_end < IMAGE_HEADER_SIZE || header.data_end + header.chunk_cnt * sizeof(ImageChunk) > file_size ||
+        header.chunk_cnt != (header.row_cnt + header.chunk_row_cnt - 1) / header.chunk_row_cnt) {
+        PDLOG(WARNING, "invalid header of image %s", path.c_str());
+        ok = false;
+    } else if (header.row_cnt != expect_cnt) {
+        PDLOG(WARNING, "image %s, expect cnt %lu but the cnt is %lu", path.c_str(), expect_cnt, header.row_cnt);
+        ok = false;
+    } else if (header.layout_size != layout.size() ||
+               memcmp(base + sizeof(header), layout.data(), layout.size()) != 0) {
+        PDLOG(INFO, "the indexes of table are changed after image %s is written. tid %u pid %u", path.c_str(),
+              table->GetId(), table->GetPid());
+        ok = false;
+    } else if (::openmldb::log::Unmask(header.chunk_table_crc) !=
+               ::openmldb::log::Value(base + header.data_end, header.chunk_cnt * sizeof(ImageChunk))) {
+        PDLOG(WARNING, "the chunk table of image %s is broken", path.c_str());
+        ok = false;
+    }
+    if (!ok) {
+        munmap(addr, file_size);
+        return false;
+    }
+    std::vector<ImageChunk> chunks(header.chunk_cnt);
+    memcpy(chunks.data(), base + header.data_end, header.chunk_cnt * sizeof(ImageChunk));
+    chunks.push_back({header.data_end, 0, 0});
+    for (uint32_t i = 0; i < header.chunk_cnt; i++) {
+        if (chunks[i].offset < IMAGE_HEADER_SIZE || chunks[i].offset >= chunks[i + 1].offset) {
+            PDLOG(WARNING, "invalid chunk offsets of image %s", path.c_str());
+            munmap(addr, file_size);
+            return false;
+        }
+    }
+    auto chunk_row_cnt = [&](uint32_t chunk) {
+        uint64_t row_cnt = header.row_cnt - static_cast<uint64_t>(chunk) * header.chunk_row_cnt;
+        return static_cast<uint32_t>(std::min<uint64_t>(row_cnt, header.chunk_row_cnt));
+    };
+    // every chunk is checked before any row is put, so the table is untouched if the image is broken
+    uint32_t broken_chunk_cnt = ForEachChunk(header.chunk_cnt, thread_num, [&](uint32_t chunk) {
+        uint64_t begin = chunks[chunk].offset;
+        uint64_t end = chunks[chunk + 1].offset;
+        return ::openmldb::log::Unmask(chunks[chunk].crc) == ::openmldb::log::Value(base + begin, end - begin) &&
+               LoadChunk(base, begin, end, chunk_row_cnt(chunk), *plan, NULL, succ_cnt, failed_cnt);
+    });
+    if (broken_chunk_cnt > 0) {
+        PDLOG(WARNING, "%u chunks of image %s are broken. tid %u pid %u", broken_chunk_cnt, path.c_str(),
+              table->GetId(), table->GetPid());
+        munmap(addr, file_size);
+        return false;
+    }
+    ForEachChunk(header.chunk_cnt, thread_num, [&](uint32_t chunk) {
+        return LoadChunk(base, chunks[chunk].offset, chunks[chunk + 1].offset, chunk_row_cnt(chunk), *plan,
+                         table.get(), succ_cnt, failed_cnt);
+    });
+    munmap(addr, file_size);
+    return true;
+}
+
+}  // namespace storage
+}  // namespace openmldb
@@ -0,0 +1,104 @@
+/*
+ * Copyright 2021 4Paradigm
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_STORAGE_SNAPSHOT_IMAGE_H_
+#define SRC_STORAGE_SNAPSHOT_IMAGE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <string>
+#include <vector>
+
+#include "proto/tablet.pb.h"
+#include "storage/mem_table.h"
+
+namespace openmldb {
+namespace storage {
+
+// an entry of the chunk table of a snapshot image
+struct ImageChunk {
+    // the offset of the first record of the chunk
+    uint64_t offset;
+    // the masked crc32c of the records of the chunk
+    uint32_t crc;
+    uint32_t reserved;
+};
+
+// a snapshot image keeps the same rows as a snapshot of a memory table in a flat binary
+// layout. the rows are resolved into the keys and the ts of the inner indexes when the
+// image is written, so they are put into the segments directly when the table is recovered,
+// without decoding protobuf or rows.
+//
+// layout: a header page, the records aligned to 8 bytes, then the chunk table with the offset
+// of the first record and the crc of every chunk, which are loaded by different threads. a record is
+//   RecordHead | ts of the ts columns of the plan | (inner pos, key size) of the keys | keys | value
+// the image is only used if the layout of the put plan of the table is the same as the
+// one it's written with
+class SnapshotImageWriter {
+ public:
+    SnapshotImageWriter(const std::shared_ptr<MemTable>& table, const std::string& path, uint32_t chunk_row_cnt);
+    ~SnapshotImageWriter();
+    SnapshotImageWriter(const SnapshotImageWriter&) = delete;
+    SnapshotImageWriter& operator=(const SnapshotImageWriter&) = delete;
+
+    bool Open();
+
+    // append a row written to the snapshot, it can be called by different threads. the image is
+    // aborted if it's failed
+    bool Append(const ::openmldb::api::LogEntry& entry);
+
+    // write the chunk offsets and the header, and sync the file
+    bool Finish();
+
+    // close and remove the file if it's not finished
+    void Abort();
+
+    uint64_t GetRowCnt() const { return row_cnt_; }
+
+ private:
+    bool Write(const void* data, size_t size);
+    void Close(bool remove);
+
+ private:
+    std::shared_ptr<MemTable> table_;
+    std::shared_ptr<const PutPlan> plan_;
+    // the layout of the plan when the writer is created, the rows are resolved by it
+    std::string layout_;
+    std::string path_;
+    uint32_t chunk_row_cnt_;
+    FILE* fd_;
+    uint64_t offset_;
+    uint64_t row_cnt_;
+    std::vector<ImageChunk> chunks_;
+    // the crc of the records of the last chunk
+    uint32_t chunk_crc_;
+    // protect the file and the offsets
+    std::mutex mu_;
+};
+
+// load the rows of the image into table by thread_num threads. return false without putting
+// any row if the image can not be used, e.g. it's broken, it has not expect_cnt rows or the
+// indexes of table are changed
+bool LoadSnapshotImage(const std::string& path, const std::shared_ptr<MemTable>& table, uint64_t expect_cnt,
+                       uint32_t thread_num, std::atomic<uint64_t>* succ_cnt, std::atomic<uint64_t>* failed_cnt);
+
+}  // namespace storage
+}  // namespace openmldb
+#endif  // SRC_STORAGE_SNAPSHOT_IMAGE_H_
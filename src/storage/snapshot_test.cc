@@ -23,7 +23,9 @@
 #include <time.h>
 #include <unistd.h>
 
+#include <fstream>
 #include <iostream>
+#include <iterator>
 
 #include "base/file_util.h"
 #include "base/glog_wapper.h"
@@ -42,6 +44,9 @@
 
 DECLARE_string(db_root_path);
 DECLARE_string(snapshot_compression);
+DECLARE_bool(snapshot_image);
+DECLARE_uint32(snapshot_part_num);
+DECLARE_uint32(snapshot_delta_max_num);
 
 using ::openmldb::api::LogEntry;
 namespace openmldb {
@@ -1707,6 +1712,297 @@ TEST_F(SnapshotTest, Recover_large_snapshot_and_binlog) {
     delete it;
 }
 
+TEST_F(SnapshotTest, Recover_snapshot_image) {
+    std::string snapshot_dir = FLAGS_db_root_path + "/102_0/snapshot/";
+    std::string binlog_dir = FLAGS_db_root_path + "/102_0/binlog/";
+    LogParts* log_part = new LogParts(12, 4, scmp);
+    uint64_t offset = 0;
+    uint32_t binlog_index = 0;
+    WriteHandle* wh = NULL;
+    RollWLogFile(&wh, log_part, binlog_dir, binlog_index, offset);
+    uint32_t total_num = 200000;
+    uint32_t key_num = 100;
+    for (uint32_t count = 0; count < total_num; count++) {
+        offset++;
+        auto entry = ::openmldb::test::PackKVEntry(offset, "key" + std::to_string(count % key_num),
+                "value" + std::to_string(count), count + 1, 1);
+        std::string buffer;
+        entry.SerializeToString(&buffer);
+        ::openmldb::base::Slice slice(buffer);
+        ::openmldb::log::Status status = wh->Write(slice);
+        ASSERT_TRUE(status.ok());
+    }
+    wh->Sync();
+    MemTableSnapshot snapshot(102, 0, log_part, FLAGS_db_root_path);
+    snapshot.Init();
+    std::map<std::string, uint32_t> mapping;
+    mapping.insert(std::make_pair("idx0", 0));
+    std::shared_ptr<MemTable> table =
+        std::make_shared<MemTable>("test", 102, 0, 8, mapping, 0, ::openmldb::type::TTLType::kAbsoluteTime);
+    table->Init();
+    FLAGS_snapshot_image = true;
+    uint64_t offset_value = 0;
+    int ret = snapshot.MakeSnapshot(table, offset_value, 0);
+    FLAGS_snapshot_image = false;
+    ASSERT_EQ(0, ret);
+    ::openmldb::api::Manifest manifest;
+    ASSERT_EQ(0, snapshot.GetLocalManifest(snapshot_dir + "MANIFEST", manifest));
+    ASSERT_TRUE(manifest.has_image_name());
+    ASSERT_EQ(total_num, manifest.count());
+    std::string image_path = snapshot_dir + manifest.image_name();
+    ASSERT_TRUE(::openmldb::base::IsExists(image_path));
+
+    auto check = [&](const std::shared_ptr<MemTable>& recovered) {
+        ASSERT_EQ(manifest.count(), recovered->GetRecordCnt());
+        for (uint32_t idx = 0; idx < key_num; idx++) {
+            Ticket ticket;
+            std::unique_ptr<TableIterator> it(recovered->NewIterator("key" + std::to_string(idx), ticket));
+            it->SeekToFirst();
+            uint64_t num = total_num - key_num + idx;
+            while (it->Valid()) {
+                ASSERT_EQ(num + 1, it->GetKey());
+                std::string value_str(it->GetValue().data(), it->GetValue().size());
+                ASSERT_EQ("value" + std::to_string(num), ::openmldb::test::DecodeV(value_str));
+                it->Next();
+                if (num < key_num) {
+                    break;
+                }
+                num -= key_num;
+            }
+            ASSERT_FALSE(it->Valid());
+            ASSERT_EQ(idx, num);
+        }
+    };
+    auto recover = [&](const std::map<std::string, uint32_t>& index_mapping) {
+        std::shared_ptr<MemTable> recovered = std::make_shared<MemTable>("test", 102, 0, 8, index_mapping, 0,
+                ::openmldb::type::TTLType::kAbsoluteTime);
+        recovered->Init();
+        uint64_t snapshot_offset = 0;
+        uint64_t start_time = ::baidu::common::timer::get_micros();
+        EXPECT_TRUE(snapshot.Recover(recovered, snapshot_offset));
+        std::cout << "use time in us: " << ::baidu::common::timer::get_micros() - start_time << std::endl;
+        EXPECT_EQ(manifest.offset(), snapshot_offset);
+        return recovered;
+    };
+    // from the image
+    check(recover(mapping));
+    // a key of the first record is changed but the record still can be parsed. the image can not
+    // be used as the crc of the chunk is mismatched, and no row of it is put
+    std::string image_data;
+    {
+        std::ifstream in(image_path, std::ios::binary);
+        image_data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    size_t key_offset = image_data.find("key", 4096);
+    ASSERT_NE(std::string::npos, key_offset);
+    auto write_image = [&](const std::string& data) {
+        std::ofstream out(image_path, std::ios::binary | std::ios::trunc);
+        out.write(data.data(), data.size());
+    };
+    std::string broken_data(image_data);
+    broken_data[key_offset + 1] = 'x';
+    write_image(broken_data);
+    check(recover(mapping));
+    write_image(image_data);
+    check(recover(mapping));
+    // the image can not be used as the indexes are changed
+    std::map<std::string, uint32_t> mapping1(mapping);
+    mapping1.insert(std::make_pair("idx1", 1));
+    check(recover(mapping1));
+    // the image of the last snapshot is removed if the new one is made without image
+    RollWLogFile(&wh, log_part, binlog_dir, binlog_index, offset);
+    offset++;
+    auto entry = ::openmldb::test::PackKVEntry(offset, "key_new", "value", 1, 1);
+    std::string buffer;
+    entry.SerializeToString(&buffer);
+    ASSERT_TRUE(wh->Write(::openmldb::base::Slice(buffer)).ok());
+    wh->Sync();
+    ASSERT_EQ(0, snapshot.MakeSnapshot(table, offset_value, 0));
+    ASSERT_EQ(0, snapshot.GetLocalManifest(snapshot_dir + "MANIFEST", manifest));
+    ASSERT_FALSE(manifest.has_image_name());
+    ASSERT_FALSE(::openmldb::base::IsExists(image_path));
+    check(recover(mapping));
+    delete wh;
+    RemoveData(FLAGS_db_root_path);
+}
+
+TEST_F(SnapshotTest, MakeSnapshotWithParts) {
+    std::string snapshot_dir = FLAGS_db_root_path + "/103_0/snapshot/";
+    std::string binlog_dir = FLAGS_db_root_path + "/103_0/binlog/";
+    LogParts* log_part = new LogParts(12, 4, scmp);
+    uint64_t offset = 0;
+    uint32_t binlog_index = 0;
+    WriteHandle* wh = NULL;
+    RollWLogFile(&wh, log_part, binlog_dir, binlog_index, offset);
+    uint32_t key_num = 100;
+    auto write_binlog = [&](uint32_t start, uint32_t end) {
+        for (uint32_t count = start; count < end; count++) {
+            offset++;
+            auto entry = ::openmldb::test::PackKVEntry(offset, "key" + std::to_string(count % key_num),
+                    "value" + std::to_string(count), count + 1, 1);
+            std::string buffer;
+            entry.SerializeToString(&buffer);
+            ASSERT_TRUE(wh->Write(::openmldb::base::Slice(buffer)).ok());
+        }
+        // delete a key
+        offset++;
+        ::openmldb::api::LogEntry entry;
+        entry.set_log_index(offset);
+        entry.set_method_type(::openmldb::api::MethodType::kDelete);
+        ::openmldb::api::Dimension* dimension = entry.add_dimensions();
+        dimension->set_key("key" + std::to_string(end % key_num));
+        dimension->set_idx(0);
+        std::string buffer;
+        entry.SerializeToString(&buffer);
+        ASSERT_TRUE(wh->Write(::openmldb::base::Slice(buffer)).ok());
+        wh->Sync();
+    };
+    write_binlog(0, 10000);
+    MemTableSnapshot snapshot(103, 0, log_part, FLAGS_db_root_path);
+    snapshot.Init();
+    std::map<std::string, uint32_t> mapping;
+    mapping.insert(std::make_pair("idx0", 0));
+    std::shared_ptr<MemTable> table =
+        std::make_shared<MemTable>("test", 103, 0, 8, mapping, 0, ::openmldb::type::TTLType::kAbsoluteTime);
+    table->Init();
+    auto check = [&](uint32_t part_num, uint64_t count) {
+        ::openmldb::api::Manifest manifest;
+        ASSERT_EQ(0, snapshot.GetLocalManifest(snapshot_dir + "MANIFEST", manifest));
+        ASSERT_EQ(count, manifest.count());
+        ASSERT_EQ(offset, manifest.offset());
+        ASSERT_EQ(part_num - 1, (uint32_t)manifest.part_names_size());
+        std::vector<std::string> files;
+        ASSERT_EQ(0, ::openmldb::base::GetFileName(snapshot_dir, files));
+        // the data files and MANIFEST
+        ASSERT_EQ(part_num + 1, files.size());
+        std::shared_ptr<MemTable> recovered =
+            std::make_shared<MemTable>("test", 103, 0, 8, mapping, 0, ::openmldb::type::TTLType::kAbsoluteTime);
+        recovered->Init();
+        uint64_t snapshot_offset = 0;
+        ASSERT_TRUE(snapshot.Recover(recovered, snapshot_offset));
+        ASSERT_EQ(offset, snapshot_offset);
+        ASSERT_EQ(count, recovered->GetRecordCnt());
+        Ticket ticket;
+        std::unique_ptr<TableIterator> it(recovered->NewIterator("key1", ticket));
+        it->SeekToFirst();
+        ASSERT_TRUE(it->Valid());
+        std::string value_str(it->GetValue().data(), it->GetValue().size());
+        ASSERT_EQ("value" + std::to_string(it->GetKey() - 1), ::openmldb::test::DecodeV(value_str));
+    };
+    FLAGS_snapshot_part_num = 4;
+    uint64_t offset_value = 0;
+    ASSERT_EQ(0, snapshot.MakeSnapshot(table, offset_value, 0));
+    // the 100 rows of key0 are deleted
+    check(4, 9900);
+
+    // the parts of the old snapshot are merged into less parts
+    RollWLogFile(&wh, log_part, binlog_dir, binlog_index, offset);
+    write_binlog(10000, 10050);
+    FLAGS_snapshot_part_num = 2;
+    ASSERT_EQ(0, snapshot.MakeSnapshot(table, offset_value, 0));
+    FLAGS_snapshot_part_num = 1;
+    // the rows of key50 are deleted
+    check(2, 9900 + 50 - 100);
+    delete wh;
+    RemoveData(FLAGS_db_root_path);
+}
+
+TEST_F(SnapshotTest, MakeDeltaSnapshot) {
+    std::string snapshot_dir = FLAGS_db_root_path + "/104_0/snapshot/";
+    std::string binlog_dir = FLAGS_db_root_path + "/104_0/binlog/";
+    LogParts* log_part = new LogParts(12, 4, scmp);
+    uint64_t offset = 0;
+    uint32_t binlog_index = 0;
+    WriteHandle* wh = NULL;
+    RollWLogFile(&wh, log_part, binlog_dir, binlog_index, offset);
+    uint32_t key_num = 100;
+    auto write_binlog = [&](uint32_t start, uint32_t end) {
+        for (uint32_t count = start; count < end; count++) {
+            offset++;
+            auto entry = ::openmldb::test::PackKVEntry(offset, "key" + std::to_string(count % key_num),
+                    "value" + std::to_string(count), count + 1, 1);
+            std::string buffer;
+            entry.SerializeToString(&buffer);
+            ASSERT_TRUE(wh->Write(::openmldb::base::Slice(buffer)).ok());
+        }
+        // delete a key
+        offset++;
+        ::openmldb::api::LogEntry entry;
+        entry.set_log_index(offset);
+        entry.set_method_type(::openmldb::api::MethodType::kDelete);
+        ::openmldb::api::Dimension* dimension = entry.add_dimensions();
+        dimension->set_key("key" + std::to_string(end % key_num));
+        dimension->set_idx(0);
+        std::string buffer;
+        entry.SerializeToString(&buffer);
+        ASSERT_TRUE(wh->Write(::openmldb::base::Slice(buffer)).ok());
+        wh->Sync();
+    };
+    MemTableSnapshot snapshot(104, 0, log_part, FLAGS_db_root_path);
+    snapshot.Init();
+    std::map<std::string, uint32_t> mapping;
+    mapping.insert(std::make_pair("idx0", 0));
+    std::shared_ptr<MemTable> table =
+        std::make_shared<MemTable>("test", 104, 0, 8, mapping, 0, ::openmldb::type::TTLType::kAbsoluteTime);
+    table->Init();
+    auto count_rows = [](std::shared_ptr<MemTable> recovered, const std::string& key) {
+        Ticket ticket;
+        std::unique_ptr<TableIterator> it(recovered->NewIterator(key, ticket));
+        uint32_t cnt = 0;
+        for (it->SeekToFirst(); it->Valid(); it->Next()) {
+            cnt++;
+        }
+        return cnt;
+    };
+    auto check = [&](int delta_num, uint64_t count, const std::map<std::string, uint32_t>& key_rows) {
+        ::openmldb::api::Manifest manifest;
+        ASSERT_EQ(0, snapshot.GetLocalManifest(snapshot_dir + "MANIFEST", manifest));
+        ASSERT_EQ(count, manifest.count());
+        ASSERT_EQ(offset, manifest.offset());
+        ASSERT_EQ(delta_num, manifest.deltas_size());
+        std::vector<std::string> files;
+        ASSERT_EQ(0, ::openmldb::base::GetFileName(snapshot_dir, files));
+        // the data file, the delta files and MANIFEST
+        ASSERT_EQ(delta_num + 2, (int)files.size());
+        std::shared_ptr<MemTable> recovered =
+            std::make_shared<MemTable>("test", 104, 0, 8, mapping, 0, ::openmldb::type::TTLType::kAbsoluteTime);
+        recovered->Init();
+        uint64_t snapshot_offset = 0;
+        ASSERT_TRUE(snapshot.Recover(recovered, snapshot_offset));
+        ASSERT_EQ(offset, snapshot_offset);
+        for (const auto& kv : key_rows) {
+            ASSERT_EQ(kv.second, count_rows(recovered, kv.first)) << kv.first;
+        }
+    };
+    FLAGS_snapshot_delta_max_num = 2;
+    uint64_t offset_value = 0;
+    // the first snapshot is a full one
+    write_binlog(0, 10000);
+    ASSERT_EQ(0, snapshot.MakeSnapshot(table, offset_value, 0));
+    check(0, 9900, {{"key0", 0}, {"key1", 100}, {"key50", 100}});
+
+    RollWLogFile(&wh, log_part, binlog_dir, binlog_index, offset);
+    write_binlog(10000, 10050);
+    ASSERT_EQ(0, snapshot.MakeSnapshot(table, offset_value, 0));
+    ASSERT_EQ(offset, offset_value);
+    // the rows of key50 in the full snapshot are deleted by the delta
+    check(1, 9900, {{"key0", 1}, {"key1", 101}, {"key50", 0}});
+
+    RollWLogFile(&wh, log_part, binlog_dir, binlog_index, offset);
+    write_binlog(10050, 10100);
+    ASSERT_EQ(0, snapshot.MakeSnapshot(table, offset_value, 0));
+    check(2, 9900, {{"key0", 0}, {"key1", 101}, {"key50", 1}});
+
+    // the delta snapshots are merged as the max num is reached
+    RollWLogFile(&wh, log_part, binlog_dir, binlog_index, offset);
+    write_binlog(10100, 10150);
+    ASSERT_EQ(0, snapshot.MakeSnapshot(table, offset_value, 0));
+    FLAGS_snapshot_delta_max_num = 0;
+    check(0, 9900 + 50 + 50 + 50 - 100 - 1 - 1, {{"key0", 1}, {"key1", 102}, {"key50", 0}, {"key99", 101}});
+    delete wh;
+    RemoveData(FLAGS_db_root_path);
+}
+
 }  // namespace storage
 }  // namespace openmldb
 
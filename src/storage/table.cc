@@ -96,6 +96,17 @@ void Table::AddVersionSchema(const ::openmldb::api::TableMeta& table_meta) {
     std::atomic_store_explicit(&version_decoder_, version_decoder, std::memory_order_relaxed);
 }
 
+bool Table::PutBatch(const PutBatchRows& rows, uint32_t* put_cnt) {
+    *put_cnt = 0;
+    for (const auto& row : rows) {
+        if (!Put(row.time(), row.value(), row.dimensions())) {
+            return false;
+        }
+        (*put_cnt)++;
+    }
+    return true;
+}
+
 void Table::SetTableMeta(::openmldb::api::TableMeta& table_meta) {  // NOLINT
     auto cur_table_meta = std::make_shared<::openmldb::api::TableMeta>(table_meta);
     std::atomic_store_explicit(&table_meta_, cur_table_meta, std::memory_order_release);
@@ -34,6 +34,7 @@ namespace storage {
 
 typedef google::protobuf::RepeatedPtrField<::openmldb::api::Dimension> Dimensions;
 typedef google::protobuf::RepeatedPtrField<::openmldb::api::TSDimension> TSDimensions;
+typedef google::protobuf::RepeatedPtrField<::openmldb::api::PutBatchRow> PutBatchRows;
 using Schema = google::protobuf::RepeatedPtrField<openmldb::common::ColumnDesc>;
 
 enum TableStat { kUndefined = 0, kNormal, kLoading, kMakingSnapshot, kSnapshotPaused };
@@ -57,6 +58,10 @@ class Table {
         return Put(entry.ts(), entry.value(), entry.dimensions());
     }
 
+    // put the rows in order and stop at the first failed one, put_cnt is the count
+    // of rows put before it
+    virtual bool PutBatch(const PutBatchRows& rows, uint32_t* put_cnt);
+
     virtual bool Delete(const std::string& pk, uint32_t idx) = 0;
 
     virtual TableIterator* NewIterator(const std::string& pk,
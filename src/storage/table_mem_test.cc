@@ -14,9 +14,18 @@
  * limitations under the License.
  */
 
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/glog_wapper.h"
+#include "codec/schema_codec.h"
+#include "codec/sdk_codec.h"
 #include "common/timer.h"
 #include "gtest/gtest.h"
+#include "storage/mem_table.h"
 #include "storage/table.h"
+#include "storage/ticket.h"
 #ifdef TCMALLOC_ENABLE
 #include "gperftools/heap-checker.h"
 #endif
@@ -53,6 +62,68 @@ TEST_F(TableMemTest, Memory) {
 #endif
 }
 
+TEST_F(TableMemTest, PutPlan) {
+    const uint32_t row_num = 400000;
+    ::openmldb::api::TableMeta table_meta;
+    table_meta.set_name("put_plan");
+    table_meta.set_tid(1);
+    table_meta.set_pid(1);
+    table_meta.set_seg_cnt(8);
+    table_meta.set_mode(::openmldb::api::TableMode::kTableLeader);
+    table_meta.set_format_version(1);
+    ::openmldb::codec::SchemaCodec::SetColumnDesc(table_meta.add_column_desc(), "card", ::openmldb::type::kString);
+    ::openmldb::codec::SchemaCodec::SetColumnDesc(table_meta.add_column_desc(), "mcc", ::openmldb::type::kString);
+    ::openmldb::codec::SchemaCodec::SetColumnDesc(table_meta.add_column_desc(), "price", ::openmldb::type::kBigInt);
+    ::openmldb::codec::SchemaCodec::SetColumnDesc(table_meta.add_column_desc(), "ts1", ::openmldb::type::kBigInt);
+    ::openmldb::codec::SchemaCodec::SetColumnDesc(table_meta.add_column_desc(), "ts2", ::openmldb::type::kBigInt);
+    ::openmldb::codec::SchemaCodec::SetIndex(table_meta.add_column_key(), "card", "card", "ts1",
+                                             ::openmldb::type::kAbsoluteTime, 0, 0);
+    ::openmldb::codec::SchemaCodec::SetIndex(table_meta.add_column_key(), "card1", "card", "ts2",
+                                             ::openmldb::type::kAbsoluteTime, 0, 0);
+    ::openmldb::codec::SchemaCodec::SetIndex(table_meta.add_column_key(), "mcc", "mcc", "ts1",
+                                             ::openmldb::type::kAbsoluteTime, 0, 0);
+    MemTable table(table_meta);
+    ASSERT_TRUE(table.Init());
+    ::openmldb::codec::SDKCodec codec(table_meta);
+    // the rows are encoded before, so only the puts are timed
+    std::vector<std::string> values(row_num);
+    std::vector<::openmldb::api::PutRequest> requests(row_num);
+    for (uint32_t i = 0; i < row_num; i++) {
+        std::vector<std::string> row = {"card" + std::to_string(i % 1000), "mcc" + std::to_string(i % 100), "13",
+                                        std::to_string(1000 + i), std::to_string(2000 + i)};
+        ASSERT_EQ(0, codec.EncodeRow(row, &values[i]));
+        auto dim = requests[i].add_dimensions();
+        dim->set_idx(0);
+        dim->set_key(row[0]);
+        dim = requests[i].add_dimensions();
+        dim->set_idx(1);
+        dim->set_key(row[0]);
+        dim = requests[i].add_dimensions();
+        dim->set_idx(2);
+        dim->set_key(row[1]);
+    }
+    uint64_t start = ::baidu::common::timer::get_micros();
+    for (uint32_t i = 0; i < row_num; i++) {
+        ASSERT_TRUE(table.Put(0, values[i], requests[i].dimensions()));
+    }
+    uint64_t consumed = ::baidu::common::timer::get_micros() - start;
+    PDLOG(INFO, "put %u rows of 3 indexes and 2 ts columns consumed %lu us, %lu ns per row", row_num, consumed,
+          consumed * 1000 / row_num);
+    ASSERT_EQ(row_num, table.GetRecordCnt());
+    Ticket ticket;
+    std::vector<std::pair<uint32_t, std::string>> keys = {{0, "card5"}, {1, "card5"}, {2, "mcc5"}};
+    for (const auto& kv : keys) {
+        TableIterator* it = table.NewIterator(kv.first, kv.second, ticket);
+        ASSERT_TRUE(it != NULL);
+        uint32_t cnt = 0;
+        for (it->SeekToFirst(); it->Valid(); it->Next()) {
+            cnt++;
+        }
+        ASSERT_EQ(kv.first == 2 ? row_num / 100 : row_num / 1000, cnt);
+        delete it;
+    }
+}
+
 }  // namespace storage
 }  // namespace openmldb
 
@@ -16,7 +16,9 @@
 
 #include <gflags/gflags.h>
 #include <atomic>
+#include <deque>
 #include <iostream>
+#include <thread>
 #include <utility>
 
 #include "base/glog_wapper.h"
@@ -38,6 +40,9 @@ DECLARE_string(ssd_root_path);
 DECLARE_string(hdd_root_path);
 DECLARE_uint32(max_traverse_cnt);
 DECLARE_int32(gc_safe_offset);
+DECLARE_uint32(cold_tier_age);
+DECLARE_uint32(gc_tick_key_cnt);
+DECLARE_uint32(latest_ring_max_cnt);
 
 namespace openmldb {
 namespace storage {
@@ -209,6 +214,70 @@ TEST_P(TableTest, MultiDimissionPut0) {
     delete table;
 }
 
+TEST_P(TableTest, PutBatch) {
+    ::openmldb::common::StorageMode storageMode = GetParam();
+    std::map<std::string, uint32_t> mapping;
+    mapping.insert(std::make_pair("idx0", 0));
+    mapping.insert(std::make_pair("idx1", 1));
+    std::string table_path = "";
+    int id = 1;
+    if (storageMode == ::openmldb::common::kHDD) {
+        id = ++counter;
+        table_path = GetDBPath(FLAGS_hdd_root_path, id, 1);
+    }
+    Table* table = CreateTable("tx_log", id, 1, 8, mapping, 0, ::openmldb::type::kAbsoluteTime, table_path,
+                               storageMode);
+    table->Init();
+    auto meta = ::openmldb::test::GetTableMeta({"idx0", "idx1"});
+    ::openmldb::codec::SDKCodec sdk_codec(meta);
+    PutBatchRows rows;
+    for (int i = 0; i < 100; i++) {
+        auto* row = rows.Add();
+        row->set_time(1000 + i);
+        std::string key0 = "key" + std::to_string(i % 10);
+        std::string key1 = "key" + std::to_string(i % 7);
+        sdk_codec.EncodeRow({key0, key1}, row->mutable_value());
+        auto* d0 = row->add_dimensions();
+        d0->set_key(key0);
+        d0->set_idx(0);
+        auto* d1 = row->add_dimensions();
+        d1->set_key(key1);
+        d1->set_idx(1);
+    }
+    uint32_t put_cnt = 0;
+    ASSERT_TRUE(table->PutBatch(rows, &put_cnt));
+    ASSERT_EQ(100u, put_cnt);
+    ASSERT_EQ(100, (int64_t)table->GetRecordCnt());
+    if (storageMode == ::openmldb::common::StorageMode::kMemory) {
+        ASSERT_EQ(200, (int64_t)table->GetRecordIdxCnt());
+        ASSERT_EQ(17, (int64_t)table->GetRecordPkCnt());
+    }
+    for (uint32_t idx = 0; idx < 2; idx++) {
+        Ticket ticket;
+        TableIterator* it = table->NewIterator(idx, "key3", ticket);
+        it->SeekToFirst();
+        uint64_t last_ts = UINT64_MAX;
+        int cnt = 0;
+        while (it->Valid()) {
+            ASSERT_LT(it->GetKey(), last_ts);
+            last_ts = it->GetKey();
+            cnt++;
+            it->Next();
+        }
+        ASSERT_EQ(idx == 0 ? 10 : 14, cnt);
+        delete it;
+    }
+    if (storageMode == ::openmldb::common::StorageMode::kMemory) {
+        // a batch with an invalid row is not put at all
+        rows.Mutable(50)->mutable_dimensions(1)->set_idx(5);
+        ASSERT_FALSE(table->PutBatch(rows, &put_cnt));
+        ASSERT_EQ(0u, put_cnt);
+        ASSERT_EQ(100, (int64_t)table->GetRecordCnt());
+        ASSERT_EQ(200, (int64_t)table->GetRecordIdxCnt());
+    }
+    delete table;
+}
+
 TEST_P(TableTest, IsExpired) {
     ::openmldb::common::StorageMode storageMode = GetParam();
     std::map<std::string, uint32_t> mapping;
@@ -484,6 +553,236 @@ TEST_P(TableTest, SchedGc) {
     delete table;
 }
 
+TEST_P(TableTest, SchedGcCold) {
+    ::openmldb::common::StorageMode storageMode = GetParam();
+    // cold tier is only for memory table
+    if (storageMode != ::openmldb::common::kMemory) {
+        return;
+    }
+    uint32_t old_cold_tier_age = FLAGS_cold_tier_age;
+    FLAGS_cold_tier_age = 60;
+    std::map<std::string, uint32_t> mapping;
+    mapping.insert(std::make_pair("idx0", 0));
+    Table* table = CreateTable("tx_log", 1, 1, 8, mapping, 60 * 24, ::openmldb::type::kAbsoluteTime, "",
+                               storageMode);
+    table->Init();
+    uint64_t now = ::baidu::common::timer::get_micros() / 1000;
+    uint64_t hour = 60 * 60 * 1000;
+    table->Put("test", now, "value0", 6);
+    table->Put("test", now - 2 * hour, "value1", 6);
+    table->Put("test", now - 3 * hour, "value2", 6);
+    table->Put("test", now - 48 * hour, "value3", 6);
+    table->SchedGc();
+    ASSERT_EQ(3, (int64_t)table->GetRecordCnt());
+    ASSERT_EQ(3, (int64_t)table->GetRecordIdxCnt());
+    table->Put("test", now - 1 * hour, "value4", 6);
+    {
+        Ticket ticket;
+        TableIterator* it = table->NewIterator("test", ticket);
+        it->SeekToFirst();
+        std::vector<std::string> values;
+        while (it->Valid()) {
+            values.push_back(it->GetValue().ToString());
+            it->Next();
+        }
+        ASSERT_EQ(std::vector<std::string>({"value0", "value4", "value1", "value2"}), values);
+        it->Seek(now - 2 * hour);
+        ASSERT_TRUE(it->Valid());
+        ASSERT_EQ("value1", it->GetValue().ToString());
+        delete it;
+    }
+    TraverseIterator* traverse_it = table->NewTraverseIterator(0);
+    traverse_it->SeekToFirst();
+    uint32_t cnt = 0;
+    while (traverse_it->Valid()) {
+        cnt++;
+        traverse_it->Next();
+    }
+    ASSERT_EQ(4u, cnt);
+    delete traverse_it;
+    delete table;
+    FLAGS_cold_tier_age = old_cold_tier_age;
+}
+
+TEST_P(TableTest, SchedGcSharedRow) {
+    ::openmldb::common::StorageMode storageMode = GetParam();
+    if (storageMode != ::openmldb::common::kMemory) {
+        return;
+    }
+    std::map<std::string, uint32_t> mapping;
+    mapping.insert(std::make_pair("idx0", 0));
+    mapping.insert(std::make_pair("idx1", 1));
+    Table* table = CreateTable("tx_log", 1, 1, 8, mapping, 1, ::openmldb::type::kAbsoluteTime, "", storageMode);
+    table->Init();
+    MemTable* mem_table = dynamic_cast<MemTable*>(table);
+    ASSERT_TRUE(mem_table != NULL);
+    auto meta = ::openmldb::test::GetTableMeta({"idx0", "idx1"});
+    ::openmldb::codec::SDKCodec sdk_codec(meta);
+    for (uint64_t ts = 1; ts <= 3; ts++) {
+        Dimensions dimensions;
+        ::openmldb::api::Dimension* d0 = dimensions.Add();
+        d0->set_key("d0");
+        d0->set_idx(0);
+        ::openmldb::api::Dimension* d1 = dimensions.Add();
+        d1->set_key("d1");
+        d1->set_idx(1);
+        std::string result;
+        sdk_codec.EncodeRow({"d0", "d1"}, &result);
+        ASSERT_TRUE(table->Put(ts, result, dimensions));
+    }
+    for (uint32_t idx = 0; idx < 2; idx++) {
+        Ticket ticket;
+        TableIterator* it = table->NewIterator(idx, idx == 0 ? "d0" : "d1", ticket);
+        it->SeekToFirst();
+        std::vector<uint64_t> ts_vec;
+        while (it->Valid()) {
+            ts_vec.push_back(it->GetKey());
+            it->Next();
+        }
+        ASSERT_EQ(std::vector<uint64_t>({3, 2, 1}), ts_vec);
+        it->Seek(2);
+        ASSERT_TRUE(it->Valid());
+        ASSERT_EQ(2u, it->GetKey());
+        delete it;
+    }
+    // gc the inner indexes in parallel, the shared rows are released once
+    std::vector<std::thread> threads;
+    std::atomic<bool> done(false);
+    mem_table->SchedGc([&threads](const std::function<void()>& task, uint32_t) { threads.emplace_back(task); },
+                       [&done]() { done.store(true); });
+    for (auto& t : threads) {
+        t.join();
+    }
+    ASSERT_TRUE(done.load());
+    ASSERT_EQ(0, (int64_t)table->GetRecordCnt());
+    ASSERT_EQ(0, (int64_t)table->GetRecordIdxCnt());
+    delete table;
+}
+
+TEST_P(TableTest, IncrementalGc) {
+    ::openmldb::common::StorageMode storageMode = GetParam();
+    if (storageMode != ::openmldb::common::kMemory) {
+        return;
+    }
+    std::map<std::string, uint32_t> mapping;
+    mapping.insert(std::make_pair("idx0", 0));
+    mapping.insert(std::make_pair("idx1", 1));
+    Table* table = CreateTable("tx_log", 1, 1, 8, mapping, 1, ::openmldb::type::kAbsoluteTime, "", storageMode);
+    table->Init();
+    MemTable* mem_table = dynamic_cast<MemTable*>(table);
+    ASSERT_TRUE(mem_table != NULL);
+    auto meta = ::openmldb::test::GetTableMeta({"idx0", "idx1"});
+    ::openmldb::codec::SDKCodec sdk_codec(meta);
+    for (int i = 0; i < 100; i++) {
+        std::string key = "key" + std::to_string(i);
+        Dimensions dimensions;
+        ::openmldb::api::Dimension* d0 = dimensions.Add();
+        d0->set_key(key);
+        d0->set_idx(0);
+        ::openmldb::api::Dimension* d1 = dimensions.Add();
+        d1->set_key(key);
+        d1->set_idx(1);
+        std::string result;
+        sdk_codec.EncodeRow({key, key}, &result);
+        ASSERT_TRUE(table->Put(1, result, dimensions));
+    }
+    ASSERT_EQ(100, (int64_t)table->GetRecordCnt());
+    uint32_t old_tick_key_cnt = FLAGS_gc_tick_key_cnt;
+    FLAGS_gc_tick_key_cnt = 5;
+    // run the ticks one by one, a tick submits the next one of its index
+    std::deque<std::function<void()>> tasks;
+    uint32_t delayed_cnt = 0;
+    bool done = false;
+    mem_table->SchedGc(
+        [&tasks, &delayed_cnt](const std::function<void()>& task, uint32_t delay_ms) {
+            if (delay_ms > 0) {
+                delayed_cnt++;
+            }
+            tasks.push_back(task);
+        },
+        [&done]() { done = true; });
+    ASSERT_EQ(2u, tasks.size());
+    ASSERT_EQ(200, (int64_t)mem_table->GetGcBacklogKeyCnt());
+    while (!tasks.empty()) {
+        auto task = tasks.front();
+        tasks.pop_front();
+        task();
+        if (!done) {
+            ASSERT_GT(mem_table->GetGcBacklogKeyCnt(), 0u);
+        }
+    }
+    FLAGS_gc_tick_key_cnt = old_tick_key_cnt;
+    ASSERT_TRUE(done);
+    ASSERT_GE(mem_table->GetGcTickCnt(), 40u);
+    ASSERT_EQ(mem_table->GetGcTickCnt(), delayed_cnt + 2);
+    ASSERT_EQ(0u, mem_table->GetGcBacklogKeyCnt());
+    ASSERT_EQ(0, (int64_t)table->GetRecordCnt());
+    ASSERT_EQ(0, (int64_t)table->GetRecordIdxCnt());
+    ASSERT_EQ(0, (int64_t)table->GetRecordPkCnt());
+    delete table;
+}
+
+TEST_P(TableTest, LatestRing) {
+    ::openmldb::common::StorageMode storageMode = GetParam();
+    if (storageMode != ::openmldb::common::kMemory) {
+        return;
+    }
+    uint32_t old_ring_max_cnt = FLAGS_latest_ring_max_cnt;
+    FLAGS_latest_ring_max_cnt = 10;
+    std::map<std::string, uint32_t> mapping;
+    mapping.insert(std::make_pair("idx0", 0));
+    Table* table = CreateTable("tx_log", 1, 1, 8, mapping, 3, ::openmldb::type::kLatestTime, "", storageMode);
+    table->Init();
+    FLAGS_latest_ring_max_cnt = old_ring_max_cnt;
+    auto count_rows = [table](const std::string& pk) {
+        Ticket ticket;
+        TableIterator* it = table->NewIterator(pk, ticket);
+        it->SeekToFirst();
+        uint64_t cnt = 0;
+        uint64_t last_ts = UINT64_MAX;
+        while (it->Valid()) {
+            EXPECT_LT(it->GetKey(), last_ts);
+            last_ts = it->GetKey();
+            cnt++;
+            it->Next();
+        }
+        delete it;
+        return cnt;
+    };
+    for (int i = 0; i < 10; i++) {
+        std::string value = ::openmldb::test::EncodeKV("test", "value" + std::to_string(i));
+        table->Put("test", 100 + i, value.data(), value.size());
+    }
+    ASSERT_EQ(3u, count_rows("test"));
+    ASSERT_EQ(3, (int64_t)table->GetRecordIdxCnt());
+    table->SchedGc();
+    ASSERT_EQ(3, (int64_t)table->GetRecordCnt());
+    ASSERT_EQ(1, (int64_t)table->GetRecordPkCnt());
+    {
+        Ticket ticket;
+        TableIterator* it = table->NewIterator("test", ticket);
+        it->Seek(108);
+        ASSERT_TRUE(it->Valid());
+        ASSERT_EQ(108, (int64_t)it->GetKey());
+        delete it;
+    }
+    // a larger latest count than the ring moves the rows back to skiplist
+    ::openmldb::storage::UpdateTTLMeta update_ttl(::openmldb::storage::TTLSt(0, 20, ::openmldb::storage::kLatestTime));
+    table->SetTTL(update_ttl);
+    table->SchedGc();
+    ASSERT_EQ(3u, count_rows("test"));
+    for (int i = 0; i < 30; i++) {
+        std::string value = ::openmldb::test::EncodeKV("test", "value" + std::to_string(i));
+        table->Put("test", 200 + i, value.data(), value.size());
+    }
+    ASSERT_EQ(33u, count_rows("test"));
+    table->SchedGc();
+    ASSERT_EQ(20u, count_rows("test"));
+    ASSERT_EQ(20, (int64_t)table->GetRecordCnt());
+    ASSERT_EQ(20, (int64_t)table->GetRecordIdxCnt());
+    delete table;
+}
+
 TEST_P(TableTest, TableDataCnt) {
     ::openmldb::common::StorageMode storageMode = GetParam();
 
@@ -1347,7 +1646,8 @@ TEST_P(TableTest, GcAbsOrLat) {
     // refer to issue #1238
     if (storageMode == ::openmldb::common::StorageMode::kMemory) {
         ASSERT_EQ(0, (int64_t)table->GetRecordIdxCnt());
-        ASSERT_EQ(2, (int64_t)table->GetRecordPkCnt());
+        // the empty keys are released once no reader is on them
+        ASSERT_EQ(0, (int64_t)table->GetRecordPkCnt());
     }
     {
         ::openmldb::api::LogEntry entry;
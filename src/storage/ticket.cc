@@ -26,6 +26,9 @@ Ticket::~Ticket() {
     for (; it != entries_.end(); ++it) {
         (*it)->UnRef();
     }
+    for (const auto& pin : pins_) {
+        pin.first->UnPin(pin.second);
+    }
 }
 
 void Ticket::Push(KeyEntry* entry) {
@@ -44,5 +47,17 @@ void Ticket::Pop() {
     }
 }
 
+void Ticket::Pin(EpochManager* epoch) {
+    if (epoch == NULL) {
+        return;
+    }
+    for (const auto& pin : pins_) {
+        if (pin.first == epoch) {
+            return;
+        }
+    }
+    pins_.emplace_back(epoch, epoch->Pin());
+}
+
 }  // namespace storage
 }  // namespace openmldb
@@ -17,8 +17,10 @@
 #ifndef SRC_STORAGE_TICKET_H_
 #define SRC_STORAGE_TICKET_H_
 
+#include <utility>
 #include <vector>
 
+#include "storage/epoch.h"
 #include "storage/segment.h"
 
 namespace openmldb {
@@ -26,6 +28,8 @@ namespace storage {
 
 class KeyEntry;
 
+// Ticket keeps the memory of segments observed by the iterators alive until the
+// ticket is destroyed, so it must outlive the iterators created with it
 class Ticket {
  public:
     Ticket();
@@ -36,8 +40,12 @@ class Ticket {
     void Push(KeyEntry* entry);
     void Pop();
 
+    // pin the current epoch of a segment, a segment is pinned only once by a ticket
+    void Pin(EpochManager* epoch);
+
  private:
     std::vector<KeyEntry*> entries_;
+    std::vector<std::pair<EpochManager*, uint64_t>> pins_;
 };
 
 }  // namespace storage
@@ -96,6 +96,7 @@ DECLARE_uint32(task_check_interval);
 DECLARE_uint32(load_index_max_wait_time);
 DECLARE_bool(use_name);
 DECLARE_bool(enable_distsql);
+DECLARE_string(jit_object_cache_dir);
 DECLARE_string(snapshot_compression);
 DECLARE_string(file_compression);
 
@@ -108,6 +109,7 @@ DECLARE_int32(zk_keep_alive_check_interval);
 
 DECLARE_int32(binlog_sync_to_disk_interval);
 DECLARE_int32(binlog_delete_interval);
+DECLARE_int32(binlog_sync_wait_time);
 DECLARE_uint32(absolute_ttl_max);
 DECLARE_uint32(latest_ttl_max);
 DECLARE_uint32(max_traverse_cnt);
@@ -205,6 +207,7 @@ bool TabletImpl::Init(const std::string& zk_cluster, const std::string& zk_path,
     } else {
         options.SetClusterOptimized(false);
     }
+    options.jit_options().SetObjectCacheDir(FLAGS_jit_object_cache_dir);
     engine_ = std::unique_ptr<::hybridse::vm::Engine>(new ::hybridse::vm::Engine(catalog_, options));
     catalog_->SetLocalTablet(
         std::shared_ptr<::hybridse::vm::Tablet>(new ::hybridse::vm::LocalTablet(engine_.get(), sp_cache_)));
@@ -712,7 +715,7 @@ void TabletImpl::Put(RpcController* controller, const ::openmldb::api::PutReques
     }
     bool ok = false;
     if (request->dimensions_size() > 0) {
-        int32_t ret_code = CheckDimessionPut(request, table->GetIdxCnt());
+        int32_t ret_code = CheckDimessionPut(request->dimensions(), table->GetIdxCnt());
         if (ret_code != 0) {
             response->set_code(::openmldb::base::ReturnCode::kInvalidDimensionParameter);
             response->set_msg("invalid dimension parameter");
@@ -747,7 +750,12 @@ void TabletImpl::Put(RpcController* controller, const ::openmldb::api::PutReques
         if (request->ts_dimensions_size() > 0) {
             entry.mutable_ts_dimensions()->CopyFrom(request->ts_dimensions());
         }
-        replicator->AppendEntry(entry);
+        if (!replicator->AppendEntry(entry)) {
+            PDLOG(WARNING, "fail to append entry. tid %u pid %u", request->tid(), request->pid());
+            response->set_code(::openmldb::base::ReturnCode::kFailToAppendEntriesToReplicator);
+            response->set_msg("fail to append entry to replicator");
+            return;
+        }
     } while (false);
 
     ok = UpdateAggrs(request->tid(), request->pid(), request->value(),
@@ -789,6 +797,106 @@ void TabletImpl::Put(RpcController* controller, const ::openmldb::api::PutReques
     }
 }
 
+void TabletImpl::PutBatch(RpcController* controller, const ::openmldb::api::PutBatchRequest* request,
+                          ::openmldb::api::PutBatchResponse* response, Closure* done) {
+    brpc::ClosureGuard done_guard(done);
+    response->set_put_cnt(0);
+    if (follower_.load(std::memory_order_relaxed)) {
+        response->set_code(::openmldb::base::ReturnCode::kIsFollowerCluster);
+        response->set_msg("is follower cluster");
+        return;
+    }
+    uint64_t start_time = ::baidu::common::timer::get_micros();
+    std::shared_ptr<Table> table = GetTable(request->tid(), request->pid());
+    if (!table) {
+        PDLOG(WARNING, "table is not exist. tid %u, pid %u", request->tid(), request->pid());
+        response->set_code(::openmldb::base::ReturnCode::kTableIsNotExist);
+        response->set_msg("table is not exist");
+        return;
+    }
+    if (!table->IsLeader()) {
+        response->set_code(::openmldb::base::ReturnCode::kTableIsFollower);
+        response->set_msg("table is follower");
+        return;
+    }
+    if (table->GetTableStat() == ::openmldb::storage::kLoading) {
+        PDLOG(WARNING, "table is loading. tid %u, pid %u", request->tid(), request->pid());
+        response->set_code(::openmldb::base::ReturnCode::kTableIsLoading);
+        response->set_msg("table is loading");
+        return;
+    }
+    for (const auto& row : request->rows()) {
+        if (row.dimensions_size() == 0 || CheckDimessionPut(row.dimensions(), table->GetIdxCnt()) != 0) {
+            response->set_code(::openmldb::base::ReturnCode::kInvalidDimensionParameter);
+            response->set_msg("invalid dimension parameter");
+            return;
+        }
+    }
+    uint32_t put_cnt = 0;
+    bool ok = table->PutBatch(request->rows(), &put_cnt);
+    response->set_put_cnt(put_cnt);
+    if (put_cnt == 0 && !ok) {
+        response->set_code(::openmldb::base::ReturnCode::kPutFailed);
+        response->set_msg("put failed");
+        return;
+    }
+    // the rows put are logged and aggregated even if the rest of batch is failed
+    std::shared_ptr<LogReplicator> replicator = GetReplicator(request->tid(), request->pid());
+    std::vector<::openmldb::api::LogEntry> entries(put_cnt);
+    uint32_t log_cnt = put_cnt;
+    if (replicator) {
+        uint64_t term = replicator->GetLeaderTerm();
+        for (uint32_t i = 0; i < put_cnt; i++) {
+            const auto& row = request->rows(i);
+            entries[i].set_ts(row.time());
+            entries[i].set_value(row.value());
+            entries[i].set_term(term);
+            entries[i].mutable_dimensions()->CopyFrom(row.dimensions());
+        }
+        log_cnt = replicator->AppendEntries(entries);
+    } else {
+        PDLOG(WARNING, "fail to find table tid %u pid %u leader's log replicator", request->tid(), request->pid());
+    }
+    // the rows after the first one not logged are not in binlog, so they are not counted as put
+    for (uint32_t i = 0; i < log_cnt; i++) {
+        const auto& row = request->rows(i);
+        if (!UpdateAggrs(request->tid(), request->pid(), row.value(), row.dimensions(), entries[i].log_index())) {
+            response->set_code(::openmldb::base::ReturnCode::kError);
+            response->set_msg("update aggr failed");
+            return;
+        }
+    }
+    if (log_cnt < put_cnt) {
+        PDLOG(WARNING, "fail to append entries, %u of %u rows are logged. tid %u pid %u", log_cnt, put_cnt,
+              request->tid(), request->pid());
+        if (log_cnt > 0 && FLAGS_binlog_notify_on_put) {
+            replicator->Notify();
+        }
+        response->set_put_cnt(log_cnt);
+        response->set_code(::openmldb::base::ReturnCode::kFailToAppendEntriesToReplicator);
+        response->set_msg("fail to append entries to replicator");
+        return;
+    }
+    if (!ok) {
+        response->set_code(::openmldb::base::ReturnCode::kPutFailed);
+        response->set_msg("put failed");
+        return;
+    }
+    response->set_code(::openmldb::base::ReturnCode::kOk);
+    uint64_t end_time = ::baidu::common::timer::get_micros();
+    if (start_time + FLAGS_put_slow_log_threshold < end_time) {
+        PDLOG(INFO, "slow log[put batch]. row cnt %d time %lu. tid %u, pid %u", request->rows_size(),
+              end_time - start_time, request->tid(), request->pid());
+    }
+    if (replicator && FLAGS_binlog_notify_on_put) {
+        replicator->Notify();
+    }
+    if (!IsClusterMode() && table->GetDB() == openmldb::nameserver::INFORMATION_SCHEMA_DB &&
+        table->GetName() == openmldb::nameserver::GLOBAL_VARIABLES) {
+        UpdateGlobalVarTable();
+    }
+}
+
 int TabletImpl::CheckTableMeta(const openmldb::api::TableMeta* table_meta, std::string& msg) {
     msg.clear();
     if (table_meta->name().empty()) {
@@ -1548,7 +1656,12 @@ void TabletImpl::Delete(RpcController* controller, const ::openmldb::api::Delete
         ::openmldb::api::Dimension* dimension = entry.add_dimensions();
         dimension->set_key(request->key());
         dimension->set_idx(idx);
-        replicator->AppendEntry(entry);
+        if (!replicator->AppendEntry(entry)) {
+            PDLOG(WARNING, "fail to append entry. tid %u pid %u", request->tid(), request->pid());
+            response->set_code(::openmldb::base::ReturnCode::kFailToAppendEntriesToReplicator);
+            response->set_msg("fail to append entry to replicator");
+            return;
+        }
     } while (false);
     if (replicator && FLAGS_binlog_notify_on_put) {
         replicator->Notify();
@@ -2151,7 +2264,30 @@ void TabletImpl::AppendEntries(RpcController* controller, const ::openmldb::api:
     response->set_code(::openmldb::base::ReturnCode::kOk);
     response->set_msg("ok");
     uint64_t last_log_offset = replicator->GetOffset();
-    if (request->pre_log_index() == 0 && request->entries_size() == 0) {
+    ::openmldb::api::AppendEntriesRequest decompressed;
+    // the binlog records of the entries if they are sent as they are
+    std::vector<std::string> records;
+    const auto* entries = &request->entries();
+    if (request->raw_entry_num() > 0) {
+        const butil::IOBuf& attachment = static_cast<brpc::Controller*>(controller)->request_attachment();
+        if (!::openmldb::replica::ReplicateNode::ParseRawEntries(attachment, request->raw_entry_num(), &records,
+                                                                 &decompressed)) {
+            PDLOG(WARNING, "fail to parse raw entries. tid %u pid %u", tid, pid);
+            response->set_code(::openmldb::base::ReturnCode::kFailToAppendEntriesToReplicator);
+            response->set_msg("fail to parse raw entries");
+            return;
+        }
+        entries = &decompressed.entries();
+    } else if (request->has_compressed_entries()) {
+        if (!::openmldb::replica::ReplicateNode::DecompressEntries(*request, &decompressed)) {
+            PDLOG(WARNING, "fail to decompress entries. tid %u pid %u", tid, pid);
+            response->set_code(::openmldb::base::ReturnCode::kFailToAppendEntriesToReplicator);
+            response->set_msg("fail to decompress entries");
+            return;
+        }
+        entries = &decompressed.entries();
+    }
+    if (request->pre_log_index() == 0 && entries->size() == 0) {
         response->set_log_offset(last_log_offset);
         if (!FLAGS_zk_cluster.empty() && request->term() > term) {
             replicator->SetLeaderTerm(request->term());
@@ -2162,19 +2298,38 @@ void TabletImpl::AppendEntries(RpcController* controller, const ::openmldb::api:
         PDLOG(INFO, "first sync log_index! log_offset[%lu] tid[%u] pid[%u]", last_log_offset, tid, pid);
         return;
     }
-    for (int32_t i = 0; i < request->entries_size(); i++) {
-        const auto& entry = request->entries(i);
+    // the requests of a pipelined leader may be processed out of order, so it waits for the
+    // ones before. the leader sends the records after log offset again if they are missing
+    if (request->pre_log_index() > last_log_offset) {
+        if (!replicator->WaitForOffset(request->pre_log_index(), FLAGS_binlog_sync_wait_time)) {
+            last_log_offset = replicator->GetOffset();
+            PDLOG(WARNING, "pre log index %lu is greater than log offset %lu. tid %u pid %u",
+                  request->pre_log_index(), last_log_offset, tid, pid);
+            response->set_code(::openmldb::base::ReturnCode::kLogIsNotContinuous);
+            response->set_msg("log is not continuous");
+            response->set_log_offset(last_log_offset);
+            return;
+        }
+        last_log_offset = replicator->GetOffset();
+    }
+    for (int32_t i = 0; i < entries->size(); i++) {
+        const auto& entry = entries->Get(i);
         if (entry.log_index() <= last_log_offset) {
-            PDLOG(WARNING, "entry log_index %lu cur log_offset %lu tid %u pid %u", request->entries(i).log_index(),
+            PDLOG(WARNING, "entry log_index %lu cur log_offset %lu tid %u pid %u", entry.log_index(),
                     last_log_offset, tid, pid);
             continue;
         }
-        if (!replicator->ApplyEntry(entry)) {
+        bool applied = false;
+        if (!replicator->ApplyEntry(entry, &applied, records.empty() ? NULL : &records[i])) {
             PDLOG(WARNING, "fail to write binlog. tid %u pid %u", tid, pid);
             response->set_code(::openmldb::base::ReturnCode::kFailToAppendEntriesToReplicator);
             response->set_msg("fail to append entries to replicator");
             return;
         }
+        if (!applied) {
+            // applied by a request resent concurrently
+            continue;
+        }
         if (entry.has_method_type() && entry.method_type() == ::openmldb::api::MethodType::kDelete) {
             if (entry.dimensions_size() == 0) {
                 PDLOG(WARNING, "no dimesion. tid %u pid %u", tid, pid);
@@ -2330,6 +2485,10 @@ void TabletImpl::GetTableStatus(RpcController* controller, const ::openmldb::api
                     status->set_record_idx_byte_size(mem_table->GetRecordIdxByteSize());
                     status->set_record_pk_cnt(mem_table->GetRecordPkCnt());
                     status->set_skiplist_height(mem_table->GetKeyEntryHeight());
+                    status->set_gc_backlog_key_cnt(mem_table->GetGcBacklogKeyCnt());
+                    status->set_gc_tick_cnt(mem_table->GetGcTickCnt());
+                    status->set_gc_tick_time(mem_table->GetGcTickTime());
+                    status->set_gc_max_tick_time(mem_table->GetGcMaxTickTime());
                     uint64_t record_idx_cnt = 0;
                     auto indexs = table->GetAllIndex();
                     for (const auto& index_def : indexs) {
@@ -2348,6 +2507,10 @@ void TabletImpl::GetTableStatus(RpcController* controller, const ::openmldb::api
                     }
                     status->set_idx_cnt(record_idx_cnt);
                 }
+            } else if (DiskTable* disk_table = dynamic_cast<DiskTable*>(table.get())) {
+                status->set_row_cache_hit_cnt(disk_table->GetRowCacheHitCnt());
+                status->set_row_cache_miss_cnt(disk_table->GetRowCacheMissCnt());
+                status->set_row_cache_byte_size(disk_table->GetRowCacheByteSize());
             }
         }
     }
@@ -2750,7 +2913,7 @@ void TabletImpl::SendSnapshotInternal(const std::string& endpoint, uint32_t tid,
         }
         full_path.append("snapshot/");
         std::string manifest_file = full_path + "MANIFEST";
-        std::string snapshot_file;
+        std::vector<std::string> snapshot_files;
         {
             int fd = open(manifest_file.c_str(), O_RDONLY);
             if (fd < 0) {
@@ -2765,15 +2928,28 @@ void TabletImpl::SendSnapshotInternal(const std::string& endpoint, uint32_t tid,
                 PDLOG(WARNING, "parse manifest failed. tid[%u] pid[%u]", tid, pid);
                 break;
             }
-            snapshot_file = manifest.name();
+            snapshot_files = ::openmldb::storage::Snapshot::GetDataFiles(manifest);
+            if (table->GetStorageMode() == common::kMemory) {
+                // the delta snapshots are applied after the data files in order
+                std::vector<std::string> delta_files = ::openmldb::storage::Snapshot::GetDeltaFiles(manifest);
+                snapshot_files.insert(snapshot_files.end(), delta_files.begin(), delta_files.end());
+            }
         }
         if (table->GetStorageMode() == common::kMemory) {
-            // send snapshot file
-            if (sender.SendFile(snapshot_file, full_path + snapshot_file) < 0) {
-                PDLOG(WARNING, "send snapshot failed. tid[%u] pid[%u]", tid, pid);
+            // send all data files of the snapshot
+            bool send_failed = false;
+            for (const auto& snapshot_file : snapshot_files) {
+                if (sender.SendFile(snapshot_file, full_path + snapshot_file) < 0) {
+                    PDLOG(WARNING, "send snapshot %s failed. tid[%u] pid[%u]", snapshot_file.c_str(), tid, pid);
+                    send_failed = true;
+                    break;
+                }
+            }
+            if (send_failed) {
                 break;
             }
         } else {
+            std::string snapshot_file = snapshot_files.empty() ? "" : snapshot_files[0];
             if (sender.SendDir(snapshot_file, full_path + snapshot_file) < 0) {
                 PDLOG(WARNING, "send snapshot failed. tid[%u] pid[%u]", tid, pid);
                 break;
@@ -4021,6 +4197,24 @@ void TabletImpl::GcTable(uint32_t tid, uint32_t pid, bool execute_once) {
     std::shared_ptr<Table> table = GetTable(tid, pid);
     if (table) {
         int32_t gc_interval = table->GetStorageMode() == common::kMemory ? FLAGS_gc_interval : FLAGS_disk_gc_interval;
+        if (table->GetStorageMode() == common::kMemory) {
+            // the inner indexes are gc concurrently in gc_pool_, the next gc is scheduled by the last one
+            std::dynamic_pointer_cast<MemTable>(table)->SchedGc(
+                [this, table](const std::function<void()>& task, uint32_t delay_ms) {
+                    if (delay_ms == 0) {
+                        gc_pool_.AddTask([table, task]() { task(); });
+                    } else {
+                        gc_pool_.DelayTask(delay_ms, [table, task]() { task(); });
+                    }
+                },
+                [this, tid, pid, gc_interval, execute_once]() {
+                    if (!execute_once) {
+                        gc_pool_.DelayTask(gc_interval * 60 * 1000,
+                                           boost::bind(&TabletImpl::GcTable, this, tid, pid, false));
+                    }
+                });
+            return;
+        }
         table->SchedGc();
         if (!execute_once) {
             gc_pool_.DelayTask(gc_interval * 60 * 1000, boost::bind(&TabletImpl::GcTable, this, tid, pid, false));
@@ -4355,17 +4549,17 @@ bool TabletImpl::RefreshAggrCatalog() {
     return true;
 }
 
-int TabletImpl::CheckDimessionPut(const ::openmldb::api::PutRequest* request, uint32_t idx_cnt) {
-    for (int32_t i = 0; i < request->dimensions_size(); i++) {
-        if (idx_cnt <= request->dimensions(i).idx()) {
+int TabletImpl::CheckDimessionPut(const ::openmldb::storage::Dimensions& dimensions, uint32_t idx_cnt) {
+    for (const auto& dimension : dimensions) {
+        if (idx_cnt <= dimension.idx()) {
             PDLOG(WARNING,
                   "invalid put request dimensions, request idx %u is greater "
                   "than table idx cnt %u",
-                  request->dimensions(i).idx(), idx_cnt);
+                  dimension.idx(), idx_cnt);
             return -1;
         }
-        if (request->dimensions(i).key().length() <= 0) {
-            PDLOG(WARNING, "invalid put request dimension key is empty with idx %u", request->dimensions(i).idx());
+        if (dimension.key().length() <= 0) {
+            PDLOG(WARNING, "invalid put request dimension key is empty with idx %u", dimension.idx());
             return 1;
         }
     }
@@ -4953,7 +5147,12 @@ void TabletImpl::LoadIndexDataInternal(uint32_t tid, uint32_t pid, uint32_t cur_
         } else {
             table->Put(entry);
         }
-        replicator->AppendEntry(entry);
+        if (!replicator->AppendEntry(entry)) {
+            PDLOG(WARNING, "fail to append entry. tid %u pid %u", tid, pid);
+            delete seq_file;
+            SetTaskStatus(task, ::openmldb::api::TaskStatus::kFailed);
+            return;
+        }
         succ_cnt++;
     }
     delete seq_file;
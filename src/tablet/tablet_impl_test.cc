@@ -1586,6 +1586,57 @@ TEST_P(TabletImplTest, ScanWithLatestN) {
 }
 
 
+TEST_P(TabletImplTest, PutBatch) {
+    ::openmldb::common::StorageMode storage_mode = GetParam();
+    TabletImpl tablet;
+    uint32_t id = counter++;
+    tablet.Init("");
+    ::openmldb::api::CreateTableRequest request;
+    ::openmldb::api::TableMeta* table_meta = request.mutable_table_meta();
+    table_meta->set_name("t0");
+    table_meta->set_tid(id);
+    table_meta->set_pid(1);
+    table_meta->set_storage_mode(storage_mode);
+    AddDefaultSchema(0, 0, ::openmldb::type::TTLType::kLatestTime, table_meta);
+    ::openmldb::api::CreateTableResponse response;
+    MockClosure closure;
+    tablet.CreateTable(NULL, &request, &response, &closure);
+    ASSERT_EQ(0, response.code());
+    ::openmldb::api::PutBatchRequest prequest;
+    prequest.set_tid(id);
+    prequest.set_pid(1);
+    for (int ts = 9527; ts < 9540; ts++) {
+        ::openmldb::api::PutBatchRow* row = prequest.add_rows();
+        ::openmldb::api::Dimension* dim = row->add_dimensions();
+        dim->set_key("test1");
+        dim->set_idx(0);
+        row->set_time(ts);
+        row->set_value(::openmldb::test::EncodeKV("test1", "test" + std::to_string(ts)));
+    }
+    ::openmldb::api::PutBatchResponse presponse;
+    tablet.PutBatch(NULL, &prequest, &presponse, &closure);
+    ASSERT_EQ(0, presponse.code());
+    ASSERT_EQ(13, (signed)presponse.put_cnt());
+    ::openmldb::api::ScanRequest sr;
+    sr.set_tid(id);
+    sr.set_pid(1);
+    sr.set_pk("test1");
+    sr.set_st(0);
+    sr.set_et(0);
+    auto srp = std::make_shared<::openmldb::api::ScanResponse>();
+    tablet.Scan(NULL, &sr, srp.get(), &closure);
+    ASSERT_EQ(0, srp->code());
+    ASSERT_EQ(13, (signed)srp->count());
+    ::openmldb::base::ScanKvIterator kv_it(sr.pk(), srp);
+    ASSERT_EQ(9539, (signed)kv_it.GetKey());
+    ASSERT_STREQ("test9539", ::openmldb::test::DecodeV(kv_it.GetValue().ToString()).c_str());
+    // the dimension of an unknown index fails the batch
+    prequest.mutable_rows(3)->mutable_dimensions(0)->set_idx(10);
+    tablet.PutBatch(NULL, &prequest, &presponse, &closure);
+    ASSERT_EQ(::openmldb::base::ReturnCode::kInvalidDimensionParameter, presponse.code());
+    ASSERT_EQ(0, (signed)presponse.put_cnt());
+}
+
 TEST_P(TabletImplTest, Traverse) {
     ::openmldb::common::StorageMode storage_mode = GetParam();
     TabletImpl tablet;